@@ -21,8 +21,13 @@
 
 #include <log4cplus/logger.h>
 
+#include <exception>
+#include <future>
 #include <string>
 
+#include <boost/make_shared.hpp>
+
+#include "spotify/Error.hpp"
 #include "spotify/Image.hpp"
 #include "spotify/Session.hpp"
 #include "spotify/Artist.hpp"
@@ -36,6 +41,7 @@ Album::Album(boost::shared_ptr<Session> session) : album_(NULL), session_(sessio
 }
 
 Album::~Album() {
+    session_->albums_.Forget(album_);
     sp_album_release(album_);
 }
 
@@ -61,23 +67,38 @@ boost::shared_ptr<Image> Album::GetImage() {
     if (!album_id)
         return boost::shared_ptr<Image>();
 
-    boost::shared_ptr<Image> image = session_->CreateImage();
-
-    if (image->Load(album_id))
-        return image;
-    else
-        return boost::shared_ptr<Image>();
+    return session_->GetImage(album_id);
 }
 
 boost::shared_ptr<AlbumBrowse> Album::Browse() {
-    return boost::shared_ptr<AlbumBrowse>(new AlbumBrowse(session_,
-                                                          boost::dynamic_pointer_cast<Album>(shared_from_this())));
+    boost::shared_ptr<AlbumBrowse> browse = session_->browse_cache_->Find(album_);
+    if (!browse) {
+        browse.reset(new AlbumBrowse(session_, shared_from_this()));
+        session_->browse_cache_->Add(album_, browse);
+    }
+    return browse;
+}
+
+std::future<boost::shared_ptr<AlbumBrowse> > Album::BrowseAsync() {
+    boost::shared_ptr<std::promise<boost::shared_ptr<AlbumBrowse> > > result =
+        boost::make_shared<std::promise<boost::shared_ptr<AlbumBrowse> > >();
+    BrowseAsync([result](boost::shared_ptr<AlbumBrowse> browse, sp_error error) {
+        if (error == SP_ERROR_OK)
+            result->set_value(browse);
+        else
+            result->set_exception(std::make_exception_ptr(Error(error)));
+    });
+    return result->get_future();
+}
+
+boost::shared_ptr<AlbumBrowse> Album::BrowseAsync(
+    const boost::function<void (boost::shared_ptr<AlbumBrowse>, sp_error)> &continuation) { // NOLINT
+    boost::shared_ptr<AlbumBrowse> browse = Browse();
+    browse->connectToOnComplete(continuation);
+    return browse;
 }
 
 boost::shared_ptr<Artist> Album::GetArtist() {
-    sp_artist *sp_artist = sp_album_artist(album_);
-    boost::shared_ptr<Artist> artist = session_->CreateArtist();
-    artist->Load(sp_artist);
-    return artist;
+    return session_->GetArtist(sp_album_artist(album_));
 }
 }
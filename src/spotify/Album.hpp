@@ -22,9 +22,11 @@
 #include <libspotify/api.h>
 
 // std include
+#include <future>
 #include <string>
 
 // boost includes
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
@@ -47,8 +49,18 @@ class LIBSPOTIFYPP_API Album : public boost::enable_shared_from_this<Album> {
     virtual bool IsLoading();
 
     virtual std::string GetName();
+    /// @brief The large cover, shared through the ImageCache of the session. Empty while the album loads.
     virtual boost::shared_ptr<Image> GetImage();
+    /// @brief The browse of the session cache when one is in flight or recent enough, a new one otherwise, see
+    /// BrowseCache
     virtual boost::shared_ptr<AlbumBrowse> Browse();
+    /// @brief Starts a browse resolved from its complete callback, a failed one holds an Error with its sp_error.
+    /// Call it on the session thread like Browse, and do not wait on the future there. A browse still in flight when
+    /// the session shuts down is abandoned, its future reports a broken promise.
+    virtual std::future<boost::shared_ptr<AlbumBrowse> > BrowseAsync();
+    /// @brief Same, continuation is called on the session thread once the browse completes
+    virtual boost::shared_ptr<AlbumBrowse> BrowseAsync(
+        const boost::function<void (boost::shared_ptr<AlbumBrowse>, sp_error)> &continuation); // NOLINT
     virtual boost::shared_ptr<Artist> GetArtist();
 
   protected:
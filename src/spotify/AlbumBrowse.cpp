@@ -20,37 +20,70 @@
 #include <log4cplus/logger.h>
 
 #include <string>
+#include <vector>
 
 // local includes
 #include "spotify/Session.hpp"
 #include "spotify/Album.hpp"
 #include "spotify/Disc.hpp"
+#include "spotify/Trace.hpp"
 
 namespace spotify {
 namespace {
 log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.AlbumBrowse");
 }
 
-AlbumBrowse::AlbumBrowse(boost::shared_ptr<Session> session, boost::shared_ptr<Album> album) : session_(session)
-                                                                                             , album_(album)
-                                                                                             , album_browse_(NULL) {
-    album_browse_ = sp_albumbrowse_create(session->session_, album->album_, callback_albumbrowse_complete, this);
+AlbumBrowse::AlbumBrowse(boost::shared_ptr<Session> session, boost::shared_ptr<Album> album)
+    : session_(session), album_(album->album_), album_browse_(NULL), created_(std::chrono::steady_clock::now())
+    , is_complete_(false) {
+    sp_album_add_ref(album_);
+    album_browse_ = sp_albumbrowse_create(session->session_, album_, callback_albumbrowse_complete, this);
 }
 
 AlbumBrowse::~AlbumBrowse() {
     sp_albumbrowse_release(album_browse_);
+    sp_album_release(album_);
 }
 
 bool AlbumBrowse::IsLoading() {
     return !sp_albumbrowse_is_loaded(album_browse_);
 }
 
+sp_error AlbumBrowse::GetError() {
+    return sp_albumbrowse_error(album_browse_);
+}
+
+void AlbumBrowse::connectToOnComplete(const Continuation &callback) {
+    if (is_complete_) {
+        callback(shared_from_this(), GetError());
+        return;
+    }
+
+    if (continuations_.empty()) {
+        // nothing completes the browse once the session is gone
+        boost::shared_ptr<Session> session = session_.lock();
+        if (!session)
+            return;
+        session->pending_album_browses_.insert(this);
+        self_ = shared_from_this();
+    }
+    continuations_.push_back(callback);
+}
+
+void AlbumBrowse::Abandon() {
+    continuations_.clear();
+    boost::shared_ptr<AlbumBrowse> self;
+    self.swap(self_);
+}
+
 boost::shared_ptr<Album> AlbumBrowse::GetAlbum() {
-    return album_;
+    boost::shared_ptr<Session> session = session_.lock();
+    return session ? session->GetAlbum(album_) : boost::shared_ptr<Album>();
 }
 
 boost::shared_ptr<Artist> AlbumBrowse::GetArtist() {
-    return album_->GetArtist();
+    boost::shared_ptr<Album> album = GetAlbum();
+    return album ? album->GetArtist() : boost::shared_ptr<Artist>();
 }
 
 int AlbumBrowse::GetNumCopyrights() {
@@ -84,10 +117,29 @@ boost::shared_ptr<Disc> AlbumBrowse::GetDisc(int index) {
 }
 
 void SP_CALLCONV AlbumBrowse::callback_albumbrowse_complete(sp_albumbrowse *result, void *userdata) {
+    Trace::Record(TRACE_ALBUMBROWSE_COMPLETE, result);
     AlbumBrowse *album_browse = reinterpret_cast<AlbumBrowse *>(userdata);
 
     BOOST_ASSERT(album_browse->album_browse_ == result);
 
+    // gone only when the last Update runs from the destructor of the session
+    boost::shared_ptr<Session> session = album_browse->session_.lock();
+    if (session) {
+        session->metrics_->CountCallback(TRACE_ALBUMBROWSE_COMPLETE);
+        session->metrics_->RecordAlbumBrowse(Metrics::Clock::now() - album_browse->created_);
+        session->OnLoadProgress();
+        session->pending_album_browses_.erase(album_browse);
+    }
+    album_browse->is_complete_ = true;
     album_browse->OnComplete();
+
+    // the last reference may be self_, it goes once the continuations ran
+    boost::shared_ptr<AlbumBrowse> self;
+    self.swap(album_browse->self_);
+    std::vector<Continuation> continuations;
+    continuations.swap(album_browse->continuations_);
+    sp_error error = album_browse->GetError();
+    for (std::size_t i = 0; i < continuations.size(); ++i)
+        continuations[i](self, error);
 }
 }
@@ -22,10 +22,15 @@
 #include <libspotify/api.h>
 
 // std include
+#include <chrono>
 #include <string>
+#include <vector>
 
 // boost includes
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 
 #include "spotify/LibConfig.hpp"
 
@@ -37,12 +42,20 @@ class Artist;
 class Track;
 class Disc;
 
-class LIBSPOTIFYPP_API AlbumBrowse {
+/// @class AlbumBrowse
+/// @brief The result of sp_albumbrowse_create. The session keeps completed browses in its BrowseCache, so a browse
+/// only holds the session weakly; the wrappers it hands out are empty once the session is gone.
+class LIBSPOTIFYPP_API AlbumBrowse : public boost::enable_shared_from_this<AlbumBrowse> {
   public:
+    /// @brief Called on the session thread once the browse completes, error is SP_ERROR_OK or the reason it failed
+    typedef boost::function<void (boost::shared_ptr<AlbumBrowse> browse, sp_error error)> Continuation;
+
     AlbumBrowse(boost::shared_ptr<Session> session, boost::shared_ptr<Album> album);
     virtual ~AlbumBrowse();
 
     bool IsLoading();
+    /// @brief SP_ERROR_IS_LOADING until the browse completes, then SP_ERROR_OK or the reason it failed
+    sp_error GetError();
     boost::shared_ptr<Album> GetAlbum();
     boost::shared_ptr<Artist> GetArtist();
     int GetNumCopyrights();
@@ -53,14 +66,28 @@ class LIBSPOTIFYPP_API AlbumBrowse {
     int GetNumDiscs();
     boost::shared_ptr<Disc> GetDisc(int index);
 
+    // connection function for observers, called once when the browse completes or at once when it already has.
+    // The browse stays alive until then even when nothing else holds it, or until the session shuts down, which drops
+    // the callbacks of a browse still in flight.
+    void connectToOnComplete(const Continuation &callback); // NOLINT
+
   protected:
     virtual void OnComplete() {}
 
   private:
+    friend class Session;
+
+    // called by the session when it shuts down, nothing completes the browse anymore
+    void Abandon();
+
     static void SP_CALLCONV callback_albumbrowse_complete(sp_albumbrowse *result, void *userdata);
 
-    boost::shared_ptr<Session> session_;
-    boost::shared_ptr<Album> album_;
+    boost::weak_ptr<Session> session_;
+    sp_album *album_;  // referenced, the wrapper would hold the session
     sp_albumbrowse *album_browse_;
+    std::chrono::steady_clock::time_point created_;  // for the browse latency metric
+    bool is_complete_;  // the callback fired, libspotify may report the browse loaded before it does
+    std::vector<Continuation> continuations_;
+    boost::shared_ptr<AlbumBrowse> self_;  // while continuations_ is not empty
 };
 }
@@ -21,8 +21,15 @@
 
 #include <log4cplus/logger.h>
 
+#include <exception>
+#include <future>
 #include <string>
 
+#include <boost/make_shared.hpp>
+
+#include "spotify/Error.hpp"
+#include "spotify/Session.hpp"
+
 namespace spotify {
 namespace {
 log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.Artist");
@@ -32,6 +39,7 @@ Artist::Artist(boost::shared_ptr<Session> session) : artist_(NULL), session_(ses
 }
 
 Artist::~Artist() {
+    session_->artists_.Forget(artist_);
     sp_artist_release(artist_);
 }
 
@@ -48,8 +56,32 @@ std::string Artist::GetName() {
     return sp_artist_name(artist_);
 }
 
-boost::shared_ptr<ArtistBrowse> Artist::Browse() {
-    return boost::shared_ptr<ArtistBrowse>(new ArtistBrowse(session_,
-                                                            boost::dynamic_pointer_cast<Artist>(shared_from_this())));
+boost::shared_ptr<ArtistBrowse> Artist::Browse(sp_artistbrowse_type type) {
+    boost::shared_ptr<ArtistBrowse> browse = session_->browse_cache_->Find(artist_, type);
+    if (!browse) {
+        browse.reset(new ArtistBrowse(session_, shared_from_this(), type));
+        session_->browse_cache_->Add(artist_, type, browse);
+    }
+    return browse;
+}
+
+std::future<boost::shared_ptr<ArtistBrowse> > Artist::BrowseAsync(sp_artistbrowse_type type) {
+    boost::shared_ptr<std::promise<boost::shared_ptr<ArtistBrowse> > > result =
+        boost::make_shared<std::promise<boost::shared_ptr<ArtistBrowse> > >();
+    BrowseAsync([result](boost::shared_ptr<ArtistBrowse> browse, sp_error error) {
+        if (error == SP_ERROR_OK)
+            result->set_value(browse);
+        else
+            result->set_exception(std::make_exception_ptr(Error(error)));
+    }, type);
+    return result->get_future();
+}
+
+boost::shared_ptr<ArtistBrowse> Artist::BrowseAsync(
+    const boost::function<void (boost::shared_ptr<ArtistBrowse>, sp_error)> &continuation, // NOLINT
+    sp_artistbrowse_type type) {
+    boost::shared_ptr<ArtistBrowse> browse = Browse(type);
+    browse->connectToOnComplete(continuation);
+    return browse;
 }
 }
@@ -22,9 +22,11 @@
 #include <libspotify/api.h>
 
 // std include
+#include <future>
 #include <string>
 
 // boost includes
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
@@ -47,7 +49,17 @@ class LIBSPOTIFYPP_API Artist : public boost::enable_shared_from_this<Artist> {
 
     std::string GetName();
 
-    boost::shared_ptr<ArtistBrowse> Browse();
+    /// @brief The browse of the session cache when one of the same type is in flight or recent enough, a new one
+    /// otherwise, see BrowseCache
+    boost::shared_ptr<ArtistBrowse> Browse(sp_artistbrowse_type type = SP_ARTISTBROWSE_FULL);
+    /// @brief Starts a browse resolved from its complete callback, a failed one holds an Error with its sp_error.
+    /// Call it on the session thread like Browse, and do not wait on the future there. A browse still in flight when
+    /// the session shuts down is abandoned, its future reports a broken promise.
+    std::future<boost::shared_ptr<ArtistBrowse> > BrowseAsync(sp_artistbrowse_type type = SP_ARTISTBROWSE_FULL);
+    /// @brief Same, continuation is called on the session thread once the browse completes
+    boost::shared_ptr<ArtistBrowse> BrowseAsync(
+        const boost::function<void (boost::shared_ptr<ArtistBrowse>, sp_error)> &continuation, // NOLINT
+        sp_artistbrowse_type type = SP_ARTISTBROWSE_FULL);
 
   protected:
     friend class ArtistBrowse;
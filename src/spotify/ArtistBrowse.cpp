@@ -22,36 +22,64 @@
 #include <log4cplus/logger.h>
 
 #include <string>
+#include <vector>
 
 #include "spotify/Session.hpp"
 #include "spotify/Artist.hpp"
+#include "spotify/Trace.hpp"
 
 namespace spotify {
 namespace {
 log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.ArtistBrowse");
 }
 
-ArtistBrowse::ArtistBrowse(boost::shared_ptr<Session> session, boost::shared_ptr<Artist> artist)
-    : session_(session) , artist_(artist) , artist_browse_(NULL) {
-    artist_browse_ = sp_artistbrowse_create(session->session_, artist->artist_, SP_ARTISTBROWSE_FULL,
-                                            callback_artistbrowse_complete, this);
+ArtistBrowse::ArtistBrowse(boost::shared_ptr<Session> session, boost::shared_ptr<Artist> artist,
+                           sp_artistbrowse_type type)
+    : session_(session), artist_(artist->artist_), artist_browse_(NULL), created_(std::chrono::steady_clock::now())
+    , is_complete_(false) {
+    sp_artist_add_ref(artist_);
+    artist_browse_ = sp_artistbrowse_create(session->session_, artist_, type, callback_artistbrowse_complete, this);
 }
 
 ArtistBrowse::~ArtistBrowse() {
     sp_artistbrowse_release(artist_browse_);
+    sp_artist_release(artist_);
 }
 
 bool ArtistBrowse::IsLoading() {
     return !sp_artistbrowse_is_loaded(artist_browse_);
 }
 
-boost::shared_ptr<Artist> ArtistBrowse::GetArtist() {
-    sp_artist *sp_artist = sp_artistbrowse_artist(artist_browse_);
+sp_error ArtistBrowse::GetError() {
+    return sp_artistbrowse_error(artist_browse_);
+}
 
-    boost::shared_ptr<Artist> artist = session_->CreateArtist();
-    artist->Load(sp_artist);
+void ArtistBrowse::connectToOnComplete(const Continuation &callback) {
+    if (is_complete_) {
+        callback(shared_from_this(), GetError());
+        return;
+    }
 
-    return artist;
+    if (continuations_.empty()) {
+        // nothing completes the browse once the session is gone
+        boost::shared_ptr<Session> session = session_.lock();
+        if (!session)
+            return;
+        session->pending_artist_browses_.insert(this);
+        self_ = shared_from_this();
+    }
+    continuations_.push_back(callback);
+}
+
+void ArtistBrowse::Abandon() {
+    continuations_.clear();
+    boost::shared_ptr<ArtistBrowse> self;
+    self.swap(self_);
+}
+
+boost::shared_ptr<Artist> ArtistBrowse::GetArtist() {
+    boost::shared_ptr<Session> session = session_.lock();
+    return session ? session->GetArtist(sp_artistbrowse_artist(artist_browse_)) : boost::shared_ptr<Artist>();
 }
 
 int ArtistBrowse::GetNumPortraits() {
@@ -59,11 +87,8 @@ int ArtistBrowse::GetNumPortraits() {
 }
 
 boost::shared_ptr<Image> ArtistBrowse::GetPortrait(int index) {
-    boost::shared_ptr<Image> image = session_->CreateImage();
-
-    image->Load(sp_artistbrowse_portrait(artist_browse_, index));
-
-    return image;
+    boost::shared_ptr<Session> session = session_.lock();
+    return session ? session->GetImage(sp_artistbrowse_portrait(artist_browse_, index)) : boost::shared_ptr<Image>();
 }
 
 int ArtistBrowse::GetNumTracks() {
@@ -71,13 +96,8 @@ int ArtistBrowse::GetNumTracks() {
 }
 
 boost::shared_ptr<Track> ArtistBrowse::GetTrack(int index) {
-    boost::shared_ptr<Track> track = session_->CreateTrack();
-
-    sp_track *sp_track = sp_artistbrowse_track(artist_browse_, index);
-
-    track->Load(sp_track);
-
-    return track;
+    boost::shared_ptr<Session> session = session_.lock();
+    return session ? session->GetTrack(sp_artistbrowse_track(artist_browse_, index)) : boost::shared_ptr<Track>();
 }
 
 int ArtistBrowse::GetNumAlbums() {
@@ -85,13 +105,8 @@ int ArtistBrowse::GetNumAlbums() {
 }
 
 boost::shared_ptr<Album> ArtistBrowse::GetAlbum(int index) {
-    boost::shared_ptr<Album> album = session_->CreateAlbum();
-
-    sp_album *sp_album = sp_artistbrowse_album(artist_browse_, index);
-
-    album->Load(sp_album);
-
-    return album;
+    boost::shared_ptr<Session> session = session_.lock();
+    return session ? session->GetAlbum(sp_artistbrowse_album(artist_browse_, index)) : boost::shared_ptr<Album>();
 }
 
 int ArtistBrowse::GetNumSimilarArtists() {
@@ -99,12 +114,9 @@ int ArtistBrowse::GetNumSimilarArtists() {
 }
 
 boost::shared_ptr<Artist> ArtistBrowse::GetSimilarArtist(int index) {
-    boost::shared_ptr<Artist> artist = session_->CreateArtist();
-
-    sp_artist *sp_rtist = sp_artistbrowse_similar_artist(artist_browse_, index);
-    artist->Load(sp_rtist);
-
-    return artist;
+    boost::shared_ptr<Session> session = session_.lock();
+    return session ? session->GetArtist(sp_artistbrowse_similar_artist(artist_browse_, index))
+                   : boost::shared_ptr<Artist>();
 }
 
 std::string ArtistBrowse::GetBiography() {
@@ -114,10 +126,29 @@ std::string ArtistBrowse::GetBiography() {
 }
 
 void SP_CALLCONV ArtistBrowse::callback_artistbrowse_complete(sp_artistbrowse *result, void *userdata) {
+    Trace::Record(TRACE_ARTISTBROWSE_COMPLETE, result);
     ArtistBrowse *artist_browse = reinterpret_cast<ArtistBrowse *>(userdata);
 
     BOOST_ASSERT(artist_browse->artist_browse_ == result);
 
+    // gone only when the last Update runs from the destructor of the session
+    boost::shared_ptr<Session> session = artist_browse->session_.lock();
+    if (session) {
+        session->metrics_->CountCallback(TRACE_ARTISTBROWSE_COMPLETE);
+        session->metrics_->RecordArtistBrowse(Metrics::Clock::now() - artist_browse->created_);
+        session->OnLoadProgress();
+        session->pending_artist_browses_.erase(artist_browse);
+    }
+    artist_browse->is_complete_ = true;
     artist_browse->OnComplete();
+
+    // the last reference may be self_, it goes once the continuations ran
+    boost::shared_ptr<ArtistBrowse> self;
+    self.swap(artist_browse->self_);
+    std::vector<Continuation> continuations;
+    continuations.swap(artist_browse->continuations_);
+    sp_error error = artist_browse->GetError();
+    for (std::size_t i = 0; i < continuations.size(); ++i)
+        continuations[i](self, error);
 }
 }
@@ -22,10 +22,15 @@
 #include <libspotify/api.h>
 
 // std include
+#include <chrono>
 #include <string>
+#include <vector>
 
 // boost includes
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 
 // local includes
 #include "spotify/LibConfig.hpp"
@@ -38,12 +43,21 @@ namespace spotify {
 class Session;
 class Artist;
 
-class LIBSPOTIFYPP_API ArtistBrowse {
+/// @class ArtistBrowse
+/// @brief The result of sp_artistbrowse_create. The session keeps completed browses in its BrowseCache, so a browse
+/// only holds the session weakly; the wrappers it hands out are empty once the session is gone.
+class LIBSPOTIFYPP_API ArtistBrowse : public boost::enable_shared_from_this<ArtistBrowse> {
   public:
-    ArtistBrowse(boost::shared_ptr<Session> session, boost::shared_ptr<Artist> artist);
+    /// @brief Called on the session thread once the browse completes, error is SP_ERROR_OK or the reason it failed
+    typedef boost::function<void (boost::shared_ptr<ArtistBrowse> browse, sp_error error)> Continuation;
+
+    ArtistBrowse(boost::shared_ptr<Session> session, boost::shared_ptr<Artist> artist,
+                 sp_artistbrowse_type type = SP_ARTISTBROWSE_FULL);
     virtual ~ArtistBrowse();
 
     bool IsLoading();
+    /// @brief SP_ERROR_IS_LOADING until the browse completes, then SP_ERROR_OK or the reason it failed
+    sp_error GetError();
 
     boost::shared_ptr<Artist> GetArtist();
 
@@ -61,14 +75,28 @@ class LIBSPOTIFYPP_API ArtistBrowse {
 
     std::string GetBiography();
 
+    // connection function for observers, called once when the browse completes or at once when it already has.
+    // The browse stays alive until then even when nothing else holds it, or until the session shuts down, which drops
+    // the callbacks of a browse still in flight.
+    void connectToOnComplete(const Continuation &callback); // NOLINT
+
   protected:
     virtual void OnComplete() {}
 
   private:
+    friend class Session;
+
+    // called by the session when it shuts down, nothing completes the browse anymore
+    void Abandon();
+
     static void SP_CALLCONV callback_artistbrowse_complete(sp_artistbrowse *result, void *userdata);
 
-    boost::shared_ptr<Session> session_;
-    boost::shared_ptr<Artist> artist_;
+    boost::weak_ptr<Session> session_;
+    sp_artist *artist_;  // referenced, the wrapper would hold the session
     sp_artistbrowse *artist_browse_;
+    std::chrono::steady_clock::time_point created_;  // for the browse latency metric
+    bool is_complete_;  // the callback fired, libspotify may report the browse loaded before it does
+    std::vector<Continuation> continuations_;
+    boost::shared_ptr<ArtistBrowse> self_;  // while continuations_ is not empty
 };
 }
@@ -0,0 +1,306 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/AsyncLog.hpp"
+
+#include <cstring>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace spotify {
+namespace {
+// how long the logging thread sleeps when it missed a wake up
+const int kIdleWaitMs = 50;
+
+std::size_t RoundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 2;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+struct State {
+    State() : queue(NULL), starts(0), running(false), idle(false), submitted(0), written(0), dropped(0) {}
+
+    boost::mutex mutex;  // guards the fields up to thread, and is waited on by the idle logging thread
+    boost::condition_variable wake;
+    LogQueue *queue;  // never destroyed, producers may still hold it after Stop
+    int starts;
+    boost::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> idle;
+    std::atomic<std::uint64_t> submitted;
+    std::atomic<std::uint64_t> written;
+    std::atomic<std::uint64_t> dropped;
+};
+
+// never destroyed, threads may still log while static destructors run
+State &GetState() {
+    static State *state = new State();
+    return *state;
+}
+
+void Drain(State *state) {
+    LogRecord record;
+    for (;;) {
+        while (state->queue->TryPop(&record)) {
+            record.Log();
+            state->written.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (!state->running.load(std::memory_order_acquire))
+            break;
+
+        boost::unique_lock<boost::mutex> lock(state->mutex);
+        state->idle.store(true, std::memory_order_seq_cst);
+        if (state->running.load(std::memory_order_acquire))
+            state->wake.timed_wait(lock, boost::posix_time::millisec(kIdleWaitMs));
+        state->idle.store(false, std::memory_order_relaxed);
+    }
+
+    // records pushed while the thread was stopping
+    while (state->queue->TryPop(&record)) {
+        record.Log();
+        state->written.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+}
+
+LogRecord::LogRecord()
+    : logger_(NULL), level_(log4cplus::NOT_SET_LOG_LEVEL), file_(NULL), line_(0), format_(""), num_arguments_(0)
+    , text_size_(0) {
+}
+
+LogRecord::LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+                     const char *format) {
+    Init(logger, level, file, line, format);
+}
+
+void LogRecord::Init(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+                     const char *format) {
+    logger_ = logger;
+    level_ = level;
+    file_ = file;
+    line_ = line;
+    format_ = format;
+    num_arguments_ = 0;
+    text_size_ = 0;
+}
+
+std::string LogRecord::Format() const {
+    boost::format format(format_);
+    format.exceptions(boost::io::no_error_bits);
+    for (std::size_t i = 0; i < num_arguments_; ++i) {
+        const LogArgument &argument = arguments_[i];
+        switch (argument.type) {
+        case LogArgument::INTEGER:
+            format % argument.integer;
+            break;
+        case LogArgument::UNSIGNED:
+            format % argument.unsigned_integer;
+            break;
+        case LogArgument::REAL:
+            format % argument.real;
+            break;
+        case LogArgument::POINTER:
+            format % argument.pointer;
+            break;
+        case LogArgument::TEXT:
+            format % (text_ + argument.text_offset);
+            break;
+        }
+    }
+    return format.str();
+}
+
+void LogRecord::Log() const {
+    if (logger_)
+        logger_->forcedLog(level_, Format(), file_, line_);
+}
+
+void LogRecord::Add(int value) {
+    Next(LogArgument::INTEGER).integer = value;
+}
+
+void LogRecord::Add(long value) {  // NOLINT
+    Next(LogArgument::INTEGER).integer = value;
+}
+
+void LogRecord::Add(long long value) {  // NOLINT
+    Next(LogArgument::INTEGER).integer = value;
+}
+
+void LogRecord::Add(unsigned int value) {
+    Next(LogArgument::UNSIGNED).unsigned_integer = value;
+}
+
+void LogRecord::Add(unsigned long value) {  // NOLINT
+    Next(LogArgument::UNSIGNED).unsigned_integer = value;
+}
+
+void LogRecord::Add(unsigned long long value) {  // NOLINT
+    Next(LogArgument::UNSIGNED).unsigned_integer = value;
+}
+
+void LogRecord::Add(double value) {
+    Next(LogArgument::REAL).real = value;
+}
+
+void LogRecord::Add(const char *value) {
+    if (value)
+        AddText(value, std::strlen(value));
+    else
+        AddText("(null)", 6);
+}
+
+void LogRecord::Add(char *value) {
+    Add(static_cast<const char *>(value));
+}
+
+void LogRecord::Add(const std::string &value) {
+    AddText(value.c_str(), value.size());
+}
+
+LogArgument &LogRecord::Next(LogArgument::Type type) {
+    LogArgument &argument = arguments_[num_arguments_++];
+    argument.type = type;
+    return argument;
+}
+
+void LogRecord::AddText(const char *value, std::size_t size) {
+    // every string keeps its terminator, the last one is truncated to what is left of the buffer
+    if (text_size_ >= kTextSize) {
+        Next(LogArgument::TEXT).text_offset = kTextSize - 1;  // the terminator of the truncated string
+        return;
+    }
+    std::size_t available = kTextSize - text_size_ - 1;
+    if (size > available)
+        size = available;
+
+    Next(LogArgument::TEXT).text_offset = text_size_;
+    std::memcpy(text_ + text_size_, value, size);
+    text_[text_size_ + size] = '\0';
+    text_size_ += size + 1;
+}
+
+LogQueue::LogQueue(std::size_t capacity)
+    : cells_(RoundUpToPowerOfTwo(capacity)), mask_(cells_.size() - 1), push_position_(0), pop_position_(0) {
+    for (std::size_t i = 0; i < cells_.size(); ++i)
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool LogQueue::TryPush(const LogRecord &record) {
+    std::size_t position = push_position_.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell &cell = cells_[position & mask_];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+        if (difference == 0) {
+            if (push_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                cell.record = record;
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            return false;  // full
+        } else {
+            position = push_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool LogQueue::TryPop(LogRecord *record) {
+    std::size_t position = pop_position_.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell &cell = cells_[position & mask_];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+        if (difference == 0) {
+            if (pop_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                *record = cell.record;
+                cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            return false;  // empty
+        } else {
+            position = pop_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::size_t LogQueue::GetCapacity() const {
+    return cells_.size();
+}
+
+void AsyncLog::Start(std::size_t capacity) {
+    State &state = GetState();
+    boost::lock_guard<boost::mutex> lock(state.mutex);
+    if (state.starts++)
+        return;
+
+    if (!state.queue)
+        state.queue = new LogQueue(capacity);
+    state.running.store(true, std::memory_order_release);
+    state.thread = boost::thread(Drain, &state);
+}
+
+void AsyncLog::Stop() {
+    State &state = GetState();
+    {
+        boost::lock_guard<boost::mutex> lock(state.mutex);
+        if (!state.starts || --state.starts)
+            return;
+        state.running.store(false, std::memory_order_release);
+    }
+    state.wake.notify_one();
+    state.thread.join();
+}
+
+bool AsyncLog::IsRunning() {
+    return GetState().running.load(std::memory_order_acquire);
+}
+
+void AsyncLog::Write(const LogRecord &record) {
+    State &state = GetState();
+    if (!state.running.load(std::memory_order_acquire)) {
+        record.Log();
+        return;
+    }
+
+    if (!state.queue->TryPush(record)) {
+        state.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    state.submitted.fetch_add(1, std::memory_order_relaxed);
+    // only a logging thread gone idle needs the notification
+    if (state.idle.load(std::memory_order_seq_cst))
+        state.wake.notify_one();
+}
+
+AsyncLogCounters AsyncLog::GetCounters() {
+    State &state = GetState();
+    AsyncLogCounters counters;
+    counters.submitted = state.submitted.load(std::memory_order_relaxed);
+    counters.written = state.written.load(std::memory_order_relaxed);
+    counters.dropped = state.dropped.load(std::memory_order_relaxed);
+    return counters;
+}
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// C-libs includes
+#include <cstddef>
+#include <cstdint>
+
+// std includes
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <log4cplus/logger.h>
+#include <log4cplus/loglevel.h>
+
+#include "spotify/LibConfig.hpp"
+
+// LIBSPOTIFYPP_LOG_* take a logger, a boost::format string literal and up to LogRecord::kMaxArguments arguments.
+// Nothing is evaluated when the level is disabled, and the message is only formatted when written, see AsyncLog.
+#define LIBSPOTIFYPP_LOG(logger, level, ...) \
+    do { \
+        if ((logger).isEnabledFor(level)) \
+            ::spotify::AsyncLog::Write(::spotify::LogRecord(&(logger), level, __FILE__, __LINE__, __VA_ARGS__)); \
+    } while (0)
+
+// trace statements are compiled out of release builds, define LIBSPOTIFYPP_TRACE_LOGS to keep them
+#if defined(NDEBUG) && !defined(LIBSPOTIFYPP_TRACE_LOGS)
+#define LIBSPOTIFYPP_LOG_TRACE(logger, ...) do {} while (0)
+#else
+#define LIBSPOTIFYPP_LOG_TRACE(logger, ...) LIBSPOTIFYPP_LOG(logger, log4cplus::TRACE_LOG_LEVEL, __VA_ARGS__)
+#endif
+#define LIBSPOTIFYPP_LOG_DEBUG(logger, ...) LIBSPOTIFYPP_LOG(logger, log4cplus::DEBUG_LOG_LEVEL, __VA_ARGS__)
+#define LIBSPOTIFYPP_LOG_INFO(logger, ...) LIBSPOTIFYPP_LOG(logger, log4cplus::INFO_LOG_LEVEL, __VA_ARGS__)
+#define LIBSPOTIFYPP_LOG_WARN(logger, ...) LIBSPOTIFYPP_LOG(logger, log4cplus::WARN_LOG_LEVEL, __VA_ARGS__)
+#define LIBSPOTIFYPP_LOG_ERROR(logger, ...) LIBSPOTIFYPP_LOG(logger, log4cplus::ERROR_LOG_LEVEL, __VA_ARGS__)
+
+namespace spotify {
+/// @brief One argument of a log record, captured by value
+struct LIBSPOTIFYPP_API LogArgument {
+    enum Type {
+        INTEGER,
+        UNSIGNED,
+        REAL,
+        POINTER,
+        TEXT
+    };
+
+    Type type;
+    union {
+        std::int64_t integer;
+        std::uint64_t unsigned_integer;
+        double real;
+        const void *pointer;
+        std::size_t text_offset;  // copy of the string in LogRecord::text
+    };
+};
+
+/// @class LogRecord
+/// @brief A log statement with its arguments captured, formatted only when it is written.
+///
+/// The record is a fixed size value: string arguments are copied in an inline buffer, truncated when it is full, so
+/// capturing never allocates. The format and the file must be literals, only their pointers are kept.
+class LIBSPOTIFYPP_API LogRecord {
+  public:
+    static const std::size_t kMaxArguments = 6;
+    static const std::size_t kTextSize = 192;
+
+    LogRecord();
+
+    // one constructor per number of arguments, up to kMaxArguments, VC++ 2012 has no variadic templates
+    LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+              const char *format);
+    template <typename A0>
+    LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+              const char *format, const A0 &a0);
+    template <typename A0, typename A1>
+    LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+              const char *format, const A0 &a0, const A1 &a1);
+    template <typename A0, typename A1, typename A2>
+    LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+              const char *format, const A0 &a0, const A1 &a1, const A2 &a2);
+    template <typename A0, typename A1, typename A2, typename A3>
+    LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+              const char *format, const A0 &a0, const A1 &a1, const A2 &a2, const A3 &a3);
+    template <typename A0, typename A1, typename A2, typename A3, typename A4>
+    LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+              const char *format, const A0 &a0, const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4);
+    template <typename A0, typename A1, typename A2, typename A3, typename A4, typename A5>
+    LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+              const char *format, const A0 &a0, const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4,
+              const A5 &a5);
+
+    std::string Format() const;
+    /// @brief Formats the record and hands it to the appenders of its logger
+    void Log() const;
+
+  private:
+    void Init(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+              const char *format);
+
+    void Add(int value);
+    void Add(long value);  // NOLINT
+    void Add(long long value);  // NOLINT
+    void Add(unsigned int value);
+    void Add(unsigned long value);  // NOLINT
+    void Add(unsigned long long value);  // NOLINT
+    void Add(double value);
+    void Add(const char *value);
+    void Add(char *value);
+    void Add(const std::string &value);
+    template <typename T>
+    void Add(const T *value);
+
+    LogArgument &Next(LogArgument::Type type);
+    void AddText(const char *value, std::size_t size);
+
+    const log4cplus::Logger *logger_;
+    log4cplus::LogLevel level_;
+    const char *file_;
+    int line_;
+    const char *format_;
+    std::size_t num_arguments_;
+    LogArgument arguments_[kMaxArguments];
+    std::size_t text_size_;
+    char text_[kTextSize];
+};
+
+/// @class LogQueue
+/// @brief Bounded lock-free queue of log records for many producers and one consumer, after Dmitry Vyukov's
+/// bounded MPMC queue. Pushing to a full queue fails instead of waiting.
+class LIBSPOTIFYPP_API LogQueue {
+  public:
+    /// @brief capacity is rounded up to a power of two
+    explicit LogQueue(std::size_t capacity);
+
+    bool TryPush(const LogRecord &record);
+    bool TryPop(LogRecord *record);
+
+    std::size_t GetCapacity() const;
+
+  private:
+    LogQueue(const LogQueue &);
+    LogQueue &operator=(const LogQueue &);
+
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        LogRecord record;
+    };
+
+    std::vector<Cell> cells_;
+    std::size_t mask_;
+    std::atomic<std::size_t> push_position_;
+    std::atomic<std::size_t> pop_position_;
+};
+
+/// @brief Totals of the async logging path since the program started
+struct LIBSPOTIFYPP_API AsyncLogCounters {
+    std::uint64_t submitted;  // records queued
+    std::uint64_t written;    // records handed to log4cplus by the logging thread
+    std::uint64_t dropped;    // records lost because the queue was full
+};
+
+/// @class AsyncLog
+/// @brief Moves log I/O off the calling threads.
+///
+/// While started, LIBSPOTIFYPP_LOG_* statements only capture their arguments into a LogQueue, a background thread
+/// formats them and calls the log4cplus appenders, so a slow appender never stalls the libspotify callbacks. When
+/// the queue is full the record is dropped and counted. Otherwise the statements log synchronously, like
+/// LOG4CPLUS_*. Starts are counted, the last Stop writes the records still queued and joins the thread.
+class LIBSPOTIFYPP_API AsyncLog {
+  public:
+    static const std::size_t kDefaultCapacity = 4096;
+
+    /// @brief The queue is created by the first Start, the capacity of later ones is ignored
+    static void Start(std::size_t capacity = kDefaultCapacity);
+    static void Stop();
+    static bool IsRunning();
+
+    static void Write(const LogRecord &record);
+
+    static AsyncLogCounters GetCounters();
+
+  private:
+    AsyncLog();
+};
+
+template <typename A0>
+LogRecord::LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+                     const char *format, const A0 &a0) {
+    Init(logger, level, file, line, format);
+    Add(a0);
+}
+
+template <typename A0, typename A1>
+LogRecord::LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+                     const char *format, const A0 &a0, const A1 &a1) {
+    Init(logger, level, file, line, format);
+    Add(a0);
+    Add(a1);
+}
+
+template <typename A0, typename A1, typename A2>
+LogRecord::LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+                     const char *format, const A0 &a0, const A1 &a1, const A2 &a2) {
+    Init(logger, level, file, line, format);
+    Add(a0);
+    Add(a1);
+    Add(a2);
+}
+
+template <typename A0, typename A1, typename A2, typename A3>
+LogRecord::LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+                     const char *format, const A0 &a0, const A1 &a1, const A2 &a2, const A3 &a3) {
+    Init(logger, level, file, line, format);
+    Add(a0);
+    Add(a1);
+    Add(a2);
+    Add(a3);
+}
+
+template <typename A0, typename A1, typename A2, typename A3, typename A4>
+LogRecord::LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+                     const char *format, const A0 &a0, const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4) {
+    Init(logger, level, file, line, format);
+    Add(a0);
+    Add(a1);
+    Add(a2);
+    Add(a3);
+    Add(a4);
+}
+
+template <typename A0, typename A1, typename A2, typename A3, typename A4, typename A5>
+LogRecord::LogRecord(const log4cplus::Logger *logger, log4cplus::LogLevel level, const char *file, int line,
+                     const char *format, const A0 &a0, const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4,
+                     const A5 &a5) {
+    Init(logger, level, file, line, format);
+    Add(a0);
+    Add(a1);
+    Add(a2);
+    Add(a3);
+    Add(a4);
+    Add(a5);
+}
+
+template <typename T>
+void LogRecord::Add(const T *value) {
+    Next(LogArgument::POINTER).pointer = value;
+}
+}
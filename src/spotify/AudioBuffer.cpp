@@ -0,0 +1,194 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/AudioBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace spotify {
+namespace {
+std::size_t RoundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+}
+
+AudioBuffer::AudioBuffer(std::size_t capacity) : samples_(), capacity_(RoundUpToPowerOfTwo(std::max<std::size_t>(
+                                                     capacity, 1))), mask_(capacity_ - 1), write_(0)
+                                               , cached_read_(0), channels_(kMaxChannels), sample_rate_(44100)
+                                               , backpressure_(0), peak_frames_(0), reported_underruns_(0), read_(0)
+                                               , cached_write_(0), draining_(false), underruns_(0), flush_to_(0)
+                                               , playing_(false) {
+    static_assert(offsetof(AudioBuffer, write_) >= offsetof(AudioBuffer, mask_) + sizeof(mask_) + kCacheLine,
+                  "the producer fields share a cache line with the read only ones");
+    static_assert(offsetof(AudioBuffer, read_) >= offsetof(AudioBuffer, reported_underruns_) +
+                  sizeof(reported_underruns_) + kCacheLine, "the consumer fields share a cache line with the producer");
+    static_assert(offsetof(AudioBuffer, flush_to_) >= offsetof(AudioBuffer, underruns_) + sizeof(underruns_) +
+                  kCacheLine, "the flush target shares a cache line with the consumer");
+    samples_.resize(capacity_ * kMaxChannels);
+}
+
+AudioBuffer::~AudioBuffer() {
+}
+
+std::size_t AudioBuffer::Wrap(std::uint64_t index) const {
+    return static_cast<std::size_t>(index & mask_);
+}
+
+int AudioBuffer::Write(const sp_audioformat &format, const void *frames, int num_frames) {
+    if (num_frames <= 0) {
+        Flush();
+        return 0;
+    }
+
+    // nothing else is ever delivered by libspotify, drop it rather than stall the pipeline
+    if (format.sample_type != SP_SAMPLETYPE_INT16_NATIVE_ENDIAN || format.channels < 1 ||
+        format.channels > kMaxChannels)
+        return num_frames;
+
+    std::uint64_t write = write_.load(std::memory_order_relaxed);
+
+    // a new format can only be taken once the consumer has drained the frames of the previous one
+    if (format.channels != channels_.load(std::memory_order_relaxed) ||
+        format.sample_rate != sample_rate_.load(std::memory_order_relaxed)) {
+        cached_read_ = read_.load(std::memory_order_acquire);
+        if (cached_read_ != write)
+            return 0;
+        channels_.store(format.channels, std::memory_order_relaxed);
+        sample_rate_.store(format.sample_rate, std::memory_order_relaxed);
+    }
+
+    std::size_t free = capacity_ - static_cast<std::size_t>(write - cached_read_);
+    if (free < static_cast<std::size_t>(num_frames)) {
+        cached_read_ = read_.load(std::memory_order_acquire);
+        free = capacity_ - static_cast<std::size_t>(write - cached_read_);
+    }
+
+    std::size_t count = std::min(free, static_cast<std::size_t>(num_frames));
+    // libspotify keeps what did not fit and offers it again, this is flow control rather than lost audio
+    if (count < static_cast<std::size_t>(num_frames))
+        backpressure_.store(backpressure_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (count == 0)
+        return 0;
+
+    const std::int16_t *in = reinterpret_cast<const std::int16_t *>(frames);
+    std::size_t channels = format.channels;
+    std::size_t start = Wrap(write);
+    std::size_t first = std::min(count, capacity_ - start);
+    std::memcpy(&samples_[start * channels], in, first * channels * sizeof(std::int16_t));
+    if (first < count)
+        std::memcpy(&samples_[0], in + first * channels, (count - first) * channels * sizeof(std::int16_t));
+
+    write_.store(write + count, std::memory_order_release);
+
+    // the cached read index may be stale, which overstates the fill, so refresh it before raising the peak
+    std::size_t peak = peak_frames_.load(std::memory_order_relaxed);
+    if (static_cast<std::size_t>(write + count - cached_read_) > peak) {
+        cached_read_ = read_.load(std::memory_order_acquire);
+        std::size_t fill = static_cast<std::size_t>(write + count - cached_read_);
+        if (fill > peak)
+            peak_frames_.store(fill, std::memory_order_relaxed);
+    }
+    return static_cast<int>(count);
+}
+
+void AudioBuffer::ApplyFlush(std::uint64_t *read) {
+    std::uint64_t flush_to = flush_to_.load(std::memory_order_acquire);
+    if (flush_to > *read) {
+        *read = flush_to;
+        draining_ = false;
+    }
+}
+
+int AudioBuffer::Read(std::int16_t *out, int max_frames) {
+    std::uint64_t read = read_.load(std::memory_order_relaxed);
+    ApplyFlush(&read);
+
+    std::size_t available = static_cast<std::size_t>(cached_write_ - read);
+    if (cached_write_ < read || available < static_cast<std::size_t>(max_frames)) {
+        cached_write_ = write_.load(std::memory_order_acquire);
+        available = static_cast<std::size_t>(cached_write_ - read);
+    }
+
+    std::size_t count = std::min(available, static_cast<std::size_t>(std::max(max_frames, 0)));
+    if (count < static_cast<std::size_t>(std::max(max_frames, 0))) {
+        // running dry only counts once per stretch of playback, a silent device keeps polling an empty buffer
+        if ((draining_ || count > 0) && playing_.load(std::memory_order_relaxed))
+            underruns_.store(underruns_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        draining_ = false;
+    } else if (count > 0) {
+        draining_ = true;
+    }
+    if (count > 0) {
+        std::size_t channels = channels_.load(std::memory_order_relaxed);
+        std::size_t start = Wrap(read);
+        std::size_t first = std::min(count, capacity_ - start);
+        std::memcpy(out, &samples_[start * channels], first * channels * sizeof(std::int16_t));
+        if (first < count)
+            std::memcpy(out + first * channels, &samples_[0], (count - first) * channels * sizeof(std::int16_t));
+    }
+
+    read_.store(read + count, std::memory_order_release);
+    return static_cast<int>(count);
+}
+
+void AudioBuffer::Flush() {
+    std::uint64_t write = write_.load(std::memory_order_acquire);
+    std::uint64_t flush_to = flush_to_.load(std::memory_order_relaxed);
+    while (flush_to < write && !flush_to_.compare_exchange_weak(flush_to, write, std::memory_order_release)) {
+    }
+}
+
+void AudioBuffer::SetPlaying(bool playing) {
+    playing_.store(playing, std::memory_order_relaxed);
+}
+
+sp_audioformat AudioBuffer::GetFormat() const {
+    sp_audioformat format;
+    format.sample_type = SP_SAMPLETYPE_INT16_NATIVE_ENDIAN;
+    format.sample_rate = sample_rate_.load(std::memory_order_relaxed);
+    format.channels = channels_.load(std::memory_order_relaxed);
+    return format;
+}
+
+std::size_t AudioBuffer::GetCapacity() const {
+    return capacity_;
+}
+
+std::size_t AudioBuffer::GetReadableFrames() const {
+    std::uint64_t read = std::max(read_.load(std::memory_order_acquire), flush_to_.load(std::memory_order_acquire));
+    std::uint64_t write = write_.load(std::memory_order_acquire);
+    return write > read ? static_cast<std::size_t>(write - read) : 0;
+}
+
+void AudioBuffer::GetStats(sp_audio_buffer_stats *stats) {
+    std::uint64_t underruns = underruns_.load(std::memory_order_relaxed);
+    stats->samples = static_cast<int>(GetReadableFrames());
+    stats->stutter = static_cast<int>(underruns - reported_underruns_);
+    reported_underruns_ = underruns;
+}
+
+AudioBufferCounters AudioBuffer::GetCounters() const {
+    AudioBufferCounters counters;
+    counters.underruns = underruns_.load(std::memory_order_relaxed);
+    counters.backpressure = backpressure_.load(std::memory_order_relaxed);
+    counters.peak_frames = peak_frames_.load(std::memory_order_relaxed);
+    return counters;
+}
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// C-libs includes
+#include <cstdint>
+#include <cstddef>
+
+// std includes
+#include <vector>
+#include <atomic>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+/// @brief Cumulative counters of an AudioBuffer since it was created
+struct LIBSPOTIFYPP_API AudioBufferCounters {
+    std::uint64_t underruns;     // times the buffer ran dry under a playing reader
+    std::uint64_t backpressure;  // deliveries cut short because the buffer was full, libspotify's flow control
+    std::size_t peak_frames;     // highest number of frames buffered at once
+};
+
+/// @class AudioBuffer
+/// @brief Single producer, single consumer ring of PCM frames between music_delivery and the audio thread.
+///
+/// Write is called from the libspotify delivery thread and Read from the application audio thread. Neither takes a
+/// lock nor allocates, the storage is allocated once in the constructor. Write only accepts the frames that fit, so
+/// libspotify keeps the rest and delivers them again later.
+class LIBSPOTIFYPP_API AudioBuffer {
+  public:
+    static const int kMaxChannels = 2;
+
+    /// @param capacity number of frames, rounded up to a power of two
+    explicit AudioBuffer(std::size_t capacity);
+    ~AudioBuffer();
+
+    /// @brief Producer side, returns the number of frames accepted. A call with no frames flushes the buffer, as
+    /// libspotify does after a seek.
+    int Write(const sp_audioformat &format, const void *frames, int num_frames);
+
+    /// @brief Consumer side, copies up to max_frames interleaved frames into out and returns how many were copied
+    int Read(std::int16_t *out, int max_frames);
+
+    /// @brief Drops every frame written so far, safe to call from any thread
+    void Flush();
+
+    /// @brief Tells the buffer whether the player is playing, safe to call from any thread. Reads that come up short
+    /// only count as underruns while it is, and only once the reader has had frames since the last flush, so an idle
+    /// audio device polling an empty buffer is not reported as stutter.
+    void SetPlaying(bool playing);
+
+    /// @brief Format of the frames currently in the buffer
+    sp_audioformat GetFormat() const;
+
+    std::size_t GetCapacity() const;
+    std::size_t GetReadableFrames() const;
+
+    /// @brief Fills the stats libspotify asks for, stutter being the underruns since the previous call.
+    /// Producer side, it is called from the same thread as Write.
+    void GetStats(sp_audio_buffer_stats *stats);
+
+    AudioBufferCounters GetCounters() const;
+
+  private:
+    AudioBuffer(const AudioBuffer &);
+    AudioBuffer &operator=(const AudioBuffer &);
+
+    static const std::size_t kCacheLine = 64;
+
+    std::size_t Wrap(std::uint64_t index) const;
+    void ApplyFlush(std::uint64_t *read);
+
+    // Every group is followed by a whole cache line of padding, so no two groups share a line whatever the alignment
+    // of the object. The constructor checks the gaps.
+
+    // read only after construction
+    std::vector<std::int16_t> samples_;
+    std::size_t capacity_;
+    std::size_t mask_;
+    char pad0_[kCacheLine];
+
+    // owned by the producer
+    std::atomic<std::uint64_t> write_;
+    std::uint64_t cached_read_;
+    std::atomic<int> channels_;
+    std::atomic<int> sample_rate_;
+    std::atomic<std::uint64_t> backpressure_;
+    std::atomic<std::size_t> peak_frames_;
+    std::uint64_t reported_underruns_;
+    char pad1_[kCacheLine];
+
+    // owned by the consumer
+    std::atomic<std::uint64_t> read_;
+    std::uint64_t cached_write_;
+    bool draining_;  // the reader has had frames since the buffer last ran dry or was flushed
+    std::atomic<std::uint64_t> underruns_;
+    char pad2_[kCacheLine];
+
+    // written by whoever flushes or starts and stops the player, read by the consumer
+    std::atomic<std::uint64_t> flush_to_;
+    std::atomic<bool> playing_;
+    char pad3_[kCacheLine];
+};
+}
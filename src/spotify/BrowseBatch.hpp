@@ -0,0 +1,156 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// std includes
+#include <utility>
+#include <vector>
+
+// boost includes
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace spotify {
+/// @class BrowseBatch
+/// @brief Browses a list of artists or albums with at most a given number of browses in flight, Subject being
+/// Artist or Album.
+///
+/// Every item is reported once, with its index in the list and the error of its browse, in the order the browses
+/// complete or in the order of the list. Starting every browse at once floods libspotify, starting them one at a
+/// time waits for each round trip. Browses recently completed or in flight come from the BrowseCache of the session.
+/// Session thread only, the callbacks run there.
+template <typename Subject>
+class BrowseBatch : public boost::enable_shared_from_this<BrowseBatch<Subject> > {
+  public:
+    typedef decltype(std::declval<Subject &>().Browse()) BrowsePtr;
+    typedef boost::function<void (int index, BrowsePtr browse, sp_error error)> ItemCallback;
+    typedef boost::function<void ()> DoneCallback;
+
+    enum Order {
+        COMPLETION_ORDER,
+        LIST_ORDER  // an item completed early waits for those before it
+    };
+
+    /// @brief Starts the first max_in_flight browses. The batch keeps itself alive until every browse started has
+    /// completed, on_done is called once all items were reported or, after Cancel, once nothing is in flight.
+    static boost::shared_ptr<BrowseBatch> Start(const std::vector<boost::shared_ptr<Subject> > &items,
+                                                int max_in_flight, Order order, const ItemCallback &on_item,
+                                                const DoneCallback &on_done = DoneCallback()) {
+        boost::shared_ptr<BrowseBatch> batch(new BrowseBatch(items, max_in_flight, order, on_item, on_done));
+        batch->Launch();
+        return batch;
+    }
+
+    /// @brief No more browses are started, those in flight are still reported
+    void Cancel() {
+        cancelled_ = true;
+        CheckDone();
+    }
+
+    int GetNumItems() const { return static_cast<int>(items_.size()); }
+    int GetNumInFlight() const { return in_flight_; }
+    int GetNumReported() const { return reported_; }
+    int GetNumFailed() const { return failed_; }
+    bool IsDone() const { return done_; }
+
+  private:
+    // a completed browse waiting for the items before it, LIST_ORDER only
+    struct Result {
+        BrowsePtr browse;
+        sp_error error;
+        bool is_complete;
+    };
+
+    BrowseBatch(const std::vector<boost::shared_ptr<Subject> > &items, int max_in_flight, Order order,
+                const ItemCallback &on_item, const DoneCallback &on_done)
+        : items_(items), max_in_flight_(max_in_flight > 0 ? max_in_flight : 1), order_(order), on_item_(on_item)
+        , on_done_(on_done), next_(0), in_flight_(0), reported_(0), failed_(0), launching_(false)
+        , cancelled_(false), done_(false) {
+        if (order_ == LIST_ORDER)
+            results_.resize(items_.size());
+    }
+
+    void Launch() {
+        // a browse found complete in the cache calls back at once, the loop starts the next one instead of recursing
+        if (launching_)
+            return;
+        launching_ = true;
+        boost::shared_ptr<BrowseBatch> self = this->shared_from_this();
+        while (!cancelled_ && in_flight_ < max_in_flight_ && next_ < GetNumItems()) {
+            int index = next_++;
+            ++in_flight_;
+            items_[index]->BrowseAsync([self, index](BrowsePtr browse, sp_error error) {
+                self->Complete(index, browse, error);
+            });
+        }
+        launching_ = false;
+        CheckDone();
+    }
+
+    void Complete(int index, BrowsePtr browse, sp_error error) {
+        --in_flight_;
+        if (error != SP_ERROR_OK)
+            ++failed_;
+
+        if (order_ == COMPLETION_ORDER) {
+            Report(index, browse, error);
+        } else {
+            Result result = {browse, error, true};
+            results_[index] = result;
+            for (int i = reported_; i < GetNumItems() && results_[i].is_complete; ++i) {
+                Result ready = results_[i];
+                results_[i].browse.reset();
+                Report(i, ready.browse, ready.error);
+            }
+        }
+        Launch();
+    }
+
+    void Report(int index, BrowsePtr browse, sp_error error) {
+        ++reported_;
+        if (on_item_)
+            on_item_(index, browse, error);
+    }
+
+    void CheckDone() {
+        if (done_ || launching_ || in_flight_ > 0 || (!cancelled_ && reported_ < GetNumItems()))
+            return;
+        done_ = true;
+        if (on_done_)
+            on_done_();
+    }
+
+    std::vector<boost::shared_ptr<Subject> > items_;
+    int max_in_flight_;
+    Order order_;
+    ItemCallback on_item_;
+    DoneCallback on_done_;
+    std::vector<Result> results_;
+    int next_;        // the next item to browse
+    int in_flight_;
+    int reported_;
+    int failed_;
+    bool launching_;  // inside Launch
+    bool cancelled_;
+    bool done_;
+};
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/BrowseCache.hpp"
+
+#include <string>
+
+#include <boost/functional/hash.hpp>
+
+#include "spotify/AlbumBrowse.hpp"
+#include "spotify/ArtistBrowse.hpp"
+
+namespace spotify {
+namespace {
+// rough cost of a track, album, artist or portrait held by a browse, on our side and in libspotify
+const std::size_t kItemBytes = 64;
+
+std::size_t EstimateArtistBytes(ArtistBrowse *browse) {
+    std::size_t items = browse->GetNumTracks() + browse->GetNumAlbums() + browse->GetNumSimilarArtists()
+                      + browse->GetNumPortraits();
+    return sizeof(ArtistBrowse) + browse->GetBiography().size() + items * kItemBytes;
+}
+
+std::size_t EstimateAlbumBytes(AlbumBrowse *browse) {
+    std::size_t bytes = sizeof(AlbumBrowse) + browse->GetReview().size() + browse->GetNumTracks() * kItemBytes;
+    for (int i = 0; i < browse->GetNumCopyrights(); ++i)
+        bytes += browse->GetCopyright(i).size();
+    return bytes;
+}
+}
+
+std::size_t hash_value(const BrowseCache::Key &key) {
+    std::size_t seed = boost::hash_value(key.object);
+    boost::hash_combine(seed, key.type);
+    return seed;
+}
+
+BrowseCache::BrowseCache() {
+}
+
+void BrowseCache::SetLimits(std::size_t max_bytes, Clock::duration time_to_live) {
+    cache_.SetLimits(max_bytes, time_to_live);
+}
+
+boost::shared_ptr<ArtistBrowse> BrowseCache::Find(sp_artist *artist, sp_artistbrowse_type type) {
+    Key key = {artist, type};
+    const Browse *browse = cache_.Find(key);
+    return browse ? browse->artist : boost::shared_ptr<ArtistBrowse>();
+}
+
+boost::shared_ptr<AlbumBrowse> BrowseCache::Find(sp_album *album) {
+    Key key = {album, -1};
+    const Browse *browse = cache_.Find(key);
+    return browse ? browse->album : boost::shared_ptr<AlbumBrowse>();
+}
+
+void BrowseCache::Add(sp_artist *artist, sp_artistbrowse_type type, boost::shared_ptr<ArtistBrowse> browse) {
+    Key key = {artist, type};
+    Browse started = {browse, boost::shared_ptr<AlbumBrowse>()};
+    cache_.Start(key, started);
+    browse->connectToOnComplete([this, key](boost::shared_ptr<ArtistBrowse> completed, sp_error error) {
+        Browse entry = {completed, boost::shared_ptr<AlbumBrowse>()};
+        cache_.Complete(key, entry, error == SP_ERROR_OK, &BrowseCache::EstimateBytes);
+    });
+}
+
+void BrowseCache::Add(sp_album *album, boost::shared_ptr<AlbumBrowse> browse) {
+    Key key = {album, -1};
+    Browse started = {boost::shared_ptr<ArtistBrowse>(), browse};
+    cache_.Start(key, started);
+    browse->connectToOnComplete([this, key](boost::shared_ptr<AlbumBrowse> completed, sp_error error) {
+        Browse entry = {boost::shared_ptr<ArtistBrowse>(), completed};
+        cache_.Complete(key, entry, error == SP_ERROR_OK, &BrowseCache::EstimateBytes);
+    });
+}
+
+void BrowseCache::Clear() {
+    cache_.Clear();
+}
+
+BrowseCacheStats BrowseCache::GetStats() {
+    return cache_.GetStats();
+}
+
+std::size_t BrowseCache::EstimateBytes(const Browse &browse) {
+    return browse.artist ? EstimateArtistBytes(browse.artist.get()) : EstimateAlbumBytes(browse.album.get());
+}
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// C-libs includes
+#include <cstddef>
+#include <cstdint>
+
+// std includes
+#include <chrono>
+
+// boost includes
+#include <boost/shared_ptr.hpp>
+
+#include "spotify/LibConfig.hpp"
+#include "spotify/LruCache.hpp"
+
+namespace spotify {
+// forward declaration
+class AlbumBrowse;
+class ArtistBrowse;
+
+/// @brief Activity and occupancy of a BrowseCache, counted in browses
+typedef LruCacheStats BrowseCacheStats;
+
+/// @class BrowseCache
+/// @brief The browses of a session by artist and browse type or by album, so a browse is only requested once.
+///
+/// A browse requested while an identical one is in flight joins it. Once complete it is kept, most recently used
+/// first, until it is older than the time to live or evicted to stay within the byte budget; a failed browse is not
+/// kept, see LruCache. The size of a browse is estimated from its contents, libspotify does not report it. Session
+/// thread only.
+class LIBSPOTIFYPP_API BrowseCache {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    BrowseCache();
+
+    /// @brief A zero budget or time to live keeps nothing once complete, requests in flight are still joined
+    void SetLimits(std::size_t max_bytes, Clock::duration time_to_live);
+
+    /// @brief The browse in flight or completed for the key, empty when a new one has to be started
+    boost::shared_ptr<ArtistBrowse> Find(sp_artist *artist, sp_artistbrowse_type type);
+    boost::shared_ptr<AlbumBrowse> Find(sp_album *album);
+    /// @brief Records a browse just started, it is kept once it completes without error
+    void Add(sp_artist *artist, sp_artistbrowse_type type, boost::shared_ptr<ArtistBrowse> browse);
+    void Add(sp_album *album, boost::shared_ptr<AlbumBrowse> browse);
+
+    /// @brief Forgets every browse, those in flight complete for whoever holds them
+    void Clear();
+
+    BrowseCacheStats GetStats();
+
+  private:
+    BrowseCache(const BrowseCache &);
+    BrowseCache &operator=(const BrowseCache &);
+
+    // the artist or album browsed and the artist browse type, -1 for albums
+    struct Key {
+        const void *object;
+        int type;
+
+        bool operator==(const Key &other) const { return object == other.object && type == other.type; }
+    };
+    friend std::size_t hash_value(const Key &key);
+
+    // one of artist and album is set
+    struct Browse {
+        boost::shared_ptr<ArtistBrowse> artist;
+        boost::shared_ptr<AlbumBrowse> album;
+
+        bool operator==(const Browse &other) const { return artist == other.artist && album == other.album; }
+    };
+
+    static std::size_t EstimateBytes(const Browse &browse);
+
+    LruCache<Key, Browse> cache_;
+};
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/CommandQueue.hpp"
+
+namespace spotify {
+CommandQueue::CommandQueue() : head_(&stub_), tail_(&stub_) {
+    stub_.next = NULL;
+}
+
+CommandQueue::~CommandQueue() {
+    // commands never run are dropped, their futures report a broken promise
+    boost::function<void ()> command;
+    while (Pop(&command)) {
+    }
+}
+
+void CommandQueue::Link(Node *node) {
+    node->next.store(NULL, std::memory_order_relaxed);
+    Node *previous = head_.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+void CommandQueue::Push(const boost::function<void ()> &command) {
+    Node *node = new Node;
+    node->command = command;
+    Link(node);
+}
+
+bool CommandQueue::Pop(boost::function<void ()> *command) {
+    Node *tail = tail_;
+    Node *next = tail->next.load(std::memory_order_acquire);
+
+    // the stub only marks the queue as empty, skip it
+    if (tail == &stub_) {
+        if (!next)
+            return false;
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (!next) {
+        // tail is the last node, it can only be taken once the stub is linked behind it
+        if (tail != head_.load(std::memory_order_acquire))
+            return false;
+        Link(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+    }
+
+    tail_ = next;
+    command->swap(tail->command);
+    delete tail;
+    return true;
+}
+}
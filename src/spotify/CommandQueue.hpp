@@ -0,0 +1,61 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// std includes
+#include <atomic>
+
+// boost includes
+#include <boost/function.hpp>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+/// @class CommandQueue
+/// @brief Multiple producer, single consumer queue of commands for the libspotify thread.
+///
+/// Push never blocks nor spins, whatever the number of producers: a producer swaps itself in as the new head and
+/// links the previous one. Only the session thread calls Pop.
+class LIBSPOTIFYPP_API CommandQueue {
+  public:
+    CommandQueue();
+    ~CommandQueue();
+
+    /// @brief Safe to call from any thread
+    void Push(const boost::function<void ()> &command);
+
+    /// @brief Consumer side, false when the queue is empty or a producer has not finished linking its command yet
+    bool Pop(boost::function<void ()> *command);
+
+  private:
+    CommandQueue(const CommandQueue &);
+    CommandQueue &operator=(const CommandQueue &);
+
+    struct Node {
+        std::atomic<Node *> next;
+        boost::function<void ()> command;
+    };
+
+    void Link(Node *node);
+
+    std::atomic<Node *> head_;  // last pushed, shared by the producers
+    char pad_[64];
+    Node *tail_;                // next to pop, owned by the consumer
+    Node stub_;
+};
+}
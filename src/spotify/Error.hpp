@@ -0,0 +1,38 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// std includes
+#include <stdexcept>
+
+namespace spotify {
+/// @class Error
+/// @brief An sp_error delivered through the exception of a future, see Artist::BrowseAsync
+class Error : public std::runtime_error {
+  public:
+    explicit Error(sp_error error) : std::runtime_error(sp_error_message(error)), error_(error) {}
+
+    sp_error GetError() const { return error_; }
+
+  private:
+    sp_error error_;
+};
+}
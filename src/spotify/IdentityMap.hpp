@@ -0,0 +1,110 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// C-libs includes
+#include <cstddef>
+
+// boost includes
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace spotify {
+/// @class IdentityMap
+/// @brief Canonical wrapper of each libspotify object, so the same sp_* pointer always yields the same wrapper.
+///
+/// Entries are weak: a wrapper dies once the application drops it and the next lookup creates a new one. Wrappers
+/// forget their entry when destroyed; entries of wrappers created elsewhere are purged when the map doubles in size
+/// since the last purge, which keeps lookups amortised O(1).
+template <typename Key, typename Value>
+class IdentityMap {
+  public:
+    IdentityMap() : purge_at_(kMinPurge) {}
+
+    /// @brief The live wrapper of key, or the result of create which becomes the canonical one. A NULL key is
+    /// never mapped.
+    ///
+    /// create runs without the lock, so it may look other objects up in the map. When another thread maps the key
+    /// meanwhile, its wrapper is returned and the one just created is dropped.
+    boost::shared_ptr<Value> Get(Key *key, const boost::function<boost::shared_ptr<Value> ()> &create) {
+        if (!key)
+            return create();
+
+        {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            typename Map::iterator found = map_.find(key);
+            if (found != map_.end()) {
+                boost::shared_ptr<Value> value = found->second.lock();
+                if (value)
+                    return value;
+            }
+        }
+
+        // declared first so a losing wrapper is destroyed after the lock is released, its destructor calls Forget
+        boost::shared_ptr<Value> created = create();
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        boost::weak_ptr<Value> &entry = map_[key];
+        boost::shared_ptr<Value> value = entry.lock();
+        if (value)
+            return value;
+
+        entry = created;
+        if (map_.size() >= purge_at_)
+            Purge();
+        return created;
+    }
+
+    /// @brief Drops the entry of key if its wrapper is gone. The wrappers call it from their destructor, otherwise the
+    /// weak reference would keep the block shared by a pooled wrapper and its control block allocated.
+    void Forget(Key *key) {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        typename Map::iterator found = map_.find(key);
+        if (found != map_.end() && found->second.expired())
+            map_.erase(found);
+    }
+
+    std::size_t GetSize() {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        return map_.size();
+    }
+
+  private:
+    static const std::size_t kMinPurge = 1024;
+
+    void Purge() {
+        for (typename Map::iterator it = map_.begin(); it != map_.end();) {
+            if (it->second.expired())
+                it = map_.erase(it);
+            else
+                ++it;
+        }
+        purge_at_ = map_.size() * 2;
+        if (purge_at_ < kMinPurge)
+            purge_at_ = kMinPurge;
+    }
+
+    typedef boost::unordered_map<Key *, boost::weak_ptr<Value> > Map;
+    Map map_;
+    std::size_t purge_at_;
+    boost::mutex mutex_;
+};
+}
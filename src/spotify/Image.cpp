@@ -21,14 +21,29 @@
 
 #include <log4cplus/logger.h>
 
+#include <boost/make_shared.hpp>
+
 #include "spotify/Session.hpp"
+#include "spotify/Trace.hpp"
 
 namespace spotify {
 namespace {
 log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.Image");
 }
 
-Image::Image(boost::shared_ptr<Session> session) : image_(NULL), session_(session) {
+ImageData::ImageData(boost::shared_ptr<Session> session, sp_image *image)
+    : session_(session), image_(image), data_(NULL), size_(0), format_(sp_image_format(image)) {
+    sp_image_add_ref(image_);
+    data_ = sp_image_data(image_, &size_);
+}
+
+ImageData::~ImageData() {
+    sp_image *image = image_;
+    session_->RunOnSessionThread([image] { sp_image_release(image); });
+}
+
+Image::Image(boost::shared_ptr<Session> session) : image_(NULL), session_(session), is_waiting_(false)
+                                                 , is_loaded_(false) {
 }
 
 Image::~Image() {
@@ -36,16 +51,35 @@ Image::~Image() {
 }
 
 bool Image::Load(const byte *image_id) {
-    image_ = sp_image_create(session_->session_, image_id);
+    boost::shared_ptr<Session> session = session_.lock();
+    if (!session)
+        return false;
+    image_ = sp_image_create(session->session_, image_id);
+
+    if (image_) {
+        requested_ = std::chrono::steady_clock::now();
+        is_waiting_ = true;
+        sp_image_add_load_callback(image_, callback_image_loaded, this);
+        // libspotify need not call back for an image it already has, complete the waiting at once
+        if (sp_image_is_loaded(image_)) {
+            is_waiting_ = false;
+            is_loaded_ = true;
+        }
+    }
 
     return (image_ != NULL);
 }
 
 void Image::Unload() {
     if (image_) {
+        sp_image_remove_load_callback(image_, callback_image_loaded, this);
         sp_image_release(image_);
         image_ = NULL;
     }
+    // nothing calls back anymore
+    continuations_.clear();
+    boost::shared_ptr<Image> self;
+    self.swap(self_);
 }
 
 bool Image::IsLoading() {
@@ -56,8 +90,14 @@ bool Image::IsLoading() {
     return false;
 }
 
+sp_error Image::GetError() {
+    if (!image_)
+        return SP_ERROR_INVALID_INDATA;
+    return sp_image_error(image_);
+}
+
 const void *Image::GetData(std::size_t *out_data_size) {
-    out_data_size = 0;
+    *out_data_size = 0;
 
     if (!image_)
         return NULL;
@@ -68,4 +108,51 @@ const void *Image::GetData(std::size_t *out_data_size) {
 
     return sp_image_data(image_, out_data_size);
 }
+
+boost::shared_ptr<const ImageData> Image::GetDataView() {
+    boost::shared_ptr<Session> session = session_.lock();
+    if (!image_ || IsLoading() || !session)
+        return boost::shared_ptr<const ImageData>();
+    return boost::make_shared<ImageData>(session, image_);
+}
+
+void Image::connectToOnLoaded(const Continuation &callback) {
+    if (is_loaded_ || !image_) {
+        callback(shared_from_this(), GetError());
+        return;
+    }
+
+    if (continuations_.empty())
+        self_ = shared_from_this();
+    continuations_.push_back(callback);
+}
+
+void SP_CALLCONV Image::callback_image_loaded(sp_image *image, void *userdata) {
+    Trace::Record(TRACE_IMAGE_LOADED, image);
+    Image *img = reinterpret_cast<Image *>(userdata);
+
+    BOOST_ASSERT(img->image_ == image);
+
+    // gone only when the last Update runs from the destructor of the session
+    boost::shared_ptr<Session> session = img->session_.lock();
+    if (session) {
+        session->metrics_->CountCallback(TRACE_IMAGE_LOADED);
+        session->OnLoadProgress();
+    }
+    if (img->is_waiting_) {
+        img->is_waiting_ = false;
+        if (session)
+            session->metrics_->RecordImageLoad(Metrics::Clock::now() - img->requested_);
+    }
+    img->is_loaded_ = true;
+
+    // the last reference may be self_, it goes once the continuations ran
+    boost::shared_ptr<Image> self;
+    self.swap(img->self_);
+    std::vector<Continuation> continuations;
+    continuations.swap(img->continuations_);
+    sp_error error = img->GetError();
+    for (std::size_t i = 0; i < continuations.size(); ++i)
+        continuations[i](self, error);
+}
 }
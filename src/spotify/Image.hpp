@@ -21,8 +21,14 @@
 // libspotify includes
 #include <libspotify/api.h>
 
+// std includes
+#include <chrono>
+#include <vector>
+
 // boost includes
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
 #include "spotify/LibConfig.hpp"
@@ -31,19 +37,69 @@ namespace spotify {
 // forward declaration
 class Session;
 
+/// @class ImageData
+/// @brief The bytes of a loaded image, used in place without a copy.
+///
+/// Holds its own reference to the sp_image, the bytes stay valid for as long as the view lives even once the Image
+/// is unloaded or evicted from the cache. A view dropped on another thread is released from the session thread, see
+/// Session::RunOnSessionThread.
+class LIBSPOTIFYPP_API ImageData {
+  public:
+    ImageData(boost::shared_ptr<Session> session, sp_image *image);
+    ~ImageData();
+
+    const void *GetData() const { return data_; }
+    std::size_t GetSize() const { return size_; }
+    sp_imageformat GetFormat() const { return format_; }
+
+  private:
+    ImageData(const ImageData &);
+    ImageData &operator=(const ImageData &);
+
+    boost::shared_ptr<Session> session_;
+    sp_image *image_;
+    const void *data_;
+    std::size_t size_;
+    sp_imageformat format_;
+};
+
+/// @class Image
+/// @brief An image requested from libspotify. The session keeps loaded images in its ImageCache, so an image only
+/// holds the session weakly.
 class LIBSPOTIFYPP_API Image : public boost::enable_shared_from_this<Image> {
   public:
+    /// @brief Called on the session thread once the image loads, error is SP_ERROR_OK or the reason it failed
+    typedef boost::function<void (boost::shared_ptr<Image> image, sp_error error)> Continuation;
+
     explicit Image(boost::shared_ptr<Session> session);
     virtual ~Image();
 
     virtual bool Load(const byte *image_id);
     virtual void Unload();
     virtual bool IsLoading();
+    /// @brief SP_ERROR_IS_LOADING until the image loads, then SP_ERROR_OK or the reason it failed
+    sp_error GetError();
 
+    /// @brief The bytes of the image, valid while the image stays loaded. NULL and a size of 0 while loading.
     virtual const void *GetData(std::size_t *data_size);
+    /// @brief The bytes of the image, kept alive by the view. Empty while loading.
+    boost::shared_ptr<const ImageData> GetDataView();
+
+    // connection function for observers, called once when the image loads or at once when it already has.
+    // The image stays alive until then even when nothing else holds it.
+    void connectToOnLoaded(const Continuation &callback); // NOLINT
 
   protected:
     sp_image *image_;
-    boost::shared_ptr<Session> session_;
+    boost::weak_ptr<Session> session_;
+
+  private:
+    static void SP_CALLCONV callback_image_loaded(sp_image *image, void *userdata);
+
+    std::chrono::steady_clock::time_point requested_;  // for the image load metric
+    bool is_waiting_;
+    bool is_loaded_;  // the callback fired or the image was loaded when requested
+    std::vector<Continuation> continuations_;
+    boost::shared_ptr<Image> self_;  // while continuations_ is not empty
 };
 }
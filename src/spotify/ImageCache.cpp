@@ -0,0 +1,62 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/ImageCache.hpp"
+
+#include "spotify/Image.hpp"
+
+namespace spotify {
+namespace {
+// image ids are the 20 bytes of a SHA-1
+const std::size_t kImageIdSize = 20;
+
+std::size_t EstimateBytes(const boost::shared_ptr<Image> &image) {
+    std::size_t data_size = 0;
+    image->GetData(&data_size);
+    return sizeof(Image) + data_size;
+}
+}
+
+ImageCache::ImageCache() {
+}
+
+void ImageCache::SetLimit(std::size_t max_bytes) {
+    // images do not expire
+    cache_.SetLimits(max_bytes, LruCache<std::string, boost::shared_ptr<Image> >::Clock::duration::max());
+}
+
+boost::shared_ptr<Image> ImageCache::Find(const byte *image_id) {
+    std::string id(reinterpret_cast<const char *>(image_id), kImageIdSize);
+    const boost::shared_ptr<Image> *image = cache_.Find(id);
+    return image ? *image : boost::shared_ptr<Image>();
+}
+
+void ImageCache::Add(const byte *image_id, boost::shared_ptr<Image> image) {
+    std::string id(reinterpret_cast<const char *>(image_id), kImageIdSize);
+    cache_.Start(id, image);
+    image->connectToOnLoaded([this, id](boost::shared_ptr<Image> loaded, sp_error error) {
+        cache_.Complete(id, loaded, error == SP_ERROR_OK, &EstimateBytes);
+    });
+}
+
+void ImageCache::Clear() {
+    cache_.Clear();
+}
+
+ImageCacheStats ImageCache::GetStats() {
+    return cache_.GetStats();
+}
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// C-libs includes
+#include <cstddef>
+#include <cstdint>
+
+// std includes
+#include <string>
+
+// boost includes
+#include <boost/shared_ptr.hpp>
+
+#include "spotify/LibConfig.hpp"
+#include "spotify/LruCache.hpp"
+
+namespace spotify {
+// forward declaration
+class Image;
+
+/// @brief Activity and occupancy of an ImageCache, counted in images and the bytes of their data and wrappers
+typedef LruCacheStats ImageCacheStats;
+
+/// @class ImageCache
+/// @brief The images of a session by image id, so a cover shown again is not requested again.
+///
+/// An image requested while it loads joins the request in flight. Once loaded it is kept, most recently used first,
+/// until evicted to stay within the byte budget; an image that failed to load is not kept, see LruCache. An ImageData
+/// taken from an evicted image stays valid. Session thread only.
+class LIBSPOTIFYPP_API ImageCache {
+  public:
+    ImageCache();
+
+    /// @brief A zero budget keeps nothing once loaded, images loading are still joined
+    void SetLimit(std::size_t max_bytes);
+
+    /// @brief The image loading or loaded for the 20 byte id, empty when a new one has to be requested
+    boost::shared_ptr<Image> Find(const byte *image_id);
+    /// @brief Records an image just requested, it is kept once it loads without error
+    void Add(const byte *image_id, boost::shared_ptr<Image> image);
+
+    /// @brief Forgets every image, those loading complete for whoever holds them
+    void Clear();
+
+    ImageCacheStats GetStats();
+
+  private:
+    ImageCache(const ImageCache &);
+    ImageCache &operator=(const ImageCache &);
+
+    // by the 20 bytes of the image id
+    LruCache<std::string, boost::shared_ptr<Image> > cache_;
+};
+}
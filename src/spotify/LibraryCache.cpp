@@ -0,0 +1,509 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/LibraryCache.hpp"
+
+#include <log4cplus/logger.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <fstream>
+#include <iterator>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "spotify/AsyncLog.hpp"
+#include "spotify/TrackSnapshot.hpp"
+
+namespace spotify {
+namespace {
+log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.LibraryCache");
+
+const char kMagic[8] = {'L', 'S', 'P', 'P', 'L', 'I', 'B', '\0'};
+const std::uint32_t kByteOrder = 0x01020304;
+
+enum FileKind {
+    TREE_FILE = 1,
+    TRACKS_FILE
+};
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t kind;
+    std::uint32_t byte_order;
+    std::uint32_t reserved;
+};
+
+struct TracksHeader {
+    std::uint32_t num_tracks;
+    std::uint32_t num_albums;
+    std::uint32_t num_artists;
+    std::uint32_t num_loading;
+    std::uint32_t arena_size;
+    std::uint32_t link_size;
+};
+
+// Where the sections of a tracks file start, the writer and the reader both derive them from the counts. Each
+// section starts 8 byte aligned, the mapping itself is page aligned.
+struct TracksLayout {
+    explicit TracksLayout(const TracksHeader &counts) {
+        std::size_t rows = counts.num_tracks * sizeof(std::uint32_t);
+        size = sizeof(Header) + sizeof(TracksHeader);
+        link = Take(counts.link_size + 1);
+        durations = Take(rows);
+        popularities = Take(rows);
+        discs = Take(rows);
+        starred = Take(rows);
+        album_ids = Take(rows);
+        artist_ids = Take(rows);
+        name_offsets = Take(rows);
+        name_lengths = Take(rows);
+        track_links = Take(rows);
+        artist_name_offsets = Take(counts.num_artists * sizeof(std::uint32_t));
+        artist_links = Take(counts.num_artists * sizeof(std::uint32_t));
+        album_links = Take(counts.num_albums * sizeof(std::uint32_t));
+        arena = Take(counts.arena_size);
+    }
+
+    std::size_t Take(std::size_t bytes) {
+        std::size_t start = size;
+        size = (start + bytes + 7) & ~static_cast<std::size_t>(7);
+        return start;
+    }
+
+    std::size_t size;
+    std::size_t link;
+    std::size_t durations;
+    std::size_t popularities;
+    std::size_t discs;
+    std::size_t starred;
+    std::size_t album_ids;
+    std::size_t artist_ids;
+    std::size_t name_offsets;
+    std::size_t name_lengths;
+    std::size_t track_links;
+    std::size_t artist_name_offsets;
+    std::size_t artist_links;
+    std::size_t album_links;
+    std::size_t arena;
+};
+
+Header MakeHeader(FileKind kind) {
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = LibraryCache::kVersion;
+    header.kind = kind;
+    header.byte_order = kByteOrder;
+    header.reserved = 0;
+    return header;
+}
+
+bool IsValid(const char *data, std::size_t size, FileKind kind) {
+    if (size < sizeof(Header))
+        return false;
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    return std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == LibraryCache::kVersion
+        && header.kind == static_cast<std::uint32_t>(kind) && header.byte_order == kByteOrder;
+}
+
+// stable across runs and platforms, unlike boost::hash
+std::uint64_t Fnv1a(const std::string &text) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string GetLinkString(sp_link *link) {
+    if (!link)
+        return "";
+
+    const int BUFFER_SIZE = 256;
+    char buffer[BUFFER_SIZE] = "";
+    sp_link_as_string(link, buffer, BUFFER_SIZE);
+    sp_link_release(link);
+    return buffer;
+}
+
+template <typename T>
+void Put(std::vector<char> *data, std::size_t offset, const T *values, std::size_t count) {
+    if (count)
+        std::memcpy(&(*data)[offset], values, count * sizeof(T));
+}
+
+template <typename T>
+void Append(std::vector<char> *data, const T &value) {
+    const char *bytes = reinterpret_cast<const char *>(&value);
+    data->insert(data->end(), bytes, bytes + sizeof(T));
+}
+
+void AppendString(std::vector<char> *data, const std::string &text) {
+    Append(data, static_cast<std::uint32_t>(text.size()));
+    data->insert(data->end(), text.begin(), text.end());
+}
+
+// reads a T at *at, false past the end of the data
+template <typename T>
+bool Get(const std::vector<char> &data, std::size_t *at, T *value) {
+    if (data.size() - *at < sizeof(T))
+        return false;
+    std::memcpy(value, &data[*at], sizeof(T));
+    *at += sizeof(T);
+    return true;
+}
+
+bool GetString(const std::vector<char> &data, std::size_t *at, std::string *text) {
+    std::uint32_t size = 0;
+    if (!Get(data, at, &size) || data.size() - *at < size)
+        return false;
+    text->assign(&data[*at], size);
+    *at += size;
+    return true;
+}
+
+// every offset has to land inside the arena, every id on an album or an artist
+bool AreWithin(const std::uint32_t *offsets, std::size_t count, std::uint32_t size) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (offsets[i] >= size)
+            return false;
+    }
+    return true;
+}
+
+// and every name has to end inside it, before the NUL that follows it
+bool AreSpans(const std::uint32_t *offsets, const std::uint32_t *lengths, std::size_t count, std::uint32_t size) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (offsets[i] >= size || lengths[i] >= size - offsets[i])
+            return false;
+    }
+    return true;
+}
+
+bool AreIds(const int *ids, std::size_t count, std::uint32_t num_ids) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (ids[i] != TrackSnapshot::kNone && (ids[i] < 0 || static_cast<std::uint32_t>(ids[i]) >= num_ids))
+            return false;
+    }
+    return true;
+}
+}
+
+const std::uint32_t LibraryCache::kVersion;
+
+LibraryCache::LibraryCache(const std::string &directory) : directory_(directory), writing_(false), stopping_(false) {
+}
+
+LibraryCache::~LibraryCache() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    if (writer_.joinable())
+        writer_.join();
+}
+
+bool LibraryCache::ReadTree(std::vector<Entry> *entries) const {
+    std::ifstream file(GetTreePath().c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!IsValid(data.data(), data.size(), TREE_FILE))
+        return false;
+
+    std::size_t at = sizeof(Header);
+    std::uint32_t count = 0;
+    if (!Get(data, &at, &count))
+        return false;
+
+    std::vector<Entry> read;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        Entry entry;
+        std::uint32_t type = 0;
+        if (!Get(data, &at, &type) || !Get(data, &at, &entry.group_id) || !GetString(data, &at, &entry.name)
+            || !GetString(data, &at, &entry.link))
+            return false;
+        entry.type = static_cast<sp_playlist_type>(type);
+        read.push_back(entry);
+    }
+    entries->swap(read);
+    return true;
+}
+
+boost::shared_ptr<const TrackSnapshot> LibraryCache::ReadTracks(const std::string &link) const {
+    boost::shared_ptr<boost::interprocess::mapped_region> region;
+    try {
+        boost::interprocess::file_mapping file(GetTracksPath(link).c_str(), boost::interprocess::read_only);
+        region = boost::make_shared<boost::interprocess::mapped_region>(file, boost::interprocess::read_only);
+    } catch(const boost::interprocess::interprocess_exception &) {
+        return boost::shared_ptr<const TrackSnapshot>();
+    }
+
+    const char *data = static_cast<const char *>(region->get_address());
+    std::size_t size = region->get_size();
+    if (!IsValid(data, size, TRACKS_FILE) || size < sizeof(Header) + sizeof(TracksHeader))
+        return boost::shared_ptr<const TrackSnapshot>();
+
+    TracksHeader counts;
+    std::memcpy(&counts, data + sizeof(Header), sizeof(counts));
+    TracksLayout layout(counts);
+    // another playlist whose link hashes the same, or a file cut short
+    if (size < layout.size || counts.arena_size == 0 || data[layout.arena + counts.arena_size - 1] != '\0'
+        || link.compare(0, std::string::npos, data + layout.link, counts.link_size) != 0)
+        return boost::shared_ptr<const TrackSnapshot>();
+
+    TrackSnapshot::View view = {
+        static_cast<int>(counts.num_tracks), static_cast<int>(counts.num_albums),
+        static_cast<int>(counts.num_artists), static_cast<int>(counts.num_loading),
+        reinterpret_cast<const int *>(data + layout.durations),
+        reinterpret_cast<const int *>(data + layout.popularities),
+        reinterpret_cast<const int *>(data + layout.discs),
+        reinterpret_cast<const int *>(data + layout.starred),
+        reinterpret_cast<const int *>(data + layout.album_ids),
+        reinterpret_cast<const int *>(data + layout.artist_ids),
+        reinterpret_cast<const std::uint32_t *>(data + layout.name_offsets),
+        reinterpret_cast<const std::uint32_t *>(data + layout.name_lengths),
+        reinterpret_cast<const std::uint32_t *>(data + layout.artist_name_offsets),
+        reinterpret_cast<const std::uint32_t *>(data + layout.track_links),
+        reinterpret_cast<const std::uint32_t *>(data + layout.album_links),
+        reinterpret_cast<const std::uint32_t *>(data + layout.artist_links),
+        NULL, NULL, NULL, data + layout.arena, counts.arena_size
+    };
+
+    if (!AreSpans(view.name_offsets, view.name_lengths, counts.num_tracks, counts.arena_size)
+        || !AreWithin(view.track_links, counts.num_tracks, counts.arena_size)
+        || !AreWithin(view.artist_name_offsets, counts.num_artists, counts.arena_size)
+        || !AreWithin(view.artist_links, counts.num_artists, counts.arena_size)
+        || !AreWithin(view.album_links, counts.num_albums, counts.arena_size)
+        || !AreIds(view.album_ids, counts.num_tracks, counts.num_albums)
+        || !AreIds(view.artist_ids, counts.num_tracks, counts.num_artists)) {
+        LIBSPOTIFYPP_LOG_WARN(logger, "LibraryCache::ReadTracks: %s is corrupt", GetTracksPath(link).c_str());
+        return boost::shared_ptr<const TrackSnapshot>();
+    }
+
+    return boost::shared_ptr<const TrackSnapshot>(new TrackSnapshot(view, region));
+}
+
+bool LibraryCache::WriteTree(const std::vector<Entry> &entries) {
+    std::vector<char> data;
+    Append(&data, MakeHeader(TREE_FILE));
+    Append(&data, static_cast<std::uint32_t>(entries.size()));
+    boost::unordered_set<std::string> links;
+    // a playlist that has not loaded yet has no link, its tracks may be among those of the previous tree
+    bool complete = true;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const Entry &entry = entries[i];
+        Append(&data, static_cast<std::uint32_t>(entry.type));
+        Append(&data, entry.group_id);
+        AppendString(&data, entry.name);
+        AppendString(&data, entry.link);
+        if (!entry.link.empty())
+            links.insert(entry.link);
+        else if (entry.type == SP_PLAYLIST_TYPE_PLAYLIST)
+            complete = false;
+    }
+
+    std::vector<Entry> previous;
+    if (complete && ReadTree(&previous)) {
+        for (std::size_t i = 0; i < previous.size(); ++i) {
+            if (!previous[i].link.empty() && !links.count(previous[i].link))
+                std::remove(GetTracksPath(previous[i].link).c_str());
+        }
+    }
+
+    return Replace(GetTreePath(), data);
+}
+
+bool LibraryCache::WriteTracks(const std::string &link, const TrackSnapshot &snapshot) {
+    Links links;
+    GetLinks(snapshot, &links);
+    return WriteTracks(link, snapshot, links);
+}
+
+void LibraryCache::PostTree(const std::vector<Entry> &entries) {
+    Job job;
+    job.entries = entries;
+    Post(job);
+}
+
+void LibraryCache::PostTracks(const std::string &link, boost::shared_ptr<const TrackSnapshot> snapshot) {
+    boost::shared_ptr<Links> links = boost::make_shared<Links>();
+    GetLinks(*snapshot, links.get());
+    Job job;
+    job.link = link;
+    job.snapshot = snapshot;
+    job.links = links;
+    Post(job);
+}
+
+void LibraryCache::Flush() {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!jobs_.empty() || writing_)
+        changed_.wait(lock);
+}
+
+void LibraryCache::Post(const Job &job) {
+    Job replaced;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        // the newer write goes last, a tree written after the tracks it prunes would bring them back otherwise
+        for (std::deque<Job>::iterator it = jobs_.begin(); it != jobs_.end(); ++it) {
+            if (it->link == job.link) {
+                replaced = *it;
+                jobs_.erase(it);
+                break;
+            }
+        }
+        jobs_.push_back(job);
+        if (!writer_.joinable())
+            writer_ = boost::thread(&LibraryCache::RunWriter, this);
+    }
+    changed_.notify_all();
+}
+
+void LibraryCache::RunWriter() {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    for (;;) {
+        if (jobs_.empty()) {
+            writing_ = false;
+            changed_.notify_all();
+            // the queued writes are done before the cache goes away
+            if (stopping_)
+                return;
+            changed_.wait(lock);
+            continue;
+        }
+
+        Job job = jobs_.front();
+        jobs_.pop_front();
+        writing_ = true;
+        lock.unlock();
+        if (job.link.empty())
+            WriteTree(job.entries);
+        else
+            WriteTracks(job.link, *job.snapshot, *job.links);
+        // the snapshot is released before the next wait, not when the next job replaces it
+        job = Job();
+        lock.lock();
+    }
+}
+
+void LibraryCache::GetLinks(const TrackSnapshot &snapshot, Links *links) const {
+    const TrackSnapshot::View &view = snapshot.view_;
+
+    // the links go at the end of the names, a snapshot read from the cache has them already
+    std::vector<char> &text = links->text;
+    auto store = [&text, &view](const std::string &link) -> std::uint32_t {
+        if (link.empty())
+            return 0;
+        std::uint32_t offset = static_cast<std::uint32_t>(view.arena_size + text.size());
+        text.insert(text.end(), link.c_str(), link.c_str() + link.size() + 1);
+        return offset;
+    };
+    links->tracks.resize(view.num_tracks);
+    links->albums.resize(view.num_albums);
+    links->artists.resize(view.num_artists);
+    for (int row = 0; row < view.num_tracks; ++row) {
+        sp_track *track = snapshot.GetTrack(row);
+        links->tracks[row] = store(track ? GetLinkString(sp_link_create_from_track(track, 0))
+                                         : snapshot.GetTrackLink(row));
+    }
+    for (int id = 0; id < view.num_albums; ++id) {
+        sp_album *album = snapshot.GetAlbum(id);
+        links->albums[id] = store(album ? GetLinkString(sp_link_create_from_album(album))
+                                        : snapshot.GetAlbumLink(id));
+    }
+    for (int id = 0; id < view.num_artists; ++id) {
+        sp_artist *artist = snapshot.GetArtist(id);
+        links->artists[id] = store(artist ? GetLinkString(sp_link_create_from_artist(artist))
+                                          : snapshot.GetArtistLink(id));
+    }
+}
+
+bool LibraryCache::WriteTracks(const std::string &link, const TrackSnapshot &snapshot, const Links &links) {
+    const TrackSnapshot::View &view = snapshot.view_;
+    std::size_t arena_size = view.arena_size + links.text.size();
+
+    TracksHeader counts = {static_cast<std::uint32_t>(view.num_tracks), static_cast<std::uint32_t>(view.num_albums),
+                           static_cast<std::uint32_t>(view.num_artists), static_cast<std::uint32_t>(view.num_loading),
+                           static_cast<std::uint32_t>(arena_size), static_cast<std::uint32_t>(link.size())};
+    TracksLayout layout(counts);
+    std::vector<char> data(layout.size, '\0');
+    Header header = MakeHeader(TRACKS_FILE);
+    Put(&data, 0, &header, 1);
+    Put(&data, sizeof(Header), &counts, 1);
+    Put(&data, layout.link, link.data(), link.size());
+    Put(&data, layout.durations, view.durations, view.num_tracks);
+    Put(&data, layout.popularities, view.popularities, view.num_tracks);
+    Put(&data, layout.discs, view.discs, view.num_tracks);
+    Put(&data, layout.starred, view.starred, view.num_tracks);
+    Put(&data, layout.album_ids, view.album_ids, view.num_tracks);
+    Put(&data, layout.artist_ids, view.artist_ids, view.num_tracks);
+    Put(&data, layout.name_offsets, view.name_offsets, view.num_tracks);
+    Put(&data, layout.name_lengths, view.name_lengths, view.num_tracks);
+    Put(&data, layout.track_links, links.tracks.data(), links.tracks.size());
+    Put(&data, layout.artist_name_offsets, view.artist_name_offsets, view.num_artists);
+    Put(&data, layout.artist_links, links.artists.data(), links.artists.size());
+    Put(&data, layout.album_links, links.albums.data(), links.albums.size());
+    Put(&data, layout.arena, view.arena, view.arena_size);
+    Put(&data, layout.arena + view.arena_size, links.text.data(), links.text.size());
+
+    return Replace(GetTracksPath(link), data);
+}
+
+std::string LibraryCache::GetTreePath() const {
+    return directory_ + "/libspotifypp-tree.bin";
+}
+
+std::string LibraryCache::GetTracksPath(const std::string &link) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "/libspotifypp-tracks-%016llx.bin",
+                  static_cast<unsigned long long>(Fnv1a(link)));  // NOLINT
+    return directory_ + name;
+}
+
+bool LibraryCache::Replace(const std::string &path, const std::vector<char> &data) const {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+        if (!file) {
+            LIBSPOTIFYPP_LOG_WARN(logger, "LibraryCache: unable to write %s", temporary.c_str());
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+#if defined(WIN32)
+    // rename does not replace on Windows
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        LIBSPOTIFYPP_LOG_WARN(logger, "LibraryCache: unable to replace %s", path.c_str());
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// C-libs includes
+#include <cstdint>
+
+// std includes
+#include <deque>
+#include <string>
+#include <vector>
+
+// boost includes
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+// forward declaration
+class TrackSnapshot;
+
+/// @class LibraryCache
+/// @brief The playlist tree and the tracks of each playlist kept on disk, so a restart can show the library before
+/// libspotify has loaded any of it.
+///
+/// With Config::cache_library the session writes the tree once the container has loaded and again after each
+/// change, and the tracks of a playlist every time they settle. The session only takes the snapshots and asks
+/// libspotify for the links, the files are written by a thread of the cache. An application reads both right after
+/// Initialise to show a provisional library, then switches to the live tree once PlayListContainer fires
+/// OnAllLoaded; the links match the cached entries to the live ones, see PlayListContainer::FindByLink. Merging the
+/// provisional tree into the live one is left to the application, the cache does not track what changed between
+/// them.
+///
+/// Each file starts with a header holding the format version and the byte order, a file written by another version
+/// or machine reads as missing. Files are replaced atomically, a crash leaves the previous version. The tracks are
+/// mapped, not read, so the cost of ReadTracks does not depend on the size of the playlist.
+class LIBSPOTIFYPP_API LibraryCache {
+  public:
+    static const std::uint32_t kVersion = 1;
+
+    /// @brief An entry of the container, in the order of the flat list of libspotify
+    struct Entry {
+        sp_playlist_type type;
+        std::string name;
+        std::string link;    // of a playlist
+        sp_uint64 group_id;  // of a folder
+    };
+
+    /// @brief The files are kept in directory, which must exist
+    explicit LibraryCache(const std::string &directory);
+    /// @brief Waits for the queued writes
+    ~LibraryCache();
+
+    /// @brief The tree last written, false when there is none. Safe to call from any thread.
+    bool ReadTree(std::vector<Entry> *entries) const;
+    /// @brief The tracks of the playlist last written, empty when there are none. Safe to call from any thread.
+    boost::shared_ptr<const TrackSnapshot> ReadTracks(const std::string &link) const;
+
+    /// @brief Replaces the tree and removes the tracks of the playlists no longer in it, which is skipped while a
+    /// playlist of entries has no link yet
+    bool WriteTree(const std::vector<Entry> &entries);
+    /// @brief Replaces the tracks of the playlist. Asks libspotify for the links of the snapshot, so it runs on the
+    /// session thread.
+    bool WriteTracks(const std::string &link, const TrackSnapshot &snapshot);
+
+    /// @brief Like WriteTree and WriteTracks, the files are written by the thread of the cache. A write still queued
+    /// for the same file is replaced. PostTracks asks libspotify for the links, so it runs on the session thread,
+    /// and the snapshot is released by the writer thread.
+    void PostTree(const std::vector<Entry> &entries);
+    void PostTracks(const std::string &link, boost::shared_ptr<const TrackSnapshot> snapshot);
+    /// @brief Waits until the writes posted before the call are done
+    void Flush();
+
+  private:
+    LibraryCache(const LibraryCache &);
+    LibraryCache &operator=(const LibraryCache &);
+
+    // the links of a snapshot, taken on the session thread and stored after the names
+    struct Links {
+        std::vector<char> text;
+        std::vector<std::uint32_t> tracks;  // offsets in the arena of the file, 0 when there is no link
+        std::vector<std::uint32_t> albums;
+        std::vector<std::uint32_t> artists;
+    };
+
+    // a write waiting for the writer thread, the tree when link is empty
+    struct Job {
+        std::string link;
+        std::vector<Entry> entries;
+        boost::shared_ptr<const TrackSnapshot> snapshot;
+        boost::shared_ptr<const Links> links;
+    };
+
+    void GetLinks(const TrackSnapshot &snapshot, Links *links) const;
+    bool WriteTracks(const std::string &link, const TrackSnapshot &snapshot, const Links &links);
+    void Post(const Job &job);
+    void RunWriter();
+
+    std::string GetTreePath() const;
+    std::string GetTracksPath(const std::string &link) const;
+    // writes to a temporary file renamed over path once complete
+    bool Replace(const std::string &path, const std::vector<char> &data) const;
+
+    std::string directory_;
+
+    boost::mutex mutex_;  // guards the fields below, the writer thread waits on it for jobs
+    boost::condition_variable changed_;
+    std::deque<Job> jobs_;
+    bool writing_;        // a job was taken off jobs_ and is not done yet
+    bool stopping_;
+    boost::thread writer_;  // started by the first post
+};
+}
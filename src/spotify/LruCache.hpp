@@ -0,0 +1,167 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+// C-libs includes
+#include <cstddef>
+#include <cstdint>
+
+// std includes
+#include <chrono>
+#include <list>
+
+// boost includes
+#include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+/// @brief Activity and occupancy of an LruCache
+struct LIBSPOTIFYPP_API LruCacheStats {
+    std::uint64_t hits;    // served from a completed request
+    std::uint64_t joins;   // joined a request still in flight
+    std::uint64_t misses;  // started a new request
+    std::uint64_t evictions;
+    std::size_t entries;   // completed requests kept
+    std::size_t bytes;     // estimated size of those
+    std::size_t pending;   // requests in flight
+};
+
+/// @class LruCache
+/// @brief Requests to libspotify by key, in flight or completed, so the same object is only requested once.
+///
+/// A request started while an identical one is in flight joins it. Once complete it is kept, most recently used
+/// first, until it is older than the time to live or evicted to stay within the byte budget; a failed request is not
+/// kept. Value is compared to tell a completing request from a later one of the same key. Session thread only.
+template <typename Key, typename Value>
+class LruCache {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    LruCache() : max_bytes_(0), time_to_live_(Clock::duration::max()), stats_() {}
+
+    /// @brief A zero budget or time to live keeps nothing once complete, requests in flight are still joined
+    void SetLimits(std::size_t max_bytes, Clock::duration time_to_live) {
+        max_bytes_ = max_bytes;
+        time_to_live_ = time_to_live;
+        Trim();
+    }
+
+    /// @brief The request in flight or completed for key, NULL when a new one has to be started
+    const Value *Find(const Key &key) {
+        typename Pending::const_iterator pending = pending_.find(key);
+        if (pending != pending_.end()) {
+            ++stats_.joins;
+            return &pending->second;
+        }
+
+        typename Index::iterator found = index_.find(key);
+        if (found == index_.end())
+            return NULL;
+
+        if (Clock::now() - found->second->completed > time_to_live_) {
+            Erase(found);
+            return NULL;
+        }
+
+        ++stats_.hits;
+        completed_.splice(completed_.begin(), completed_, found->second);
+        return &found->second->value;
+    }
+
+    /// @brief Records a request just started. An expired or evicted request of the same key may still be in flight
+    /// for its holders, it completes without being kept.
+    void Start(const Key &key, const Value &value) {
+        ++stats_.misses;
+        pending_[key] = value;
+        stats_.pending = pending_.size();
+    }
+
+    /// @brief Called once the request completes. Kept when it succeeded and it is still the one in flight for key,
+    /// measure estimates its size then.
+    void Complete(const Key &key, const Value &value, bool succeeded,
+                  const boost::function<std::size_t (const Value &)> &measure) {
+        typename Pending::iterator pending = pending_.find(key);
+        // the cache was cleared, or a later request of the same key replaced this one
+        if (pending == pending_.end() || !(pending->second == value))
+            return;
+
+        pending_.erase(pending);
+        stats_.pending = pending_.size();
+        if (!succeeded || !max_bytes_ || time_to_live_ <= Clock::duration::zero())
+            return;
+
+        Entry entry = {key, value, measure(value), Clock::now()};
+        typename Index::iterator found = index_.find(key);
+        if (found != index_.end())
+            Erase(found);
+        completed_.push_front(entry);
+        index_[key] = completed_.begin();
+        ++stats_.entries;
+        stats_.bytes += entry.bytes;
+        Trim();
+    }
+
+    /// @brief Forgets every request, those in flight complete for whoever holds them
+    void Clear() {
+        pending_.clear();
+        completed_.clear();
+        index_.clear();
+        stats_.entries = 0;
+        stats_.bytes = 0;
+        stats_.pending = 0;
+    }
+
+    LruCacheStats GetStats() const {
+        return stats_;
+    }
+
+  private:
+    struct Entry {
+        Key key;
+        Value value;
+        std::size_t bytes;
+        Clock::time_point completed;
+    };
+    typedef std::list<Entry> EntryList;
+    typedef boost::unordered_map<Key, Value> Pending;
+    typedef boost::unordered_map<Key, typename EntryList::iterator> Index;
+
+    void Erase(typename Index::iterator found) {
+        --stats_.entries;
+        stats_.bytes -= found->second->bytes;
+        completed_.erase(found->second);
+        index_.erase(found);
+    }
+
+    // evicts the least recently used entries until the budget holds
+    void Trim() {
+        while (!completed_.empty() && stats_.bytes > max_bytes_) {
+            Erase(index_.find(completed_.back().key));
+            ++stats_.evictions;
+        }
+    }
+
+    std::size_t max_bytes_;
+    Clock::duration time_to_live_;
+    Pending pending_;
+    EntryList completed_;  // most recently used first
+    Index index_;
+    LruCacheStats stats_;
+};
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/Metrics.hpp"
+
+#include <cmath>
+#include <string>
+
+namespace spotify {
+namespace {
+const std::uint64_t kSubBuckets = 1 << Histogram::kSubBucketBits;
+
+int FloorLog2(std::uint64_t value) {
+    int log = 0;
+    for (int shift = 32; shift > 0; shift >>= 1) {
+        if (value >> shift) {
+            value >>= shift;
+            log += shift;
+        }
+    }
+    return log;
+}
+
+std::uint64_t ToMicros(Metrics::Clock::duration elapsed) {
+    std::int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    return micros > 0 ? static_cast<std::uint64_t>(micros) : 0;
+}
+
+// exposed histogram buckets end at 2^kMaxExposedLog - 1, about 19 hours in microseconds
+const int kMaxExposedLog = 36;
+
+void WriteHeader(std::ostream &out, const char *name, const char *type, const char *help) {
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n';
+}
+
+// labels is empty or a comma separated list of label="value" pairs
+void WriteHistogram(std::ostream &out, const std::string &name, const std::string &labels,
+                    const HistogramSnapshot &histogram) {
+    std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+
+    // the upper bound of the last bucket of each power of two is 2^n - 1, so every exposed bucket is exact
+    std::uint64_t cumulative = 0;
+    std::size_t bucket = 0;
+    for (int log = Histogram::kSubBucketBits; log <= kMaxExposedLog; ++log) {
+        std::uint64_t bound = (static_cast<std::uint64_t>(1) << log) - 1;
+        for (; bucket < histogram.buckets.size() && Histogram::GetBucketUpperBound(bucket) <= bound; ++bucket)
+            cumulative += histogram.buckets[bucket];
+        out << name << "_bucket" << prefix << "le=\"" << bound << "\"} " << cumulative << '\n';
+    }
+    out << name << "_bucket" << prefix << "le=\"+Inf\"} " << histogram.count << '\n';
+
+    std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << suffix << ' ' << histogram.sum << '\n'
+        << name << "_count" << suffix << ' ' << histogram.count << '\n';
+}
+}
+
+HistogramSnapshot::HistogramSnapshot() : count(0), sum(0), max(0) {
+}
+
+double HistogramSnapshot::GetMean() const {
+    return count ? static_cast<double>(sum) / count : 0.0;
+}
+
+std::uint64_t HistogramSnapshot::GetPercentile(double percentile) const {
+    if (!count)
+        return 0;
+
+    std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(percentile / 100.0 * count));
+    if (rank < 1)
+        rank = 1;
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            std::uint64_t bound = Histogram::GetBucketUpperBound(i);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+Histogram::Histogram() : count_(0), sum_(0), max_(0) {
+    for (std::size_t i = 0; i < kNumBuckets; ++i)
+        buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+std::size_t Histogram::GetBucket(std::uint64_t value) {
+    if (value < kSubBuckets)
+        return static_cast<std::size_t>(value);
+
+    int log = FloorLog2(value);
+    std::uint64_t sub_bucket = (value >> (log - kSubBucketBits)) & (kSubBuckets - 1);
+    return static_cast<std::size_t>(((log - kSubBucketBits + 1) << kSubBucketBits) + sub_bucket);
+}
+
+std::uint64_t Histogram::GetBucketUpperBound(std::size_t bucket) {
+    if (bucket < kSubBuckets)
+        return bucket;
+
+    int shift = static_cast<int>(bucket >> kSubBucketBits) - 1;
+    std::uint64_t lower = (kSubBuckets + (bucket & (kSubBuckets - 1))) << shift;
+    return lower + ((static_cast<std::uint64_t>(1) << shift) - 1);
+}
+
+void Histogram::Record(std::uint64_t value) {
+    buckets_[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    std::uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot Histogram::GetSnapshot() const {
+    // the fields are read one by one, a snapshot taken while values are recorded may be off by those values
+    HistogramSnapshot snapshot;
+    snapshot.buckets.resize(kNumBuckets);
+    for (std::size_t i = 0; i < kNumBuckets; ++i)
+        snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count = count_.load(std::memory_order_relaxed);
+    snapshot.sum = sum_.load(std::memory_order_relaxed);
+    snapshot.max = max_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+SessionMetrics::SessionMetrics() : uptime_seconds(0), frames_delivered(0), frames_consumed(0) {
+    for (int i = 0; i < TRACE_NUM_EVENTS; ++i)
+        callbacks[i] = 0;
+}
+
+double SessionMetrics::GetNotifyRate() const {
+    return uptime_seconds > 0 ? callbacks[TRACE_NOTIFY_MAIN_THREAD] / uptime_seconds : 0.0;
+}
+
+double SessionMetrics::GetConsumedRatio() const {
+    return frames_delivered ? static_cast<double>(frames_consumed) / frames_delivered : 0.0;
+}
+
+void SessionMetrics::WritePrometheus(std::ostream &out) const {
+    WriteHeader(out, "spotify_uptime_seconds", "gauge", "Seconds since the session was created.");
+    out << "spotify_uptime_seconds " << uptime_seconds << '\n';
+
+    WriteHeader(out, "spotify_callbacks_total", "counter", "libspotify callbacks received, by callback.");
+    for (int i = 0; i < TRACE_PROCESS_EVENTS_BEGIN; ++i) {
+        out << "spotify_callbacks_total{callback=\"" << Trace::GetEventName(static_cast<TraceEvent>(i)) << "\"} "
+            << callbacks[i] << '\n';
+    }
+
+    WriteHeader(out, "spotify_frames_delivered_total", "counter", "Frames offered by music_delivery.");
+    out << "spotify_frames_delivered_total " << frames_delivered << '\n';
+    WriteHeader(out, "spotify_frames_consumed_total", "counter", "Frames accepted by the audio buffer.");
+    out << "spotify_frames_consumed_total " << frames_consumed << '\n';
+
+    WriteHeader(out, "spotify_process_events_microseconds", "histogram", "Duration of sp_session_process_events.");
+    WriteHistogram(out, "spotify_process_events_microseconds", "", process_events);
+    WriteHeader(out, "spotify_process_events_timeout_milliseconds", "histogram",
+                "Timeout returned by sp_session_process_events.");
+    WriteHistogram(out, "spotify_process_events_timeout_milliseconds", "", next_timeout);
+
+    WriteHeader(out, "spotify_browse_microseconds", "histogram", "Browse construction to completion, by type.");
+    WriteHistogram(out, "spotify_browse_microseconds", "type=\"artist\"", artist_browse);
+    WriteHistogram(out, "spotify_browse_microseconds", "type=\"album\"", album_browse);
+    WriteHeader(out, "spotify_image_load_microseconds", "histogram", "Image::Load to the image being loaded.");
+    WriteHistogram(out, "spotify_image_load_microseconds", "", image_load);
+}
+
+Metrics::Metrics() : created_(Clock::now()), frames_delivered_(0), frames_consumed_(0) {
+    for (int i = 0; i < TRACE_NUM_EVENTS; ++i)
+        callbacks_[i].store(0, std::memory_order_relaxed);
+}
+
+void Metrics::CountCallback(TraceEvent event) {
+    callbacks_[event].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::CountFrames(int delivered, int consumed) {
+    frames_delivered_.fetch_add(delivered, std::memory_order_relaxed);
+    frames_consumed_.fetch_add(consumed, std::memory_order_relaxed);
+}
+
+void Metrics::RecordProcessEvents(Clock::duration elapsed, int next_timeout) {
+    process_events_.Record(ToMicros(elapsed));
+    next_timeout_.Record(next_timeout > 0 ? next_timeout : 0);
+}
+
+void Metrics::RecordArtistBrowse(Clock::duration elapsed) {
+    artist_browse_.Record(ToMicros(elapsed));
+}
+
+void Metrics::RecordAlbumBrowse(Clock::duration elapsed) {
+    album_browse_.Record(ToMicros(elapsed));
+}
+
+void Metrics::RecordImageLoad(Clock::duration elapsed) {
+    image_load_.Record(ToMicros(elapsed));
+}
+
+SessionMetrics Metrics::GetSnapshot() const {
+    SessionMetrics snapshot;
+    snapshot.uptime_seconds = std::chrono::duration_cast<std::chrono::duration<double> >(Clock::now() - created_)
+                                  .count();
+    for (int i = 0; i < TRACE_NUM_EVENTS; ++i)
+        snapshot.callbacks[i] = callbacks_[i].load(std::memory_order_relaxed);
+    snapshot.frames_delivered = frames_delivered_.load(std::memory_order_relaxed);
+    snapshot.frames_consumed = frames_consumed_.load(std::memory_order_relaxed);
+    snapshot.process_events = process_events_.GetSnapshot();
+    snapshot.next_timeout = next_timeout_.GetSnapshot();
+    snapshot.artist_browse = artist_browse_.GetSnapshot();
+    snapshot.album_browse = album_browse_.GetSnapshot();
+    snapshot.image_load = image_load_.GetSnapshot();
+    return snapshot;
+}
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// C-libs includes
+#include <cstddef>
+#include <cstdint>
+
+// std includes
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+#include "spotify/LibConfig.hpp"
+#include "spotify/Trace.hpp"
+
+namespace spotify {
+/// @brief Point in time copy of a Histogram
+struct LIBSPOTIFYPP_API HistogramSnapshot {
+    HistogramSnapshot();
+
+    double GetMean() const;
+    /// @brief Upper bound of the bucket holding the given percentile (0 to 100), within 1/8 of the real value
+    std::uint64_t GetPercentile(double percentile) const;
+
+    std::uint64_t count;
+    std::uint64_t sum;
+    std::uint64_t max;
+    std::vector<std::uint64_t> buckets;  // see Histogram::GetBucketUpperBound
+};
+
+/// @class Histogram
+/// @brief Lock-free log-linear histogram in the style of HdrHistogram.
+///
+/// Values below 8 have a bucket each, every power of two above is split in 8 buckets, so a bucket is never wider than
+/// 1/8 of the values it holds. Record is a few relaxed atomic increments and may be called from any thread.
+class LIBSPOTIFYPP_API Histogram {
+  public:
+    static const int kSubBucketBits = 3;
+    static const std::size_t kNumBuckets = (64 - kSubBucketBits + 1) << kSubBucketBits;
+
+    Histogram();
+
+    void Record(std::uint64_t value);
+    HistogramSnapshot GetSnapshot() const;
+
+    static std::size_t GetBucket(std::uint64_t value);
+    static std::uint64_t GetBucketUpperBound(std::size_t bucket);
+
+  private:
+    Histogram(const Histogram &);
+    Histogram &operator=(const Histogram &);
+
+    std::atomic<std::uint64_t> buckets_[kNumBuckets];
+    std::atomic<std::uint64_t> count_;
+    std::atomic<std::uint64_t> sum_;
+    std::atomic<std::uint64_t> max_;
+};
+
+/// @brief Point in time copy of the metrics of a session, see Session::GetMetrics
+struct LIBSPOTIFYPP_API SessionMetrics {
+    SessionMetrics();
+
+    /// @brief notify_main_thread calls per second since the session was created
+    double GetNotifyRate() const;
+    /// @brief Share of the frames offered by music_delivery that the audio buffer accepted
+    double GetConsumedRatio() const;
+
+    /// @brief Writes the metrics in the Prometheus text exposition format. Histograms are exposed with a bucket per
+    /// power of two, durations stay in microseconds as recorded.
+    void WritePrometheus(std::ostream &out) const;
+
+    double uptime_seconds;                      // since the session was created
+    std::uint64_t callbacks[TRACE_NUM_EVENTS];  // libspotify callbacks received, by type
+    std::uint64_t frames_delivered;             // frames offered by music_delivery
+    std::uint64_t frames_consumed;              // frames accepted by the audio buffer
+    HistogramSnapshot process_events;           // duration of sp_session_process_events, in microseconds
+    HistogramSnapshot next_timeout;             // timeout returned by sp_session_process_events, in milliseconds
+    HistogramSnapshot artist_browse;            // ArtistBrowse construction to completion, in microseconds
+    HistogramSnapshot album_browse;             // AlbumBrowse construction to completion, in microseconds
+    HistogramSnapshot image_load;               // Image::Load to the image being loaded, in microseconds
+};
+
+/// @class Metrics
+/// @brief Live counters and histograms of a session. Every update is lock-free, so they may be kept on the
+/// libspotify threads, including the audio thread.
+class LIBSPOTIFYPP_API Metrics {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    Metrics();
+
+    void CountCallback(TraceEvent event);
+    void CountFrames(int delivered, int consumed);
+    void RecordProcessEvents(Clock::duration elapsed, int next_timeout);
+    void RecordArtistBrowse(Clock::duration elapsed);
+    void RecordAlbumBrowse(Clock::duration elapsed);
+    void RecordImageLoad(Clock::duration elapsed);
+
+    SessionMetrics GetSnapshot() const;
+
+  private:
+    Metrics(const Metrics &);
+    Metrics &operator=(const Metrics &);
+
+    Clock::time_point created_;
+    std::atomic<std::uint64_t> callbacks_[TRACE_NUM_EVENTS];
+    std::atomic<std::uint64_t> frames_delivered_;
+    std::atomic<std::uint64_t> frames_consumed_;
+    Histogram process_events_;
+    Histogram next_timeout_;
+    Histogram artist_browse_;
+    Histogram album_browse_;
+    Histogram image_load_;
+};
+}
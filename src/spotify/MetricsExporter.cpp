@@ -0,0 +1,210 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/MetricsExporter.hpp"
+
+#include <log4cplus/logger.h>
+
+#if !defined(WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <boost/bind.hpp>
+
+#include "spotify/AsyncLog.hpp"
+
+namespace spotify {
+namespace {
+log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.MetricsExporter");
+
+#if !defined(WIN32)
+// how long a client gets to send its request before the response is written anyway
+const int kRequestTimeoutMs = 100;
+
+// a client closing early must not raise SIGPIPE, macOS has no MSG_NOSIGNAL
+#if defined(MSG_NOSIGNAL)
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+void CloseFd(int *fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+bool WriteAll(int fd, const std::string &data) {
+    std::size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result = send(fd, data.data() + written, data.size() - written, kSendFlags);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        written += static_cast<std::size_t>(result);
+    }
+    return true;
+}
+#endif
+}
+
+MetricsExporter::MetricsExporter(const Source &source) : source_(source), listen_fd_(-1) {
+    stop_fds_[0] = -1;
+    stop_fds_[1] = -1;
+}
+
+MetricsExporter::~MetricsExporter() {
+    Stop();
+}
+
+#if !defined(WIN32)
+bool MetricsExporter::Start(const std::string &path) {
+    if (IsRunning())
+        return false;
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        LIBSPOTIFYPP_LOG_ERROR(logger, "invalid socket path %s", path);
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0 || pipe(stop_fds_) < 0) {
+        LIBSPOTIFYPP_LOG_ERROR(logger, "unable to create the socket: %s", std::strerror(errno));
+        CloseFd(&listen_fd_);
+        return false;
+    }
+    fcntl(listen_fd_, F_SETFD, FD_CLOEXEC);
+    fcntl(stop_fds_[0], F_SETFD, FD_CLOEXEC);
+    fcntl(stop_fds_[1], F_SETFD, FD_CLOEXEC);
+
+    unlink(path.c_str());
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(listen_fd_, 8) < 0) {
+        LIBSPOTIFYPP_LOG_ERROR(logger, "unable to listen on %s: %s", path, std::strerror(errno));
+        CloseFd(&listen_fd_);
+        CloseFd(&stop_fds_[0]);
+        CloseFd(&stop_fds_[1]);
+        return false;
+    }
+
+    path_ = path;
+    thread_ = boost::thread(boost::bind(&MetricsExporter::Run, this));
+    LIBSPOTIFYPP_LOG_INFO(logger, "serving metrics on %s", path);
+    return true;
+}
+
+void MetricsExporter::Stop() {
+    if (!IsRunning())
+        return;
+
+    char stop = 0;
+    if (write(stop_fds_[1], &stop, 1) < 0)
+        LIBSPOTIFYPP_LOG_WARN(logger, "unable to wake the exporter thread up");
+    thread_.join();
+
+    CloseFd(&listen_fd_);
+    CloseFd(&stop_fds_[0]);
+    CloseFd(&stop_fds_[1]);
+    unlink(path_.c_str());
+    path_.clear();
+}
+
+bool MetricsExporter::IsRunning() const {
+    return listen_fd_ >= 0;
+}
+
+void MetricsExporter::Run() {
+    for (;;) {
+        pollfd fds[2];
+        fds[0].fd = listen_fd_;
+        fds[0].events = POLLIN;
+        fds[1].fd = stop_fds_[0];
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            LIBSPOTIFYPP_LOG_ERROR(logger, "poll failed: %s", std::strerror(errno));
+            return;
+        }
+        if (fds[1].revents)
+            return;
+        if (!(fds[0].revents & POLLIN))
+            continue;
+
+        int client = accept(listen_fd_, NULL, NULL);
+        if (client < 0)
+            continue;
+        Serve(client);
+        close(client);
+    }
+}
+
+void MetricsExporter::Serve(int client) {
+    // the request is read and ignored, whatever the path every client gets the document
+    pollfd fd;
+    fd.fd = client;
+    fd.events = POLLIN;
+    if (poll(&fd, 1, kRequestTimeoutMs) > 0) {
+        char request[1024];
+        if (recv(client, request, sizeof(request), 0) < 0)
+            return;
+    }
+
+    std::string body = source_();
+    std::ostringstream response;
+    response << "HTTP/1.0 200 OK\r\n"
+             << "Content-Type: text/plain; version=0.0.4\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "\r\n"
+             << body;
+    if (!WriteAll(client, response.str()))
+        LIBSPOTIFYPP_LOG_DEBUG(logger, "client went away: %s", std::strerror(errno));
+}
+#else
+bool MetricsExporter::Start(const std::string &path) {
+    LIBSPOTIFYPP_LOG_ERROR(logger, "unix domain sockets are not supported on this platform");
+    return false;
+}
+
+void MetricsExporter::Stop() {
+}
+
+bool MetricsExporter::IsRunning() const {
+    return false;
+}
+
+void MetricsExporter::Run() {
+}
+
+void MetricsExporter::Serve(int client) {
+}
+#endif
+}
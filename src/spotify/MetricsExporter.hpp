@@ -0,0 +1,63 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// std includes
+#include <string>
+
+// boost includes
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+/// @class MetricsExporter
+/// @brief Serves a text document over HTTP on a Unix domain socket, from a thread of its own.
+///
+/// Every connection is answered with a single HTTP/1.0 response holding what the source returns, then closed, so
+/// `curl --unix-socket <path> http://localhost/metrics` or a Prometheus scrape proxy can read it. The source runs on
+/// the exporter thread. Not available on Windows, where Start always fails.
+class LIBSPOTIFYPP_API MetricsExporter {
+  public:
+    typedef boost::function<std::string ()> Source;
+
+    explicit MetricsExporter(const Source &source);
+    ~MetricsExporter();
+
+    /// @brief Binds the socket, replacing a stale one at path, and starts serving
+    bool Start(const std::string &path);
+    /// @brief Stops serving and removes the socket, waits for the response being written
+    void Stop();
+
+    bool IsRunning() const;
+
+  private:
+    MetricsExporter(const MetricsExporter &);
+    MetricsExporter &operator=(const MetricsExporter &);
+
+    void Run();
+    void Serve(int client);
+
+    Source source_;
+    std::string path_;
+    int listen_fd_;
+    int stop_fds_[2];  // self-pipe waking the exporter thread up on Stop
+    boost::thread thread_;
+};
+}
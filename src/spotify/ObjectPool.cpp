@@ -0,0 +1,91 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/ObjectPool.hpp"
+
+#include <boost/thread/locks.hpp>
+
+namespace spotify {
+namespace {
+// new char[] is aligned for any fundamental type, blocks keep that alignment
+const std::size_t kBlockAlignment = 16;
+}
+
+ObjectPool::ObjectPool(std::size_t blocks_per_chunk) : block_size_(0), blocks_per_chunk_(blocks_per_chunk)
+                                                     , free_(NULL), live_(0) {
+}
+
+ObjectPool::~ObjectPool() {
+    for (std::size_t i = 0; i < chunks_.size(); ++i)
+        delete[] chunks_[i];
+}
+
+void ObjectPool::AddChunk() {
+    char *chunk = new char[block_size_ * blocks_per_chunk_];
+    chunks_.push_back(chunk);
+
+    // blocks are linked back to front so they are handed out in address order
+    for (std::size_t i = blocks_per_chunk_; i > 0; --i) {
+        FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + (i - 1) * block_size_);
+        block->next = free_;
+        free_ = block;
+    }
+}
+
+void *ObjectPool::Allocate(std::size_t size) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    if (!block_size_) {
+        std::size_t block_size = size < sizeof(FreeBlock) ? sizeof(FreeBlock) : size;
+        block_size_ = (block_size + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment;
+    }
+
+    if (size > block_size_)
+        return ::operator new(size);
+
+    if (!free_)
+        AddChunk();
+
+    FreeBlock *block = free_;
+    free_ = block->next;
+    ++live_;
+    return block;
+}
+
+void ObjectPool::Deallocate(void *block, std::size_t size) {
+    if (!block)
+        return;
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    if (size > block_size_) {
+        ::operator delete(block);
+        return;
+    }
+
+    FreeBlock *free_block = static_cast<FreeBlock *>(block);
+    free_block->next = free_;
+    free_ = free_block;
+    --live_;
+}
+
+PoolStats ObjectPool::GetStats() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    PoolStats stats;
+    stats.block_size = block_size_;
+    stats.live = live_;
+    stats.capacity = chunks_.size() * blocks_per_chunk_;
+    return stats;
+}
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// C-libs includes
+#include <cstddef>
+
+// std includes
+#include <new>
+#include <vector>
+
+// boost includes
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+/// @brief Occupancy of an ObjectPool
+struct LIBSPOTIFYPP_API PoolStats {
+    std::size_t block_size;  // bytes per block, zero until the first allocation
+    std::size_t live;        // blocks handed out
+    std::size_t capacity;    // blocks in the chunks allocated so far
+};
+
+/// @class ObjectPool
+/// @brief Arena of fixed size blocks, carved out of chunks that are only freed with the pool.
+///
+/// The block size is fixed by the first allocation; larger requests fall back to the heap. Freed blocks go to a free
+/// list and are reused before a new chunk is allocated.
+class LIBSPOTIFYPP_API ObjectPool {
+  public:
+    explicit ObjectPool(std::size_t blocks_per_chunk = 256);
+    ~ObjectPool();
+
+    /// @brief Safe to call from any thread
+    void *Allocate(std::size_t size);
+    void Deallocate(void *block, std::size_t size);
+
+    PoolStats GetStats();
+
+  private:
+    ObjectPool(const ObjectPool &);
+    ObjectPool &operator=(const ObjectPool &);
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    void AddChunk();
+
+    boost::mutex mutex_;
+    std::size_t block_size_;
+    std::size_t blocks_per_chunk_;
+    std::vector<char *> chunks_;
+    FreeBlock *free_;
+    std::size_t live_;
+};
+
+/// @class PoolAllocator
+/// @brief Standard allocator over an ObjectPool, meant for boost::allocate_shared so the object and its control block
+/// share a single block. Every copy keeps the pool alive, so objects may outlive whoever created the pool.
+template <typename T>
+class PoolAllocator {
+  public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U> other;
+    };
+
+    explicit PoolAllocator(boost::shared_ptr<ObjectPool> pool) : pool_(pool) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool_) {}  // NOLINT
+
+    pointer address(reference value) const { return &value; }
+    const_pointer address(const_reference value) const { return &value; }
+
+    pointer allocate(size_type n, const void * = 0) {
+        return static_cast<pointer>(pool_->Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(pointer block, size_type n) {
+        pool_->Deallocate(block, n * sizeof(T));
+    }
+
+    size_type max_size() const { return static_cast<size_type>(-1) / sizeof(T); }
+
+    void construct(pointer block, const T &value) { new(block) T(value); }
+    void destroy(pointer block) { block->~T(); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &other) const { return pool_ == other.pool_; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &other) const { return pool_ != other.pool_; }
+
+  private:
+    template <typename U> friend class PoolAllocator;
+
+    boost::shared_ptr<ObjectPool> pool_;
+};
+}
@@ -17,27 +17,47 @@
  */
 #include "spotify/PlayList.hpp"
 
-#include <log4cplus/loggingmacros.h>
 #include <log4cplus/logger.h>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <cstdlib>
 
-#include <boost/format.hpp>
+#include <boost/make_shared.hpp>
 
 // local includes
+#include "spotify/AsyncLog.hpp"
+#include "spotify/PlayListContainer.hpp"
 #include "spotify/Session.hpp"
+#include "spotify/Trace.hpp"
 #include "spotify/Track.hpp"
+#include "spotify/TrackSnapshot.hpp"
 
 
 
 namespace spotify {
 namespace {
 log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.PlayList");
+
+// the snapshot releases its libspotify references when destroyed, which has to happen on the session thread
+struct SnapshotDeleter {
+    void operator()(const TrackSnapshot *snapshot) const {
+        boost::shared_ptr<Session> owner = session.lock();
+        if (owner)
+            owner->RunOnSessionThread([snapshot] { delete snapshot; });
+        else
+            delete snapshot;
+    }
+
+    boost::weak_ptr<Session> session;
+};
 }
 
 PlayList::PlayList(boost::shared_ptr<Session> session) : PlayListElement(session), playlist_(NULL)
-                                                       , is_loading_(false) {
+                                                       , is_loading_(false)
+                                                       , is_lazy_(session && session->lazy_playlist_tracks_)
+                                                       , num_tracks_(0) {
 }
 
 PlayList::~PlayList() {
@@ -59,8 +79,10 @@ bool PlayList::Load(sp_playlist *playlist) {
 
     if (!sp_playlist_is_loaded(playlist_)) {
         is_loading_ = true;
+        AddPendingLoads(1);
     } else {
         LoadTracks();
+        session_->MarkCacheDirty(this);
     }
 
     return true;
@@ -68,18 +90,108 @@ bool PlayList::Load(sp_playlist *playlist) {
 
 void PlayList::LoadTracks() {
     int num_tracks = sp_playlist_num_tracks(playlist_);
+    CountPendingTracks();
+
+    if (is_lazy_) {
+        num_tracks_ = num_tracks;
+        InvalidateTracks(0, num_tracks_);
+        return;
+    }
 
-    tracks_.empty();
+    tracks_.clear();
     tracks_.reserve(num_tracks);
 
-    for (int j = 0; j < num_tracks; j++) {
-        sp_track *t = sp_playlist_track(playlist_, j);
+    for (int j = 0; j < num_tracks; j++)
+        tracks_.push_back(CreateTrack(sp_playlist_track(playlist_, j)));
+}
+
+void PlayList::CountPendingTracks() {
+    std::vector<sp_track *> pending;
+    int num_tracks = sp_playlist_num_tracks(playlist_);
+    for (int i = 0; i < num_tracks; ++i) {
+        sp_track *track = sp_playlist_track(playlist_, i);
+        if (!sp_track_is_loaded(track))
+            pending.push_back(track);
+    }
+    SetPendingTracks(pending);
+}
 
-        boost::shared_ptr<Track> track = session_->CreateTrack();
-        track->Load(t);
+void PlayList::AddPendingTracks(sp_track *const *tracks, int num_tracks) {
+    std::vector<sp_track *> pending(pending_tracks_);
+    for (int i = 0; i < num_tracks; ++i) {
+        if (!sp_track_is_loaded(tracks[i]))
+            pending.push_back(tracks[i]);
+    }
+    SetPendingTracks(pending);
+}
 
-        tracks_.push_back(track);
+void PlayList::UpdatePendingTracks() {
+    std::vector<sp_track *> pending;
+    for (std::size_t i = 0; i < pending_tracks_.size(); ++i) {
+        if (!sp_track_is_loaded(pending_tracks_[i]))
+            pending.push_back(pending_tracks_[i]);
     }
+    SetPendingTracks(pending);
+}
+
+void PlayList::SetPendingTracks(const std::vector<sp_track *> &pending) {
+    int delta = static_cast<int>(pending.size()) - static_cast<int>(pending_tracks_.size());
+    pending_tracks_ = pending;
+
+    // the session only asks the playlists with tracks still loading on metadata_updated
+    if (session_) {
+        if (pending_tracks_.empty())
+            session_->loading_playlists_.erase(this);
+        else
+            session_->loading_playlists_.insert(this);
+        // the names of the tracks that loaded go to the cache
+        if (delta < 0 && playlist_)
+            session_->MarkCacheDirty(this);
+    }
+
+    AddPendingLoads(delta);
+}
+
+boost::shared_ptr<Track> PlayList::CreateTrack(sp_track *t) {
+    return session_->GetTrack(t);
+}
+
+void PlayList::UpdateContainerIndex() {
+    boost::shared_ptr<PlayListElement> root = GetParent();
+    while (root && root->GetParent())
+        root = root->GetParent();
+
+    if (root && root->GetType() == PLAYLIST_CONTAINER)
+        boost::static_pointer_cast<PlayListContainer>(root)->IndexPlayList(this);
+}
+
+void PlayList::InvalidateTracks(int first, int last) {
+    int end = std::min(static_cast<int>(chunks_.size()), (last + kChunkSize - 1) / kChunkSize);
+    for (int i = first / kChunkSize; i < end; ++i)
+        TrackStore().swap(chunks_[i]);
+
+    chunks_.resize((num_tracks_ + kChunkSize - 1) / kChunkSize);
+}
+
+void PlayList::EvictTracks() {
+    for (std::size_t i = 0; i < chunks_.size(); ++i) {
+        TrackStore &chunk = chunks_[i];
+        bool is_held = false;
+        for (TrackStore::iterator it = chunk.begin(); it != chunk.end(); ++it) {
+            if (*it && !it->unique())
+                is_held = true;
+            else
+                it->reset();
+        }
+
+        if (!is_held)
+            TrackStore().swap(chunk);
+    }
+}
+
+boost::shared_ptr<const TrackSnapshot> PlayList::Snapshot() {
+    SnapshotDeleter deleter = {session_};
+    return boost::shared_ptr<const TrackSnapshot>(new TrackSnapshot(session_->session_, playlist_), deleter);
 }
 
 void PlayList::Unload() {
@@ -91,36 +203,44 @@ void PlayList::Unload() {
 
         sp_playlist_release(playlist_);
         tracks_.clear();
-
+        chunks_.clear();
+        num_tracks_ = 0;
+        SetPendingTracks(std::vector<sp_track *>());
+        if (session_)
+            session_->ForgetCache(this);
+
+        if (is_loading_)
+            AddPendingLoads(-1);
         is_loading_ = false;
         playlist_ = NULL;
     }
 }
 
 bool PlayList::IsLoading(bool recursive) {
-    int num_tracks = GetNumTracks();
-
     // is playlist, or any of its' tracks loading?
     if (is_loading_)
         return true;
 
-    if (recursive) {
-        for (int i = 0; i < num_tracks; i++) {
-            if (tracks_[i]->IsLoading(recursive)) {
-                return true;
-            }
-        }
-    }
-
-    return false;
+    return recursive && GetPendingLoads() > 0;
 }
 
 int PlayList::GetNumTracks() {
-    return tracks_.size();
+    return is_lazy_ ? num_tracks_ : static_cast<int>(tracks_.size());
 }
 
 boost::shared_ptr<Track> PlayList::GetTrack(int index) {
-    return tracks_[index];
+    if (!is_lazy_)
+        return tracks_[index];
+
+    TrackStore &chunk = chunks_[index / kChunkSize];
+    if (chunk.empty())
+        chunk.resize(kChunkSize);
+
+    boost::shared_ptr<Track> &track = chunk[index % kChunkSize];
+    if (!track)
+        track = CreateTrack(sp_playlist_track(playlist_, index));
+
+    return track;
 }
 
 std::string PlayList::GetName() {
@@ -128,23 +248,35 @@ std::string PlayList::GetName() {
     return name;
 }
 
+std::string PlayList::GetLink() {
+    sp_link *link = sp_link_create_from_playlist(playlist_);
+    if (!link)
+        return "";
+
+    const int BUFFER_SIZE = 256;
+    char buffer[BUFFER_SIZE] = "";
+    sp_link_as_string(link, buffer, BUFFER_SIZE);
+    sp_link_release(link);
+    return buffer;
+}
+
 bool PlayList::HasChildren() {
-    return !tracks_.empty();
+    return GetNumTracks() > 0;
 }
 
 int PlayList::GetNumChildren() {
-    return tracks_.size();
+    return GetNumTracks();
 }
 
 boost::shared_ptr<PlayListElement> PlayList::GetChild(int index) {
-    return tracks_[index];
+    return GetTrack(index);
 }
 
 void PlayList::DumpToTTY(int level) {
     std::string indent = "";
     for (int i = 0; i < level; ++i)
         indent += " ";
-    LOG4CPLUS_DEBUG(logger, (boost::format("%sPlaylist [%s]") % indent % GetName()));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "%sPlaylist [%s]", indent, GetName());
 
     ++level;
 
@@ -154,6 +286,18 @@ void PlayList::DumpToTTY(int level) {
         GetTrack(i)->DumpToTTY(level);
 }
 
+void PlayList::connectToOnTracksAdded(boost::function<void (int, int)> callback) { // NOLINT
+    on_tracks_added_.connect(callback);
+}
+
+void PlayList::connectToOnTracksRemoved(boost::function<void (const int *, int)> callback) { // NOLINT
+    on_tracks_removed_.connect(callback);
+}
+
+void PlayList::connectToOnTracksMoved(boost::function<void (const int *, int, int)> callback) { // NOLINT
+    on_tracks_moved_.connect(callback);
+}
+
 void PlayList::GetCallbacks(sp_playlist_callbacks *callbacks) {
     std::memset(callbacks, 0, sizeof(*callbacks));
 
@@ -179,114 +323,257 @@ PlayList *PlayList::GetPlayListFromUserData(sp_playlist *pl, void *userdata) {
 
 void PlayList::callback_tracks_added(sp_playlist *pl, sp_track *const *tracks, int num_tracks, int position,
                                      void *userdata) {
+    Trace::Record(TRACE_TRACKS_ADDED, pl, num_tracks, position);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_TRACKS_ADDED);
     play_list->OnTracksAdded(tracks, num_tracks, position);
+    play_list->session_->MarkCacheDirty(play_list);
 }
 
 void PlayList::callback_tracks_removed(sp_playlist *pl, const int *tracks, int num_tracks, void *userdata) {
+    Trace::Record(TRACE_TRACKS_REMOVED, pl, num_tracks);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_TRACKS_REMOVED);
     play_list->OnTracksRemoved(tracks, num_tracks);
+    play_list->session_->MarkCacheDirty(play_list);
 }
 
 void PlayList::callback_tracks_moved(sp_playlist *pl, const int *tracks, int num_tracks, int new_position,
                                      void *userdata) {
+    Trace::Record(TRACE_TRACKS_MOVED, pl, num_tracks, new_position);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_TRACKS_MOVED);
     play_list->OnTracksMoved(tracks, num_tracks, new_position);
+    play_list->session_->MarkCacheDirty(play_list);
 }
 
 void PlayList::callback_playlist_renamed(sp_playlist *pl, void *userdata) {
+    Trace::Record(TRACE_PLAYLIST_RENAMED, pl);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_PLAYLIST_RENAMED);
     play_list->OnPlaylistRenamed();
 }
 
 void PlayList::callback_playlist_state_changed(sp_playlist *pl, void *userdata) {
+    Trace::Record(TRACE_PLAYLIST_STATE_CHANGED, pl);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_PLAYLIST_STATE_CHANGED);
     play_list->OnPlaylistStateChanged();
 }
 
 void PlayList::callback_playlist_update_in_progress(sp_playlist *pl, bool done, void *userdata) {
+    Trace::Record(TRACE_PLAYLIST_UPDATE_IN_PROGRESS, pl, done);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_PLAYLIST_UPDATE_IN_PROGRESS);
     play_list->OnPlaylistUpdateInProgress(done);
 }
 
 void PlayList::callback_playlist_metadata_updated(sp_playlist *pl, void *userdata) {
+    Trace::Record(TRACE_PLAYLIST_METADATA_UPDATED, pl);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_PLAYLIST_METADATA_UPDATED);
     play_list->OnPlaylistMetadataUpdated();
 }
 
 void PlayList::callback_track_created_changed(sp_playlist *pl, int position, sp_user *user, int when,
                                               void *userdata) {
+    Trace::Record(TRACE_TRACK_CREATED_CHANGED, pl, position, when);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_TRACK_CREATED_CHANGED);
     play_list->OnTrackCreatedChanged(position, user, when);
 }
 
 void PlayList::callback_track_seen_changed(sp_playlist *pl, int position, bool seen, void *userdata) {
+    Trace::Record(TRACE_TRACK_SEEN_CHANGED, pl, position, seen);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_TRACK_SEEN_CHANGED);
     play_list->OnTrackSeenChanged(position, seen);
 }
 
 void PlayList::callback_description_changed(sp_playlist *pl, const char *desc, void *userdata) {
+    Trace::Record(TRACE_DESCRIPTION_CHANGED, pl);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_DESCRIPTION_CHANGED);
     play_list->OnDescriptionChanged(desc);
 }
 
 void PlayList::callback_image_changed(sp_playlist *pl, const byte *image, void *userdata) {
+    Trace::Record(TRACE_IMAGE_CHANGED, pl);
     PlayList *play_list = GetPlayListFromUserData(pl, userdata);
+    play_list->session_->metrics_->CountCallback(TRACE_IMAGE_CHANGED);
     play_list->OnImageChanged(image);
 }
 
+// The deltas are only applied once the tracks are loaded, until then LoadTracks picks them up. A lazy playlist
+// only drops the cached wrappers of the range the delta touches, they are created again from libspotify on demand.
+
 void PlayList::OnTracksAdded(sp_track *const *tracks, int num_tracks, int position) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnTracksAdded [0x%08X] num_tracks[%d] position[%d]")
-                                           % this % num_tracks % position));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnTracksAdded [0x%08X] num_tracks[%d] position[%d]",
+                           this, num_tracks, position);
+    if (is_loading_)
+        return;
+
+    position = std::max(0, std::min(position, GetNumTracks()));
+
+    AddPendingTracks(tracks, num_tracks);
+
+    if (is_lazy_) {
+        num_tracks_ += num_tracks;
+        InvalidateTracks(position, num_tracks_);
+        on_tracks_added_(position, num_tracks);
+        return;
+    }
+
+    // the new wrappers are built first so the tail is shifted only once
+    TrackStore added;
+    added.reserve(num_tracks);
+    for (int i = 0; i < num_tracks; ++i)
+        added.push_back(CreateTrack(tracks[i]));
+
+    tracks_.insert(tracks_.begin() + position, added.begin(), added.end());
+
+    on_tracks_added_(position, num_tracks);
 }
 
 void PlayList::OnTracksRemoved(const int *tracks, int num_tracks) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnTracksRemoved [0x%08X] num_tracks[%d]") % this % num_tracks));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnTracksRemoved [0x%08X] num_tracks[%d]", this, num_tracks);
+    if (is_loading_ || num_tracks <= 0)
+        return;
+
+    int size = GetNumTracks();
+    std::vector<int> removed;
+    removed.reserve(num_tracks);
+    for (int i = 0; i < num_tracks; ++i) {
+        if (tracks[i] >= 0 && tracks[i] < size)
+            removed.push_back(tracks[i]);
+    }
+    if (removed.empty())
+        return;
+    std::sort(removed.begin(), removed.end());
+    removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+
+    // the removed tracks are already gone from libspotify, the pending ones are counted again if there are any
+    if (!pending_tracks_.empty())
+        CountPendingTracks();
+
+    if (is_lazy_) {
+        num_tracks_ -= static_cast<int>(removed.size());
+        InvalidateTracks(removed.front(), size);
+        on_tracks_removed_(tracks, num_tracks);
+        return;
+    }
+
+    // single pass from the first removed index, every kept track is moved at most once
+    std::size_t next = 0;
+    int write = removed.front();
+    for (int read = removed.front(); read < size; ++read) {
+        if (next < removed.size() && removed[next] == read) {
+            ++next;
+            continue;
+        }
+        tracks_[write++].swap(tracks_[read]);
+    }
+    tracks_.resize(write);
+
+    on_tracks_removed_(tracks, num_tracks);
 }
 
 void PlayList::OnTracksMoved(const int *tracks, int num_tracks, int new_position) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnTracksMoved [0x%08X] num_tracks[%d] new_position[%d]")
-                                           % this % num_tracks % new_position));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnTracksMoved [0x%08X] num_tracks[%d] new_position[%d]",
+                           this, num_tracks, new_position);
+    if (is_loading_ || num_tracks <= 0)
+        return;
+
+    int size = GetNumTracks();
+    std::vector<int> moved;
+    moved.reserve(num_tracks);
+    for (int i = 0; i < num_tracks; ++i) {
+        if (tracks[i] >= 0 && tracks[i] < size)
+            moved.push_back(tracks[i]);
+    }
+    if (moved.empty())
+        return;
+    std::sort(moved.begin(), moved.end());
+    moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+
+    int first = moved.front();
+    int last = moved.back() + 1;
+    int position = std::max(0, std::min(new_position, size));
+
+    if (is_lazy_) {
+        InvalidateTracks(std::min(first, position), std::max(last, position));
+    } else if (last - first == static_cast<int>(moved.size())) {
+        // a contiguous block, the usual case, is a rotation of the range between it and its destination
+        if (position > last)
+            std::rotate(tracks_.begin() + first, tracks_.begin() + last, tracks_.begin() + position);
+        else if (position < first)
+            std::rotate(tracks_.begin() + position, tracks_.begin() + first, tracks_.begin() + last);
+    } else {
+        // scattered tracks, only the range spanning them and the destination is rebuilt
+        int begin = std::min(first, position);
+        int end = std::max(last, position);
+        TrackStore before, block, after;
+        std::size_t next = 0;
+        for (int i = begin; i < end; ++i) {
+            if (next < moved.size() && moved[next] == i) {
+                block.push_back(tracks_[i]);
+                ++next;
+            } else if (i < position) {
+                before.push_back(tracks_[i]);
+            } else {
+                after.push_back(tracks_[i]);
+            }
+        }
+        TrackStore::iterator out = std::copy(before.begin(), before.end(), tracks_.begin() + begin);
+        out = std::copy(block.begin(), block.end(), out);
+        std::copy(after.begin(), after.end(), out);
+    }
+
+    on_tracks_moved_(tracks, num_tracks, new_position);
 }
 
 void PlayList::OnPlaylistRenamed() {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnPlaylistRenamed [0x%08X]") % this));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnPlaylistRenamed [0x%08X]", this);
+    UpdateContainerIndex();
 }
 
 void PlayList::OnPlaylistStateChanged() {
     bool loaded = sp_playlist_is_loaded(playlist_);
 
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnPlaylistStateChanged [0x%08X] m_isLoading [%d] isLoaded [%d]")
-                                           % this % is_loading_ % loaded));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnPlaylistStateChanged [0x%08X] m_isLoading [%d] isLoaded [%d]",
+                           this, is_loading_, loaded);
 
     if (is_loading_ && loaded) {
         is_loading_ = false;
+        // the tracks are counted before the playlist stops counting itself
         LoadTracks();
+        AddPendingLoads(-1);
+        UpdateContainerIndex();
+        session_->MarkCacheDirty(this);
     }
 }
 
 void PlayList::OnPlaylistUpdateInProgress(bool done) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnPlaylistUpdateInProgress [0x%08X] - done [%d]")
-                                           % this % done));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnPlaylistUpdateInProgress [0x%08X] - done [%d]", this, done);
 }
 
 void PlayList::OnPlaylistMetadataUpdated() {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnPlaylistMetadataUpdated [0x%08X]") % this));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnPlaylistMetadataUpdated [0x%08X]", this);
 }
 
 void PlayList::OnTrackCreatedChanged(int position, sp_user *user, int when) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnTrackCreatedChanged [0x%08X]") % this));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnTrackCreatedChanged [0x%08X]", this);
 }
 
 void PlayList::OnTrackSeenChanged(int position, bool seen) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnTrackSeenChanged [0x%08X]") % this));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnTrackSeenChanged [0x%08X]", this);
 }
 
 void PlayList::OnDescriptionChanged(const char *desc) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnDescriptionChanged [0x%08X]") % this));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnDescriptionChanged [0x%08X]", this);
 }
 
 void PlayList::OnImageChanged(const byte *image) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("PlayList::OnImageChanged [0x%08X]") % this));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "PlayList::OnImageChanged [0x%08X]", this);
 }
 }  // namespace spotify
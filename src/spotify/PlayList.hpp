@@ -27,6 +27,8 @@
 
 // boost includes
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/signal.hpp>
 
 // local includes
 #include "spotify/LibConfig.hpp"
@@ -36,6 +38,7 @@ namespace spotify {
 // forward declarations
 class Session;
 class Track;
+class TrackSnapshot;
 
 class LIBSPOTIFYPP_API PlayList : public PlayListElement {
   public:
@@ -49,9 +52,19 @@ class LIBSPOTIFYPP_API PlayList : public PlayListElement {
     virtual bool IsLoading(bool recursive);
 
     virtual int GetNumTracks();
+    /// @brief With Config::lazy_playlist_tracks the wrapper is created on the first call for the index and cached
     virtual boost::shared_ptr<Track> GetTrack(int index);
+    /// @brief Releases the cached wrappers of a lazy playlist that are not held anywhere else, they are created
+    /// again on the next GetTrack. Does nothing on an eager playlist.
+    void EvictTracks();
+    /// @brief Name, duration, popularity, disc, starred, album and first artist of every track, read in one pass into
+    /// contiguous columns, see TrackSnapshot. Fields still loading are left empty and counted by
+    /// TrackSnapshot::GetNumLoading, a later snapshot picks them up.
+    boost::shared_ptr<const TrackSnapshot> Snapshot();
 
     virtual std::string GetName();
+    /// @brief The spotify: URI of the playlist, empty until it is loaded
+    virtual std::string GetLink();
 
     virtual bool HasChildren();
     virtual int GetNumChildren();
@@ -59,6 +72,13 @@ class LIBSPOTIFYPP_API PlayList : public PlayListElement {
 
     virtual void DumpToTTY(int level = 0);
 
+    // connection functions for observers, called once the change is applied to the tracks of the playlist. The
+    // arguments are the ones libspotify passed to the callback.
+    void connectToOnTracksAdded(boost::function<void (int position, int num_tracks)> callback); // NOLINT
+    void connectToOnTracksRemoved(boost::function<void (const int *tracks, int num_tracks)> callback); // NOLINT
+    void connectToOnTracksMoved(boost::function<void (const int *tracks, int num_tracks, int new_position)> // NOLINT
+                                callback);
+
   protected:
     virtual void OnTracksAdded(sp_track *const *tracks, int num_tracks, int position);
     virtual void OnTracksRemoved(const int *tracks, int num_tracks);
@@ -73,9 +93,22 @@ class LIBSPOTIFYPP_API PlayList : public PlayListElement {
     virtual void OnImageChanged(const byte *image);
 
     virtual void LoadTracks();
+    boost::shared_ptr<Track> CreateTrack(sp_track *track);
+    // lazy mode, drops the cached wrappers of the chunks overlapping [first, last) and resizes the cache
+    void InvalidateTracks(int first, int last);
+    // tells the container at the root of the tree that the name or the link of the playlist may have changed
+    void UpdateContainerIndex();
+
+    // pending loads of the tracks, the playlist counts one more while it loads itself
+    void CountPendingTracks();
+    void AddPendingTracks(sp_track *const *tracks, int num_tracks);
+    // called by the session on metadata_updated, only checks the tracks still loading
+    void UpdatePendingTracks();
+    void SetPendingTracks(const std::vector<sp_track *> &pending);
 
   private:
     friend class Session;
+    friend class PlayListContainer;
 
     static void SP_CALLCONV callback_tracks_added(sp_playlist *pl, sp_track *const *tracks, int num_tracks,
                                                   int position, void *userdata);
@@ -100,5 +133,19 @@ class LIBSPOTIFYPP_API PlayList : public PlayListElement {
     bool is_loading_;
     typedef std::vector<boost::shared_ptr<Track>> TrackStore;
     TrackStore tracks_;
+
+    // lazy mode only records the number of tracks, the wrappers are cached in chunks of kChunkSize that stay
+    // unallocated until one of their tracks is requested
+    static const int kChunkSize = 64;
+    bool is_lazy_;
+    int num_tracks_;
+    std::vector<TrackStore> chunks_;
+
+    // tracks of the playlist whose metadata has not arrived, once per position they are at
+    std::vector<sp_track *> pending_tracks_;
+
+    boost::signal<void (int, int)> on_tracks_added_; // NOLINT
+    boost::signal<void (const int *, int)> on_tracks_removed_; // NOLINT
+    boost::signal<void (const int *, int, int)> on_tracks_moved_; // NOLINT
 };
 }
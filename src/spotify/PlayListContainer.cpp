@@ -18,17 +18,19 @@
 #include "spotify/PlayListContainer.hpp"
 
 // c-lib includes
-#include <log4cplus/loggingmacros.h>
 #include <log4cplus/logger.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <string>
+#include <utility>
 
-#include <boost/format.hpp>
 
 // local includes
+#include "spotify/AsyncLog.hpp"
 #include "spotify/PlayListFolder.hpp"
 #include "spotify/Session.hpp"
+#include "spotify/Trace.hpp"
 
 namespace spotify {
 namespace {
@@ -36,7 +38,9 @@ log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.PlayListConta
 }
 
 PlayListContainer::PlayListContainer(boost::shared_ptr<Session> session) : PlayListElement(session), container_(NULL)
-                                                                         , loading_(false), playlists_() {
+                                                                         , loading_(false), splicing_(false)
+                                                                         , all_loaded_(false), playlists_()
+                                                                         , pending_marker_removal_(-1) {
 }
 
 PlayListContainer::~PlayListContainer() {
@@ -62,6 +66,8 @@ bool PlayListContainer::Load(sp_playlistcontainer *container) {
     GetCallbacks(&callbacks);
     sp_playlistcontainer_add_callbacks(container_, &callbacks, this);
     loading_ = true;
+    all_loaded_ = false;
+    AddPendingLoads(1);
     return true;
 }
 
@@ -71,8 +77,19 @@ void PlayListContainer::Unload() {
         GetCallbacks(&callbacks);
         sp_playlistcontainer_remove_callbacks(container_, &callbacks, this);
         container_ = NULL;
+        for (PlayListStore::iterator it = playlists_.begin(); it != playlists_.end(); ++it)
+            (*it)->SetParent(boost::shared_ptr<PlayListElement>());
         playlists_.clear();
+        entries_.clear();
+        pending_marker_removal_ = -1;
+        playlist_index_.clear();
+        name_index_.clear();
+        link_index_.clear();
+        folder_index_.clear();
+        if (loading_)
+            AddPendingLoads(-1);
         loading_ = false;
+        session_->ForgetCache(this);
     }
 }
 
@@ -80,16 +97,7 @@ bool PlayListContainer::IsLoading(bool recursive) {
     if (loading_)
         return true;
 
-    if (recursive) {
-        int numPlayLists = GetNumChildren();
-
-        for (int i = 0; i < numPlayLists; i++) {
-            if (playlists_[i]->IsLoading(recursive))
-                return true;
-        }
-    }
-
-    return false;
+    return recursive && GetPendingLoads() > 0;
 }
 
 void PlayListContainer::AddPlayList(boost::shared_ptr<PlayListElement> playlist) {
@@ -97,6 +105,16 @@ void PlayListContainer::AddPlayList(boost::shared_ptr<PlayListElement> playlist)
     playlists_.push_back(playlist);
 }
 
+void PlayListContainer::InsertPlayList(int index, boost::shared_ptr<PlayListElement> playlist) {
+    playlist->SetParent(shared_from_this());
+    playlists_.insert(playlists_.begin() + index, playlist);
+}
+
+void PlayListContainer::RemovePlayList(int index) {
+    playlists_[index]->SetParent(boost::shared_ptr<PlayListElement>());
+    playlists_.erase(playlists_.begin() + index);
+}
+
 bool PlayListContainer::HasChildren() {
     return !playlists_.empty();
 }
@@ -113,7 +131,7 @@ void PlayListContainer::DumpToTTY(int level) {
     std::string indent = "";
     for (int i = 0; i < level; ++i)
         indent += " ";
-    LOG4CPLUS_DEBUG(logger, (boost::format("%sPlayListContainer") % indent));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "%sPlayListContainer", indent);
 
     ++level;
 
@@ -127,6 +145,122 @@ std::string PlayListContainer::GetName() {
     return "Container";
 }
 
+boost::shared_ptr<PlayListElement> PlayListContainer::FindByName(const std::string &name) {
+    NameIndex::const_iterator found = name_index_.find(name);
+    return found != name_index_.end() ? found->second : boost::shared_ptr<PlayListElement>();
+}
+
+boost::shared_ptr<PlayList> PlayListContainer::FindByLink(const std::string &link) {
+    LinkIndex::const_iterator found = link_index_.find(link);
+    return found != link_index_.end() ? found->second : boost::shared_ptr<PlayList>();
+}
+
+boost::shared_ptr<PlayListFolder> PlayListContainer::FindFolder(sp_uint64 group_id) {
+    FolderIndex::const_iterator found = folder_index_.find(group_id);
+    return found != folder_index_.end() ? found->second : boost::shared_ptr<PlayListFolder>();
+}
+
+void PlayListContainer::IndexPlayList(PlayList *playlist) {
+    PlayListIndex::iterator found = playlist_index_.find(playlist->playlist_);
+    // a playlist removed from the container still points at its old parent
+    if (found == playlist_index_.end() || found->second.playlist.get() != playlist)
+        return;
+
+    RemoveKeys(found->second);
+    ReadKeys(&found->second);
+    AddKeys(found->second);
+    session_->MarkCacheDirty(this);
+}
+
+void PlayListContainer::GetCacheEntries(std::vector<LibraryCache::Entry> *entries) {
+    entries->clear();
+    entries->reserve(entries_.size());
+    for (EntryStore::const_iterator it = entries_.begin(); it != entries_.end(); ++it) {
+        LibraryCache::Entry entry = {it->type, std::string(), std::string(), 0};
+        switch (it->type) {
+            case SP_PLAYLIST_TYPE_PLAYLIST: {
+                // the keys of the index, read once the playlist loaded
+                PlayListIndex::const_iterator found =
+                    playlist_index_.find(boost::static_pointer_cast<PlayList>(it->element)->playlist_);
+                if (found != playlist_index_.end()) {
+                    entry.name = found->second.name;
+                    entry.link = found->second.link;
+                }
+            }   break;
+            case SP_PLAYLIST_TYPE_START_FOLDER:
+            case SP_PLAYLIST_TYPE_END_FOLDER:
+                if (it->element) {
+                    boost::shared_ptr<PlayListFolder> folder = boost::static_pointer_cast<PlayListFolder>(it->element);
+                    entry.name = folder->GetName();
+                    entry.group_id = folder->GetGroupID();
+                }
+                break;
+            case SP_PLAYLIST_TYPE_PLACEHOLDER:
+            default:
+                break;
+        }
+        entries->push_back(entry);
+    }
+}
+
+void PlayListContainer::ReadKeys(IndexedPlayList *entry) {
+    if (sp_playlist_is_loaded(entry->playlist->playlist_)) {
+        entry->name = entry->playlist->GetName();
+        entry->link = entry->playlist->GetLink();
+    } else {
+        entry->name.clear();
+        entry->link.clear();
+    }
+}
+
+void PlayListContainer::AddKeys(const IndexedPlayList &entry) {
+    if (!entry.name.empty())
+        name_index_.insert(std::make_pair(entry.name, entry.playlist));
+    if (!entry.link.empty())
+        link_index_[entry.link] = entry.playlist;
+}
+
+void PlayListContainer::RemoveKeys(const IndexedPlayList &entry) {
+    std::pair<NameIndex::iterator, NameIndex::iterator> named = name_index_.equal_range(entry.name);
+    for (NameIndex::iterator it = named.first; it != named.second; ++it) {
+        if (it->second == entry.playlist) {
+            name_index_.erase(it);
+            break;
+        }
+    }
+
+    LinkIndex::iterator linked = link_index_.find(entry.link);
+    if (linked != link_index_.end() && linked->second == entry.playlist)
+        link_index_.erase(linked);
+}
+
+void PlayListContainer::connectToOnElementAdded(boost::function<void (boost::shared_ptr<PlayListElement>, // NOLINT
+                                                                     boost::shared_ptr<PlayListElement>, int)>
+                                                callback) {
+    on_element_added_.connect(callback);
+}
+
+void PlayListContainer::connectToOnElementRemoved(boost::function<void (boost::shared_ptr<PlayListElement>, // NOLINT
+                                                                       boost::shared_ptr<PlayListElement>, int)>
+                                                  callback) {
+    on_element_removed_.connect(callback);
+}
+
+void PlayListContainer::connectToOnElementMoved(boost::function<void (boost::shared_ptr<PlayListElement>, // NOLINT
+                                                                     boost::shared_ptr<PlayListElement>, int,
+                                                                     boost::shared_ptr<PlayListElement>, int)>
+                                                callback) {
+    on_element_moved_.connect(callback);
+}
+
+void PlayListContainer::connectToOnTreeRebuilt(boost::function<void ()> callback) { // NOLINT
+    on_tree_rebuilt_.connect(callback);
+}
+
+void PlayListContainer::connectToOnAllLoaded(boost::function<void ()> callback) { // NOLINT
+    on_all_loaded_.connect(callback);
+}
+
 PlayListContainer *PlayListContainer::GetPlayListContainer(sp_playlistcontainer *pc, void *userdata) {
     PlayListContainer *container = reinterpret_cast<PlayListContainer *>(userdata);
     BOOST_ASSERT(container->container_ == pc);
@@ -136,42 +270,396 @@ PlayListContainer *PlayListContainer::GetPlayListContainer(sp_playlistcontainer
 
 void PlayListContainer::callback_playlist_added(sp_playlistcontainer *pc, sp_playlist *playlist, int position,
                                                 void *userdata) {
+    Trace::Record(TRACE_PLAYLIST_ADDED, pc, position);
     PlayListContainer *container = GetPlayListContainer(pc, userdata);
+    container->session_->metrics_->CountCallback(TRACE_PLAYLIST_ADDED);
+    container->splicing_ = true;
     container->OnPlaylistAdded(playlist, position);
+    container->splicing_ = false;
+    container->CheckAllLoaded();
+    container->session_->MarkCacheDirty(container);
 }
 
 void PlayListContainer::callback_playlist_removed(sp_playlistcontainer *pc, sp_playlist *playlist, int position,
                                                   void *userdata) {
+    Trace::Record(TRACE_PLAYLIST_REMOVED, pc, position);
     PlayListContainer *container = GetPlayListContainer(pc, userdata);
+    container->session_->metrics_->CountCallback(TRACE_PLAYLIST_REMOVED);
+    container->splicing_ = true;
     container->OnPlaylistRemoved(playlist, position);
+    container->splicing_ = false;
+    container->CheckAllLoaded();
+    container->session_->MarkCacheDirty(container);
 }
 
 void PlayListContainer::callback_playlist_moved(sp_playlistcontainer *pc, sp_playlist *playlist, int position,
                                                 int new_position, void *userdata) {
+    Trace::Record(TRACE_PLAYLIST_MOVED, pc, position, new_position);
     PlayListContainer *container = GetPlayListContainer(pc, userdata);
+    container->session_->metrics_->CountCallback(TRACE_PLAYLIST_MOVED);
+    container->splicing_ = true;
     container->OnPlaylistMoved(playlist, position, new_position);
+    container->splicing_ = false;
+    container->CheckAllLoaded();
+    container->session_->MarkCacheDirty(container);
 }
 
 void PlayListContainer::callback_container_loaded(sp_playlistcontainer *pc, void *userdata) {
+    Trace::Record(TRACE_CONTAINER_LOADED, pc);
     PlayListContainer *container = GetPlayListContainer(pc, userdata);
+    container->session_->metrics_->CountCallback(TRACE_CONTAINER_LOADED);
+    bool was_loading = container->loading_;
     container->loading_ = false;
+    container->splicing_ = true;
     container->OnContainerLoaded();
+    container->splicing_ = false;
+    // the tree counts the pending loads of the playlists before the container stops counting itself
+    if (was_loading)
+        container->AddPendingLoads(-1);
+    container->CheckAllLoaded();
+    container->session_->MarkCacheDirty(container);
 }
 
+// The callbacks are spliced into entries_, the flat list libspotify positions refer to, and into the children of
+// the parent the position lands in. A callback that does not match that list rebuilds the whole tree.
+
 void PlayListContainer::OnPlaylistAdded(sp_playlist *playlist, int position) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("OnPlaylistAdded [0x%08X]") % playlist));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "OnPlaylistAdded [0x%08X] position[%d]", playlist, position);
+    if (loading_)
+        return;
+
+    if (position < 0 || position > static_cast<int>(entries_.size())) {
+        Rebuild();
+        return;
+    }
+
+    Entry entry = {sp_playlistcontainer_playlist_type(container_, position), boost::shared_ptr<PlayListElement>()};
+    switch (entry.type) {
+        case SP_PLAYLIST_TYPE_PLAYLIST: {
+            entry.element = AcquirePlayList(playlist);
+            entries_.insert(entries_.begin() + position, entry);
+
+            boost::shared_ptr<PlayListElement> parent;
+            int index;
+            Locate(position, &parent, &index);
+            parent->InsertPlayList(index, entry.element);
+            on_element_added_(entry.element, parent, index);
+        }   break;
+        case SP_PLAYLIST_TYPE_START_FOLDER:
+            AddFolder(position);
+            break;
+        case SP_PLAYLIST_TYPE_END_FOLDER:
+            CloseFolder(position);
+            break;
+        case SP_PLAYLIST_TYPE_PLACEHOLDER:
+        default:
+            entries_.insert(entries_.begin() + position, entry);
+            break;
+    }
 }
 
 void PlayListContainer::OnPlaylistRemoved(sp_playlist *playlist, int position) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("OnPlaylistRemoved [0x%08X]") % playlist));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "OnPlaylistRemoved [0x%08X] position[%d]", playlist, position);
+    if (loading_)
+        return;
+
+    if (position == pending_marker_removal_) {
+        pending_marker_removal_ = -1;
+        return;
+    }
+
+    if (position < 0 || position >= static_cast<int>(entries_.size())) {
+        Rebuild();
+        return;
+    }
+
+    Entry entry = entries_[position];
+    switch (entry.type) {
+        case SP_PLAYLIST_TYPE_PLAYLIST: {
+            boost::shared_ptr<PlayListElement> parent;
+            int index;
+            Locate(position, &parent, &index);
+            entries_.erase(entries_.begin() + position);
+            parent->RemovePlayList(index);
+            ReleasePlayList(boost::static_pointer_cast<PlayList>(entry.element)->playlist_);
+            on_element_removed_(entry.element, parent, index);
+        }   break;
+        case SP_PLAYLIST_TYPE_START_FOLDER:
+        case SP_PLAYLIST_TYPE_END_FOLDER:
+            RemoveFolder(position);
+            break;
+        case SP_PLAYLIST_TYPE_PLACEHOLDER:
+        default:
+            entries_.erase(entries_.begin() + position);
+            break;
+    }
 }
 
 void PlayListContainer::OnPlaylistMoved(sp_playlist *playlist, int position, int new_position) {
-    LOG4CPLUS_DEBUG(logger, (boost::format("OnPlaylistMoved [0x%08X]") % playlist));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "OnPlaylistMoved [0x%08X] position[%d] new_position[%d]",
+                           playlist, position, new_position);
+    if (loading_)
+        return;
+
+    int num_entries = entries_.size();
+    if (position < 0 || position >= num_entries || new_position < 0 || new_position > num_entries) {
+        Rebuild();
+        return;
+    }
+
+    MoveElement(position, new_position);
 }
 
 void PlayListContainer::OnContainerLoaded() {
-    LOG4CPLUS_DEBUG(logger, "OnContainerLoaded");
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "OnContainerLoaded");
+    Build();
+    on_tree_rebuilt_();
+}
+
+void PlayListContainer::OnPendingLoadsChanged() {
+    CheckAllLoaded();
+}
+
+void PlayListContainer::CheckAllLoaded() {
+    if (all_loaded_ || splicing_ || loading_ || !container_ || GetPendingLoads() > 0)
+        return;
+
+    all_loaded_ = true;
+    on_all_loaded_();
+}
+
+void PlayListContainer::Rebuild() {
+    LIBSPOTIFYPP_LOG_WARN(logger, "Container callback does not match the tree, rebuilding it");
+    Build();
+    on_tree_rebuilt_();
+}
+
+void PlayListContainer::Locate(int position, boost::shared_ptr<PlayListElement> *parent, int *index) {
+    *parent = shared_from_this();
+    *index = 0;
+
+    // walks back to the start marker of the enclosing folder, counting the siblings on the way
+    int depth = 0;
+    for (int i = position - 1; i >= 0; --i) {
+        const Entry &entry = entries_[i];
+        switch (entry.type) {
+            case SP_PLAYLIST_TYPE_PLAYLIST:
+                if (depth == 0)
+                    ++*index;
+                break;
+            case SP_PLAYLIST_TYPE_START_FOLDER:
+                if (depth == 0) {
+                    *parent = entry.element;
+                    return;
+                }
+                if (--depth == 0)
+                    ++*index;
+                break;
+            case SP_PLAYLIST_TYPE_END_FOLDER:
+                ++depth;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int PlayListContainer::FindPair(int position) {
+    sp_playlist_type type = entries_[position].type;
+    int step = type == SP_PLAYLIST_TYPE_START_FOLDER ? 1 : -1;
+    int depth = 0;
+    for (int i = position; i >= 0 && i < static_cast<int>(entries_.size()); i += step) {
+        if (entries_[i].type == type)
+            ++depth;
+        else if (entries_[i].type == SP_PLAYLIST_TYPE_START_FOLDER || entries_[i].type == SP_PLAYLIST_TYPE_END_FOLDER)
+            --depth;
+
+        if (depth == 0)
+            return i;
+    }
+    return -1;
+}
+
+boost::shared_ptr<PlayList> PlayListContainer::AcquirePlayList(sp_playlist *playlist) {
+    std::pair<PlayListIndex::iterator, bool> slot = playlist_index_.insert(std::make_pair(playlist, IndexedPlayList()));
+    IndexedPlayList &entry = slot.first->second;
+    if (slot.second) {
+        entry.playlist = session_->CreatePlayList();
+        entry.playlist->Load(playlist);
+        ReadKeys(&entry);
+        AddKeys(entry);
+    }
+    return entry.playlist;
+}
+
+void PlayListContainer::ReleasePlayList(sp_playlist *playlist) {
+    PlayListIndex::iterator found = playlist_index_.find(playlist);
+    if (found == playlist_index_.end())
+        return;
+
+    // the same playlist may be in the container more than once
+    for (EntryStore::const_iterator it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->element == found->second.playlist)
+            return;
+    }
+
+    RemoveKeys(found->second);
+    playlist_index_.erase(found);
+}
+
+void PlayListContainer::AddFolder(int position) {
+    boost::shared_ptr<PlayListFolder> folder = session_->CreatePlayListFolder();
+    folder->Load(container_, position);
+    folder_index_[folder->GetGroupID()] = folder;
+    name_index_.insert(std::make_pair(folder->GetName(), folder));
+
+    // the folder stays empty until its end marker is added
+    Entry entry = {SP_PLAYLIST_TYPE_START_FOLDER, folder};
+    entries_.insert(entries_.begin() + position, entry);
+
+    boost::shared_ptr<PlayListElement> parent;
+    int index;
+    Locate(position, &parent, &index);
+    parent->InsertPlayList(index, folder);
+    on_element_added_(folder, parent, index);
+}
+
+void PlayListContainer::CloseFolder(int position) {
+    Entry entry = {SP_PLAYLIST_TYPE_END_FOLDER, boost::shared_ptr<PlayListElement>()};
+    entries_.insert(entries_.begin() + position, entry);
+
+    int start = FindPair(position);
+    if (start < 0) {
+        Rebuild();
+        return;
+    }
+    boost::shared_ptr<PlayListElement> folder = entries_[start].element;
+    entries_[position].element = folder;
+
+    // the elements between the markers move into the folder, usually there are none
+    int child = 0;
+    for (int i = start + 1; i < position; ++i) {
+        Entry &inside = entries_[i];
+        if (inside.type != SP_PLAYLIST_TYPE_PLAYLIST && inside.type != SP_PLAYLIST_TYPE_START_FOLDER)
+            continue;
+
+        if (inside.element->GetParent() != folder) {
+            boost::shared_ptr<PlayListElement> old_parent = inside.element->GetParent();
+            int old_index = 0;
+            while (old_parent->GetChild(old_index) != inside.element)
+                ++old_index;
+            old_parent->RemovePlayList(old_index);
+            folder->InsertPlayList(child, inside.element);
+            on_element_moved_(inside.element, old_parent, old_index, folder, child);
+        }
+        ++child;
+
+        if (inside.type == SP_PLAYLIST_TYPE_START_FOLDER) {
+            int nested_end = FindPair(i);
+            if (nested_end < 0 || nested_end > position)
+                break;
+            i = nested_end;
+        }
+    }
+}
+
+void PlayListContainer::RemoveFolder(int position) {
+    int pair = FindPair(position);
+    if (pair < 0) {
+        entries_.erase(entries_.begin() + position);
+        Rebuild();
+        return;
+    }
+    int start = std::min(position, pair);
+    int end = std::max(position, pair);
+
+    boost::shared_ptr<PlayListFolder> folder = boost::static_pointer_cast<PlayListFolder>(entries_[start].element);
+    boost::shared_ptr<PlayListElement> parent;
+    int index;
+    Locate(start, &parent, &index);
+
+    // the children take the place of the folder
+    for (int i = 0; folder->HasChildren(); ++i) {
+        boost::shared_ptr<PlayListElement> child = folder->GetChild(0);
+        folder->RemovePlayList(0);
+        parent->InsertPlayList(index + 1 + i, child);
+        on_element_moved_(child, folder, 0, parent, index + 1 + i);
+    }
+    parent->RemovePlayList(index);
+
+    folder_index_.erase(folder->GetGroupID());
+    std::pair<NameIndex::iterator, NameIndex::iterator> named = name_index_.equal_range(folder->GetName());
+    for (NameIndex::iterator it = named.first; it != named.second; ++it) {
+        if (it->second == folder) {
+            name_index_.erase(it);
+            break;
+        }
+    }
+
+    entries_.erase(entries_.begin() + end);
+    entries_.erase(entries_.begin() + start);
+    // libspotify reports the other marker next, at its position once this one is gone
+    pending_marker_removal_ = position == start ? end - 1 : start;
+
+    on_element_removed_(folder, parent, index);
+}
+
+void PlayListContainer::MoveElement(int position, int new_position) {
+    // a folder moves with everything up to its end marker
+    int first = position;
+    int last = position + 1;
+    switch (entries_[position].type) {
+        case SP_PLAYLIST_TYPE_START_FOLDER:
+            last = FindPair(position) + 1;
+            if (last == 0) {
+                Rebuild();
+                return;
+            }
+            break;
+        case SP_PLAYLIST_TYPE_END_FOLDER:
+            // moving the end marker alone changes what the folder holds
+            Rebuild();
+            return;
+        default:
+            break;
+    }
+
+    // new_position is a position before the move, inside the block or right after it nothing changes
+    if (new_position >= first && new_position <= last)
+        return;
+
+    boost::shared_ptr<PlayListElement> element = entries_[position].element;
+    boost::shared_ptr<PlayListElement> old_parent;
+    int old_index = 0;
+    if (element) {
+        Locate(first, &old_parent, &old_index);
+        old_parent->RemovePlayList(old_index);
+    }
+
+    EntryStore block(entries_.begin() + first, entries_.begin() + last);
+    entries_.erase(entries_.begin() + first, entries_.begin() + last);
+    int target = new_position > first ? new_position - (last - first) : new_position;
+    entries_.insert(entries_.begin() + target, block.begin(), block.end());
+
+    if (element) {
+        boost::shared_ptr<PlayListElement> new_parent;
+        int new_index;
+        Locate(target, &new_parent, &new_index);
+        new_parent->InsertPlayList(new_index, element);
+        on_element_moved_(element, old_parent, old_index, new_parent, new_index);
+    }
+}
+
+void PlayListContainer::Build() {
+    PlayListIndex previous_playlists;
+    previous_playlists.swap(playlist_index_);
+    FolderIndex previous_folders;
+    previous_folders.swap(folder_index_);
+    name_index_.clear();
+    link_index_.clear();
+    playlists_.clear();
+    entries_.clear();
+    pending_marker_removal_ = -1;
 
     int num_playlists = sp_playlistcontainer_num_playlists(container_);
 
@@ -179,33 +667,71 @@ void PlayListContainer::OnContainerLoaded() {
 
     for (int i = 0; i < num_playlists; i++) {
         sp_playlist_type type = sp_playlistcontainer_playlist_type(container_, i);
+        Entry flat = {type, boost::shared_ptr<PlayListElement>()};
 
         switch (type) {
             case SP_PLAYLIST_TYPE_PLAYLIST: {
                 sp_playlist *p = sp_playlistcontainer_playlist(container_, i);
 
-                boost::shared_ptr<PlayList> playlist = session_->CreatePlayList();
-                playlist->Load(p);
-
-                it_container->AddPlayList(playlist);
+                std::pair<PlayListIndex::iterator, bool> slot = playlist_index_.insert(
+                    std::make_pair(p, IndexedPlayList()));
+                IndexedPlayList &entry = slot.first->second;
+                if (slot.second) {
+                    PlayListIndex::iterator previous = previous_playlists.find(p);
+                    if (previous != previous_playlists.end()) {
+                        entry = previous->second;
+                    } else {
+                        entry.playlist = session_->CreatePlayList();
+                        entry.playlist->Load(p);
+                        ReadKeys(&entry);
+                    }
+                    AddKeys(entry);
+                }
+
+                it_container->AddPlayList(entry.playlist);
+                flat.element = entry.playlist;
             }   break;
             case SP_PLAYLIST_TYPE_START_FOLDER: {
-                boost::shared_ptr<PlayListFolder> folder = session_->CreatePlayListFolder();
+                sp_uint64 group_id = sp_playlistcontainer_playlist_folder_id(container_, i);
+
+                boost::shared_ptr<PlayListFolder> folder;
+                FolderIndex::iterator previous = previous_folders.find(group_id);
+                if (previous != previous_folders.end()) {
+                    folder = previous->second;
+                    folder->Unload();
+                } else {
+                    folder = session_->CreatePlayListFolder();
+                }
                 folder->Load(container_, i);
+                folder_index_[group_id] = folder;
+                name_index_.insert(std::make_pair(folder->GetName(), folder));
 
                 it_container->AddPlayList(folder);
                 it_container = folder;
+                flat.element = folder;
             }   break;
             case SP_PLAYLIST_TYPE_END_FOLDER:
+                flat.element = it_container;
                 it_container = it_container->GetParent();
                 break;
             case SP_PLAYLIST_TYPE_PLACEHOLDER:
             default:
-                LOG4CPLUS_WARN(logger, "Unrecognized playlist type");
+                LIBSPOTIFYPP_LOG_WARN(logger, "Unrecognized playlist type");
                 break;
         }
+        entries_.push_back(flat);
     }
 
     BOOST_ASSERT(it_container == shared_from_this());
+
+    // the elements that left the container stop counting in its pending loads
+    for (PlayListIndex::iterator it = previous_playlists.begin(); it != previous_playlists.end(); ++it) {
+        if (playlist_index_.find(it->first) == playlist_index_.end())
+            it->second.playlist->SetParent(boost::shared_ptr<PlayListElement>());
+    }
+    for (FolderIndex::iterator it = previous_folders.begin(); it != previous_folders.end(); ++it) {
+        if (folder_index_.find(it->first) == folder_index_.end())
+            it->second->SetParent(boost::shared_ptr<PlayListElement>());
+    }
 }
 }
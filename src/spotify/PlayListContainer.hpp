@@ -27,13 +27,18 @@
 
 // boost includes
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/signal.hpp>
+#include <boost/unordered_map.hpp>
 
 // local includes
 #include "spotify/LibConfig.hpp"
-#include "spotify/Playlist.hpp"
+#include "spotify/LibraryCache.hpp"
+#include "spotify/PlayList.hpp"
 
 namespace spotify {
 // forward declaration
+class PlayListFolder;
 class Session;
 
 class LIBSPOTIFYPP_API PlayListContainer : public PlayListElement {
@@ -48,6 +53,8 @@ class LIBSPOTIFYPP_API PlayListContainer : public PlayListElement {
     virtual bool IsLoading(bool recursive);
 
     virtual void AddPlayList(boost::shared_ptr<PlayListElement> playlist);
+    virtual void InsertPlayList(int index, boost::shared_ptr<PlayListElement> playlist);
+    virtual void RemovePlayList(int index);
 
     virtual bool HasChildren();
     virtual int GetNumChildren();
@@ -55,17 +62,80 @@ class LIBSPOTIFYPP_API PlayListContainer : public PlayListElement {
 
     virtual std::string GetName();
 
+    // lookups through hash indexes built with the tree and kept up to date by the container callbacks, empty when
+    // nothing matches. Playlists enter the name and link indexes once loaded. When several elements share a name any
+    // of them may be returned.
+    boost::shared_ptr<PlayListElement> FindByName(const std::string &name);
+    boost::shared_ptr<PlayList> FindByLink(const std::string &link);
+    boost::shared_ptr<PlayListFolder> FindFolder(sp_uint64 group_id);
+
     virtual void DumpToTTY(int level = 0);
 
+    // connection functions for observers, called once a container callback is spliced into the tree. The parent is
+    // the container or the folder holding the element and the index its position among the children of the parent.
+    // A folder is added, moved and removed as a whole, the playlists it held stay in the tree and are reported as
+    // moved. Tree rebuilt is called when the container loads and when a callback could not be applied in place.
+    void connectToOnElementAdded(boost::function<void (boost::shared_ptr<PlayListElement> element, // NOLINT
+                                                       boost::shared_ptr<PlayListElement> parent, int index)> callback);
+    void connectToOnElementRemoved(boost::function<void (boost::shared_ptr<PlayListElement> element, // NOLINT
+                                                         boost::shared_ptr<PlayListElement> parent, int index)>
+                                   callback);
+    void connectToOnElementMoved(boost::function<void (boost::shared_ptr<PlayListElement> element, // NOLINT
+                                                       boost::shared_ptr<PlayListElement> old_parent, int old_index,
+                                                       boost::shared_ptr<PlayListElement> new_parent, int new_index)>
+                                 callback);
+    void connectToOnTreeRebuilt(boost::function<void ()> callback); // NOLINT
+    // called once per Load, when the container and every playlist and track in it have loaded
+    void connectToOnAllLoaded(boost::function<void ()> callback); // NOLINT
+
   protected:
     virtual void OnPlaylistAdded(sp_playlist *playlist, int position);
     virtual void OnPlaylistRemoved(sp_playlist *playlist, int position);
     virtual void OnPlaylistMoved(sp_playlist *playlist, int position, int new_position);
     virtual void OnContainerLoaded();
+    virtual void OnPendingLoadsChanged();
 
   private:
+    friend class PlayList;
     friend class Session;
 
+    // a playlist of the tree with the keys it is indexed under, empty until it is loaded
+    struct IndexedPlayList {
+        boost::shared_ptr<PlayList> playlist;
+        std::string name;
+        std::string link;
+    };
+    typedef boost::unordered_map<sp_playlist *, IndexedPlayList> PlayListIndex;
+    typedef boost::unordered_multimap<std::string, boost::shared_ptr<PlayListElement>> NameIndex;
+    typedef boost::unordered_map<std::string, boost::shared_ptr<PlayList>> LinkIndex;
+    typedef boost::unordered_map<sp_uint64, boost::shared_ptr<PlayListFolder>> FolderIndex;
+
+    // builds the tree and the indexes in a single pass over the container, the wrappers of the playlists and
+    // folders already in the tree are kept
+    void Build();
+    // called by the playlists of the tree when they load or are renamed
+    void IndexPlayList(PlayList *playlist);
+    void ReadKeys(IndexedPlayList *entry);
+    void AddKeys(const IndexedPlayList &entry);
+    void RemoveKeys(const IndexedPlayList &entry);
+    // the flat list as written to the LibraryCache
+    void GetCacheEntries(std::vector<LibraryCache::Entry> *entries);
+
+    // incremental updates, positions are the flat positions of libspotify
+    void Rebuild();
+    // the parent an element at position belongs to and its index among the children of that parent
+    void Locate(int position, boost::shared_ptr<PlayListElement> *parent, int *index);
+    // the position of the other marker of the folder marker at position, -1 when it is missing
+    int FindPair(int position);
+    boost::shared_ptr<PlayList> AcquirePlayList(sp_playlist *playlist);
+    void ReleasePlayList(sp_playlist *playlist);
+    void AddFolder(int position);
+    void CloseFolder(int position);
+    void RemoveFolder(int position);
+    void MoveElement(int position, int new_position);
+    // fires on_all_loaded_ the first time nothing is pending outside of a callback
+    void CheckAllLoaded();
+
     static void SP_CALLCONV callback_playlist_added(sp_playlistcontainer *pc, sp_playlist *playlist, int position,
                                                     void *userdata);
     static void SP_CALLCONV callback_playlist_removed(sp_playlistcontainer *pc, sp_playlist *playlist, int position,
@@ -79,7 +149,33 @@ class LIBSPOTIFYPP_API PlayListContainer : public PlayListElement {
 
     sp_playlistcontainer *container_;
     bool loading_;
+    bool splicing_;  // inside a container callback, the pending loads may pass through zero
+    bool all_loaded_;
     typedef std::vector<boost::shared_ptr<PlayListElement>> PlayListStore;
     PlayListStore playlists_;
+
+    // the flat list of libspotify, the folder markers point at their folder and placeholders at nothing
+    struct Entry {
+        sp_playlist_type type;
+        boost::shared_ptr<PlayListElement> element;
+    };
+    typedef std::vector<Entry> EntryStore;
+    EntryStore entries_;
+    // removing a folder drops both of its markers, the callback of the second one is expected at this position
+    int pending_marker_removal_;
+
+    PlayListIndex playlist_index_;
+    NameIndex name_index_;
+    LinkIndex link_index_;
+    FolderIndex folder_index_;
+
+    boost::signal<void (boost::shared_ptr<PlayListElement>, boost::shared_ptr<PlayListElement>, int)> // NOLINT
+        on_element_added_;
+    boost::signal<void (boost::shared_ptr<PlayListElement>, boost::shared_ptr<PlayListElement>, int)> // NOLINT
+        on_element_removed_;
+    boost::signal<void (boost::shared_ptr<PlayListElement>, boost::shared_ptr<PlayListElement>, int, // NOLINT
+                        boost::shared_ptr<PlayListElement>, int)> on_element_moved_;
+    boost::signal<void ()> on_tree_rebuilt_; // NOLINT
+    boost::signal<void ()> on_all_loaded_; // NOLINT
 };
 }
@@ -20,7 +20,8 @@
 
 
 namespace spotify {
-PlayListElement::PlayListElement(boost::shared_ptr<Session> session) : session_(session), user_data_(NULL) {
+PlayListElement::PlayListElement(boost::shared_ptr<Session> session) : session_(session), user_data_(NULL)
+                                                                     , pending_loads_(0) {
 }
 
 PlayListElement::~PlayListElement() {
@@ -31,7 +32,35 @@ boost::shared_ptr<PlayListElement> PlayListElement::GetParent() const {
 }
 
 void PlayListElement::SetParent(boost::shared_ptr<PlayListElement> parent) {
+    boost::shared_ptr<PlayListElement> old_parent = parent_.lock();
     parent_ = parent;
+    if (old_parent == parent || !pending_loads_)
+        return;
+
+    // added before it is removed, so a common ancestor never sees a count that drops to zero on the way
+    if (parent)
+        parent->AddPendingLoads(pending_loads_);
+    if (old_parent)
+        old_parent->AddPendingLoads(-pending_loads_);
+}
+
+int PlayListElement::GetPendingLoads() const {
+    return pending_loads_;
+}
+
+void PlayListElement::AddPendingLoads(int delta) {
+    if (!delta)
+        return;
+
+    pending_loads_ += delta;
+    OnPendingLoadsChanged();
+    // a recursive WaitFor may be waiting for the count to drop
+    if (delta < 0 && session_)
+        session_->OnLoadProgress();
+
+    boost::shared_ptr<PlayListElement> parent = parent_.lock();
+    if (parent)
+        parent->AddPendingLoads(delta);
 }
 
 void *PlayListElement::GetUserData() {
@@ -46,6 +46,9 @@ class LIBSPOTIFYPP_API PlayListElement : virtual public boost::enable_shared_fro
     virtual boost::shared_ptr<PlayListElement> GetChild(int index) = 0;
 
     virtual bool IsLoading(bool recursive) = 0;
+    /// @brief Loads still pending in the element and below it, kept up to date by the callbacks so a recursive
+    /// IsLoading is a read of this count
+    int GetPendingLoads() const;
 
     virtual std::string GetName() = 0;
 
@@ -60,6 +63,8 @@ class LIBSPOTIFYPP_API PlayListElement : virtual public boost::enable_shared_fro
     virtual PlayListType GetType() = 0;
 
     virtual void AddPlayList(boost::shared_ptr<PlayListElement> playList) {}
+    virtual void InsertPlayList(int index, boost::shared_ptr<PlayListElement> playList) {}
+    virtual void RemovePlayList(int index) {}
 
     virtual void DumpToTTY(int level = 0) = 0;
 
@@ -69,10 +74,16 @@ class LIBSPOTIFYPP_API PlayListElement : virtual public boost::enable_shared_fro
     boost::shared_ptr<Session> GetSession();
 
   protected:
+    // adds delta to the pending loads of the element and of its ancestors
+    void AddPendingLoads(int delta);
+    // called on each element a change of the pending loads goes through
+    virtual void OnPendingLoadsChanged() {}
+
     boost::weak_ptr<PlayListElement> parent_;
     boost::shared_ptr<Session> session_;
 
   private:
     void *user_data_;
+    int pending_loads_;
 };
 }
@@ -19,12 +19,11 @@
 // Lib Includes
 #include "spotify/PlayListFolder.hpp"
 
-#include <log4cplus/loggingmacros.h>
 #include <log4cplus/logger.h>
 
 #include <string>
 
-#include <boost/format.hpp>
+#include "spotify/AsyncLog.hpp"
 
 namespace spotify {
 namespace {
@@ -32,7 +31,8 @@ log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.PlayListFolde
 }
 
 PlayListFolder::PlayListFolder(boost::shared_ptr<Session> session) : PlayListElement(session), playlists_()
-                                                                   , container_(NULL), container_index_(-1) {
+                                                                   , container_(NULL), container_index_(-1)
+                                                                   , group_id_(0) {
 }
 
 PlayListFolder::~PlayListFolder() {
@@ -40,19 +40,10 @@ PlayListFolder::~PlayListFolder() {
 }
 
 bool PlayListFolder::IsLoading(bool recursive) {
-    int numPlayLists = playlists_.size();
-
     if (!container_)
         return false;
 
-    if (recursive) {
-        for (int i = 0; i < numPlayLists; i++) {
-            if (playlists_[i]->IsLoading(recursive))
-                return true;
-        }
-    }
-
-    return false;
+    return recursive && GetPendingLoads() > 0;
 }
 
 PlayListElement::PlayListType PlayListFolder::GetType() {
@@ -63,12 +54,21 @@ bool PlayListFolder::Load(sp_playlistcontainer *container, int index) {
     container_ = container;
     container_index_ = index;
 
+    const int BUFFER_SIZE = 256;
+    char buffer[BUFFER_SIZE] = "";
+    sp_playlistcontainer_playlist_folder_name(container_, container_index_, buffer, BUFFER_SIZE);
+    name_ = buffer;
+    group_id_ = sp_playlistcontainer_playlist_folder_id(container_, container_index_);
+
     return true;
 }
 
 void PlayListFolder::Unload() {
     container_ = NULL;
     container_index_ = -1;
+    name_.clear();
+    group_id_ = 0;
+    playlists_.clear();
 }
 
 void PlayListFolder::AddPlayList(boost::shared_ptr<PlayListElement> playList) {
@@ -76,18 +76,22 @@ void PlayListFolder::AddPlayList(boost::shared_ptr<PlayListElement> playList) {
     playlists_.push_back(playList);
 }
 
-std::string PlayListFolder::GetName() {
-    const int BUFFER_SIZE = 256;
-    char buffer[BUFFER_SIZE];
-    sp_playlistcontainer_playlist_folder_name(container_, container_index_, buffer, BUFFER_SIZE);
+void PlayListFolder::InsertPlayList(int index, boost::shared_ptr<PlayListElement> playList) {
+    playList->SetParent(shared_from_this());
+    playlists_.insert(playlists_.begin() + index, playList);
+}
 
-    std::string folderName = buffer;
-    return folderName;
+void PlayListFolder::RemovePlayList(int index) {
+    playlists_[index]->SetParent(boost::shared_ptr<PlayListElement>());
+    playlists_.erase(playlists_.begin() + index);
+}
+
+std::string PlayListFolder::GetName() {
+    return name_;
 }
 
 sp_uint64 PlayListFolder::GetGroupID() {
-    sp_uint64 groupID = sp_playlistcontainer_playlist_folder_id(container_, container_index_);
-    return groupID;
+    return group_id_;
 }
 
 bool PlayListFolder::HasChildren() {
@@ -106,7 +110,7 @@ void PlayListFolder::DumpToTTY(int level) {
     std::string indent = "";
     for (int i = 0; i < level; ++i)
         indent += " ";
-    LOG4CPLUS_DEBUG(logger, (boost::format("Folder [%s]") % GetName()));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "%sFolder [%s]", indent, GetName());
 
     ++level;
 
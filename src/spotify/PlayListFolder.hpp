@@ -41,10 +41,14 @@ class LIBSPOTIFYPP_API PlayListFolder : public PlayListElement {
     explicit PlayListFolder(boost::shared_ptr<Session> session);
     virtual ~PlayListFolder();
 
+    /// @brief Reads the name and the group id of the folder, which do not change while it is in the container
     virtual bool Load(sp_playlistcontainer *container, int index);
+    /// @brief Forgets the container entry and the children of the folder
     virtual void Unload();
 
     virtual void AddPlayList(boost::shared_ptr<PlayListElement> playList);
+    virtual void InsertPlayList(int index, boost::shared_ptr<PlayListElement> playList);
+    virtual void RemovePlayList(int index);
 
     virtual bool IsLoading(bool recursive);
 
@@ -66,5 +70,7 @@ class LIBSPOTIFYPP_API PlayListFolder : public PlayListElement {
 
     sp_playlistcontainer *container_;
     int container_index_;
+    std::string name_;
+    sp_uint64 group_id_;
 };
 }
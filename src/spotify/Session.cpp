@@ -19,24 +19,51 @@
 // Includes
 #include "spotify/Session.hpp"
 
-#include <log4cplus/loggingmacros.h>
 #include <log4cplus/logger.h>
 
+#include <algorithm>
+#include <exception>
+#include <sstream>
+#include <vector>
+
 #include <boost/make_shared.hpp>
-#include <boost/format.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
 
 #include "spotify/Album.hpp"
+#include "spotify/AlbumBrowse.hpp"
 #include "spotify/Artist.hpp"
+#include "spotify/ArtistBrowse.hpp"
+#include "spotify/AsyncLog.hpp"
+#include "spotify/AudioBuffer.hpp"
+#include "spotify/CommandQueue.hpp"
 #include "spotify/Image.hpp"
+#include "spotify/LibraryCache.hpp"
+#include "spotify/MetricsExporter.hpp"
 #include "spotify/PlayList.hpp"
 #include "spotify/PlayListContainer.hpp"
 #include "spotify/PlayListElement.hpp"
 #include "spotify/PlayListFolder.hpp"
+#include "spotify/Trace.hpp"
 #include "spotify/Track.hpp"
+#include "spotify/TrackSnapshot.hpp"
+#include "spotify/Wakeup.hpp"
 
 namespace spotify {
 namespace {
 log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.Session");
+
+// leaves room for sp_session_process_events when commands are posted faster than they run
+const int kMaxCommandsPerUpdate = 256;
+
+// a playlist cached while some of its artists or albums were loading is written again at most this often
+const std::chrono::milliseconds kIncompleteRewriteInterval(1000);
+
+// rounded up, waking before the deadline would only come back with nothing to do
+int MillisecondsUntil(Session::Deadline next, Session::Deadline now) {
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        next - now + std::chrono::milliseconds(1) - Session::Deadline::duration(1)).count());
+}
 }
 
 Config::Config() {
@@ -48,22 +75,53 @@ Config::Config() {
     compress_playlists = true;
     dont_saveMetadata_for_playlists = false;
     initially_unload_playlists = false;
+    audio_buffer_frames = 65536;
+    lazy_playlist_tracks = false;
+    metrics_socket = "";
+    async_log_records = 0;
+    cache_library = false;
+    browse_cache_bytes = 4 * 1024 * 1024;
+    browse_cache_seconds = 300;
+    image_cache_bytes = 8 * 1024 * 1024;
 }
 
 boost::shared_ptr<Session> Session::Create() {
     return boost::shared_ptr<Session>(boost::make_shared<Session>());
 }
 
-Session::Session() : session_(), is_process_events_required_(false), has_logged_out_(NULL) {
+Session::Session() : session_(), is_process_events_required_(false), has_logged_out_(NULL)
+                   , wakeup_(boost::make_shared<Wakeup>())
+                   , commands_(boost::make_shared<CommandQueue>()), lazy_playlist_tracks_(false)
+                   , browse_cache_(boost::make_shared<BrowseCache>())
+                   , image_cache_(boost::make_shared<ImageCache>()), cache_metadata_updated_(false)
+                   , cache_container_(NULL), load_progress_(false), updating_(false)
+                   , playlist_pool_(boost::make_shared<ObjectPool>()), track_pool_(boost::make_shared<ObjectPool>())
+                   , artist_pool_(boost::make_shared<ObjectPool>()), album_pool_(boost::make_shared<ObjectPool>())
+                   , image_pool_(boost::make_shared<ObjectPool>()), metrics_(boost::make_shared<Metrics>())
+                   , async_log_(false), running_(false) {
 }
 
 Session::~Session() {
+    StopMetricsExporter();
+    Quit();
     Shutdown();
+    if (async_log_)
+        AsyncLog::Stop();
 }
 
 sp_error Session::Initialise(const Config &config) {
     sp_session_config sp_config = {0};
 
+    // music_delivery may be called as soon as the session exists
+    audio_buffer_ = boost::make_shared<AudioBuffer>(config.audio_buffer_frames);
+    lazy_playlist_tracks_ = config.lazy_playlist_tracks;
+    browse_cache_->SetLimits(config.browse_cache_bytes, std::chrono::seconds(config.browse_cache_seconds));
+    image_cache_->SetLimit(config.image_cache_bytes);
+    if (config.async_log_records && !async_log_) {
+        AsyncLog::Start(config.async_log_records);
+        async_log_ = true;
+    }
+
     sp_config.api_version = SPOTIFY_API_VERSION;
 
     // app specified configuration
@@ -101,13 +159,33 @@ sp_error Session::Initialise(const Config &config) {
 
     sp_error error = sp_session_create(&sp_config, &session_);
 
+    if (error == SP_ERROR_OK && config.metrics_socket && *config.metrics_socket)
+        StartMetricsExporter(config.metrics_socket);
+
+    // libspotify has created the cache directory by now
+    if (error == SP_ERROR_OK && config.cache_library && config.cache_location && *config.cache_location)
+        library_cache_ = boost::make_shared<LibraryCache>(config.cache_location);
+
     return error;
 }
 
 void Session::Shutdown() {
+    // the browses still in flight never complete, drop the continuations keeping them alive
+    boost::unordered_set<ArtistBrowse *> artist_browses;
+    artist_browses.swap(pending_artist_browses_);
+    for (boost::unordered_set<ArtistBrowse *>::iterator it = artist_browses.begin(); it != artist_browses.end(); ++it)
+        (*it)->Abandon();
+    boost::unordered_set<AlbumBrowse *> album_browses;
+    album_browses.swap(pending_album_browses_);
+    for (boost::unordered_set<AlbumBrowse *>::iterator it = album_browses.begin(); it != album_browses.end(); ++it)
+        (*it)->Abandon();
+
     if (session_) {
         if (track_)
             Unload(track_);
+        // the snapshots the cache has written are released by the next Update
+        if (library_cache_)
+            library_cache_->Flush();
         // clear any remaining events
         Update();
         // release the session
@@ -115,16 +193,282 @@ void Session::Shutdown() {
         // sp_session_release(session_);
         session_ = NULL;
     }
+    // the browses and images hold the session
+    browse_cache_->Clear();
+    image_cache_->Clear();
+    // nothing can complete them anymore
+    for (std::size_t i = 0; i < waiters_.size(); ++i)
+        waiters_[i].loaded->set_value(false);
+    waiters_.clear();
 }
 
 int Session::Update() {
+    {
+        boost::lock_guard<boost::mutex> lock(loop_mutex_);
+        update_thread_ = boost::this_thread::get_id();
+    }
+    updating_ = true;
+    RunCommands();
+    int next_timeout = -1;
     if (session_) {
         is_process_events_required_ = false;
-        int next_timeout = 0;
+        next_timeout = 0;
+        Trace::Record(TRACE_PROCESS_EVENTS_BEGIN, session_);
+        Metrics::Clock::time_point start = Metrics::Clock::now();
         sp_session_process_events(session_, &next_timeout);
-        return next_timeout;
+        metrics_->RecordProcessEvents(Metrics::Clock::now() - start, next_timeout);
+        Trace::Record(TRACE_PROCESS_EVENTS_END, session_, next_timeout);
+        Trace::DumpIfRequested();
+        next_timeout = WriteLibraryCache(next_timeout);
+        next_timeout = CheckWaiters(next_timeout);
+    }
+    updating_ = false;
+    return next_timeout;
+}
+
+void Session::Run() {
+    running_ = true;
+    RunLoop();
+}
+
+void Session::RunInThread() {
+    if (run_thread_.joinable())
+        return;
+    // set before the thread starts, so a Quit right after this call is not lost
+    running_ = true;
+    run_thread_ = boost::thread([this] { RunLoop(); });
+    // the caller stops driving the session here, before the first Update of the thread
+    boost::lock_guard<boost::mutex> lock(loop_mutex_);
+    update_thread_ = run_thread_.get_id();
+}
+
+void Session::RunLoop() {
+    {
+        boost::lock_guard<boost::mutex> lock(loop_mutex_);
+        loop_thread_ = boost::this_thread::get_id();
+        update_thread_ = loop_thread_;
+    }
+    while (running_) {
+        int next_timeout = Update();
+        if (next_timeout < 0)
+            break;
+        // notifications arriving while Update runs leave the wakeup pending, so they are not lost
+        wakeup_->Wait(next_timeout);
     }
-    return -1;
+    running_ = false;
+    {
+        boost::lock_guard<boost::mutex> lock(loop_mutex_);
+        loop_thread_ = boost::thread::id();
+    }
+
+    // what was posted while the loop ran is not left for an Update that may never come
+    boost::function<void ()> command;
+    while (commands_->Pop(&command))
+        RunCommand(command);
+}
+
+void Session::Quit() {
+    running_ = false;
+    wakeup_->Notify();
+    if (run_thread_.joinable() && run_thread_.get_id() != boost::this_thread::get_id())
+        run_thread_.join();
+}
+
+bool Session::IsRunning() {
+    return running_;
+}
+
+bool Session::IsLoopOnOtherThread() {
+    boost::lock_guard<boost::mutex> lock(loop_mutex_);
+    return running_ && loop_thread_ != boost::this_thread::get_id();
+}
+
+void Session::Post(const boost::function<void ()> &command) {
+    commands_->Push(command);
+    wakeup_->Notify();
+}
+
+void Session::RunCommands() {
+    boost::function<void ()> command;
+    for (int i = 0; i < kMaxCommandsPerUpdate; ++i) {
+        if (!commands_->Pop(&command))
+            return;
+        RunCommand(command);
+    }
+    // the rest runs on the next pass of the loop
+    wakeup_->Notify();
+}
+
+void Session::RunCommand(const boost::function<void ()> &command) {
+    try {
+        command();
+    } catch(const std::exception &e) {
+        LIBSPOTIFYPP_LOG_ERROR(logger, "Session::RunCommands: %s", e.what());
+    }
+}
+
+void Session::RunOnSessionThread(const boost::function<void ()> &command) {
+    {
+        boost::lock_guard<boost::mutex> lock(loop_mutex_);
+        if (update_thread_ != boost::thread::id() && update_thread_ != boost::this_thread::get_id()) {
+            Post(command);
+            return;
+        }
+    }
+    command();
+}
+
+bool Session::WaitFor(boost::shared_ptr<PlayListElement> element, Deadline deadline) {
+    return WaitUntil([element] { return !element->IsLoading(true); }, deadline);
+}
+
+bool Session::WaitFor(boost::shared_ptr<Album> album, Deadline deadline) {
+    return WaitUntil([album] { return !album->IsLoading(); }, deadline);
+}
+
+bool Session::WaitFor(boost::shared_ptr<Artist> artist, Deadline deadline) {
+    return WaitUntil([artist] { return !artist->IsLoading(); }, deadline);
+}
+
+bool Session::WaitFor(boost::shared_ptr<Image> image, Deadline deadline) {
+    return WaitUntil([image] { return !image->IsLoading(); }, deadline);
+}
+
+bool Session::WaitFor(boost::shared_ptr<ArtistBrowse> browse, Deadline deadline) {
+    return WaitUntil([browse] { return !browse->IsLoading(); }, deadline);
+}
+
+bool Session::WaitFor(boost::shared_ptr<AlbumBrowse> browse, Deadline deadline) {
+    return WaitUntil([browse] { return !browse->IsLoading(); }, deadline);
+}
+
+bool Session::WaitForLogin(Deadline deadline) {
+    return WaitUntil(boost::bind(&Session::IsLoggedIn, this), deadline);
+}
+
+std::future<bool> Session::WhenLoaded(boost::shared_ptr<PlayListElement> element, Deadline deadline) {
+    return WhenTrue([element] { return !element->IsLoading(true); }, deadline);
+}
+
+std::future<bool> Session::WhenLoaded(boost::shared_ptr<Album> album, Deadline deadline) {
+    return WhenTrue([album] { return !album->IsLoading(); }, deadline);
+}
+
+std::future<bool> Session::WhenLoaded(boost::shared_ptr<Artist> artist, Deadline deadline) {
+    return WhenTrue([artist] { return !artist->IsLoading(); }, deadline);
+}
+
+std::future<bool> Session::WhenLoaded(boost::shared_ptr<Image> image, Deadline deadline) {
+    return WhenTrue([image] { return !image->IsLoading(); }, deadline);
+}
+
+std::future<bool> Session::WhenLoaded(boost::shared_ptr<ArtistBrowse> browse, Deadline deadline) {
+    return WhenTrue([browse] { return !browse->IsLoading(); }, deadline);
+}
+
+std::future<bool> Session::WhenLoaded(boost::shared_ptr<AlbumBrowse> browse, Deadline deadline) {
+    return WhenTrue([browse] { return !browse->IsLoading(); }, deadline);
+}
+
+bool Session::WaitUntil(const boost::function<bool ()> &is_loaded, Deadline deadline) {
+    if (IsLoopOnOtherThread()) {
+        // the session thread completes the waiter, at the latest when the deadline passes
+        std::future<bool> loaded = WhenTrue(is_loaded, deadline);
+        return loaded.wait_until(deadline) == std::future_status::ready && loaded.get();
+    }
+
+    if (updating_) {
+        LIBSPOTIFYPP_LOG_ERROR(logger, "Session::WaitFor called from a callback or a command, not waiting");
+        return is_loaded();
+    }
+
+    // nobody else drives the session, do it from here until the waiter completes
+    Waiter waiter = {is_loaded, deadline, boost::make_shared<std::promise<bool> >()};
+    std::future<bool> loaded = waiter.loaded->get_future();
+    AddWaiter(waiter);
+    while (loaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        int next_timeout = Update();
+        if (next_timeout < 0)
+            return false;
+        if (loaded.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            break;
+        wakeup_->Wait(next_timeout);
+    }
+    return loaded.get();
+}
+
+std::future<bool> Session::WhenTrue(const boost::function<bool ()> &is_loaded, Deadline deadline) {
+    Waiter waiter = {is_loaded, deadline, boost::make_shared<std::promise<bool> >()};
+    std::future<bool> loaded = waiter.loaded->get_future();
+    // the elements are only touched on the session thread
+    Post(boost::bind(&Session::AddWaiter, this, waiter));
+    return loaded;
+}
+
+void Session::AddWaiter(const Waiter &waiter) {
+    if (waiter.is_loaded())
+        waiter.loaded->set_value(true);
+    else
+        waiters_.push_back(waiter);
+}
+
+int Session::CheckWaiters(int timeout) {
+    if (waiters_.empty())
+        return timeout;
+
+    bool load_progress = load_progress_;
+    load_progress_ = false;
+    Deadline now = Deadline::clock::now();
+    Deadline next = Deadline::max();
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < waiters_.size(); ++i) {
+        Waiter &waiter = waiters_[i];
+        if (load_progress && waiter.is_loaded()) {
+            waiter.loaded->set_value(true);
+        } else if (waiter.deadline <= now) {
+            waiter.loaded->set_value(false);
+        } else {
+            next = std::min(next, waiter.deadline);
+            if (kept != i)
+                waiters_[kept] = waiter;
+            ++kept;
+        }
+    }
+    waiters_.resize(kept);
+
+    if (next == Deadline::max())
+        return timeout;
+    int until_next = MillisecondsUntil(next, now);
+    return (timeout < 0 || until_next < timeout) ? until_next : timeout;
+}
+
+void Session::OnLoadProgress() {
+    load_progress_ = true;
+}
+
+std::future<sp_error> Session::LoadAsync(boost::shared_ptr<Track> track) {
+    return Execute<sp_error>(boost::bind(&Session::Load, this, track));
+}
+
+std::future<void> Session::UnloadAsync(boost::shared_ptr<Track> track) {
+    return Execute<void>(boost::bind(&Session::Unload, this, track));
+}
+
+std::future<void> Session::SeekAsync(int offset) {
+    return Execute<void>(boost::bind(&Session::Seek, this, offset));
+}
+
+std::future<void> Session::PlayAsync() {
+    return Execute<void>(boost::bind(&Session::Play, this));
+}
+
+std::future<void> Session::StopAsync() {
+    return Execute<void>(boost::bind(&Session::Stop, this));
+}
+
+std::future<sp_error> Session::PreFetchAsync(boost::shared_ptr<Track> track) {
+    return Execute<sp_error>(boost::bind(&Session::PreFetch, this, track));
 }
 
 void Session::Login(const char *username, const char *password, bool remember_me) {
@@ -138,7 +482,7 @@ void Session::Logout() {
 
 bool Session::IsLoggedIn() {
     sp_connectionstate state = GetConnectionState();
-    LOG4CPLUS_TRACE(logger, (boost::format("conn state: %d") % state));
+    LIBSPOTIFYPP_LOG_TRACE(logger, "conn state: %d", state);
     bool is_logged_in = session_ && !has_logged_out_ && (state == SP_CONNECTION_STATE_LOGGED_IN);
     return is_logged_in;
 }
@@ -158,6 +502,8 @@ sp_error Session::Load(boost::shared_ptr<Track> track) {
         }
 
         if (track) {
+            if (audio_buffer_)
+                audio_buffer_->Flush();
             sp_error error = sp_session_player_load(session_, track->track_);
             if (error == SP_ERROR_OK)
                 track_ = track;
@@ -172,6 +518,10 @@ void Session::Unload(boost::shared_ptr<Track> track) {
     if (track && (track == track_)) {
         sp_session_player_unload(session_);
         track_.reset();
+        if (audio_buffer_) {
+            audio_buffer_->SetPlaying(false);
+            audio_buffer_->Flush();
+        }
     }
 }
 
@@ -181,14 +531,20 @@ boost::shared_ptr<Track> Session::GetCurrentTrack() {
 
 void Session::Seek(int offset) {
     sp_session_player_seek(session_, offset);
+    if (audio_buffer_)
+        audio_buffer_->Flush();
 }
 
 void Session::Play() {
     sp_session_player_play(session_, true);
+    if (audio_buffer_)
+        audio_buffer_->SetPlaying(true);
 }
 
 void Session::Stop() {
     sp_session_player_play(session_, false);
+    if (audio_buffer_)
+        audio_buffer_->SetPlaying(false);
 }
 
 sp_error Session::PreFetch(boost::shared_ptr<Track> track) {
@@ -230,8 +586,63 @@ void Session::SetPreferredBitrate(sp_bitrate bitrate) {
     sp_session_preferred_bitrate(session_, bitrate);
 }
 
+boost::shared_ptr<AudioBuffer> Session::GetAudioBuffer() {
+    return audio_buffer_;
+}
+
+SessionMetrics Session::GetMetrics() {
+    return metrics_->GetSnapshot();
+}
+
+std::string Session::GetMetricsText() {
+    std::ostringstream out;
+    metrics_->GetSnapshot().WritePrometheus(out);
+
+    if (audio_buffer_) {
+        AudioBufferCounters counters = audio_buffer_->GetCounters();
+        out << "# HELP spotify_audio_buffer_frames Frames waiting in the audio buffer.\n"
+            << "# TYPE spotify_audio_buffer_frames gauge\n"
+            << "spotify_audio_buffer_frames " << audio_buffer_->GetReadableFrames() << '\n'
+            << "# HELP spotify_audio_buffer_capacity_frames Capacity of the audio buffer.\n"
+            << "# TYPE spotify_audio_buffer_capacity_frames gauge\n"
+            << "spotify_audio_buffer_capacity_frames " << audio_buffer_->GetCapacity() << '\n'
+            << "# HELP spotify_audio_buffer_peak_frames Highest fill of the audio buffer.\n"
+            << "# TYPE spotify_audio_buffer_peak_frames gauge\n"
+            << "spotify_audio_buffer_peak_frames " << counters.peak_frames << '\n'
+            << "# HELP spotify_audio_buffer_underruns_total Times the audio buffer ran dry during playback.\n"
+            << "# TYPE spotify_audio_buffer_underruns_total counter\n"
+            << "spotify_audio_buffer_underruns_total " << counters.underruns << '\n'
+            << "# HELP spotify_audio_buffer_backpressure_total Deliveries the full audio buffer cut short.\n"
+            << "# TYPE spotify_audio_buffer_backpressure_total counter\n"
+            << "spotify_audio_buffer_backpressure_total " << counters.backpressure << '\n';
+    }
+
+    AsyncLogCounters log = AsyncLog::GetCounters();
+    out << "# HELP spotify_log_records_dropped_total Log records dropped because the async log queue was full.\n"
+        << "# TYPE spotify_log_records_dropped_total counter\n"
+        << "spotify_log_records_dropped_total " << log.dropped << '\n';
+    return out.str();
+}
+
+bool Session::StartMetricsExporter(const std::string &path) {
+    StopMetricsExporter();
+    exporter_ = boost::make_shared<MetricsExporter>(boost::bind(&Session::GetMetricsText, this));
+    if (exporter_->Start(path))
+        return true;
+
+    exporter_.reset();
+    return false;
+}
+
+void Session::StopMetricsExporter() {
+    if (exporter_) {
+        exporter_->Stop();
+        exporter_.reset();
+    }
+}
+
 boost::shared_ptr<PlayList> Session::CreatePlayList() {
-    return boost::shared_ptr<PlayList>(new PlayList(shared_from_this()));
+    return boost::allocate_shared<PlayList>(PoolAllocator<PlayList>(playlist_pool_), shared_from_this());
 }
 
 boost::shared_ptr<PlayListContainer> Session::CreatePlayListContainer() {
@@ -243,19 +654,148 @@ boost::shared_ptr<PlayListFolder> Session::CreatePlayListFolder() {
 }
 
 boost::shared_ptr<Track> Session::CreateTrack() {
-    return boost::shared_ptr<Track>(new Track(shared_from_this()));
+    return boost::allocate_shared<Track>(PoolAllocator<Track>(track_pool_), shared_from_this());
 }
 
 boost::shared_ptr<Artist> Session::CreateArtist() {
-    return boost::shared_ptr<Artist>(new Artist(shared_from_this()));
+    return boost::allocate_shared<Artist>(PoolAllocator<Artist>(artist_pool_), shared_from_this());
 }
 
 boost::shared_ptr<Album> Session::CreateAlbum() {
-    return boost::shared_ptr<Album>(new Album(shared_from_this()));
+    return boost::allocate_shared<Album>(PoolAllocator<Album>(album_pool_), shared_from_this());
 }
 
 boost::shared_ptr<Image> Session::CreateImage() {
-    return boost::shared_ptr<Image>(new Image(shared_from_this()));
+    return boost::allocate_shared<Image>(PoolAllocator<Image>(image_pool_), shared_from_this());
+}
+
+PoolOccupancy Session::GetPoolOccupancy() {
+    PoolOccupancy occupancy;
+    occupancy.playlists = playlist_pool_->GetStats();
+    occupancy.tracks = track_pool_->GetStats();
+    occupancy.artists = artist_pool_->GetStats();
+    occupancy.albums = album_pool_->GetStats();
+    occupancy.images = image_pool_->GetStats();
+    return occupancy;
+}
+
+BrowseCacheStats Session::GetBrowseCacheStats() {
+    return browse_cache_->GetStats();
+}
+
+ImageCacheStats Session::GetImageCacheStats() {
+    return image_cache_->GetStats();
+}
+
+boost::shared_ptr<LibraryCache> Session::GetLibraryCache() {
+    return library_cache_;
+}
+
+void Session::MarkCacheDirty(PlayList *playlist) {
+    if (library_cache_)
+        cache_playlists_.insert(playlist);
+}
+
+void Session::MarkCacheDirty(PlayListContainer *container) {
+    if (library_cache_)
+        cache_container_ = container;
+}
+
+void Session::ForgetCache(PlayList *playlist) {
+    cache_playlists_.erase(playlist);
+    cache_incomplete_.erase(playlist);
+}
+
+void Session::ForgetCache(PlayListContainer *container) {
+    if (cache_container_ == container)
+        cache_container_ = NULL;
+}
+
+int Session::WriteLibraryCache(int timeout) {
+    if (!library_cache_)
+        return timeout;
+
+    // the names missing from the incomplete playlists may have arrived. metadata_updated fires for every object
+    // that loads, so they are taken again at most once per kIncompleteRewriteInterval
+    if (cache_incomplete_.empty())
+        cache_metadata_updated_ = false;
+    if (cache_metadata_updated_) {
+        Deadline now = Deadline::clock::now();
+        if (now >= cache_incomplete_due_) {
+            cache_playlists_.insert(cache_incomplete_.begin(), cache_incomplete_.end());
+            cache_incomplete_.clear();
+            cache_metadata_updated_ = false;
+            cache_incomplete_due_ = now + kIncompleteRewriteInterval;
+        } else {
+            int until_due = MillisecondsUntil(cache_incomplete_due_, now);
+            if (timeout < 0 || until_due < timeout)
+                timeout = until_due;
+        }
+    }
+
+    // the playlists still loading stay dirty until they settle, an edit in the middle of a load costs nothing
+    std::vector<PlayList *> dirty(cache_playlists_.begin(), cache_playlists_.end());
+    for (std::size_t i = 0; i < dirty.size(); ++i) {
+        PlayList *playlist = dirty[i];
+        if (playlist->IsLoading(true))
+            continue;
+
+        cache_playlists_.erase(playlist);
+        std::string link = playlist->GetLink();
+        if (link.empty())
+            continue;
+
+        boost::shared_ptr<const TrackSnapshot> snapshot = playlist->Snapshot();
+        if (snapshot->GetNumLoading() > 0)
+            cache_incomplete_.insert(playlist);
+        library_cache_->PostTracks(link, snapshot);
+    }
+
+    if (cache_container_ && !cache_container_->IsLoading(false)) {
+        std::vector<LibraryCache::Entry> entries;
+        cache_container_->GetCacheEntries(&entries);
+        library_cache_->PostTree(entries);
+        cache_container_ = NULL;
+    }
+    return timeout;
+}
+
+boost::shared_ptr<Track> Session::GetTrack(sp_track *track) {
+    return tracks_.Get(track, [this, track] {
+        boost::shared_ptr<Track> wrapper = CreateTrack();
+        wrapper->Load(track);
+        return wrapper;
+    });
+}
+
+boost::shared_ptr<Artist> Session::GetArtist(sp_artist *artist) {
+    return artists_.Get(artist, [this, artist] {
+        boost::shared_ptr<Artist> wrapper = CreateArtist();
+        wrapper->Load(artist);
+        return wrapper;
+    });
+}
+
+boost::shared_ptr<Album> Session::GetAlbum(sp_album *album) {
+    return albums_.Get(album, [this, album] {
+        boost::shared_ptr<Album> wrapper = CreateAlbum();
+        wrapper->Load(album);
+        return wrapper;
+    });
+}
+
+boost::shared_ptr<Image> Session::GetImage(const byte *image_id) {
+    if (!image_id)
+        return boost::shared_ptr<Image>();
+
+    boost::shared_ptr<Image> image = image_cache_->Find(image_id);
+    if (!image) {
+        image = CreateImage();
+        if (!image->Load(image_id))
+            return boost::shared_ptr<Image>();
+        image_cache_->Add(image_id, image);
+    }
+    return image;
 }
 
 void Session::connectToOnLoggedIn(boost::function<void (sp_error)> callback) { // NOLINT
@@ -275,148 +815,201 @@ Session *GetSessionFromUserdata(sp_session *session) {
 }
 
 void SP_CALLCONV Session::callback_logged_in(sp_session *session, sp_error error) {
+    Trace::Record(TRACE_LOGGED_IN, session, error);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_LOGGED_IN);
+    sess->OnLoadProgress();
     sess->OnLoggedIn(error);
 }
 
 void SP_CALLCONV Session::callback_logged_out(sp_session *session) {
+    Trace::Record(TRACE_LOGGED_OUT, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_LOGGED_OUT);
     sess->has_logged_out_ = true;
     sess->OnLoggedOut();
 }
 
 void SP_CALLCONV Session::callback_metadata_updated(sp_session *session) {
+    Trace::Record(TRACE_METADATA_UPDATED, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_METADATA_UPDATED);
+    sess->OnLoadProgress();
     sess->OnMetadataUpdated();
 }
 
 void SP_CALLCONV Session::callback_connection_error(sp_session *session, sp_error error) {
+    Trace::Record(TRACE_CONNECTION_ERROR, session, error);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_CONNECTION_ERROR);
     sess->OnConnectionError(error);
 }
 
 void SP_CALLCONV Session::callback_message_to_user(sp_session *session, const char *message) {
+    Trace::Record(TRACE_MESSAGE_TO_USER, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_MESSAGE_TO_USER);
     sess->OnMessageToUser(message);
 }
 
 void SP_CALLCONV Session::callback_notify_main_thread(sp_session *session) {
+    Trace::Record(TRACE_NOTIFY_MAIN_THREAD, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_NOTIFY_MAIN_THREAD);
     sess->OnNotifyMainThread();
     sess->is_process_events_required_ = true;
+    sess->wakeup_->Notify();
 }
 
 int  SP_CALLCONV Session::callback_music_delivery(sp_session *session, const sp_audioformat *format,
                                                   const void *frames, int num_frames) {
+    Trace::Record(TRACE_MUSIC_DELIVERY, session, num_frames);
     Session *sess = GetSessionFromUserdata(session);
-    return sess->OnMusicDelivery(format, frames, num_frames);
+    sess->metrics_->CountCallback(TRACE_MUSIC_DELIVERY);
+    int consumed = sess->OnMusicDelivery(format, frames, num_frames);
+    sess->metrics_->CountFrames(num_frames, consumed);
+    return consumed;
 }
 
 void SP_CALLCONV Session::callback_play_token_lost(sp_session *session) {
+    Trace::Record(TRACE_PLAY_TOKEN_LOST, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_PLAY_TOKEN_LOST);
     sess->OnPlayTokenLost();
 }
 
 void SP_CALLCONV Session::callback_log_message(sp_session *session, const char *data) {
+    Trace::Record(TRACE_LOG_MESSAGE, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_LOG_MESSAGE);
     sess->OnLogMessage(data);
 }
 
 void SP_CALLCONV Session::callback_end_of_track(sp_session *session) {
+    Trace::Record(TRACE_END_OF_TRACK, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_END_OF_TRACK);
     sess->OnEndOfTrack();
 }
 
 void SP_CALLCONV Session::callback_streaming_error(sp_session *session, sp_error error) {
+    Trace::Record(TRACE_STREAMING_ERROR, session, error);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_STREAMING_ERROR);
     sess->OnStreamingError(error);
 }
 
 void SP_CALLCONV Session::callback_userinfo_updated(sp_session *session) {
+    Trace::Record(TRACE_USERINFO_UPDATED, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_USERINFO_UPDATED);
     sess->OnUserinfoUpdated();
 }
 
 void SP_CALLCONV Session::callback_start_playback(sp_session *session) {
+    Trace::Record(TRACE_START_PLAYBACK, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_START_PLAYBACK);
     sess->OnStartPlayback();
 }
 
 void SP_CALLCONV Session::callback_stop_playback(sp_session *session) {
+    Trace::Record(TRACE_STOP_PLAYBACK, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_STOP_PLAYBACK);
     sess->OnStopPlayback();
 }
 
 void SP_CALLCONV Session::callback_get_audio_buffer_stats(sp_session *session, sp_audio_buffer_stats *stats) {
+    Trace::Record(TRACE_GET_AUDIO_BUFFER_STATS, session);
     Session *sess = GetSessionFromUserdata(session);
+    sess->metrics_->CountCallback(TRACE_GET_AUDIO_BUFFER_STATS);
     sess->OnGetAudioBufferStats(stats);
 }
 
 void Session::OnLoggedIn(sp_error error) {
-    LOG4CPLUS_TRACE(logger, (boost::format("Session::OnLoggedIn: %s") % sp_error_message(error)));
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnLoggedIn: %s", sp_error_message(error));
     on_loggedin_(error);
 }
 
 void Session::OnLoggedOut() {
-    LOG4CPLUS_TRACE(logger, "Session::OnLoggedOut");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnLoggedOut");
+    browse_cache_->Clear();
+    image_cache_->Clear();
 }
 
 void Session::OnMetadataUpdated() {
-    LOG4CPLUS_TRACE(logger, "Session::OnMetadataUpdated");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnMetadataUpdated");
+
+    // a playlist leaves the set once all of its tracks are loaded, so it is walked over a copy
+    std::vector<PlayList *> loading(loading_playlists_.begin(), loading_playlists_.end());
+    for (std::size_t i = 0; i < loading.size(); ++i)
+        loading[i]->UpdatePendingTracks();
+
+    // the names of the artists and albums missing from the cache may have arrived
+    cache_metadata_updated_ = true;
 }
 
 void Session::OnConnectionError(sp_error error) {
-    LOG4CPLUS_TRACE(logger, "Session::OnConnectionError");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnConnectionError");
 }
 
 void Session::OnMessageToUser(const char *message) {
-    LOG4CPLUS_TRACE(logger, "Session::OnMessageToUser");
-    LOG4CPLUS_INFO(logger, message);
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnMessageToUser");
+    LIBSPOTIFYPP_LOG_INFO(logger, "%s", message);
 }
 
 void Session::OnNotifyMainThread() {
-    LOG4CPLUS_TRACE(logger, "Session::OnNotifyMainThread");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnNotifyMainThread");
     on_notify_main_thread_();
 }
 
 int  Session::OnMusicDelivery(const sp_audioformat *format, const void *frames, int num_frames) {
-    LOG4CPLUS_TRACE(logger, (boost::format("Session::OnMusicDelivery [%d]")
-                                           % (reinterpret_cast<const int*>(frames))[0]));
-
-    // pretend that we have consumed all of the audio frames
-    return num_frames;
+    // runs on the libspotify audio thread, keep it free of locks, allocations and logging
+    if (!audio_buffer_)
+        return num_frames;
+    return audio_buffer_->Write(*format, frames, num_frames);
 }
 
 void Session::OnPlayTokenLost() {
-    LOG4CPLUS_TRACE(logger, "Session::OnPlayTokenLost");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnPlayTokenLost");
 }
 
 void Session::OnLogMessage(const char *data) {
-    LOG4CPLUS_TRACE(logger, "Session::OnLogMessage");
-    LOG4CPLUS_TRACE(logger, data);
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnLogMessage");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "%s", data);
 }
 
 void Session::OnEndOfTrack() {
-    LOG4CPLUS_TRACE(logger, "Session::OnEndOfTrack");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnEndOfTrack");
+    // the reader drains what is left and then finds the buffer empty, which is not stutter
+    if (audio_buffer_)
+        audio_buffer_->SetPlaying(false);
 }
 
 void Session::OnStreamingError(sp_error error) {
-    LOG4CPLUS_ERROR(logger, "Session::OnStreamingError");
+    LIBSPOTIFYPP_LOG_ERROR(logger, "Session::OnStreamingError");
 }
 
 void Session::OnUserinfoUpdated() {
-    LOG4CPLUS_TRACE(logger, "Session::OnUserinfoUpdated");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnUserinfoUpdated");
 }
 
 void Session::OnStartPlayback() {
-    LOG4CPLUS_TRACE(logger, "Session::OnStartPlayback");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnStartPlayback");
 }
 
 void Session::OnStopPlayback() {
-    LOG4CPLUS_TRACE(logger, "Session::OnStopPlayback");
+    LIBSPOTIFYPP_LOG_TRACE(logger, "Session::OnStopPlayback");
 }
 
 void Session::OnGetAudioBufferStats(sp_audio_buffer_stats *stats) {
-    LOG4CPLUS_TRACE(logger, "Session::OnGetAudioBufferStats");
+    // called after every delivery from the libspotify audio thread, like OnMusicDelivery
+    if (audio_buffer_) {
+        audio_buffer_->GetStats(stats);
+    } else {
+        stats->samples = 0;
+        stats->stutter = 0;
+    }
 }
 }
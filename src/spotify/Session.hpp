@@ -24,14 +24,29 @@
 // C-libs includes
 #include <cstdint>
 
+// std includes
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+
 // boost includes
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/signal.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/unordered_set.hpp>
 
 #include "spotify/LibConfig.hpp"
+#include "spotify/BrowseCache.hpp"
+#include "spotify/IdentityMap.hpp"
+#include "spotify/ImageCache.hpp"
+#include "spotify/Metrics.hpp"
+#include "spotify/ObjectPool.hpp"
 
 namespace spotify {
 class Album;
@@ -44,6 +59,11 @@ class PlayListFolder;
 class Track;
 class AlbumBrowse;
 class ArtistBrowse;
+class AudioBuffer;
+class CommandQueue;
+class LibraryCache;
+class MetricsExporter;
+class Wakeup;
 
 struct LIBSPOTIFYPP_API Config {
     Config();
@@ -56,10 +76,29 @@ struct LIBSPOTIFYPP_API Config {
     bool compress_playlists;
     bool dont_saveMetadata_for_playlists;
     bool initially_unload_playlists;
+    std::size_t audio_buffer_frames;  // capacity of the PCM ring filled by music_delivery
+    bool lazy_playlist_tracks;  // playlists create their Track wrappers on first access, see PlayList::GetTrack
+    const char *metrics_socket;  // when not empty Initialise starts serving the metrics there, see StartMetricsExporter
+    std::size_t async_log_records;  // when not 0 the session logs through an AsyncLog queue of that many records
+    bool cache_library;  // keeps the playlist tree and the tracks in cache_location, see LibraryCache
+    std::size_t browse_cache_bytes;  // budget of the completed browses kept for reuse, see BrowseCache
+    int browse_cache_seconds;        // how long a completed browse is reused
+    std::size_t image_cache_bytes;   // budget of the loaded images kept for reuse, see ImageCache
+};
+
+/// @brief Occupancy of the pools backing the factory functions
+struct LIBSPOTIFYPP_API PoolOccupancy {
+    PoolStats playlists;
+    PoolStats tracks;
+    PoolStats artists;
+    PoolStats albums;
+    PoolStats images;
 };
 
 class LIBSPOTIFYPP_API Session : public boost::enable_shared_from_this<Session> {
   public:
+    typedef std::chrono::steady_clock::time_point Deadline;
+
     static boost::shared_ptr<Session> Create();
 
     Session();
@@ -69,11 +108,72 @@ class LIBSPOTIFYPP_API Session : public boost::enable_shared_from_this<Session>
 
     int Update();
 
+    /// @brief Drives libspotify from the calling thread until Quit is called. Events are processed when libspotify
+    /// notifies or when the timeout returned by the previous Update expires, a burst of notifications results in
+    /// a single Update.
+    void Run();
+
+    /// @brief Same as Run, but on a thread owned by the session. The session must not be used from any other
+    /// thread while it runs.
+    void RunInThread();
+
+    /// @brief Makes Run return, waits for the session thread to finish if RunInThread was used
+    void Quit();
+
+    bool IsRunning();
+
+    /// @brief Queues a command to run on the session thread before the next sp_session_process_events. Safe to call
+    /// from any thread, a session waiting in Run is woken up. Commands run in the order they were posted.
+    void Post(const boost::function<void ()> &command);
+
+    /// @brief Like Post, the result or the exception thrown is delivered through the future. Do not wait on the
+    /// future from the session thread, it would never be ready.
+    template <typename R>
+    std::future<R> Execute(const boost::function<R ()> &command);
+
+    /// @brief Runs command now on the thread that drives the session, the one that last called Update, and posts it
+    /// from any other. Meant for releasing libspotify objects from whatever thread drops them, a command posted
+    /// while the loop runs still runs if the loop quits.
+    void RunOnSessionThread(const boost::function<void ()> &command);
+
+    // player functions marshalled onto the session thread
+    std::future<sp_error> LoadAsync(boost::shared_ptr<Track> track);
+    std::future<void> UnloadAsync(boost::shared_ptr<Track> track);
+    std::future<void> SeekAsync(int offset);
+    std::future<void> PlayAsync();
+    std::future<void> StopAsync();
+    std::future<sp_error> PreFetchAsync(boost::shared_ptr<Track> track);
+
     void Login(const char *username, const char *password, bool remember_me = false);
     void Logout();
 
     bool IsLoggedIn();
 
+    /// @brief Blocks until the element has loaded or the deadline passes. A playlist, folder or container waits
+    /// for everything below it. The wait ends from the callback that completes the load, metadata_updated,
+    /// playlist_state_changed, image_loaded or the browse callbacks, not from polling. When neither Run nor
+    /// RunInThread drives the session the calling thread drives it until then. Not to be called from a callback or
+    /// a command.
+    /// @return true when the element loaded in time
+    bool WaitFor(boost::shared_ptr<PlayListElement> element, Deadline deadline);
+    bool WaitFor(boost::shared_ptr<Album> album, Deadline deadline);
+    bool WaitFor(boost::shared_ptr<Artist> artist, Deadline deadline);
+    bool WaitFor(boost::shared_ptr<Image> image, Deadline deadline);
+    bool WaitFor(boost::shared_ptr<ArtistBrowse> browse, Deadline deadline);
+    bool WaitFor(boost::shared_ptr<AlbumBrowse> browse, Deadline deadline);
+
+    /// @brief Same as WaitFor, for the logged_in callback
+    bool WaitForLogin(Deadline deadline);
+
+    /// @brief Does not block, the future is true once the element has loaded and false when the deadline passes or
+    /// the session shuts down first. Safe to call from any thread, the session has to be driven for it to complete.
+    std::future<bool> WhenLoaded(boost::shared_ptr<PlayListElement> element, Deadline deadline);
+    std::future<bool> WhenLoaded(boost::shared_ptr<Album> album, Deadline deadline);
+    std::future<bool> WhenLoaded(boost::shared_ptr<Artist> artist, Deadline deadline);
+    std::future<bool> WhenLoaded(boost::shared_ptr<Image> image, Deadline deadline);
+    std::future<bool> WhenLoaded(boost::shared_ptr<ArtistBrowse> browse, Deadline deadline);
+    std::future<bool> WhenLoaded(boost::shared_ptr<AlbumBrowse> browse, Deadline deadline);
+
     sp_connectionstate GetConnectionState();
 
     sp_error Load(boost::shared_ptr<Track> track);
@@ -91,7 +191,23 @@ class LIBSPOTIFYPP_API Session : public boost::enable_shared_from_this<Session>
 
     void SetPreferredBitrate(sp_bitrate bitrate);
 
-    // factory functions
+    /// @brief PCM delivered by libspotify, the application audio thread drains it with AudioBuffer::Read.
+    /// Empty until Initialise is called.
+    boost::shared_ptr<AudioBuffer> GetAudioBuffer();
+
+    /// @brief Counters and latency histograms of the session, cheap enough to poll
+    SessionMetrics GetMetrics();
+
+    /// @brief GetMetrics and the audio buffer fill in the Prometheus text exposition format. Only reads atomics, so
+    /// it never blocks the libspotify threads.
+    std::string GetMetricsText();
+
+    /// @brief Serves GetMetricsText over HTTP on a Unix domain socket, from a thread of its own, until
+    /// StopMetricsExporter or the session is destroyed. Call it after Initialise. Not available on Windows.
+    bool StartMetricsExporter(const std::string &path);
+    void StopMetricsExporter();
+
+    // factory functions, the wrappers and their control blocks are allocated together from session owned pools
     boost::shared_ptr<PlayList> CreatePlayList();
     boost::shared_ptr<PlayListContainer> CreatePlayListContainer();
     boost::shared_ptr<PlayListFolder> CreatePlayListFolder();
@@ -100,6 +216,21 @@ class LIBSPOTIFYPP_API Session : public boost::enable_shared_from_this<Session>
     boost::shared_ptr<Album> CreateAlbum();
     boost::shared_ptr<Image> CreateImage();
 
+    PoolOccupancy GetPoolOccupancy();
+    BrowseCacheStats GetBrowseCacheStats();
+    ImageCacheStats GetImageCacheStats();
+
+    /// @brief The cache written with Config::cache_library, empty when it is off. Can be read before logging in.
+    boost::shared_ptr<LibraryCache> GetLibraryCache();
+
+    // canonical wrappers, the same libspotify object yields the same wrapper for as long as it is held somewhere
+    boost::shared_ptr<Track> GetTrack(sp_track *track);
+    boost::shared_ptr<Artist> GetArtist(sp_artist *artist);
+    boost::shared_ptr<Album> GetAlbum(sp_album *album);
+    /// @brief The image of the 20 byte id, loading or loaded, shared through the ImageCache. Empty when libspotify
+    /// cannot create it.
+    boost::shared_ptr<Image> GetImage(const byte *image_id);
+
     // connection functions for observers
     void connectToOnLoggedIn(boost::function<void (sp_error)> callback); // NOLINT
     void connectToOnNotifyMainThread(boost::function<void ()> callback); // NOLINT
@@ -125,11 +256,48 @@ class LIBSPOTIFYPP_API Session : public boost::enable_shared_from_this<Session>
     void OnGetAudioBufferStats(sp_audio_buffer_stats *stats);
 
   private:
+    friend class Album;
+    friend class Artist;
     friend class Image;
+    friend class ImageData;
+    friend class PlayList;
+    friend class PlayListContainer;
+    friend class PlayListElement;
     friend class Track;
     friend class ArtistBrowse;
     friend class AlbumBrowse;
 
+    void RunLoop();
+    void RunCommands();
+    void RunCommand(const boost::function<void ()> &command);
+    // true while the loop runs on a thread other than the calling one, any thread may ask
+    bool IsLoopOnOtherThread();
+
+    // a WaitFor or WhenLoaded pending on the session thread
+    struct Waiter {
+        boost::function<bool ()> is_loaded;
+        Deadline deadline;
+        boost::shared_ptr<std::promise<bool> > loaded;
+    };
+
+    bool WaitUntil(const boost::function<bool ()> &is_loaded, Deadline deadline);
+    std::future<bool> WhenTrue(const boost::function<bool ()> &is_loaded, Deadline deadline);
+    // session thread only, the waiter completes at once when is_loaded already holds
+    void AddWaiter(const Waiter &waiter);
+    // completes the waiters that loaded or expired, returns timeout shortened to the earliest deadline left
+    int CheckWaiters(int timeout);
+    // called by the callbacks that may complete a load
+    void OnLoadProgress();
+
+    // the library cache is written from Update, once per pass whatever the number of callbacks that changed it
+    void MarkCacheDirty(PlayList *playlist);
+    void MarkCacheDirty(PlayListContainer *container);
+    // called when the wrapper unloads, it cannot be written anymore
+    void ForgetCache(PlayList *playlist);
+    void ForgetCache(PlayListContainer *container);
+    // returns timeout shortened to the next rewrite of the incomplete playlists
+    int WriteLibraryCache(int timeout);
+
     // C Style Static callbacks
     static void SP_CALLCONV callback_logged_in(sp_session *session, sp_error error);
     static void SP_CALLCONV callback_logged_out(sp_session *session);
@@ -152,7 +320,49 @@ class LIBSPOTIFYPP_API Session : public boost::enable_shared_from_this<Session>
     volatile bool is_process_events_required_;
     volatile bool has_logged_out_;
     boost::shared_ptr<Track> track_;  // currently playing track
+    boost::shared_ptr<AudioBuffer> audio_buffer_;
+    boost::shared_ptr<Wakeup> wakeup_;
+    boost::shared_ptr<CommandQueue> commands_;
+    bool lazy_playlist_tracks_;
+    IdentityMap<sp_track, Track> tracks_;
+    IdentityMap<sp_artist, Artist> artists_;
+    IdentityMap<sp_album, Album> albums_;
+    boost::unordered_set<PlayList *> loading_playlists_;  // playlists with tracks waiting for their metadata
+    boost::unordered_set<ArtistBrowse *> pending_artist_browses_;  // in flight and held by their continuations
+    boost::unordered_set<AlbumBrowse *> pending_album_browses_;
+    boost::shared_ptr<LibraryCache> library_cache_;
+    boost::shared_ptr<BrowseCache> browse_cache_;
+    boost::shared_ptr<ImageCache> image_cache_;
+    boost::unordered_set<PlayList *> cache_playlists_;    // playlists changed since they were last written
+    boost::unordered_set<PlayList *> cache_incomplete_;   // written while some artist or album was loading
+    bool cache_metadata_updated_;                         // metadata arrived since they were last written
+    Deadline cache_incomplete_due_;                       // they are not written again before
+    PlayListContainer *cache_container_;                  // the container when its tree changed since last written
+    std::vector<Waiter> waiters_;
+    bool load_progress_;  // a load may have completed since the waiters were last checked
+    bool updating_;       // inside Update, WaitFor cannot drive the session from there
+    boost::shared_ptr<ObjectPool> playlist_pool_;
+    boost::shared_ptr<ObjectPool> track_pool_;
+    boost::shared_ptr<ObjectPool> artist_pool_;
+    boost::shared_ptr<ObjectPool> album_pool_;
+    boost::shared_ptr<ObjectPool> image_pool_;
+    boost::shared_ptr<Metrics> metrics_;
+    boost::shared_ptr<MetricsExporter> exporter_;
+    bool async_log_;  // the session started AsyncLog
+    std::atomic<bool> running_;
+    boost::thread run_thread_;
+    boost::mutex loop_mutex_;
+    boost::thread::id loop_thread_;    // the thread in RunLoop, guarded by loop_mutex_
+    boost::thread::id update_thread_;  // the thread that last called Update, guarded by loop_mutex_
     boost::signal<void (sp_error)> on_loggedin_; // NOLINT
     boost::signal<void ()> on_notify_main_thread_; // NOLINT
 };
+
+template <typename R>
+std::future<R> Session::Execute(const boost::function<R ()> &command) {
+    boost::shared_ptr<std::packaged_task<R ()> > task = boost::make_shared<std::packaged_task<R ()> >(command);
+    std::future<R> result = task->get_future();
+    Post([task] { (*task)(); });
+    return result;
+}
 }
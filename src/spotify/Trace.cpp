@@ -0,0 +1,247 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <vector>
+
+#include <boost/format.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace spotify {
+namespace {
+// plain fields, written by the thread that owns the ring while WriteChromeTrace may be copying them. That race is
+// deliberate, Record stays a handful of stores, and the reader checks head to discard any slot it may have torn.
+struct TraceRecord {
+    std::uint64_t timestamp;
+    const void *object;
+    std::int32_t args[2];
+    std::uint32_t event;
+    std::uint32_t thread;
+};
+
+struct Ring {
+    std::atomic<std::uint64_t> head;  // number of records written so far, by every thread that used the ring
+    std::uint32_t thread;             // the thread using it now
+    TraceRecord records[Trace::kCapacity];
+};
+
+// rings outlive their threads so their history can still be dumped. A new thread reuses the ring of an exited one and
+// writes after its records, which are only lost as they are overwritten.
+struct Registry {
+    boost::mutex mutex;
+    std::vector<Ring *> rings;
+    std::vector<Ring *> free_rings;
+    std::uint32_t next_thread;
+    std::string signal_path;
+};
+
+const char *const kEventNames[TRACE_NUM_EVENTS] = {
+    "logged_in", "logged_out", "metadata_updated", "connection_error", "message_to_user", "notify_main_thread",
+    "music_delivery", "play_token_lost", "log_message", "end_of_track", "streaming_error", "userinfo_updated",
+    "start_playback", "stop_playback", "get_audio_buffer_stats",
+    "tracks_added", "tracks_removed", "tracks_moved", "playlist_renamed", "playlist_state_changed",
+    "playlist_update_in_progress", "playlist_metadata_updated", "track_created_changed", "track_seen_changed",
+    "description_changed", "image_changed",
+    "playlist_added", "playlist_removed", "playlist_moved", "container_loaded",
+    "artistbrowse_complete", "albumbrowse_complete",
+    "image_loaded",
+    "process_events", "process_events"
+};
+
+// never destroyed, threads may still record while static destructors run
+Registry &GetRegistry() {
+    static Registry *registry = new Registry();
+    return *registry;
+}
+
+std::atomic<bool> dump_requested(false);
+
+inline std::uint64_t ReadClock() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// reference points to convert clock ticks into microseconds
+struct Calibration {
+    Calibration() : ticks(ReadClock()), time(std::chrono::steady_clock::now()) {}
+
+    std::uint64_t ticks;
+    std::chrono::steady_clock::time_point time;
+};
+
+const Calibration calibration;
+
+Ring *AcquireRing() {
+    Registry &registry = GetRegistry();
+    boost::lock_guard<boost::mutex> lock(registry.mutex);
+
+    Ring *ring;
+    if (registry.free_rings.empty()) {
+        ring = new Ring();
+        registry.rings.push_back(ring);
+    } else {
+        ring = registry.free_rings.back();
+        registry.free_rings.pop_back();
+    }
+    ring->thread = ++registry.next_thread;
+    return ring;
+}
+
+struct ThreadRing {
+    ThreadRing() : ring(AcquireRing()) {}
+
+    ~ThreadRing() {
+        Registry &registry = GetRegistry();
+        boost::lock_guard<boost::mutex> lock(registry.mutex);
+        registry.free_rings.push_back(ring);
+    }
+
+    Ring *ring;
+};
+
+// a thread_specific_ptr rather than thread_local, which VC++ 2012 lacks. Never destroyed, like the registry.
+boost::thread_specific_ptr<ThreadRing> *const thread_rings = new boost::thread_specific_ptr<ThreadRing>();
+
+extern "C" void OnDumpSignal(int) {
+    dump_requested.store(true, std::memory_order_relaxed);
+}
+}
+
+void Trace::Record(TraceEvent event, const void *object, std::int32_t arg0, std::int32_t arg1) {
+    ThreadRing *thread_ring = thread_rings->get();
+    if (!thread_ring) {
+        thread_ring = new ThreadRing();
+        thread_rings->reset(thread_ring);
+    }
+    Ring *ring = thread_ring->ring;
+    std::uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+    // pairs with the acquire fence of WriteChromeTrace: a reader that copies any field stored below also sees the
+    // head stored by the previous call, which tells it the slot is being written again
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceRecord &record = ring->records[head & (kCapacity - 1)];
+    record.timestamp = ReadClock();
+    record.object = object;
+    record.args[0] = arg0;
+    record.args[1] = arg1;
+    record.event = event;
+    record.thread = ring->thread;
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::WriteChromeTrace(std::ostream &out) {
+    std::uint64_t ticks = ReadClock() - calibration.ticks;
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - calibration.time;
+    double micros = std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(elapsed).count();
+    double ticks_per_micro = micros > 0 && ticks > 0 ? ticks / micros : 1.0;
+
+    Registry &registry = GetRegistry();
+    boost::lock_guard<boost::mutex> lock(registry.mutex);
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    std::vector<TraceRecord> records;
+    for (std::size_t i = 0; i < registry.rings.size(); ++i) {
+        Ring *ring = registry.rings[i];
+
+        // a seqlock read: copy, then drop whatever the thread may have overwritten meanwhile. The fields of a
+        // TraceRecord are plain and the copy races with Record, so a slot may be copied torn, but only one the second
+        // load of head shows as written again, and that one is dropped. The fence keeps the copies before that load.
+        std::uint64_t head = ring->head.load(std::memory_order_acquire);
+        std::uint64_t begin = head > kCapacity ? head - kCapacity : 0;
+        records.clear();
+        for (std::uint64_t position = begin; position < head; ++position)
+            records.push_back(ring->records[position & (kCapacity - 1)]);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t written = ring->head.load(std::memory_order_relaxed);
+        std::uint64_t valid = written >= kCapacity ? written - kCapacity + 1 : 0;
+
+        for (std::uint64_t position = std::max(begin, valid); position < head; ++position) {
+            const TraceRecord &record = records[position - begin];
+            if (record.event >= TRACE_NUM_EVENTS)
+                continue;
+
+            const char *phase = "i";
+            if (record.event == TRACE_PROCESS_EVENTS_BEGIN)
+                phase = "B";
+            else if (record.event == TRACE_PROCESS_EVENTS_END)
+                phase = "E";
+
+            double ts = static_cast<std::int64_t>(record.timestamp - calibration.ticks) / ticks_per_micro;
+            out << (first ? "" : ",")
+                << boost::format("\n{\"name\":\"%s\",\"cat\":\"libspotify\",\"ph\":\"%s\",\"s\":\"t\",\"ts\":%.3f,"
+                                 "\"pid\":1,\"tid\":%u,\"args\":{\"object\":\"0x%X\",\"arg0\":%d,\"arg1\":%d}}")
+                   % kEventNames[record.event] % phase % ts % record.thread
+                   % reinterpret_cast<std::uintptr_t>(record.object) % record.args[0] % record.args[1];
+            first = false;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+bool Trace::WriteChromeTrace(const std::string &path) {
+    std::ofstream out(path.c_str());
+    if (!out)
+        return false;
+    WriteChromeTrace(out);
+    return static_cast<bool>(out);
+}
+
+void Trace::DumpOnSignal(int signum, const std::string &path) {
+    {
+        Registry &registry = GetRegistry();
+        boost::lock_guard<boost::mutex> lock(registry.mutex);
+        registry.signal_path = path;
+    }
+    std::signal(signum, OnDumpSignal);
+}
+
+void Trace::DumpIfRequested() {
+    if (!dump_requested.load(std::memory_order_relaxed) || !dump_requested.exchange(false))
+        return;
+
+    std::string path;
+    {
+        Registry &registry = GetRegistry();
+        boost::lock_guard<boost::mutex> lock(registry.mutex);
+        path = registry.signal_path;
+    }
+    WriteChromeTrace(path);
+}
+
+const char *Trace::GetEventName(TraceEvent event) {
+    return kEventNames[event];
+}
+}
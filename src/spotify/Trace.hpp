@@ -0,0 +1,108 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// C-libs includes
+#include <cstddef>
+#include <cstdint>
+
+// std includes
+#include <ostream>
+#include <string>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+/// @brief Everything the trace records: one event per libspotify callback, plus the span of each
+/// sp_session_process_events
+enum TraceEvent {
+    // session callbacks
+    TRACE_LOGGED_IN = 0,
+    TRACE_LOGGED_OUT,
+    TRACE_METADATA_UPDATED,
+    TRACE_CONNECTION_ERROR,
+    TRACE_MESSAGE_TO_USER,
+    TRACE_NOTIFY_MAIN_THREAD,
+    TRACE_MUSIC_DELIVERY,
+    TRACE_PLAY_TOKEN_LOST,
+    TRACE_LOG_MESSAGE,
+    TRACE_END_OF_TRACK,
+    TRACE_STREAMING_ERROR,
+    TRACE_USERINFO_UPDATED,
+    TRACE_START_PLAYBACK,
+    TRACE_STOP_PLAYBACK,
+    TRACE_GET_AUDIO_BUFFER_STATS,
+    // playlist callbacks
+    TRACE_TRACKS_ADDED,
+    TRACE_TRACKS_REMOVED,
+    TRACE_TRACKS_MOVED,
+    TRACE_PLAYLIST_RENAMED,
+    TRACE_PLAYLIST_STATE_CHANGED,
+    TRACE_PLAYLIST_UPDATE_IN_PROGRESS,
+    TRACE_PLAYLIST_METADATA_UPDATED,
+    TRACE_TRACK_CREATED_CHANGED,
+    TRACE_TRACK_SEEN_CHANGED,
+    TRACE_DESCRIPTION_CHANGED,
+    TRACE_IMAGE_CHANGED,
+    // container callbacks
+    TRACE_PLAYLIST_ADDED,
+    TRACE_PLAYLIST_REMOVED,
+    TRACE_PLAYLIST_MOVED,
+    TRACE_CONTAINER_LOADED,
+    // browse callbacks
+    TRACE_ARTISTBROWSE_COMPLETE,
+    TRACE_ALBUMBROWSE_COMPLETE,
+    // image callbacks
+    TRACE_IMAGE_LOADED,
+    // Session::Update
+    TRACE_PROCESS_EVENTS_BEGIN,
+    TRACE_PROCESS_EVENTS_END,
+    TRACE_NUM_EVENTS
+};
+
+/// @class Trace
+/// @brief Always-on binary recorder of the libspotify callbacks.
+///
+/// Every thread writes to its own ring of the last kCapacity records, so recording takes no lock and does not
+/// allocate once the ring of the thread exists. A record holds the event, the object the callback is for, two integer
+/// arguments and a TSC timestamp. The rings are only read when dumped, in the Chrome trace JSON format which Perfetto
+/// loads as well. A dump taken while threads are recording is best effort: records overwritten during the copy are
+/// dropped. The ring of an exited thread goes to the next new thread, the records of the exited thread stay in the
+/// dumps until the new one overwrites them.
+class LIBSPOTIFYPP_API Trace {
+  public:
+    static const std::size_t kCapacity = 4096;  // records per thread, a power of two
+
+    /// @brief Safe to call from any thread, including the libspotify audio thread
+    static void Record(TraceEvent event, const void *object, std::int32_t arg0 = 0, std::int32_t arg1 = 0);
+
+    static void WriteChromeTrace(std::ostream &out);
+    static bool WriteChromeTrace(const std::string &path);
+
+    /// @brief On signum the trace is written to path. The handler only raises a flag, the dump is written by the next
+    /// DumpIfRequested, which Session::Update calls.
+    static void DumpOnSignal(int signum, const std::string &path);
+    static void DumpIfRequested();
+
+    /// @brief Name of the event as written in the dumps
+    static const char *GetEventName(TraceEvent event);
+
+  private:
+    Trace();
+};
+}
@@ -17,14 +17,12 @@
  */
 #include "spotify/Track.hpp"
 
-#include <log4cplus/loggingmacros.h>
 #include <log4cplus/logger.h>
 
 #include <string>
 
-#include <boost/format.hpp>
-
 // lib includes
+#include "spotify/AsyncLog.hpp"
 #include "spotify/Session.hpp"
 
 namespace spotify {
@@ -36,6 +34,7 @@ Track::Track(boost::shared_ptr<Session> session) : PlayListElement(session), tra
 }
 
 Track::~Track() {
+    session_->tracks_.Forget(track_);
     Unload();
 }
 
@@ -90,7 +89,7 @@ void Track::DumpToTTY(int level) {
     std::string indent = "";
     for (int i = 0; i < level; ++i)
         indent += " ";
-    LOG4CPLUS_DEBUG(logger, (boost::format("Track [%s] [%d]mins [%d]secs") % GetName() % mins % seconds));
+    LIBSPOTIFYPP_LOG_DEBUG(logger, "%sTrack [%s] [%d]mins [%d]secs", indent, GetName(), mins, seconds);
 
     ++level;
 }
@@ -100,17 +99,11 @@ int Track::GetNumArtists() {
 }
 
 boost::shared_ptr<Artist> Track::GetArtist(int index) {
-    boost::shared_ptr<Artist> artist = session_->CreateArtist();
-    artist->Load(sp_track_artist(track_, index));
-
-    return artist;
+    return session_->GetArtist(sp_track_artist(track_, index));
 }
 
 boost::shared_ptr<Album> Track::GetAlbum() {
-    boost::shared_ptr<Album> album = session_->CreateAlbum();
-    album->Load(sp_track_album(track_));
-
-    return album;
+    return session_->GetAlbum(sp_track_album(track_));
 }
 
 int Track::GetDisc() {
@@ -128,4 +121,10 @@ bool Track::IsStarred() {
 void Track::SetStarred(bool isStarred) {
     sp_track_set_starred(session_->session_, &track_, 1, isStarred);
 }
+
+std::future<void> Track::SetStarredAsync(bool isStarred) {
+    // the command holds the track, so it is starred even when the caller releases it first
+    boost::shared_ptr<Track> self = boost::static_pointer_cast<Track>(shared_from_this());
+    return session_->Execute<void>([self, isStarred] { self->SetStarred(isStarred); });
+}
 }
@@ -22,6 +22,7 @@
 
 // std include
 #include <string>
+#include <future>
 
 // boost includes
 #include <boost/shared_ptr.hpp>
@@ -63,6 +64,8 @@ class LIBSPOTIFYPP_API Track : public PlayListElement {
     virtual int GetPopularity();
     virtual bool IsStarred();
     virtual void SetStarred(bool isStarred);
+    /// @brief SetStarred run on the session thread, see Session::Post
+    std::future<void> SetStarredAsync(bool isStarred);
 
     virtual void DumpToTTY(int level = 0);
 
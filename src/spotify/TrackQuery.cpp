@@ -0,0 +1,319 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/TrackQuery.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "spotify/TrackSnapshot.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LIBSPOTIFYPP_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIBSPOTIFYPP_SSE2
+#endif
+
+namespace spotify {
+namespace {
+// below this many rows per thread starting the thread costs more than it saves
+const int kRowsPerThread = 32768;
+
+// joins the range threads however Run is left, they read the locals of Run
+struct JoinThreads {
+    explicit JoinThreads(std::vector<boost::shared_ptr<boost::thread> > *threads) : threads(threads) {}
+
+    ~JoinThreads() {
+        for (std::size_t t = 0; t < threads->size(); ++t)
+            (*threads)[t]->join();
+    }
+
+    std::vector<boost::shared_ptr<boost::thread> > *threads;
+};
+
+char Fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool StartsWith(const char *text, const std::string &folded) {
+    for (std::size_t i = 0; i < folded.size(); ++i) {
+        if (Fold(text[i]) != folded[i])
+            return false;  // also stops at the NUL of a shorter text
+    }
+    return true;
+}
+
+bool Contains(const char *text, std::size_t length, const std::string &folded) {
+    if (folded.size() > length)
+        return false;
+    for (std::size_t i = 0; i + folded.size() <= length; ++i) {
+        if (Fold(text[i]) == folded[0] && StartsWith(text + i, folded))
+            return true;
+    }
+    return folded.empty();
+}
+
+bool Matches(const char *text, std::size_t length, TrackQuery::Match match, const std::string &folded) {
+    return match == TrackQuery::PREFIX ? StartsWith(text, folded) : Contains(text, length, folded);
+}
+
+int Compare(const char *a, const char *b) {
+    for (;; ++a, ++b) {
+        unsigned char fa = Fold(*a);
+        unsigned char fb = Fold(*b);
+        if (fa != fb || !fa)
+            return fa - fb;
+    }
+}
+
+const int *GetColumn(const TrackSnapshot &snapshot, TrackQuery::Column column) {
+    switch (column) {
+        case TrackQuery::DURATION:
+            return snapshot.GetDurations();
+        case TrackQuery::POPULARITY:
+            return snapshot.GetPopularities();
+        case TrackQuery::DISC:
+            return snapshot.GetDiscs();
+        case TrackQuery::STARRED:
+            return snapshot.GetStarred();
+    }
+    return NULL;
+}
+
+// Clears the mask of the values outside [min, max]. value - min is compared to max - min as unsigned, one compare
+// per value that cannot overflow. SSE and AVX2 only compare signed, flipping the sign bit of both sides makes up
+// for it.
+void KeepBetween(const int *values, std::size_t count, int min, int max, std::uint8_t *mask) {
+    if (min > max) {
+        std::memset(mask, 0, count);
+        return;
+    }
+
+    const std::uint32_t range = static_cast<std::uint32_t>(max) - static_cast<std::uint32_t>(min);
+    std::size_t i = 0;
+#if defined(LIBSPOTIFYPP_AVX2)
+    const __m256i low = _mm256_set1_epi32(min);
+    const __m256i sign = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+    const __m256i high = _mm256_set1_epi32(static_cast<int>(range ^ 0x80000000u));
+    // the packs work within each 128 bit lane, this puts the 4 byte groups back in order
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    for (; i + 32 <= count; i += 32) {
+        __m256i outside[4];
+        for (int j = 0; j < 4; ++j) {
+            __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i + 8 * j));
+            outside[j] = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_sub_epi32(value, low), sign), high);
+        }
+        __m256i bytes = _mm256_packs_epi16(_mm256_packs_epi32(outside[0], outside[1]),
+                                           _mm256_packs_epi32(outside[2], outside[3]));
+        bytes = _mm256_permutevar8x32_epi32(bytes, order);
+        __m256i *out = reinterpret_cast<__m256i *>(mask + i);
+        _mm256_storeu_si256(out, _mm256_andnot_si256(bytes, _mm256_loadu_si256(out)));
+    }
+#endif
+#if defined(LIBSPOTIFYPP_SSE2)
+    const __m128i low4 = _mm_set1_epi32(min);
+    const __m128i sign4 = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const __m128i high4 = _mm_set1_epi32(static_cast<int>(range ^ 0x80000000u));
+    for (; i + 16 <= count; i += 16) {
+        __m128i outside[4];
+        for (int j = 0; j < 4; ++j) {
+            __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i + 4 * j));
+            outside[j] = _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(value, low4), sign4), high4);
+        }
+        __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(outside[0], outside[1]),
+                                        _mm_packs_epi32(outside[2], outside[3]));
+        __m128i *out = reinterpret_cast<__m128i *>(mask + i);
+        _mm_storeu_si128(out, _mm_andnot_si128(bytes, _mm_loadu_si128(out)));
+    }
+#endif
+    for (; i < count; ++i) {
+        if (static_cast<std::uint32_t>(values[i]) - static_cast<std::uint32_t>(min) > range)
+            mask[i] = 0;
+    }
+}
+}
+
+TrackQuery::TrackQuery() : limit_(0), max_threads_(0) {
+}
+
+TrackQuery &TrackQuery::Where(Column column, int min, int max) {
+    Range range = {column, min, max};
+    ranges_.push_back(range);
+    return *this;
+}
+
+TrackQuery &TrackQuery::Where(Text text, Match match, const std::string &value) {
+    Pattern pattern = {text, match, value};
+    std::transform(pattern.folded.begin(), pattern.folded.end(), pattern.folded.begin(), Fold);
+    patterns_.push_back(pattern);
+    return *this;
+}
+
+TrackQuery &TrackQuery::OrderBy(Key key, bool descending) {
+    SortKey sort_key = {key, descending};
+    keys_.push_back(sort_key);
+    return *this;
+}
+
+TrackQuery &TrackQuery::Limit(std::size_t count) {
+    limit_ = count;
+    return *this;
+}
+
+TrackQuery &TrackQuery::SetMaxThreads(int max_threads) {
+    max_threads_ = max_threads;
+    return *this;
+}
+
+std::vector<int> TrackQuery::Run(const TrackSnapshot &snapshot) const {
+    int num_rows = snapshot.GetNumTracks();
+
+    // the artist conditions are decided once per artist rather than once per row
+    std::vector<char> artists(snapshot.GetNumArtists(), 1);
+    for (std::size_t p = 0; p < patterns_.size(); ++p) {
+        const Pattern &pattern = patterns_[p];
+        if (pattern.text != ARTIST)
+            continue;
+        for (int id = 0; id < snapshot.GetNumArtists(); ++id) {
+            const char *name = snapshot.GetArtistNameById(id);
+            if (artists[id] && !Matches(name, std::strlen(name), pattern.match, pattern.folded))
+                artists[id] = 0;
+        }
+    }
+
+    int max_threads = max_threads_ > 0 ? max_threads_ : static_cast<int>(boost::thread::hardware_concurrency());
+    int num_parts = std::max(1, std::min(max_threads, num_rows / kRowsPerThread));
+
+    std::vector<int> bounds(num_parts + 1);
+    for (int p = 0; p <= num_parts; ++p)
+        bounds[p] = static_cast<int>(static_cast<std::int64_t>(num_rows) * p / num_parts);
+
+    // the calling thread takes the first range
+    std::vector<std::vector<int> > parts(num_parts);
+    std::vector<boost::shared_ptr<boost::thread> > threads;
+    {
+        JoinThreads join(&threads);
+        threads.reserve(num_parts - 1);
+        for (int p = 1; p < num_parts; ++p) {
+            threads.push_back(boost::make_shared<boost::thread>(boost::bind(&TrackQuery::RunRange, this,
+                boost::cref(snapshot), boost::cref(artists), bounds[p], bounds[p + 1], &parts[p])));
+        }
+        RunRange(snapshot, artists, bounds[0], bounds[1], &parts[0]);
+    }
+
+    // each range is sorted and cut already, Less is a total order so merging them gives the sort of the whole
+    std::vector<int> rows;
+    rows.swap(parts[0]);
+    for (int p = 1; p < num_parts; ++p) {
+        std::size_t middle = rows.size();
+        rows.insert(rows.end(), parts[p].begin(), parts[p].end());
+        if (!keys_.empty()) {
+            std::inplace_merge(rows.begin(), rows.begin() + middle, rows.end(),
+                               boost::bind(&TrackQuery::Less, this, boost::cref(snapshot), _1, _2));
+        }
+        if (limit_ && rows.size() > limit_)
+            rows.resize(limit_);
+    }
+    return rows;
+}
+
+void TrackQuery::RunRange(const TrackSnapshot &snapshot, const std::vector<char> &artists, int begin, int end,
+                          std::vector<int> *rows) const {
+    std::size_t count = end - begin;
+    std::vector<std::uint8_t> mask(count, 0xFF);
+    for (std::size_t r = 0; r < ranges_.size(); ++r) {
+        const Range &range = ranges_[r];
+        KeepBetween(GetColumn(snapshot, range.column) + begin, count, range.min, range.max, mask.data());
+    }
+
+    const int *artist_ids = snapshot.GetArtistIds();
+    for (int row = begin; row < end; ++row) {
+        if (!mask[row - begin])
+            continue;
+
+        bool keep = true;
+        for (std::size_t p = 0; keep && p < patterns_.size(); ++p) {
+            const Pattern &pattern = patterns_[p];
+            if (pattern.text == NAME) {
+                keep = Matches(snapshot.GetName(row), snapshot.GetNameLength(row), pattern.match, pattern.folded);
+            } else {
+                int id = artist_ids[row];
+                keep = id == TrackSnapshot::kNone ? pattern.folded.empty() : artists[id] != 0;
+            }
+        }
+        if (keep)
+            rows->push_back(row);
+    }
+
+    if (keys_.empty()) {
+        // playlist order, the first rows are the ones kept
+        if (limit_ && rows->size() > limit_)
+            rows->resize(limit_);
+        return;
+    }
+
+    if (limit_ && rows->size() > limit_) {
+        std::partial_sort(rows->begin(), rows->begin() + limit_, rows->end(),
+                          boost::bind(&TrackQuery::Less, this, boost::cref(snapshot), _1, _2));
+        rows->resize(limit_);
+    } else {
+        std::sort(rows->begin(), rows->end(), boost::bind(&TrackQuery::Less, this, boost::cref(snapshot), _1, _2));
+    }
+}
+
+bool TrackQuery::Less(const TrackSnapshot &snapshot, int a, int b) const {
+    for (std::size_t k = 0; k < keys_.size(); ++k) {
+        int order = 0;
+        switch (keys_[k].key) {
+            case BY_NAME:
+                order = Compare(snapshot.GetName(a), snapshot.GetName(b));
+                break;
+            case BY_ARTIST: {
+                const int *ids = snapshot.GetArtistIds();
+                if (ids[a] != ids[b])
+                    order = Compare(snapshot.GetArtistName(a), snapshot.GetArtistName(b));
+            }   break;
+            case BY_DURATION:
+                order = (snapshot.GetDurations()[a] > snapshot.GetDurations()[b])
+                      - (snapshot.GetDurations()[a] < snapshot.GetDurations()[b]);
+                break;
+            case BY_POPULARITY:
+                order = (snapshot.GetPopularities()[a] > snapshot.GetPopularities()[b])
+                      - (snapshot.GetPopularities()[a] < snapshot.GetPopularities()[b]);
+                break;
+            case BY_DISC:
+                order = (snapshot.GetDiscs()[a] > snapshot.GetDiscs()[b])
+                      - (snapshot.GetDiscs()[a] < snapshot.GetDiscs()[b]);
+                break;
+            case BY_STARRED:
+                order = snapshot.GetStarred()[a] - snapshot.GetStarred()[b];
+                break;
+        }
+        if (order)
+            return keys_[k].descending ? order > 0 : order < 0;
+    }
+    // the playlist order breaks the ties, which makes the sort stable
+    return a < b;
+}
+}
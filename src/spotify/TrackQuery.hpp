@@ -0,0 +1,114 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// C-libs includes
+#include <cstddef>
+
+// std includes
+#include <string>
+#include <vector>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+// forward declaration
+class TrackSnapshot;
+
+/// @class TrackQuery
+/// @brief Filters, sorts and cuts the rows of a TrackSnapshot, for smart playlists and sorted views.
+///
+/// The numeric conditions are evaluated a column at a time with SSE2, or AVX2 when the library is built WITH_AVX2,
+/// the text conditions only on the rows they leave. Snapshots large enough are split in ranges filtered and sorted
+/// on threads of their own, then merged. Run does not change the query, it may be kept and run on newer snapshots.
+class LIBSPOTIFYPP_API TrackQuery {
+  public:
+    enum Column {
+        DURATION = 0,
+        POPULARITY,
+        DISC,
+        STARRED
+    };
+
+    enum Text {
+        NAME = 0,
+        ARTIST
+    };
+
+    enum Match {
+        PREFIX = 0,
+        SUBSTRING
+    };
+
+    enum Key {
+        BY_NAME = 0,
+        BY_ARTIST,
+        BY_DURATION,
+        BY_POPULARITY,
+        BY_DISC,
+        BY_STARRED
+    };
+
+    TrackQuery();
+
+    /// @brief Keeps the rows where min <= column <= max
+    TrackQuery &Where(Column column, int min, int max);
+    /// @brief Keeps the rows whose text starts with or contains value, the case of ASCII letters is ignored
+    TrackQuery &Where(Text text, Match match, const std::string &value);
+    /// @brief Adds a sort key after the ones already given, the texts compare ignoring the case of ASCII letters.
+    /// Rows equal on every key keep their playlist order.
+    TrackQuery &OrderBy(Key key, bool descending = false);
+    /// @brief Keeps the first count rows once sorted, 0 keeps them all
+    TrackQuery &Limit(std::size_t count);
+    /// @brief Most threads Run may use, 0 for one per core
+    TrackQuery &SetMaxThreads(int max_threads);
+
+    /// @brief Rows of the snapshot matching every condition, in order
+    std::vector<int> Run(const TrackSnapshot &snapshot) const;
+
+  private:
+    struct Range {
+        Column column;
+        int min;
+        int max;
+    };
+
+    struct Pattern {
+        Text text;
+        Match match;
+        std::string folded;  // value in lower case
+    };
+
+    struct SortKey {
+        Key key;
+        bool descending;
+    };
+
+    // filters and sorts the rows [begin, end), on a thread of its own
+    void RunRange(const TrackSnapshot &snapshot, const std::vector<char> &artists, int begin, int end,
+                  std::vector<int> *rows) const;
+    // orders two rows by the sort keys, then by row
+    bool Less(const TrackSnapshot &snapshot, int a, int b) const;
+
+    std::vector<Range> ranges_;
+    std::vector<Pattern> patterns_;
+    std::vector<SortKey> keys_;
+    std::size_t limit_;
+    int max_threads_;
+};
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/TrackSnapshot.hpp"
+
+#include <cstring>
+
+#include <utility>
+
+#include <boost/unordered_map.hpp>
+
+namespace spotify {
+namespace {
+// average length of a track name, the arena is reserved for it up front
+const std::size_t kNameReserve = 24;
+}
+
+const int TrackSnapshot::kNone;
+
+TrackSnapshot::TrackSnapshot(sp_session *session, sp_playlist *playlist) : arena_(1, '\0') {
+    int num_tracks = playlist ? sp_playlist_num_tracks(playlist) : 0;
+    tracks_.resize(num_tracks);
+    durations_.resize(num_tracks);
+    popularities_.resize(num_tracks);
+    discs_.resize(num_tracks);
+    starred_.resize(num_tracks);
+    album_ids_.resize(num_tracks, kNone);
+    artist_ids_.resize(num_tracks, kNone);
+    name_offsets_.resize(num_tracks);
+    name_lengths_.resize(num_tracks);
+    arena_.reserve(num_tracks * kNameReserve);
+
+    // only the first row of an album or artist asks libspotify about it
+    boost::unordered_map<sp_album *, int> album_ids;
+    boost::unordered_map<sp_artist *, int> artist_ids;
+    std::vector<char> artist_loaded;
+    int num_loading = 0;
+
+    for (int row = 0; row < num_tracks; ++row) {
+        sp_track *track = sp_playlist_track(playlist, row);
+        tracks_[row] = track;
+        if (track)
+            sp_track_add_ref(track);
+        if (!track || !sp_track_is_loaded(track)) {
+            ++num_loading;
+            name_offsets_[row] = 0;
+            name_lengths_[row] = 0;
+            continue;
+        }
+
+        name_offsets_[row] = Store(sp_track_name(track), &name_lengths_[row]);
+        durations_[row] = sp_track_duration(track);
+        popularities_[row] = sp_track_popularity(track);
+        discs_[row] = sp_track_disc(track);
+        starred_[row] = session && sp_track_is_starred(session, track) ? 1 : 0;
+
+        sp_album *album = sp_track_album(track);
+        if (album) {
+            std::pair<boost::unordered_map<sp_album *, int>::iterator, bool> added =
+                album_ids.insert(std::make_pair(album, static_cast<int>(albums_.size())));
+            if (added.second) {
+                sp_album_add_ref(album);
+                albums_.push_back(album);
+            }
+            album_ids_[row] = added.first->second;
+        }
+
+        sp_artist *artist = sp_track_num_artists(track) > 0 ? sp_track_artist(track, 0) : NULL;
+        if (artist) {
+            std::pair<boost::unordered_map<sp_artist *, int>::iterator, bool> added =
+                artist_ids.insert(std::make_pair(artist, static_cast<int>(artists_.size())));
+            if (added.second) {
+                std::uint32_t length = 0;
+                bool loaded = sp_artist_is_loaded(artist);
+                sp_artist_add_ref(artist);
+                artists_.push_back(artist);
+                artist_name_offsets_.push_back(loaded ? Store(sp_artist_name(artist), &length) : 0);
+                artist_loaded.push_back(loaded);
+            }
+            artist_ids_[row] = added.first->second;
+            if (!artist_loaded[artist_ids_[row]])
+                ++num_loading;
+        }
+    }
+
+    View view = {num_tracks, static_cast<int>(albums_.size()), static_cast<int>(artists_.size()), num_loading,
+                 durations_.data(), popularities_.data(), discs_.data(), starred_.data(), album_ids_.data(),
+                 artist_ids_.data(), name_offsets_.data(), name_lengths_.data(), artist_name_offsets_.data(), NULL,
+                 NULL, NULL, tracks_.data(), albums_.data(), artists_.data(), arena_.data(), arena_.size()};
+    view_ = view;
+}
+
+TrackSnapshot::TrackSnapshot(const View &view, boost::shared_ptr<const void> storage)
+    : view_(view), storage_(storage) {
+}
+
+TrackSnapshot::~TrackSnapshot() {
+    for (std::size_t i = 0; i < tracks_.size(); ++i) {
+        if (tracks_[i])
+            sp_track_release(tracks_[i]);
+    }
+    for (std::size_t i = 0; i < albums_.size(); ++i)
+        sp_album_release(albums_[i]);
+    for (std::size_t i = 0; i < artists_.size(); ++i)
+        sp_artist_release(artists_[i]);
+}
+
+std::uint32_t TrackSnapshot::Store(const char *text, std::uint32_t *length) {
+    std::size_t size = std::strlen(text);
+    if (!size) {
+        *length = 0;
+        return 0;
+    }
+    std::uint32_t offset = static_cast<std::uint32_t>(arena_.size());
+    arena_.insert(arena_.end(), text, text + size + 1);
+    *length = static_cast<std::uint32_t>(size);
+    return offset;
+}
+
+int TrackSnapshot::GetNumTracks() const {
+    return view_.num_tracks;
+}
+
+int TrackSnapshot::GetNumLoading() const {
+    return view_.num_loading;
+}
+
+const int *TrackSnapshot::GetDurations() const {
+    return view_.durations;
+}
+
+const int *TrackSnapshot::GetPopularities() const {
+    return view_.popularities;
+}
+
+const int *TrackSnapshot::GetDiscs() const {
+    return view_.discs;
+}
+
+const int *TrackSnapshot::GetStarred() const {
+    return view_.starred;
+}
+
+const int *TrackSnapshot::GetAlbumIds() const {
+    return view_.album_ids;
+}
+
+const int *TrackSnapshot::GetArtistIds() const {
+    return view_.artist_ids;
+}
+
+const char *TrackSnapshot::GetName(int row) const {
+    return view_.arena + view_.name_offsets[row];
+}
+
+std::size_t TrackSnapshot::GetNameLength(int row) const {
+    return view_.name_lengths[row];
+}
+
+const char *TrackSnapshot::GetArtistName(int row) const {
+    return GetArtistNameById(view_.artist_ids[row]);
+}
+
+sp_track *TrackSnapshot::GetTrack(int row) const {
+    return view_.tracks ? view_.tracks[row] : NULL;
+}
+
+const char *TrackSnapshot::GetTrackLink(int row) const {
+    return view_.arena + (view_.track_links ? view_.track_links[row] : 0);
+}
+
+int TrackSnapshot::GetNumAlbums() const {
+    return view_.num_albums;
+}
+
+sp_album *TrackSnapshot::GetAlbum(int album_id) const {
+    return album_id == kNone || !view_.albums ? NULL : view_.albums[album_id];
+}
+
+const char *TrackSnapshot::GetAlbumLink(int album_id) const {
+    return view_.arena + (album_id == kNone || !view_.album_links ? 0 : view_.album_links[album_id]);
+}
+
+int TrackSnapshot::GetNumArtists() const {
+    return view_.num_artists;
+}
+
+sp_artist *TrackSnapshot::GetArtist(int artist_id) const {
+    return artist_id == kNone || !view_.artists ? NULL : view_.artists[artist_id];
+}
+
+const char *TrackSnapshot::GetArtistLink(int artist_id) const {
+    return view_.arena + (artist_id == kNone || !view_.artist_links ? 0 : view_.artist_links[artist_id]);
+}
+
+const char *TrackSnapshot::GetArtistNameById(int artist_id) const {
+    return view_.arena + (artist_id == kNone ? 0 : view_.artist_name_offsets[artist_id]);
+}
+}
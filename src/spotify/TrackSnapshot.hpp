@@ -0,0 +1,141 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// C-libs includes
+#include <cstddef>
+#include <cstdint>
+
+// std includes
+#include <vector>
+
+// boost includes
+#include <boost/shared_ptr.hpp>
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+/// @class TrackSnapshot
+/// @brief Metadata of the tracks of a playlist, copied out of libspotify in one pass into one array per column.
+///
+/// Row i is the track at position i when the snapshot was taken, later edits of the playlist do not show. The names
+/// are stored back to back in a single arena of NUL terminated strings. Albums and artists are numbered densely in
+/// the order they are first met, so grouping or comparing them is an int compare. The snapshot never changes once
+/// built and may be read from any thread, the sp_* pointers it hands back are for the session thread only. It holds a
+/// reference on each of them, so they stay valid after the playlist drops the track, and releases them when it is
+/// destroyed. PlayList::Snapshot hands out snapshots that are destroyed on the session thread.
+///
+/// A snapshot read from a LibraryCache is mapped from its file. It has the links of its tracks, albums and artists
+/// instead of sp_* pointers.
+class LIBSPOTIFYPP_API TrackSnapshot {
+  public:
+    static const int kNone = -1;  // album or artist id of a row without one
+
+    /// @brief Reads every track of the playlist, on the session thread. A NULL playlist gives an empty snapshot.
+    TrackSnapshot(sp_session *session, sp_playlist *playlist);
+    ~TrackSnapshot();
+
+    int GetNumTracks() const;
+    /// @brief Rows whose track or first artist had not loaded, their missing fields are empty, 0 or kNone
+    int GetNumLoading() const;
+
+    // columns, GetNumTracks entries each
+    const int *GetDurations() const;
+    const int *GetPopularities() const;
+    const int *GetDiscs() const;
+    const int *GetStarred() const;  // 1 when starred, 0 otherwise
+    const int *GetAlbumIds() const;
+    const int *GetArtistIds() const;  // of the first artist
+
+    const char *GetName(int row) const;
+    std::size_t GetNameLength(int row) const;
+    /// @brief Name of the first artist of the row, "" when there is none
+    const char *GetArtistName(int row) const;
+
+    /// @brief NULL when read from a cache
+    sp_track *GetTrack(int row) const;
+    /// @brief The spotify: URI of the track, "" unless read from a cache
+    const char *GetTrackLink(int row) const;
+
+    int GetNumAlbums() const;
+    sp_album *GetAlbum(int album_id) const;
+    const char *GetAlbumLink(int album_id) const;
+
+    int GetNumArtists() const;
+    sp_artist *GetArtist(int artist_id) const;
+    const char *GetArtistLink(int artist_id) const;
+    const char *GetArtistNameById(int artist_id) const;
+
+  private:
+    friend class LibraryCache;
+
+    TrackSnapshot(const TrackSnapshot &);
+    TrackSnapshot &operator=(const TrackSnapshot &);
+
+    // where the accessors read from, the vectors below or a mapped file
+    struct View {
+        int num_tracks;
+        int num_albums;
+        int num_artists;
+        int num_loading;
+        const int *durations;
+        const int *popularities;
+        const int *discs;
+        const int *starred;
+        const int *album_ids;
+        const int *artist_ids;
+        const std::uint32_t *name_offsets;
+        const std::uint32_t *name_lengths;
+        const std::uint32_t *artist_name_offsets;  // by artist id
+        const std::uint32_t *track_links;          // offsets of the links, NULL without them
+        const std::uint32_t *album_links;
+        const std::uint32_t *artist_links;
+        sp_track *const *tracks;                   // NULL without them
+        sp_album *const *albums;
+        sp_artist *const *artists;
+        const char *arena;                         // starts with the empty string
+        std::size_t arena_size;
+    };
+
+    // a view on memory storage keeps alive
+    TrackSnapshot(const View &view, boost::shared_ptr<const void> storage);
+
+    // appends the string and its NUL to the arena, returns where it starts
+    std::uint32_t Store(const char *text, std::uint32_t *length);
+
+    View view_;
+    boost::shared_ptr<const void> storage_;
+
+    std::vector<sp_track *> tracks_;
+    std::vector<int> durations_;
+    std::vector<int> popularities_;
+    std::vector<int> discs_;
+    std::vector<int> starred_;
+    std::vector<int> album_ids_;
+    std::vector<int> artist_ids_;
+    std::vector<std::uint32_t> name_offsets_;
+    std::vector<std::uint32_t> name_lengths_;
+    std::vector<sp_album *> albums_;
+    std::vector<sp_artist *> artists_;
+    std::vector<std::uint32_t> artist_name_offsets_;
+    std::vector<char> arena_;
+};
+}
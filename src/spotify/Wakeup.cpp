@@ -0,0 +1,113 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "spotify/Wakeup.hpp"
+
+#include <log4cplus/logger.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#else
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/locks.hpp>
+#endif
+
+#include <cstdint>
+#include <chrono>
+
+#include "spotify/AsyncLog.hpp"
+
+namespace spotify {
+namespace {
+log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.Wakeup");
+
+typedef std::chrono::steady_clock Clock;
+}
+
+#if defined(__linux__)
+Wakeup::Wakeup() : pending_(false), fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (fd_ < 0)
+        LIBSPOTIFYPP_LOG_ERROR(logger, "unable to create an eventfd, falling back to polling");
+}
+
+Wakeup::~Wakeup() {
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+void Wakeup::Notify() {
+    if (pending_.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    std::uint64_t one = 1;
+    if (fd_ >= 0 && write(fd_, &one, sizeof(one)) < 0)
+        LIBSPOTIFYPP_LOG_WARN(logger, "unable to signal the eventfd");
+}
+
+bool Wakeup::Wait(int timeout) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    while (!pending_.exchange(false, std::memory_order_acq_rel)) {
+        int remaining = -1;
+        if (timeout >= 0) {
+            // rounded up, so the wait never ends before the deadline
+            Clock::duration left = deadline - Clock::now();
+            if (left <= Clock::duration::zero())
+                return false;
+            remaining = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                            left + std::chrono::milliseconds(1) - Clock::duration(1)).count());
+        }
+        if (fd_ < 0 && (remaining < 0 || remaining > 10))
+            remaining = 10;
+
+        pollfd descriptor = {fd_, POLLIN, 0};
+        if (poll(&descriptor, fd_ >= 0 ? 1 : 0, remaining) > 0) {
+            std::uint64_t count;
+            if (read(fd_, &count, sizeof(count)) < 0)
+                LIBSPOTIFYPP_LOG_WARN(logger, "unable to reset the eventfd");
+        }
+    }
+    return true;
+}
+#else
+Wakeup::Wakeup() : pending_(false) {
+}
+
+Wakeup::~Wakeup() {
+}
+
+void Wakeup::Notify() {
+    if (pending_.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    condition_.notify_one();
+}
+
+bool Wakeup::Wait(int timeout) {
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::millisec(timeout);
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!pending_.exchange(false, std::memory_order_acq_rel)) {
+        if (timeout < 0)
+            condition_.wait(lock);
+        else if (!condition_.timed_wait(lock, deadline))
+            return pending_.exchange(false, std::memory_order_acq_rel);
+    }
+    return true;
+}
+#endif
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// std includes
+#include <atomic>
+
+// boost includes
+#if !defined(__linux__)
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#endif
+
+#include "spotify/LibConfig.hpp"
+
+namespace spotify {
+/// @class Wakeup
+/// @brief Wakes a single waiting thread, any number of Notify calls before it wakes up count as one.
+///
+/// Only the first Notify after a Wait touches the kernel, an eventfd on Linux and a condition variable elsewhere.
+class LIBSPOTIFYPP_API Wakeup {
+  public:
+    Wakeup();
+    ~Wakeup();
+
+    /// @brief Safe to call from any thread, including from libspotify callbacks
+    void Notify();
+
+    /// @brief Blocks until Notify is called or timeout milliseconds pass, a negative timeout waits forever.
+    /// @return true when woken by Notify, the pending notification is consumed
+    bool Wait(int timeout);
+
+  private:
+    Wakeup(const Wakeup &);
+    Wakeup &operator=(const Wakeup &);
+
+    std::atomic<bool> pending_;
+#if defined(__linux__)
+    int fd_;
+#else
+    boost::mutex mutex_;
+    boost::condition_variable condition_;
+#endif
+};
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// std includes
+#include <future>
+#include <vector>
+
+// boost includes
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace spotify {
+/// @brief Calls continuation with browses once every one of them has completed, whatever its error. Works with
+/// ArtistBrowse and AlbumBrowse, the browses run concurrently and the continuation runs on the session thread.
+template <typename Browse, typename Continuation>
+void WhenAll(const std::vector<boost::shared_ptr<Browse> > &browses, Continuation continuation) {
+    if (browses.empty()) {
+        continuation(browses);
+        return;
+    }
+
+    // only touched from the session thread
+    boost::shared_ptr<std::size_t> remaining = boost::make_shared<std::size_t>(browses.size());
+    boost::shared_ptr<std::vector<boost::shared_ptr<Browse> > > all =
+        boost::make_shared<std::vector<boost::shared_ptr<Browse> > >(browses);
+    for (std::size_t i = 0; i < browses.size(); ++i) {
+        browses[i]->connectToOnComplete([remaining, all, continuation](boost::shared_ptr<Browse>, sp_error) {
+            if (--*remaining == 0)
+                continuation(*all);
+        });
+    }
+}
+
+/// @brief Like WhenAll with a continuation, the browses are delivered through the future. Do not wait on the
+/// future from the session thread, it would never be ready.
+template <typename Browse>
+std::future<std::vector<boost::shared_ptr<Browse> > > WhenAll(const std::vector<boost::shared_ptr<Browse> > &browses) {
+    typedef std::vector<boost::shared_ptr<Browse> > Browses;
+    boost::shared_ptr<std::promise<Browses> > result = boost::make_shared<std::promise<Browses> >();
+    WhenAll(browses, [result](const Browses &all) { result->set_value(all); });
+    return result->get_future();
+}
+}
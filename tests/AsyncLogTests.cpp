@@ -0,0 +1,89 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <cstddef>
+#include <string>
+
+#include <log4cplus/logger.h>
+
+#include <spotify/AsyncLog.hpp>
+
+namespace {
+log4cplus::Logger logger = log4cplus::Logger::getInstance("spotify.AsyncLogTests");
+
+void LogMany(int count) {
+    for (int i = 0; i < count; ++i)
+        LIBSPOTIFYPP_LOG_INFO(logger, "record %d of %d", i, count);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(AsyncLogTests)
+
+BOOST_AUTO_TEST_CASE(TestRecordFormat)
+{
+    std::string name = "starred";
+    std::size_t tracks = 7;
+    spotify::LogRecord record(&logger, log4cplus::INFO_LOG_LEVEL, __FILE__, __LINE__, "%s [%d] %u %s",
+                              name, -3, tracks, "done");
+    BOOST_CHECK_EQUAL(record.Format(), "starred [-3] 7 done");
+
+    spotify::LogRecord full(&logger, log4cplus::INFO_LOG_LEVEL, __FILE__, __LINE__, "%d %d %d %d %d %d", 1, 2, 3, 4,
+                            5, 6);
+    BOOST_CHECK_EQUAL(full.Format(), "1 2 3 4 5 6");
+
+    // the arguments are copies, the record outlives them
+    char transient[] = "transient";
+    spotify::LogRecord copied(&logger, log4cplus::INFO_LOG_LEVEL, __FILE__, __LINE__, "%s", transient);
+    transient[0] = 'X';
+    BOOST_CHECK_EQUAL(copied.Format(), "transient");
+
+    std::string longer(1000, 'a');
+    spotify::LogRecord truncated(&logger, log4cplus::INFO_LOG_LEVEL, __FILE__, __LINE__, "%s%s", longer, "b");
+    BOOST_CHECK_EQUAL(truncated.Format(), std::string(spotify::LogRecord::kTextSize - 1, 'a'));
+}
+
+BOOST_AUTO_TEST_CASE(TestQueueIsBounded)
+{
+    spotify::LogQueue queue(3);
+    BOOST_REQUIRE_EQUAL(queue.GetCapacity(), 4u);
+
+    for (int i = 0; i < 4; ++i)
+        BOOST_CHECK(queue.TryPush(spotify::LogRecord(&logger, log4cplus::INFO_LOG_LEVEL, __FILE__, __LINE__, "%d", i)));
+    BOOST_CHECK(!queue.TryPush(spotify::LogRecord(&logger, log4cplus::INFO_LOG_LEVEL, __FILE__, __LINE__, "full")));
+
+    spotify::LogRecord record;
+    for (int i = 0; i < 4; ++i) {
+        BOOST_REQUIRE(queue.TryPop(&record));
+        BOOST_CHECK_EQUAL(record.Format(), std::to_string(i));
+    }
+    BOOST_CHECK(!queue.TryPop(&record));
+
+    // the cells are reused once popped
+    BOOST_CHECK(queue.TryPush(spotify::LogRecord(&logger, log4cplus::INFO_LOG_LEVEL, __FILE__, __LINE__, "again")));
+    BOOST_REQUIRE(queue.TryPop(&record));
+    BOOST_CHECK_EQUAL(record.Format(), "again");
+}
+
+BOOST_AUTO_TEST_CASE(TestStopWritesEveryQueuedRecord)
+{
+    log4cplus::LogLevel level = logger.getLogLevel();
+    logger.setLogLevel(log4cplus::INFO_LOG_LEVEL);
+    spotify::AsyncLogCounters before = spotify::AsyncLog::GetCounters();
+
+    spotify::AsyncLog::Start(16);
+    BOOST_CHECK(spotify::AsyncLog::IsRunning());
+    boost::thread_group producers;
+    for (int i = 0; i < 4; ++i)
+        producers.create_thread(boost::bind(LogMany, 1000));
+    producers.join_all();
+    spotify::AsyncLog::Stop();
+    BOOST_CHECK(!spotify::AsyncLog::IsRunning());
+
+    spotify::AsyncLogCounters after = spotify::AsyncLog::GetCounters();
+    BOOST_CHECK_EQUAL((after.submitted - before.submitted) + (after.dropped - before.dropped), 4000u);
+    BOOST_CHECK_EQUAL(after.written - before.written, after.submitted - before.submitted);
+    logger.setLogLevel(level);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,206 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include <spotify/AudioBuffer.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/Track.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+namespace {
+sp_audioformat StereoFormat() {
+    sp_audioformat format;
+    format.sample_type = SP_SAMPLETYPE_INT16_NATIVE_ENDIAN;
+    format.sample_rate = 44100;
+    format.channels = 2;
+    return format;
+}
+
+// frame i holds the samples 2i and 2i + 1
+std::vector<std::int16_t> MakeFrames(int first, int count) {
+    std::vector<std::int16_t> frames(count * 2);
+    for (int i = 0; i < count * 2; ++i)
+        frames[i] = static_cast<std::int16_t>(first * 2 + i);
+    return frames;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(AudioBufferTests)
+
+BOOST_AUTO_TEST_CASE(TestPartialWritesWrapAround)
+{
+    spotify::AudioBuffer buffer(6);
+    BOOST_REQUIRE_EQUAL(buffer.GetCapacity(), 8);
+
+    std::vector<std::int16_t> frames = MakeFrames(0, 6);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 6), 6);
+
+    // only the frames that fit are accepted, libspotify delivers the rest again
+    frames = MakeFrames(6, 6);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 6), 2);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[4], 4), 0);
+
+    std::vector<std::int16_t> out(16);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 5), 5);
+    BOOST_CHECK_EQUAL(out[9], 9);
+
+    frames = MakeFrames(8, 6);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 6), 5);
+    BOOST_CHECK_EQUAL(buffer.GetReadableFrames(), 8);
+
+    BOOST_REQUIRE_EQUAL(buffer.Read(&out[0], 8), 8);
+    for (int i = 0; i < 16; ++i)
+        BOOST_CHECK_EQUAL(out[i], 10 + i);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 8), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestFlush)
+{
+    spotify::AudioBuffer buffer(16);
+    std::vector<std::int16_t> frames = MakeFrames(0, 10);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 10), 10);
+
+    // libspotify delivers no frames after a seek
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), NULL, 0), 0);
+    BOOST_CHECK_EQUAL(buffer.GetReadableFrames(), 0);
+
+    frames = MakeFrames(100, 4);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 4), 4);
+
+    std::vector<std::int16_t> out(32);
+    BOOST_REQUIRE_EQUAL(buffer.Read(&out[0], 16), 4);
+    BOOST_CHECK_EQUAL(out[0], 200);
+}
+
+BOOST_AUTO_TEST_CASE(TestFormatChangeWaitsForDrain)
+{
+    spotify::AudioBuffer buffer(16);
+    std::vector<std::int16_t> frames = MakeFrames(0, 4);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 4), 4);
+
+    sp_audioformat mono = StereoFormat();
+    mono.channels = 1;
+    BOOST_CHECK_EQUAL(buffer.Write(mono, &frames[0], 8), 0);
+
+    std::vector<std::int16_t> out(32);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 16), 4);
+    BOOST_CHECK_EQUAL(buffer.Write(mono, &frames[0], 8), 8);
+    BOOST_CHECK_EQUAL(buffer.GetFormat().channels, 1);
+    BOOST_REQUIRE_EQUAL(buffer.Read(&out[0], 16), 8);
+    BOOST_CHECK_EQUAL(out[7], 7);
+}
+
+BOOST_AUTO_TEST_CASE(TestStatsAndCounters)
+{
+    spotify::AudioBuffer buffer(8);
+    std::vector<std::int16_t> frames = MakeFrames(0, 6);
+    std::vector<std::int16_t> out(32);
+    buffer.SetPlaying(true);
+
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 6), 6);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 6), 2);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 4), 4);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 6), 4);
+    // still dry, the same stretch of silence
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 6), 0);
+
+    sp_audio_buffer_stats stats = {0, 0};
+    buffer.GetStats(&stats);
+    BOOST_CHECK_EQUAL(stats.samples, 0);
+    BOOST_CHECK_EQUAL(stats.stutter, 1);
+
+    // stutter only covers the underruns since the previous call
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 3), 3);
+    buffer.GetStats(&stats);
+    BOOST_CHECK_EQUAL(stats.samples, 3);
+    BOOST_CHECK_EQUAL(stats.stutter, 0);
+
+    spotify::AudioBufferCounters counters = buffer.GetCounters();
+    BOOST_CHECK_EQUAL(counters.underruns, 1);
+    BOOST_CHECK_EQUAL(counters.backpressure, 1);
+    BOOST_CHECK_EQUAL(counters.peak_frames, 8);
+}
+
+BOOST_AUTO_TEST_CASE(TestIdleReadsReportNoStutter)
+{
+    spotify::AudioBuffer buffer(8);
+    std::vector<std::int16_t> frames = MakeFrames(0, 4);
+    std::vector<std::int16_t> out(32);
+    sp_audio_buffer_stats stats = {0, 0};
+
+    // a device polling before anything was delivered
+    for (int i = 0; i < 10; ++i)
+        BOOST_CHECK_EQUAL(buffer.Read(&out[0], 4), 0);
+    buffer.SetPlaying(true);
+    for (int i = 0; i < 10; ++i)
+        BOOST_CHECK_EQUAL(buffer.Read(&out[0], 4), 0);
+    buffer.GetStats(&stats);
+    BOOST_CHECK_EQUAL(stats.stutter, 0);
+
+    // paused, the device drains what is left and keeps polling
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 4), 4);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 2), 2);
+    buffer.SetPlaying(false);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 4), 2);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 4), 0);
+    buffer.GetStats(&stats);
+    BOOST_CHECK_EQUAL(stats.stutter, 0);
+
+    // a flush while playing, as after a seek, starts over
+    buffer.SetPlaying(true);
+    BOOST_CHECK_EQUAL(buffer.Write(StereoFormat(), &frames[0], 4), 4);
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 2), 2);
+    buffer.Flush();
+    BOOST_CHECK_EQUAL(buffer.Read(&out[0], 4), 0);
+    buffer.GetStats(&stats);
+    BOOST_CHECK_EQUAL(stats.stutter, 0);
+    BOOST_CHECK_EQUAL(buffer.GetCounters().underruns, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(AudioBufferPlaybackTests, FakeSessionFixture)
+
+BOOST_AUTO_TEST_CASE(TestMusicDeliveryFillsBuffer)
+{
+    boost::shared_ptr<spotify::AudioBuffer> buffer = session->GetAudioBuffer();
+    BOOST_REQUIRE(buffer);
+
+    boost::shared_ptr<spotify::Track> track = session->CreateTrack();
+    track->Load(fakespotify::GetTrack(0));
+    BOOST_REQUIRE(PumpUntil([&] { return !track->IsLoading(false); }));
+    BOOST_REQUIRE(session->Load(track) == SP_ERROR_OK);
+    session->Play();
+
+    // drain the buffer the way an audio thread would, the stand-in delivers consecutive sample values
+    const int wanted = 4 * static_cast<int>(buffer->GetCapacity());
+    std::vector<std::int16_t> out(1024 * 2);
+    int read = 0;
+    std::int16_t expected = 0;
+    bool continuous = true;
+    BOOST_REQUIRE(PumpUntil([&] {
+        int frames = buffer->Read(&out[0], 1024);
+        for (int i = 0; i < frames * 2; ++i) {
+            continuous = continuous && out[i] == expected;
+            expected = static_cast<std::int16_t>((expected + 1) & 0x7FFF);
+        }
+        read += frames;
+        return read >= wanted;
+    }, 10000));
+    BOOST_CHECK(continuous);
+
+    session->Stop();
+    fakespotify::Counters counters = fakespotify::GetCounters();
+    BOOST_CHECK_LT(counters.frames_consumed, counters.frames_delivered);
+    BOOST_CHECK_LE(counters.frames_consumed, read + buffer->GetCapacity());
+
+    // libspotify is told how full the buffer is after every delivery
+    BOOST_CHECK_LE(counters.buffered_samples, buffer->GetCapacity());
+    BOOST_CHECK_GT(buffer->GetCounters().backpressure, 0);
+    BOOST_CHECK_EQUAL(buffer->GetCounters().peak_frames, buffer->GetCapacity());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
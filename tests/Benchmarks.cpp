@@ -0,0 +1,421 @@
+// Micro benchmarks of the wrapper hot paths, run against the libspotify stand-in of tests/fakespotify.
+//
+// usage: SpotifyppBench [output.json]
+//
+// The results are written as JSON to the given file, or to stdout, so they can be compared between releases.
+#include <log4cplus/configurator.h>
+#include <log4cplus/loglevel.h>
+#include <log4cplus/logger.h>
+
+#include <cstdint>
+#include <cstddef>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <spotify/PlayListContainer.hpp>
+#include <spotify/AudioBuffer.hpp>
+#include <spotify/LibraryCache.hpp>
+#include <spotify/PlayList.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/Artist.hpp>
+#include <spotify/Album.hpp>
+#include <spotify/Image.hpp>
+#include <spotify/Track.hpp>
+#include <spotify/TrackQuery.hpp>
+#include <spotify/TrackSnapshot.hpp>
+
+#include "fakespotify/FakeSpotify.hpp"
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// Accumulates the time between Start and Stop, benchmark bodies use it to leave setup out of the measure
+class Stopwatch {
+  public:
+    Stopwatch() : elapsed_(Clock::duration::zero()) {}
+
+    void Start() { start_ = Clock::now(); }
+    void Stop() { elapsed_ += Clock::now() - start_; }
+
+    double GetSeconds() const { return std::chrono::duration<double>(elapsed_).count(); }
+
+  private:
+    Clock::time_point start_;
+    Clock::duration elapsed_;
+};
+
+struct Result {
+    std::string name;
+    long long iterations;
+    long long items;
+    double seconds;
+    std::uint64_t api_calls;
+};
+
+class Suite {
+  public:
+    // Runs body iterations times, each iteration processing items_per_iteration items
+    void Run(const std::string &name, long long iterations, long long items_per_iteration,
+             boost::function<void (Stopwatch &)> body) {
+        Stopwatch warmup;
+        body(warmup);
+
+        fakespotify::ResetCounters();
+        Stopwatch watch;
+        for (long long i = 0; i < iterations; ++i)
+            body(watch);
+
+        Result result = {name, iterations, iterations * items_per_iteration, watch.GetSeconds(),
+                         fakespotify::GetCounters().api_calls};
+        results_.push_back(result);
+        std::cerr << name << ": " << result.seconds * 1e9 / result.items << " ns/item" << std::endl;
+    }
+
+    void Write(std::ostream &out) const {
+        out << std::fixed << std::setprecision(3);
+        out << "{\n  \"suite\": \"SpotifyppBench\",\n  \"results\": [";
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const Result &r = results_[i];
+            out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+                << ", \"items\": " << r.items << ", \"seconds\": " << std::setprecision(6) << r.seconds
+                << std::setprecision(3) << ", \"ns_per_item\": " << r.seconds * 1e9 / r.items
+                << ", \"items_per_second\": " << r.items / r.seconds
+                << ", \"api_calls_per_item\": " << static_cast<double>(r.api_calls) / r.items << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+  private:
+    std::vector<Result> results_;
+};
+
+bool PumpUntil(boost::shared_ptr<spotify::Session> session, boost::function<bool ()> predicate) {
+    for (int i = 0; i < 10000; ++i) {
+        session->Update();
+        if (predicate())
+            return true;
+        boost::this_thread::sleep(boost::posix_time::millisec(1));
+    }
+    return false;
+}
+
+// Everything is available as soon as it is requested, so only the wrapper is measured
+fakespotify::CatalogConfig InstantCatalog(int num_playlists, int tracks_per_playlist, int num_folders) {
+    fakespotify::CatalogConfig catalog;
+    catalog.num_playlists = num_playlists;
+    catalog.tracks_per_playlist = tracks_per_playlist;
+    catalog.num_folders = num_folders;
+    catalog.playlists_per_folder = 2;
+    catalog.num_artists = 2000;
+    catalog.num_albums = 5000;
+    catalog.login_latency = 0;
+    catalog.container_latency = 0;
+    catalog.playlist_latency = 0;
+    catalog.metadata_latency = 0;
+    catalog.browse_latency = 0;
+    catalog.image_latency = 0;
+    return catalog;
+}
+
+boost::shared_ptr<spotify::Session> Login(const fakespotify::CatalogConfig &catalog,
+                                          const spotify::Config &config = spotify::Config()) {
+    fakespotify::Configure(catalog);
+
+    boost::shared_ptr<spotify::Session> session = spotify::Session::Create();
+    if (session->Initialise(config) != SP_ERROR_OK)
+        throw std::runtime_error("unable to initialise the session");
+    session->Login("bench", "bench");
+    if (!PumpUntil(session, [&] { return session->IsLoggedIn(); }))
+        throw std::runtime_error("unable to log in");
+    return session;
+}
+
+boost::shared_ptr<spotify::PlayListContainer> LoadContainer(boost::shared_ptr<spotify::Session> session) {
+    boost::shared_ptr<spotify::PlayListContainer> container = session->GetPlayListContainer();
+    if (!PumpUntil(session, [&] { return !container->IsLoading(true); }))
+        throw std::runtime_error("unable to load the container");
+    return container;
+}
+
+void BenchFactories(Suite *suite) {
+    const int batch = 1000;
+    boost::shared_ptr<spotify::Session> session = Login(InstantCatalog(1, 1, 0));
+
+    suite->Run("Session::CreatePlayList", 200, batch, [&](Stopwatch &watch) {
+        watch.Start();
+        for (int i = 0; i < batch; ++i)
+            session->CreatePlayList();
+        watch.Stop();
+    });
+    suite->Run("Session::CreateTrack", 200, batch, [&](Stopwatch &watch) {
+        watch.Start();
+        for (int i = 0; i < batch; ++i)
+            session->CreateTrack();
+        watch.Stop();
+    });
+    suite->Run("Session::CreateArtist", 200, batch, [&](Stopwatch &watch) {
+        watch.Start();
+        for (int i = 0; i < batch; ++i)
+            session->CreateArtist();
+        watch.Stop();
+    });
+    suite->Run("Session::CreateAlbum", 200, batch, [&](Stopwatch &watch) {
+        watch.Start();
+        for (int i = 0; i < batch; ++i)
+            session->CreateAlbum();
+        watch.Stop();
+    });
+    suite->Run("Session::CreateImage", 200, batch, [&](Stopwatch &watch) {
+        watch.Start();
+        for (int i = 0; i < batch; ++i)
+            session->CreateImage();
+        watch.Stop();
+    });
+    fakespotify::StopSessions();
+}
+
+void BenchLoadTracks(Suite *suite, int num_tracks, int iterations, bool lazy) {
+    spotify::Config config;
+    config.lazy_playlist_tracks = lazy;
+    boost::shared_ptr<spotify::Session> session = Login(InstantCatalog(1, num_tracks, 0), config);
+    sp_playlist *playlist = fakespotify::GetPlayList(0);
+
+    std::ostringstream name;
+    name << "PlayList::LoadTracks/" << num_tracks << (lazy ? "/lazy" : "");
+    suite->Run(name.str(), iterations, num_tracks, [&](Stopwatch &watch) {
+        boost::shared_ptr<spotify::PlayList> wrapper = session->CreatePlayList();
+        watch.Start();
+        wrapper->Load(playlist);
+        watch.Stop();
+    });
+    fakespotify::StopSessions();
+}
+
+void BenchContainerLoaded(Suite *suite, int num_playlists, int num_folders) {
+    boost::shared_ptr<spotify::Session> session = Login(InstantCatalog(num_playlists, 10, num_folders));
+    LoadContainer(session);
+    int num_entries = num_playlists + 2 * num_folders;
+
+    std::ostringstream name;
+    name << "PlayListContainer::OnContainerLoaded/" << num_playlists << "x" << num_folders;
+    suite->Run(name.str(), 20, num_entries, [&](Stopwatch &watch) {
+        // the container is already loaded, so container_loaded fires from the next Update
+        boost::shared_ptr<spotify::PlayListContainer> container = session->GetPlayListContainer();
+        watch.Start();
+        session->Update();
+        watch.Stop();
+        if (!container->HasChildren())
+            throw std::runtime_error("container_loaded was not fired");
+    });
+    fakespotify::StopSessions();
+}
+
+void BenchIsLoading(Suite *suite) {
+    const int num_playlists = 200;
+    const int tracks_per_playlist = 500;
+    boost::shared_ptr<spotify::Session> session = Login(InstantCatalog(num_playlists, tracks_per_playlist, 20));
+    boost::shared_ptr<spotify::PlayListContainer> container = LoadContainer(session);
+
+    std::ostringstream name;
+    name << "PlayListContainer::IsLoading(true)/" << num_playlists * tracks_per_playlist;
+    suite->Run(name.str(), 50, 1, [&](Stopwatch &watch) {
+        watch.Start();
+        bool loading = container->IsLoading(true);
+        watch.Stop();
+        if (loading)
+            throw std::runtime_error("container still loading");
+    });
+    fakespotify::StopSessions();
+}
+
+// commands posted from several threads and run in batches on the session thread
+void BenchPost(Suite *suite, int num_producers) {
+    const int commands_per_producer = 20000;
+    boost::shared_ptr<spotify::Session> session = Login(InstantCatalog(1, 1, 0));
+    session->RunInThread();
+
+    std::ostringstream name;
+    name << "Session::Post/producers=" << num_producers;
+    suite->Run(name.str(), 5, num_producers * commands_per_producer, [&](Stopwatch &watch) {
+        long long executed = 0;
+        watch.Start();
+        std::vector<boost::shared_ptr<boost::thread> > producers;
+        for (int p = 0; p < num_producers; ++p) {
+            producers.push_back(boost::make_shared<boost::thread>([&] {
+                for (int i = 0; i < commands_per_producer; ++i)
+                    session->Post([&] { ++executed; });
+            }));
+        }
+        for (int p = 0; p < num_producers; ++p)
+            producers[p]->join();
+        session->Execute<void>([] {}).get();
+        watch.Stop();
+        if (executed != num_producers * commands_per_producer)
+            throw std::runtime_error("commands were lost");
+    });
+    session->Quit();
+    fakespotify::StopSessions();
+}
+
+// music_delivery followed by the audio thread draining what it accepted, on a single thread
+void BenchAudioBuffer(Suite *suite) {
+    const int frames_per_delivery = 2048;
+    const int deliveries = 1000;
+    spotify::AudioBuffer buffer(65536);
+    std::vector<std::int16_t> in(frames_per_delivery * 2, 1);
+    std::vector<std::int16_t> out(frames_per_delivery * 2);
+    sp_audioformat format;
+    format.sample_type = SP_SAMPLETYPE_INT16_NATIVE_ENDIAN;
+    format.sample_rate = 44100;
+    format.channels = 2;
+
+    suite->Run("AudioBuffer::Write+Read", 20, deliveries * frames_per_delivery, [&](Stopwatch &watch) {
+        watch.Start();
+        for (int i = 0; i < deliveries; ++i) {
+            if (buffer.Write(format, &in[0], frames_per_delivery) != frames_per_delivery)
+                throw std::runtime_error("frames were rejected");
+            buffer.Read(&out[0], frames_per_delivery);
+        }
+        watch.Stop();
+    });
+}
+
+void BenchTrackWrappers(Suite *suite) {
+    const int num_tracks = 10000;
+    boost::shared_ptr<spotify::Session> session = Login(InstantCatalog(1, num_tracks, 0));
+    boost::shared_ptr<spotify::PlayList> playlist = session->CreatePlayList();
+    playlist->Load(fakespotify::GetPlayList(0));
+
+    suite->Run("Track::GetArtist+GetAlbum", 20, num_tracks, [&](Stopwatch &watch) {
+        watch.Start();
+        for (int i = 0; i < num_tracks; ++i) {
+            boost::shared_ptr<spotify::Track> track = playlist->GetTrack(i);
+            track->GetArtist(0);
+            track->GetAlbum();
+        }
+        watch.Stop();
+    });
+    playlist.reset();
+    fakespotify::StopSessions();
+}
+
+// the fields a playlist view shows, read row by row through the wrappers and in one pass into a snapshot
+void BenchSnapshot(Suite *suite, int num_tracks) {
+    boost::shared_ptr<spotify::Session> session = Login(InstantCatalog(1, num_tracks, 0));
+    boost::shared_ptr<spotify::PlayList> playlist = session->CreatePlayList();
+    playlist->Load(fakespotify::GetPlayList(0));
+
+    std::ostringstream rows;
+    rows << "Track::GetName+GetDuration+GetPopularity+GetDisc+GetArtist/" << num_tracks;
+    suite->Run(rows.str(), 5, num_tracks, [&](Stopwatch &watch) {
+        std::size_t chars = 0;
+        watch.Start();
+        for (int i = 0; i < num_tracks; ++i) {
+            boost::shared_ptr<spotify::Track> track = playlist->GetTrack(i);
+            chars += track->GetName().size() + track->GetArtist(0)->GetName().size();
+            chars += track->GetDuration() + track->GetPopularity() + track->GetDisc();
+        }
+        watch.Stop();
+        if (!chars)
+            throw std::runtime_error("no metadata");
+    });
+
+    std::ostringstream snapshot;
+    snapshot << "PlayList::Snapshot/" << num_tracks;
+    suite->Run(snapshot.str(), 5, num_tracks, [&](Stopwatch &watch) {
+        watch.Start();
+        boost::shared_ptr<const spotify::TrackSnapshot> columns = playlist->Snapshot();
+        watch.Stop();
+        if (columns->GetNumTracks() != num_tracks)
+            throw std::runtime_error("rows are missing");
+    });
+
+    // a smart playlist: a few conditions and the 100 first rows of a two key sort
+    boost::shared_ptr<const spotify::TrackSnapshot> columns = playlist->Snapshot();
+    spotify::TrackQuery query;
+    query.Where(spotify::TrackQuery::DURATION, 150000, 300000)
+         .Where(spotify::TrackQuery::POPULARITY, 20, 100)
+         .Where(spotify::TrackQuery::NAME, spotify::TrackQuery::SUBSTRING, "track 1")
+         .OrderBy(spotify::TrackQuery::BY_POPULARITY, true)
+         .OrderBy(spotify::TrackQuery::BY_NAME)
+         .Limit(100);
+    std::ostringstream run;
+    run << "TrackQuery::Run/" << num_tracks;
+    suite->Run(run.str(), 20, num_tracks, [&](Stopwatch &watch) {
+        watch.Start();
+        std::vector<int> rows = query.Run(*columns);
+        watch.Stop();
+        if (rows.empty())
+            throw std::runtime_error("nothing matched");
+    });
+
+    // the cold start of the library: the tracks of the previous run mapped back from the cache
+    boost::filesystem::path directory = boost::filesystem::temp_directory_path()
+                                      / boost::filesystem::unique_path("libspotifypp-bench-%%%%-%%%%");
+    boost::filesystem::create_directories(directory);
+    spotify::LibraryCache cache(directory.string());
+    if (!cache.WriteTracks(playlist->GetLink(), *columns))
+        throw std::runtime_error("cache not written");
+    std::ostringstream cached;
+    cached << "LibraryCache::ReadTracks/" << num_tracks;
+    suite->Run(cached.str(), 20, num_tracks, [&](Stopwatch &watch) {
+        watch.Start();
+        boost::shared_ptr<const spotify::TrackSnapshot> read = cache.ReadTracks(playlist->GetLink());
+        watch.Stop();
+        if (!read || read->GetNumTracks() != num_tracks)
+            throw std::runtime_error("cache not read");
+    });
+    boost::filesystem::remove_all(directory);
+    playlist.reset();
+    fakespotify::StopSessions();
+}
+}
+
+int main(int argc, char *argv[]) {
+    log4cplus::BasicConfigurator config;
+    if (boost::filesystem::exists("logging.conf")) {
+        log4cplus::PropertyConfigurator::doConfigure("logging.conf");
+    } else {
+        config.configure();
+        log4cplus::Logger::getRoot().setLogLevel(log4cplus::WARN_LOG_LEVEL);
+    }
+
+    Suite suite;
+    try {
+        BenchFactories(&suite);
+        BenchLoadTracks(&suite, 10000, 20, false);
+        BenchLoadTracks(&suite, 100000, 5, false);
+        BenchLoadTracks(&suite, 100000, 5, true);
+        BenchContainerLoaded(&suite, 2000, 500);
+        BenchIsLoading(&suite);
+        BenchTrackWrappers(&suite);
+        BenchSnapshot(&suite, 50000);
+        BenchAudioBuffer(&suite);
+        BenchPost(&suite, 1);
+        BenchPost(&suite, 4);
+    } catch(const std::exception &e) {
+        std::cerr << "benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (argc > 1) {
+        std::ofstream out(argv[1]);
+        suite.Write(out);
+    } else {
+        suite.Write(std::cout);
+    }
+    return 0;
+}
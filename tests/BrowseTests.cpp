@@ -0,0 +1,364 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include <spotify/Album.hpp>
+#include <spotify/AlbumBrowse.hpp>
+#include <spotify/Artist.hpp>
+#include <spotify/ArtistBrowse.hpp>
+#include <spotify/BrowseBatch.hpp>
+#include <spotify/BrowseCache.hpp>
+#include <spotify/Error.hpp>
+#include <spotify/PlayList.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/Track.hpp>
+#include <spotify/WhenAll.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+namespace {
+template <typename T>
+bool IsReady(const std::future<T> &future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+fakespotify::CatalogConfig FailingBrowses() {
+    fakespotify::CatalogConfig catalog;
+    catalog.browse_error_every = 1;
+    return catalog;
+}
+
+// the starred playlist loaded, its tracks lead to the artists and albums browsed
+struct BrowseFixture : public FakeSessionFixture {
+    explicit BrowseFixture(const fakespotify::CatalogConfig &catalog = fakespotify::CatalogConfig(),
+                           ConfigHook configure = ConfigHook())
+        : FakeSessionFixture(catalog, configure) {
+        starred = session->GetStarredPlayList();
+        BOOST_REQUIRE(PumpUntil([&] { return !starred->IsLoading(true); }));
+    }
+
+    std::vector<boost::shared_ptr<spotify::Album> > GetAlbums() {
+        std::vector<boost::shared_ptr<spotify::Album> > albums;
+        for (int i = 0; i < starred->GetNumTracks(); ++i)
+            albums.push_back(starred->GetTrack(i)->GetAlbum());
+        return albums;
+    }
+
+    boost::shared_ptr<spotify::PlayList> starred;
+};
+
+struct FailingBrowseFixture : public BrowseFixture {
+    FailingBrowseFixture() : BrowseFixture(FailingBrowses()) {}
+};
+
+// a budget no browse fits in
+struct TinyCacheFixture : public BrowseFixture {
+    TinyCacheFixture() : BrowseFixture(fakespotify::CatalogConfig(), [](spotify::Config &config) {
+        config.browse_cache_bytes = 1;
+    }) {}
+};
+
+// completed browses expire at once
+struct NoReuseFixture : public BrowseFixture {
+    NoReuseFixture() : BrowseFixture(fakespotify::CatalogConfig(), [](spotify::Config &config) {
+        config.browse_cache_seconds = 0;
+    }) {}
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(BrowseTests, BrowseFixture)
+
+BOOST_AUTO_TEST_CASE(TestArtistBrowseAsync)
+{
+    std::future<boost::shared_ptr<spotify::ArtistBrowse> > result = starred->GetTrack(0)->GetArtist(0)->BrowseAsync();
+    BOOST_REQUIRE(PumpUntil([&] { return IsReady(result); }));
+
+    boost::shared_ptr<spotify::ArtistBrowse> browse = result.get();
+    BOOST_REQUIRE(browse);
+    BOOST_CHECK_EQUAL(browse->GetError(), SP_ERROR_OK);
+    BOOST_CHECK(!browse->IsLoading());
+    BOOST_CHECK(browse->GetNumAlbums() > 0);
+    BOOST_CHECK(browse->GetArtist() == starred->GetTrack(0)->GetArtist(0));
+}
+
+BOOST_AUTO_TEST_CASE(TestAlbumBrowseContinuation)
+{
+    int calls = 0;
+    sp_error error = SP_ERROR_IS_LOADING;
+    boost::shared_ptr<spotify::AlbumBrowse> completed;
+    // nothing but the continuation holds the browse
+    starred->GetTrack(0)->GetAlbum()->BrowseAsync([&](boost::shared_ptr<spotify::AlbumBrowse> browse, sp_error e) {
+        ++calls;
+        error = e;
+        completed = browse;
+    });
+    BOOST_REQUIRE(PumpUntil([&] { return calls > 0; }));
+    BOOST_CHECK_EQUAL(calls, 1);
+    BOOST_CHECK_EQUAL(error, SP_ERROR_OK);
+    BOOST_REQUIRE(completed);
+    BOOST_CHECK(completed->GetNumTracks() > 0);
+
+    // once complete, a continuation runs at once
+    int late = 0;
+    completed->connectToOnComplete([&](boost::shared_ptr<spotify::AlbumBrowse> browse, sp_error e) {
+        BOOST_CHECK(browse == completed);
+        ++late;
+    });
+    BOOST_CHECK_EQUAL(late, 1);
+    session->Update();
+    BOOST_CHECK_EQUAL(calls, 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestWhenAll)
+{
+    std::vector<boost::shared_ptr<spotify::ArtistBrowse> > browses;
+    for (int i = 0; i < starred->GetNumTracks(); ++i)
+        browses.push_back(starred->GetTrack(i)->GetArtist(0)->Browse());
+
+    std::future<std::vector<boost::shared_ptr<spotify::ArtistBrowse> > > all = spotify::WhenAll(browses);
+    BOOST_REQUIRE(PumpUntil([&] { return IsReady(all); }));
+
+    std::vector<boost::shared_ptr<spotify::ArtistBrowse> > completed = all.get();
+    BOOST_REQUIRE_EQUAL(completed.size(), browses.size());
+    for (std::size_t i = 0; i < completed.size(); ++i) {
+        BOOST_CHECK(completed[i] == browses[i]);
+        BOOST_CHECK_EQUAL(completed[i]->GetError(), SP_ERROR_OK);
+    }
+
+    // nothing to wait for
+    std::vector<boost::shared_ptr<spotify::AlbumBrowse> > none;
+    BOOST_CHECK(IsReady(spotify::WhenAll(none)));
+}
+
+BOOST_AUTO_TEST_CASE(TestBrowseJoinsRequestInFlight)
+{
+    boost::shared_ptr<spotify::Artist> artist = starred->GetTrack(0)->GetArtist(0);
+    boost::shared_ptr<spotify::ArtistBrowse> first = artist->Browse();
+    boost::shared_ptr<spotify::ArtistBrowse> second = artist->Browse();
+    BOOST_CHECK(first == second);
+    // another type is another request
+    boost::shared_ptr<spotify::ArtistBrowse> no_tracks = artist->Browse(SP_ARTISTBROWSE_NO_TRACKS);
+    BOOST_CHECK(no_tracks != first);
+
+    spotify::BrowseCacheStats stats = session->GetBrowseCacheStats();
+    BOOST_CHECK_EQUAL(stats.misses, 2u);
+    BOOST_CHECK_EQUAL(stats.joins, 1u);
+    BOOST_CHECK_EQUAL(stats.pending, 2u);
+
+    BOOST_REQUIRE(PumpUntil([&] { return session->GetBrowseCacheStats().pending == 0; }));
+    BOOST_CHECK_EQUAL(first->GetError(), SP_ERROR_OK);
+    BOOST_CHECK_EQUAL(no_tracks->GetNumTracks(), 0);
+    BOOST_CHECK(first->GetNumTracks() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestBrowseReusesCompleted)
+{
+    boost::shared_ptr<spotify::Album> album = starred->GetTrack(0)->GetAlbum();
+    std::future<boost::shared_ptr<spotify::AlbumBrowse> > result = album->BrowseAsync();
+    BOOST_REQUIRE(PumpUntil([&] { return IsReady(result); }));
+    boost::shared_ptr<spotify::AlbumBrowse> browse = result.get();
+
+    spotify::BrowseCacheStats stats = session->GetBrowseCacheStats();
+    BOOST_CHECK_EQUAL(stats.entries, 1u);
+    BOOST_CHECK(stats.bytes > browse->GetReview().size());
+
+    // kept even once nobody else holds it
+    const spotify::AlbumBrowse *kept = browse.get();
+    browse.reset();
+    BOOST_CHECK(album->Browse().get() == kept);
+    BOOST_CHECK_EQUAL(session->GetBrowseCacheStats().hits, 1u);
+    BOOST_CHECK_EQUAL(session->GetBrowseCacheStats().misses, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(TestCachedBrowsesReleaseSession)
+{
+    std::future<boost::shared_ptr<spotify::ArtistBrowse> > artist = starred->GetTrack(0)->GetArtist(0)->BrowseAsync();
+    std::future<boost::shared_ptr<spotify::AlbumBrowse> > album = starred->GetTrack(0)->GetAlbum()->BrowseAsync();
+    BOOST_REQUIRE(PumpUntil([&] { return IsReady(artist) && IsReady(album); }));
+    BOOST_CHECK(artist.get()->GetArtist());
+    BOOST_CHECK(album.get()->GetAlbum());
+    BOOST_REQUIRE_EQUAL(session->GetBrowseCacheStats().entries, 2u);
+
+    // the cache of the session holds the browses, they must not hold the session in turn
+    boost::weak_ptr<spotify::Session> released = session;
+    starred.reset();
+    session.reset();
+    BOOST_CHECK(released.expired());
+}
+
+BOOST_AUTO_TEST_CASE(TestShutdownAbandonsBrowsesInFlight)
+{
+    boost::shared_ptr<int> token = boost::make_shared<int>(0);
+    boost::weak_ptr<int> released_token = token;
+    int calls = 0;
+    // nothing but their continuations hold the browses
+    boost::weak_ptr<spotify::ArtistBrowse> artist = starred->GetTrack(0)->GetArtist(0)->BrowseAsync(
+        [token, &calls](boost::shared_ptr<spotify::ArtistBrowse>, sp_error) { ++calls; });
+    boost::weak_ptr<spotify::AlbumBrowse> album = starred->GetTrack(0)->GetAlbum()->BrowseAsync(
+        [token, &calls](boost::shared_ptr<spotify::AlbumBrowse>, sp_error) { ++calls; });
+    std::future<boost::shared_ptr<spotify::AlbumBrowse> > result = starred->GetTrack(0)->GetAlbum()->BrowseAsync();
+    token.reset();
+    BOOST_REQUIRE(!artist.expired() && !album.expired());
+
+    // the session goes before the browses complete
+    starred.reset();
+    session.reset();
+    BOOST_CHECK(artist.expired());
+    BOOST_CHECK(album.expired());
+    BOOST_CHECK(released_token.expired());
+    BOOST_CHECK_EQUAL(calls, 0);
+    BOOST_CHECK_THROW(result.get(), std::future_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestBrowseBatchCompletionOrder)
+{
+    typedef spotify::BrowseBatch<spotify::Album> Batch;
+    std::vector<boost::shared_ptr<spotify::Album> > albums = GetAlbums();
+    BOOST_REQUIRE(albums.size() > 2);
+
+    std::vector<int> reported(albums.size(), 0);
+    bool done = false;
+    boost::shared_ptr<Batch> batch = Batch::Start(albums, 2, Batch::COMPLETION_ORDER,
+        [&](int index, boost::shared_ptr<spotify::AlbumBrowse> browse, sp_error error) {
+            ++reported[index];
+            BOOST_CHECK_EQUAL(error, SP_ERROR_OK);
+            BOOST_CHECK(browse->GetAlbum() == albums[index]);
+        }, [&] { done = true; });
+
+    int most_in_flight = 0;
+    BOOST_REQUIRE(PumpUntil([&] {
+        most_in_flight = std::max(most_in_flight, batch->GetNumInFlight());
+        return done;
+    }));
+    BOOST_CHECK_EQUAL(most_in_flight, 2);
+    BOOST_CHECK_EQUAL(batch->GetNumReported(), batch->GetNumItems());
+    BOOST_CHECK_EQUAL(batch->GetNumFailed(), 0);
+    for (std::size_t i = 0; i < reported.size(); ++i)
+        BOOST_CHECK_EQUAL(reported[i], 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestBrowseBatchListOrder)
+{
+    typedef spotify::BrowseBatch<spotify::Artist> Batch;
+    std::vector<boost::shared_ptr<spotify::Artist> > artists;
+    for (int i = 0; i < starred->GetNumTracks(); ++i)
+        artists.push_back(starred->GetTrack(i)->GetArtist(0));
+    // the first already complete in the cache, reported at once
+    boost::shared_ptr<spotify::ArtistBrowse> first = artists[0]->Browse();
+    BOOST_REQUIRE(PumpUntil([&] { return !first->IsLoading(); }));
+
+    std::vector<int> order;
+    boost::shared_ptr<Batch> batch = Batch::Start(artists, 3, Batch::LIST_ORDER,
+        [&](int index, boost::shared_ptr<spotify::ArtistBrowse>, sp_error) { order.push_back(index); });
+    BOOST_CHECK_EQUAL(order.size(), 1u);
+
+    BOOST_REQUIRE(PumpUntil([&] { return batch->IsDone(); }));
+    BOOST_REQUIRE_EQUAL(order.size(), artists.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+        BOOST_CHECK_EQUAL(order[i], static_cast<int>(i));
+}
+
+BOOST_AUTO_TEST_CASE(TestBrowseBatchCancel)
+{
+    typedef spotify::BrowseBatch<spotify::Album> Batch;
+    std::vector<boost::shared_ptr<spotify::Album> > albums = GetAlbums();
+    int reported = 0;
+    bool done = false;
+    boost::shared_ptr<Batch> batch = Batch::Start(albums, 1, Batch::COMPLETION_ORDER,
+        [&](int, boost::shared_ptr<spotify::AlbumBrowse>, sp_error) { ++reported; }, [&] { done = true; });
+    batch->Cancel();
+    BOOST_CHECK(!done);
+
+    // the browse in flight is still reported, no other is started
+    BOOST_REQUIRE(PumpUntil([&] { return done; }));
+    BOOST_CHECK_EQUAL(reported, 1);
+    BOOST_CHECK_EQUAL(batch->GetNumInFlight(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(TinyCacheTests, TinyCacheFixture)
+
+BOOST_AUTO_TEST_CASE(TestBrowseOverBudgetIsEvicted)
+{
+    boost::shared_ptr<spotify::Album> album = starred->GetTrack(0)->GetAlbum();
+    boost::shared_ptr<spotify::AlbumBrowse> browse = album->Browse();
+    BOOST_REQUIRE(PumpUntil([&] { return session->GetBrowseCacheStats().pending == 0; }));
+
+    spotify::BrowseCacheStats stats = session->GetBrowseCacheStats();
+    BOOST_CHECK_EQUAL(stats.evictions, 1u);
+    BOOST_CHECK_EQUAL(stats.entries, 0u);
+    BOOST_CHECK_EQUAL(stats.bytes, 0u);
+    BOOST_CHECK(album->Browse() != browse);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(NoReuseTests, NoReuseFixture)
+
+BOOST_AUTO_TEST_CASE(TestExpiredBrowseIsRequestedAgain)
+{
+    boost::shared_ptr<spotify::Artist> artist = starred->GetTrack(0)->GetArtist(0);
+    boost::shared_ptr<spotify::ArtistBrowse> browse = artist->Browse();
+    // joined while in flight, whatever the time to live
+    BOOST_CHECK(artist->Browse() == browse);
+    BOOST_REQUIRE(PumpUntil([&] { return session->GetBrowseCacheStats().pending == 0; }));
+
+    BOOST_CHECK(artist->Browse() != browse);
+    BOOST_CHECK_EQUAL(session->GetBrowseCacheStats().misses, 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(FailingBrowseTests, FailingBrowseFixture)
+
+BOOST_AUTO_TEST_CASE(TestBrowseError)
+{
+    boost::shared_ptr<spotify::Album> album = starred->GetTrack(0)->GetAlbum();
+    std::future<boost::shared_ptr<spotify::AlbumBrowse> > result = album->BrowseAsync();
+    boost::shared_ptr<spotify::AlbumBrowse> failed = album->Browse();
+    sp_error artist_error = SP_ERROR_OK;
+    starred->GetTrack(0)->GetArtist(0)->BrowseAsync([&](boost::shared_ptr<spotify::ArtistBrowse>, sp_error error) {
+        artist_error = error;
+    });
+
+    BOOST_REQUIRE(PumpUntil([&] { return IsReady(result) && artist_error != SP_ERROR_OK; }));
+    BOOST_CHECK_EQUAL(failed->GetError(), SP_ERROR_OTHER_TRANSIENT);
+    BOOST_CHECK_EQUAL(artist_error, SP_ERROR_OTHER_TRANSIENT);
+
+    // the future carries the error rather than the browse
+    BOOST_CHECK_EXCEPTION(result.get(), spotify::Error, [](const spotify::Error &error) {
+        return error.GetError() == SP_ERROR_OTHER_TRANSIENT;
+    });
+    std::future<boost::shared_ptr<spotify::ArtistBrowse> > artist = starred->GetTrack(0)->GetArtist(0)->BrowseAsync();
+    BOOST_REQUIRE(PumpUntil([&] { return IsReady(artist); }));
+    BOOST_CHECK_THROW(artist.get(), spotify::Error);
+
+    // a failed browse is not kept, the next one asks again
+    BOOST_CHECK_EQUAL(session->GetBrowseCacheStats().entries, 0u);
+    BOOST_CHECK(starred->GetTrack(0)->GetAlbum()->Browse() != failed);
+}
+
+BOOST_AUTO_TEST_CASE(TestBrowseBatchReportsFailures)
+{
+    typedef spotify::BrowseBatch<spotify::Album> Batch;
+    std::vector<boost::shared_ptr<spotify::Album> > albums = GetAlbums();
+    std::vector<sp_error> errors;
+    boost::shared_ptr<Batch> batch = Batch::Start(albums, 4, Batch::LIST_ORDER,
+        [&](int, boost::shared_ptr<spotify::AlbumBrowse> browse, sp_error error) {
+            BOOST_CHECK_EQUAL(browse->GetError(), error);
+            errors.push_back(error);
+        });
+
+    BOOST_REQUIRE(PumpUntil([&] { return batch->IsDone(); }));
+    BOOST_REQUIRE_EQUAL(errors.size(), albums.size());
+    BOOST_CHECK_EQUAL(batch->GetNumFailed(), batch->GetNumItems());
+    for (std::size_t i = 0; i < errors.size(); ++i)
+        BOOST_CHECK_EQUAL(errors[i], SP_ERROR_OTHER_TRANSIENT);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
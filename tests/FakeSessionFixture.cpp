@@ -0,0 +1,35 @@
+#include "FakeSessionFixture.hpp"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include <chrono>
+
+FakeSessionFixture::FakeSessionFixture(const fakespotify::CatalogConfig &catalog, ConfigHook configure) {
+    fakespotify::Configure(catalog);
+    if (configure)
+        configure(configuration);
+
+    session = spotify::Session::Create();
+    BOOST_REQUIRE(session->Initialise(configuration) == SP_ERROR_OK);
+    session->Login(username.c_str(), password.c_str());
+    BOOST_REQUIRE(session->WaitForLogin(spotify::Session::Deadline::clock::now() + std::chrono::seconds(2)));
+}
+
+FakeSessionFixture::~FakeSessionFixture() {
+    // the session never releases its sp_session, stop the stand-in before the wrapper goes away
+    fakespotify::StopSessions();
+}
+
+bool FakeSessionFixture::PumpUntil(boost::function<bool ()> predicate, int timeout) {
+    boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time()
+                                      + boost::posix_time::millisec(timeout);
+    while (boost::posix_time::microsec_clock::universal_time() < deadline) {
+        session->Update();
+        if (predicate())
+            return true;
+        boost::this_thread::sleep(boost::posix_time::millisec(1));
+    }
+    return false;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+
+#include <spotify/Session.hpp>
+
+#include "fakespotify/FakeSpotify.hpp"
+#include "appkeys.hpp"
+
+// Logs a session into the libspotify stand-in, derived fixtures pass their own catalog and may adjust the session
+// configuration before it is initialised
+struct FakeSessionFixture : public SpotifyBasicFixture {
+    typedef boost::function<void (spotify::Config &)> ConfigHook;
+
+    explicit FakeSessionFixture(const fakespotify::CatalogConfig &catalog = fakespotify::CatalogConfig(),
+                                ConfigHook configure = ConfigHook());
+    ~FakeSessionFixture();
+
+    // calls Session::Update until the predicate holds, false if the timeout (in ms) expires first
+    bool PumpUntil(boost::function<bool ()> predicate, int timeout = 2000);
+
+    boost::shared_ptr<spotify::Session> session;
+};
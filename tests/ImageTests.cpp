@@ -0,0 +1,168 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <cstddef>
+
+#include <spotify/Album.hpp>
+#include <spotify/Image.hpp>
+#include <spotify/ImageCache.hpp>
+#include <spotify/PlayList.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/Track.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+namespace {
+fakespotify::CatalogConfig NoCallbackWhenLoaded() {
+    fakespotify::CatalogConfig catalog;
+    catalog.image_callback_when_loaded = false;
+    return catalog;
+}
+
+// the album of the first starred track loaded, its cover is the image requested
+struct ImageFixture : public FakeSessionFixture {
+    explicit ImageFixture(const fakespotify::CatalogConfig &catalog = fakespotify::CatalogConfig(),
+                          ConfigHook configure = ConfigHook())
+        : FakeSessionFixture(catalog, configure) {
+        boost::shared_ptr<spotify::PlayList> starred = session->GetStarredPlayList();
+        BOOST_REQUIRE(PumpUntil([&] { return !starred->IsLoading(true); }));
+        album = starred->GetTrack(0)->GetAlbum();
+        BOOST_REQUIRE(PumpUntil([&] { return !album->IsLoading(); }));
+    }
+
+    boost::shared_ptr<spotify::Album> album;
+};
+
+// a budget no image fits in
+struct TinyImageCacheFixture : public ImageFixture {
+    TinyImageCacheFixture() : ImageFixture(fakespotify::CatalogConfig(), [](spotify::Config &config) {
+        config.image_cache_bytes = 1;
+    }) {}
+};
+
+// nothing kept, and no callback for an image libspotify already has
+struct NoCallbackFixture : public ImageFixture {
+    NoCallbackFixture() : ImageFixture(NoCallbackWhenLoaded(), [](spotify::Config &config) {
+        config.image_cache_bytes = 1;
+    }) {}
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(ImageTests, ImageFixture)
+
+BOOST_AUTO_TEST_CASE(TestCoverIsRequestedOnce)
+{
+    boost::shared_ptr<spotify::Image> image = album->GetImage();
+    BOOST_REQUIRE(image);
+    BOOST_CHECK(album->GetImage() == image);
+
+    std::size_t size = 42;
+    BOOST_CHECK(!image->GetData(&size));
+    BOOST_CHECK_EQUAL(size, 0u);
+    BOOST_CHECK(!image->GetDataView());
+
+    int calls = 0;
+    image->connectToOnLoaded([&](boost::shared_ptr<spotify::Image> loaded, sp_error error) {
+        BOOST_CHECK(loaded == image);
+        BOOST_CHECK_EQUAL(error, SP_ERROR_OK);
+        ++calls;
+    });
+    BOOST_REQUIRE(PumpUntil([&] { return calls > 0; }));
+    BOOST_CHECK_EQUAL(calls, 1);
+    BOOST_CHECK(image->GetData(&size));
+    BOOST_CHECK_EQUAL(size, 4096u);
+
+    // kept once nobody else holds it
+    const spotify::Image *kept = image.get();
+    image.reset();
+    BOOST_CHECK(album->GetImage().get() == kept);
+
+    spotify::ImageCacheStats stats = session->GetImageCacheStats();
+    BOOST_CHECK_EQUAL(stats.misses, 1u);
+    BOOST_CHECK_EQUAL(stats.joins, 1u);
+    BOOST_CHECK_EQUAL(stats.hits, 1u);
+    BOOST_CHECK_EQUAL(stats.entries, 1u);
+    BOOST_CHECK(stats.bytes > 4096u);
+    BOOST_CHECK_EQUAL(stats.pending, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(TestDataViewOutlivesImage)
+{
+    boost::shared_ptr<spotify::Image> image = album->GetImage();
+    BOOST_REQUIRE(PumpUntil([&] { return !image->IsLoading(); }));
+
+    std::size_t size = 0;
+    const void *data = image->GetData(&size);
+    boost::shared_ptr<const spotify::ImageData> view = image->GetDataView();
+    BOOST_REQUIRE(view);
+    // the bytes of libspotify, not a copy
+    BOOST_CHECK_EQUAL(view->GetData(), data);
+    BOOST_CHECK_EQUAL(view->GetSize(), size);
+    BOOST_CHECK_EQUAL(view->GetFormat(), SP_IMAGE_FORMAT_JPEG);
+
+    image->Unload();
+    image.reset();
+    session->Logout();
+    BOOST_REQUIRE(PumpUntil([&] { return session->GetImageCacheStats().entries == 0; }));
+
+    const byte *bytes = static_cast<const byte *>(view->GetData());
+    BOOST_CHECK_EQUAL(bytes[1] - bytes[0], 1);
+    BOOST_CHECK_EQUAL(static_cast<byte>(bytes[size - 1] - bytes[0]), static_cast<byte>(size - 1));
+}
+
+BOOST_AUTO_TEST_CASE(TestCachedImageReleasesSession)
+{
+    boost::shared_ptr<spotify::Image> image = album->GetImage();
+    BOOST_REQUIRE(PumpUntil([&] { return session->GetImageCacheStats().entries == 1; }));
+
+    // the cache of the session holds the image, it must not hold the session in turn
+    boost::weak_ptr<spotify::Session> released = session;
+    image.reset();
+    album.reset();
+    session.reset();
+    BOOST_CHECK(released.expired());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(TinyImageCacheTests, TinyImageCacheFixture)
+
+BOOST_AUTO_TEST_CASE(TestImageOverBudgetIsEvicted)
+{
+    boost::shared_ptr<spotify::Image> image = album->GetImage();
+    BOOST_REQUIRE(PumpUntil([&] { return session->GetImageCacheStats().pending == 0; }));
+
+    spotify::ImageCacheStats stats = session->GetImageCacheStats();
+    BOOST_CHECK_EQUAL(stats.evictions, 1u);
+    BOOST_CHECK_EQUAL(stats.entries, 0u);
+    BOOST_CHECK_EQUAL(stats.bytes, 0u);
+    BOOST_CHECK(album->GetImage() != image);
+    BOOST_CHECK_EQUAL(session->GetImageCacheStats().misses, 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(NoCallbackImageTests, NoCallbackFixture)
+
+BOOST_AUTO_TEST_CASE(TestImageLoadedWhenRequestedCompletes)
+{
+    boost::shared_ptr<spotify::Image> image = album->GetImage();
+    BOOST_REQUIRE(PumpUntil([&] { return session->GetImageCacheStats().pending == 0; }));
+    BOOST_REQUIRE(!image->IsLoading());
+
+    // evicted, a new wrapper over the image libspotify still holds loaded
+    boost::shared_ptr<spotify::Image> again = album->GetImage();
+    BOOST_REQUIRE(again != image);
+    BOOST_CHECK(!again->IsLoading());
+    BOOST_CHECK_EQUAL(session->GetImageCacheStats().pending, 0u);
+
+    int calls = 0;
+    again->connectToOnLoaded([&](boost::shared_ptr<spotify::Image> loaded, sp_error error) {
+        BOOST_CHECK(loaded == again);
+        BOOST_CHECK_EQUAL(error, SP_ERROR_OK);
+        ++calls;
+    });
+    BOOST_CHECK_EQUAL(calls, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,219 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <spotify/LibraryCache.hpp>
+#include <spotify/PlayList.hpp>
+#include <spotify/PlayListContainer.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/TrackSnapshot.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+namespace {
+const char *kPlayList4 = "spotify:user:fake:playlist:4";
+
+// a directory of its own for each test, created before the session and removed after it
+struct CacheDirectory {
+    CacheDirectory() : directory((boost::filesystem::temp_directory_path()
+                                  / boost::filesystem::unique_path("libspotifypp-%%%%-%%%%")).string()) {
+        boost::filesystem::create_directories(directory);
+    }
+    ~CacheDirectory() {
+        boost::filesystem::remove_all(directory);
+    }
+
+    std::vector<std::string> ListFiles(const std::string &prefix) {
+        std::vector<std::string> files;
+        for (boost::filesystem::directory_iterator it(directory), end; it != end; ++it) {
+            if (it->path().filename().string().compare(0, prefix.size(), prefix) == 0)
+                files.push_back(it->path().string());
+        }
+        return files;
+    }
+
+    std::string directory;
+};
+
+struct LibraryCacheFixture : public CacheDirectory, public FakeSessionFixture {
+    LibraryCacheFixture() : FakeSessionFixture(fakespotify::CatalogConfig(), [this](spotify::Config &config) {
+        config.cache_location = directory.c_str();
+        config.cache_library = true;
+    }) {
+        container = session->GetPlayListContainer();
+        BOOST_REQUIRE(PumpUntil([&] { return !container->IsLoading(true); }));
+        // the cache is posted by the Update after the loads complete, then written by its thread
+        session->Update();
+        session->GetLibraryCache()->Flush();
+    }
+
+    boost::shared_ptr<spotify::PlayListContainer> container;
+};
+
+bool HasLink(const std::vector<spotify::LibraryCache::Entry> &entries, const std::string &link) {
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].link == link)
+            return true;
+    }
+    return false;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(LibraryCacheTests, LibraryCacheFixture)
+
+BOOST_AUTO_TEST_CASE(TestTreeMatchesContainer)
+{
+    // read as an application would on the next start, before logging in
+    spotify::LibraryCache cache(directory);
+    std::vector<spotify::LibraryCache::Entry> entries;
+    BOOST_REQUIRE(cache.ReadTree(&entries));
+
+    // two folders of two playlists, then the remaining six playlists
+    BOOST_REQUIRE_EQUAL(entries.size(), 14u);
+    BOOST_CHECK_EQUAL(entries[0].type, SP_PLAYLIST_TYPE_START_FOLDER);
+    BOOST_CHECK_EQUAL(entries[0].name, "Folder 0");
+    BOOST_CHECK_EQUAL(entries[4].group_id, 1001u);
+    BOOST_CHECK_EQUAL(entries[2].type, SP_PLAYLIST_TYPE_PLAYLIST);
+    BOOST_CHECK_EQUAL(entries[2].name, "Playlist 1");
+    BOOST_CHECK_EQUAL(entries[3].type, SP_PLAYLIST_TYPE_END_FOLDER);
+    BOOST_CHECK_EQUAL(entries[8].name, "Playlist 4");
+    BOOST_CHECK_EQUAL(entries[8].link, kPlayList4);
+
+    // the links lead back to the live playlists
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].type == SP_PLAYLIST_TYPE_PLAYLIST)
+            BOOST_CHECK_EQUAL(container->FindByLink(entries[i].link)->GetName(), entries[i].name);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTracksMatchPlayList)
+{
+    boost::shared_ptr<spotify::PlayList> playlist = container->FindByLink(kPlayList4);
+    BOOST_REQUIRE(playlist);
+
+    // written again once the names of the artists and albums that were loading have arrived
+    spotify::LibraryCache cache(directory);
+    boost::shared_ptr<const spotify::TrackSnapshot> cached;
+    BOOST_REQUIRE(PumpUntil([&] {
+        session->GetLibraryCache()->Flush();
+        cached = cache.ReadTracks(kPlayList4);
+        return cached && cached->GetNumLoading() == 0;
+    }));
+    boost::shared_ptr<const spotify::TrackSnapshot> live = playlist->Snapshot();
+    BOOST_REQUIRE_EQUAL(cached->GetNumTracks(), live->GetNumTracks());
+    BOOST_REQUIRE_EQUAL(cached->GetNumArtists(), live->GetNumArtists());
+    for (int row = 0; row < cached->GetNumTracks(); ++row) {
+        BOOST_CHECK_EQUAL(cached->GetName(row), live->GetName(row));
+        BOOST_CHECK_EQUAL(cached->GetArtistName(row), live->GetArtistName(row));
+        BOOST_CHECK_EQUAL(cached->GetDurations()[row], live->GetDurations()[row]);
+        BOOST_CHECK_EQUAL(cached->GetAlbumIds()[row], live->GetAlbumIds()[row]);
+        BOOST_CHECK(std::string(cached->GetTrackLink(row)).compare(0, 14, "spotify:track:") == 0);
+        // nothing of libspotify is held by a cached snapshot
+        BOOST_CHECK(!cached->GetTrack(row));
+    }
+    BOOST_CHECK(std::string(cached->GetArtistLink(0)).compare(0, 15, "spotify:artist:") == 0);
+    BOOST_CHECK(std::string(cached->GetAlbumLink(0)).compare(0, 14, "spotify:album:") == 0);
+    BOOST_CHECK_EQUAL(live->GetTrackLink(0), "");
+
+    BOOST_CHECK(!cache.ReadTracks("spotify:user:fake:playlist:42"));
+}
+
+BOOST_AUTO_TEST_CASE(TestEditsRewriteTracks)
+{
+    spotify::LibraryCache cache(directory);
+    const int added[] = {0, 1, 2};
+    fakespotify::AddTracks(4, added, 3, 0);
+    BOOST_REQUIRE(PumpUntil([&] {
+        boost::shared_ptr<const spotify::TrackSnapshot> cached = cache.ReadTracks(kPlayList4);
+        return cached && cached->GetNumTracks() == 23;
+    }));
+
+    const int removed[] = {0, 1};
+    fakespotify::RemoveTracks(4, removed, 2);
+    BOOST_REQUIRE(PumpUntil([&] {
+        boost::shared_ptr<const spotify::TrackSnapshot> cached = cache.ReadTracks(kPlayList4);
+        return cached && cached->GetNumTracks() == 21;
+    }));
+    boost::shared_ptr<const spotify::TrackSnapshot> live = container->FindByLink(kPlayList4)->Snapshot();
+    BOOST_CHECK_EQUAL(cache.ReadTracks(kPlayList4)->GetName(0), live->GetName(0));
+}
+
+BOOST_AUTO_TEST_CASE(TestRemovedPlayListIsPruned)
+{
+    spotify::LibraryCache cache(directory);
+    BOOST_REQUIRE_EQUAL(ListFiles("libspotifypp-tracks-").size(), 10u);
+
+    // Playlist 4 follows the two folders in the flat list
+    fakespotify::RemovePlayList(8);
+    std::vector<spotify::LibraryCache::Entry> entries;
+    BOOST_REQUIRE(PumpUntil([&] { return cache.ReadTree(&entries) && !HasLink(entries, kPlayList4); }));
+    BOOST_CHECK_EQUAL(entries.size(), 13u);
+    BOOST_CHECK(!cache.ReadTracks(kPlayList4));
+    BOOST_CHECK_EQUAL(ListFiles("libspotifypp-tracks-").size(), 9u);
+}
+
+BOOST_AUTO_TEST_CASE(TestUnreadableFilesReadAsMissing)
+{
+    spotify::LibraryCache cache(directory);
+    std::vector<std::string> files = ListFiles("libspotifypp-tracks-");
+    BOOST_REQUIRE(!files.empty());
+
+    // the version follows the 8 bytes of the magic
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        std::fstream file(files[i].c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(8);
+        file.put(static_cast<char>(spotify::LibraryCache::kVersion + 1));
+    }
+    BOOST_CHECK(!cache.ReadTracks(kPlayList4));
+
+    // a truncated tree
+    std::vector<std::string> tree = ListFiles("libspotifypp-tree");
+    BOOST_REQUIRE_EQUAL(tree.size(), 1u);
+    boost::filesystem::resize_file(tree[0], boost::filesystem::file_size(tree[0]) / 2);
+    std::vector<spotify::LibraryCache::Entry> entries;
+    BOOST_CHECK(!cache.ReadTree(&entries));
+
+    // and garbage
+    std::ofstream(files[0].c_str(), std::ios::binary | std::ios::trunc) << "not a cache file";
+    BOOST_CHECK(!cache.ReadTracks(kPlayList4));
+}
+
+BOOST_AUTO_TEST_CASE(TestNameOutsideArenaReadsAsMissing)
+{
+    spotify::LibraryCache cache(directory);
+    BOOST_REQUIRE(cache.ReadTracks(kPlayList4));
+
+    // the counts follow the 24 bytes of the header, the link and the columns follow them padded to 8 bytes. The
+    // lengths of the names are the eighth column.
+    std::vector<std::string> files = ListFiles("libspotifypp-tracks-");
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        std::fstream file(files[i].c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        std::uint32_t counts[6];
+        file.seekg(24);
+        file.read(reinterpret_cast<char *>(counts), sizeof(counts));
+        auto align = [](std::size_t bytes) { return (bytes + 7) & ~static_cast<std::size_t>(7); };
+        std::size_t name_lengths = 48 + align(counts[5] + 1) + 7 * align(counts[0] * sizeof(std::uint32_t));
+        file.seekp(name_lengths);
+        file.write(reinterpret_cast<const char *>(&counts[4]), sizeof(counts[4]));
+    }
+    BOOST_CHECK(!cache.ReadTracks(kPlayList4));
+}
+
+BOOST_AUTO_TEST_CASE(TestNoCacheByDefault)
+{
+    spotify::Config config;
+    BOOST_CHECK(!config.cache_library);
+    BOOST_CHECK(session->GetLibraryCache());
+
+    spotify::LibraryCache empty((boost::filesystem::path(directory) / "missing").string());
+    std::vector<spotify::LibraryCache::Entry> entries;
+    BOOST_CHECK(!empty.ReadTree(&entries));
+    BOOST_CHECK(!empty.ReadTracks(kPlayList4));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
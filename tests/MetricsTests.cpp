@@ -0,0 +1,127 @@
+#if !defined(WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <spotify/Album.hpp>
+#include <spotify/Artist.hpp>
+#include <spotify/ArtistBrowse.hpp>
+#include <spotify/Image.hpp>
+#include <spotify/Metrics.hpp>
+#include <spotify/PlayList.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/Track.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+BOOST_AUTO_TEST_SUITE(MetricsTests)
+
+BOOST_AUTO_TEST_CASE(TestHistogramBuckets)
+{
+    spotify::Histogram histogram;
+    for (int i = 1; i <= 1000; ++i)
+        histogram.Record(i);
+
+    spotify::HistogramSnapshot snapshot = histogram.GetSnapshot();
+    BOOST_CHECK_EQUAL(snapshot.count, 1000u);
+    BOOST_CHECK_EQUAL(snapshot.max, 1000u);
+    BOOST_CHECK_CLOSE(snapshot.GetMean(), 500.5, 0.001);
+    // buckets are at most 1/8 wide
+    BOOST_CHECK(snapshot.GetPercentile(50) >= 500 && snapshot.GetPercentile(50) <= 500 * 9 / 8);
+    BOOST_CHECK_EQUAL(snapshot.GetPercentile(100), 1000u);
+
+    for (std::uint64_t value = 0; value < 5000; ++value) {
+        std::size_t bucket = spotify::Histogram::GetBucket(value);
+        BOOST_REQUIRE(value <= spotify::Histogram::GetBucketUpperBound(bucket));
+        BOOST_REQUIRE(bucket == 0 || value > spotify::Histogram::GetBucketUpperBound(bucket - 1));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(TestSessionMetrics, FakeSessionFixture)
+{
+    boost::shared_ptr<spotify::PlayList> starred = session->GetStarredPlayList();
+    BOOST_REQUIRE(PumpUntil([&] { return !starred->IsLoading(true); }));
+
+    boost::shared_ptr<spotify::Album> album = starred->GetTrack(0)->GetAlbum();
+    BOOST_REQUIRE(PumpUntil([&] { return !album->IsLoading(); }));
+    boost::shared_ptr<spotify::Image> image = album->GetImage();
+    BOOST_REQUIRE(image);
+    boost::shared_ptr<spotify::ArtistBrowse> browse = starred->GetTrack(0)->GetArtist(0)->Browse();
+    BOOST_REQUIRE(PumpUntil([&] { return !image->IsLoading() && !browse->IsLoading(); }));
+    session->Update();
+
+    spotify::SessionMetrics metrics = session->GetMetrics();
+    BOOST_CHECK_EQUAL(metrics.callbacks[spotify::TRACE_LOGGED_IN], 1u);
+    BOOST_CHECK(metrics.callbacks[spotify::TRACE_PLAYLIST_STATE_CHANGED] >= 1);
+    BOOST_CHECK(metrics.callbacks[spotify::TRACE_NOTIFY_MAIN_THREAD] >= 1);
+    BOOST_CHECK(metrics.GetNotifyRate() > 0);
+    BOOST_CHECK(metrics.process_events.count > 0);
+    BOOST_CHECK_EQUAL(metrics.process_events.count, metrics.next_timeout.count);
+    BOOST_CHECK_EQUAL(metrics.artist_browse.count, 1u);
+    BOOST_CHECK_EQUAL(metrics.image_load.count, 1u);
+    // the stand-in completes a browse after 20 ms
+    BOOST_CHECK(metrics.artist_browse.max >= 10000);
+}
+
+BOOST_AUTO_TEST_CASE(TestPrometheusHistogram)
+{
+    spotify::SessionMetrics metrics;
+    spotify::Histogram histogram;
+    for (int i = 1; i <= 100; ++i)
+        histogram.Record(i);
+    metrics.process_events = histogram.GetSnapshot();
+
+    std::ostringstream out;
+    metrics.WritePrometheus(out);
+    std::string text = out.str();
+
+    BOOST_CHECK(text.find("# TYPE spotify_process_events_microseconds histogram\n") != std::string::npos);
+    BOOST_CHECK(text.find("spotify_process_events_microseconds_bucket{le=\"7\"} 7\n") != std::string::npos);
+    BOOST_CHECK(text.find("spotify_process_events_microseconds_bucket{le=\"63\"} 63\n") != std::string::npos);
+    BOOST_CHECK(text.find("spotify_process_events_microseconds_bucket{le=\"127\"} 100\n") != std::string::npos);
+    BOOST_CHECK(text.find("spotify_process_events_microseconds_bucket{le=\"+Inf\"} 100\n") != std::string::npos);
+    BOOST_CHECK(text.find("spotify_process_events_microseconds_sum 5050\n") != std::string::npos);
+    BOOST_CHECK(text.find("spotify_process_events_microseconds_count 100\n") != std::string::npos);
+    BOOST_CHECK(text.find("spotify_browse_microseconds_count{type=\"album\"} 0\n") != std::string::npos);
+}
+
+#if !defined(WIN32)
+BOOST_FIXTURE_TEST_CASE(TestMetricsExporter, FakeSessionFixture)
+{
+    std::string path = "spotifypp-metrics-test.sock";
+    BOOST_REQUIRE(session->StartMetricsExporter(path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    BOOST_REQUIRE(fd >= 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    BOOST_REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+
+    std::string request = "GET /metrics HTTP/1.0\r\n\r\n";
+    BOOST_REQUIRE(write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size()));
+    std::string response;
+    char chunk[4096];
+    for (ssize_t read_bytes; (read_bytes = read(fd, chunk, sizeof(chunk))) > 0;)
+        response.append(chunk, read_bytes);
+    close(fd);
+
+    BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.0 200 OK"), 0);
+    BOOST_CHECK(response.find("spotify_callbacks_total{callback=\"logged_in\"} 1\n") != std::string::npos);
+    BOOST_CHECK(response.find("spotify_audio_buffer_capacity_frames ") != std::string::npos);
+
+    session->StopMetricsExporter();
+    BOOST_CHECK(access(path.c_str(), F_OK) != 0);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,213 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <utility>
+#include <vector>
+
+#include <spotify/PlayListContainer.hpp>
+#include <spotify/PlayListFolder.hpp>
+#include <spotify/PlayList.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/Track.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+BOOST_FIXTURE_TEST_SUITE(PlayListContainerTests, FakeSessionFixture)
+
+BOOST_AUTO_TEST_CASE(TestContainerTree)
+{
+    boost::shared_ptr<spotify::PlayListContainer> container = session->GetPlayListContainer();
+    BOOST_REQUIRE(container);
+    BOOST_REQUIRE(PumpUntil([&] { return !container->IsLoading(true); }));
+
+    // two folders holding two playlists each, followed by the remaining six playlists
+    BOOST_REQUIRE_EQUAL(container->GetNumChildren(), 8);
+    BOOST_CHECK(container->GetChild(0)->GetType() == spotify::PlayListElement::PLAYLIST_FOLDER);
+    BOOST_CHECK_EQUAL(container->GetChild(0)->GetName(), "Folder 0");
+    BOOST_CHECK_EQUAL(container->GetChild(0)->GetNumChildren(), 2);
+    BOOST_CHECK_EQUAL(container->GetChild(0)->GetChild(1)->GetName(), "Playlist 1");
+    BOOST_CHECK(container->GetChild(2)->GetType() == spotify::PlayListElement::PLAYLIST);
+    BOOST_CHECK_EQUAL(container->GetChild(2)->GetName(), "Playlist 4");
+    BOOST_CHECK_EQUAL(container->GetChild(2)->GetNumChildren(), 20);
+}
+
+BOOST_AUTO_TEST_CASE(TestStarredPlayList)
+{
+    boost::shared_ptr<spotify::PlayList> starred = session->GetStarredPlayList();
+    BOOST_REQUIRE(starred);
+    BOOST_REQUIRE(PumpUntil([&] { return !starred->IsLoading(true); }));
+
+    BOOST_REQUIRE_EQUAL(starred->GetNumTracks(), 10);
+    BOOST_CHECK(starred->GetTrack(0)->IsStarred());
+    BOOST_CHECK_EQUAL(starred->GetTrack(3)->GetName(), "Track 3");
+}
+
+BOOST_AUTO_TEST_CASE(TestPoolOccupancy)
+{
+    boost::shared_ptr<spotify::PlayList> starred = session->GetStarredPlayList();
+    BOOST_REQUIRE(PumpUntil([&] { return !starred->IsLoading(true); }));
+
+    spotify::PoolOccupancy occupancy = session->GetPoolOccupancy();
+    BOOST_CHECK_EQUAL(occupancy.playlists.live, 1u);
+    BOOST_CHECK_EQUAL(occupancy.tracks.live, 10u);
+    BOOST_CHECK(occupancy.tracks.capacity >= occupancy.tracks.live);
+    BOOST_CHECK(occupancy.tracks.block_size >= sizeof(spotify::Track));
+
+    // the blocks go back to the pool, the chunks stay
+    starred.reset();
+    occupancy = session->GetPoolOccupancy();
+    BOOST_CHECK_EQUAL(occupancy.playlists.live, 0u);
+    BOOST_CHECK_EQUAL(occupancy.tracks.live, 0u);
+    BOOST_CHECK(occupancy.tracks.capacity > 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestIndexedLookup)
+{
+    boost::shared_ptr<spotify::PlayListContainer> container = session->GetPlayListContainer();
+    BOOST_REQUIRE(PumpUntil([&] { return !container->IsLoading(true); }));
+
+    BOOST_CHECK(container->FindByName("Playlist 4") == container->GetChild(2));
+    BOOST_CHECK(container->FindByName("Playlist 1") == container->GetChild(0)->GetChild(1));
+    BOOST_CHECK(container->FindByName("Folder 1") == container->GetChild(1));
+    BOOST_CHECK(!container->FindByName("Playlist 42"));
+
+    BOOST_CHECK(container->FindByLink("spotify:user:fake:playlist:4") == container->GetChild(2));
+    BOOST_CHECK(!container->FindByLink("spotify:user:fake:playlist:42"));
+
+    boost::shared_ptr<spotify::PlayListFolder> folder = container->FindFolder(1001);
+    BOOST_REQUIRE(folder);
+    BOOST_CHECK(folder == container->GetChild(1));
+    BOOST_CHECK_EQUAL(folder->GetGroupID(), 1001u);
+    BOOST_CHECK(!container->FindFolder(42));
+}
+
+BOOST_AUTO_TEST_CASE(TestIndexFollowsContainerEdits)
+{
+    boost::shared_ptr<spotify::PlayListContainer> container = session->GetPlayListContainer();
+    BOOST_REQUIRE(PumpUntil([&] { return !container->IsLoading(true); }));
+    boost::shared_ptr<spotify::PlayListElement> first = container->FindByName("Playlist 0");
+    BOOST_REQUIRE(first);
+
+    // entry positions: folder 0 holds 1 and 2, folder 1 holds 5 and 6, the playlists 4 to 9 start at 8
+    fakespotify::RemovePlayList(8);
+    BOOST_REQUIRE(PumpUntil([&] { return !container->FindByLink("spotify:user:fake:playlist:4"); }));
+    BOOST_CHECK_EQUAL(container->GetNumChildren(), 7);
+    BOOST_CHECK(!container->FindByName("Playlist 4"));
+
+    // back at the start of folder 0
+    fakespotify::AddPlayList(4, 1);
+    boost::shared_ptr<spotify::PlayList> added;
+    BOOST_REQUIRE(PumpUntil([&] {
+        added = container->FindByLink("spotify:user:fake:playlist:4");
+        return static_cast<bool>(added);
+    }));
+    BOOST_REQUIRE(PumpUntil([&] { return !added->IsLoading(false); }));
+    BOOST_CHECK(container->FindByName("Playlist 4") == added);
+    BOOST_CHECK(added->GetParent() == container->FindFolder(1000));
+    BOOST_CHECK_EQUAL(container->FindFolder(1000)->GetNumChildren(), 3);
+    // the wrappers already in the tree are kept
+    BOOST_CHECK(container->FindByName("Playlist 0") == first);
+    BOOST_CHECK(container->GetChild(0)->GetChild(1) == first);
+
+    // and out to the end of the container
+    fakespotify::MovePlayList(1, 14);
+    BOOST_REQUIRE(PumpUntil([&] { return added->GetParent() == container; }));
+    BOOST_CHECK(container->GetChild(container->GetNumChildren() - 1) == added);
+    BOOST_CHECK_EQUAL(container->FindFolder(1000)->GetNumChildren(), 2);
+    BOOST_CHECK(container->FindByLink("spotify:user:fake:playlist:4") == added);
+}
+
+BOOST_AUTO_TEST_CASE(TestFolderEditsAreSpliced)
+{
+    typedef boost::shared_ptr<spotify::PlayListElement> Element;
+    boost::shared_ptr<spotify::PlayListContainer> container = session->GetPlayListContainer();
+    BOOST_REQUIRE(PumpUntil([&] { return !container->IsLoading(true); }));
+
+    int added = 0, removed = 0, rebuilt = 0;
+    std::vector<std::pair<Element, int>> moves;
+    container->connectToOnElementAdded([&](Element, Element, int) { ++added; });
+    container->connectToOnElementRemoved([&](Element, Element, int) { ++removed; });
+    container->connectToOnElementMoved([&](Element element, Element, int, Element, int new_index) {
+        moves.push_back(std::make_pair(element, new_index));
+    });
+    container->connectToOnTreeRebuilt([&] { ++rebuilt; });
+
+    Element first = container->FindByName("Playlist 0");
+    Element second = container->FindByName("Playlist 2");
+    Element fourth = container->FindByName("Playlist 4");
+    boost::shared_ptr<spotify::PlayListFolder> folder1 = container->FindFolder(1001);
+    BOOST_REQUIRE(first && second && fourth && folder1);
+
+    // entry positions: folder 0 at 0 to 3, folder 1 at 4 to 7, the playlists 4 to 9 from 8
+    fakespotify::AddFolder("Folder 2", 1002, 8);
+    BOOST_REQUIRE(PumpUntil([&] { return static_cast<bool>(container->FindFolder(1002)); }));
+    boost::shared_ptr<spotify::PlayListFolder> folder2 = container->FindFolder(1002);
+    BOOST_CHECK(container->GetChild(2) == folder2);
+    BOOST_CHECK(container->FindByName("Folder 2") == folder2);
+    BOOST_CHECK_EQUAL(folder2->GetNumChildren(), 0);
+    BOOST_CHECK_EQUAL(container->GetNumChildren(), 9);
+    BOOST_CHECK_EQUAL(added, 1);
+
+    // playlist 4 at 10 goes in front of the end marker of folder 2
+    fakespotify::MovePlayList(10, 9);
+    BOOST_REQUIRE(PumpUntil([&] { return fourth->GetParent() == folder2; }));
+    BOOST_CHECK_EQUAL(folder2->GetNumChildren(), 1);
+    BOOST_CHECK_EQUAL(container->GetNumChildren(), 8);
+    BOOST_REQUIRE_EQUAL(moves.size(), 1u);
+    BOOST_CHECK(moves[0].first == fourth);
+    BOOST_CHECK_EQUAL(moves[0].second, 0);
+
+    // folder 1 and its two playlists move to the end as a unit
+    fakespotify::MovePlayList(4, 16);
+    BOOST_REQUIRE(PumpUntil([&] { return container->GetChild(container->GetNumChildren() - 1) == folder1; }));
+    BOOST_CHECK_EQUAL(container->GetNumChildren(), 8);
+    BOOST_CHECK_EQUAL(folder1->GetNumChildren(), 2);
+    BOOST_CHECK(folder1->GetChild(0) == second);
+    BOOST_CHECK_EQUAL(moves.size(), 2u);
+
+    // removing folder 0 keeps its playlists in its place
+    fakespotify::RemovePlayList(0);
+    BOOST_REQUIRE(PumpUntil([&] { return !container->FindFolder(1000); }));
+    BOOST_CHECK(!container->FindByName("Folder 0"));
+    BOOST_CHECK_EQUAL(container->GetNumChildren(), 9);
+    BOOST_CHECK(container->GetChild(0) == first);
+    BOOST_CHECK(first->GetParent() == container);
+    BOOST_CHECK_EQUAL(removed, 1);
+    BOOST_CHECK_EQUAL(moves.size(), 4u);
+
+    // every callback was applied in place
+    fakespotify::RemovePlayList(0);
+    BOOST_REQUIRE(PumpUntil([&] { return !first->GetParent(); }));
+    BOOST_CHECK(container->GetChild(0) == container->FindByName("Playlist 1"));
+    BOOST_CHECK_EQUAL(rebuilt, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestAllLoadedFiresOnce)
+{
+    boost::shared_ptr<spotify::PlayListContainer> container = session->GetPlayListContainer();
+    int all_loaded = 0;
+    container->connectToOnAllLoaded([&] { ++all_loaded; });
+    BOOST_CHECK(container->IsLoading(true));
+
+    // the count of a parent is the sum of the counts of its children
+    BOOST_REQUIRE(PumpUntil([&] { return !container->IsLoading(false); }));
+    int pending = 0;
+    for (int i = 0; i < container->GetNumChildren(); ++i)
+        pending += container->GetChild(i)->GetPendingLoads();
+    BOOST_CHECK_EQUAL(container->GetPendingLoads(), pending);
+
+    BOOST_REQUIRE(PumpUntil([&] { return all_loaded > 0; }));
+    BOOST_CHECK(!container->IsLoading(true));
+    BOOST_CHECK_EQUAL(container->GetPendingLoads(), 0);
+    for (int i = 0; i < container->GetNumChildren(); ++i)
+        BOOST_CHECK_EQUAL(container->GetChild(i)->GetPendingLoads(), 0);
+
+    // later edits do not fire it again
+    fakespotify::RemovePlayList(8);
+    fakespotify::AddPlayList(4, 1);
+    BOOST_REQUIRE(PumpUntil([&] { return container->FindFolder(1000)->GetNumChildren() == 3; }));
+    BOOST_REQUIRE(PumpUntil([&] { return !container->IsLoading(true); }));
+    BOOST_CHECK_EQUAL(all_loaded, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,315 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+#include <spotify/Album.hpp>
+#include <spotify/Artist.hpp>
+#include <spotify/IdentityMap.hpp>
+#include <spotify/PlayList.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/Track.hpp>
+#include <spotify/TrackSnapshot.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+namespace {
+struct PlayListFixture : public FakeSessionFixture {
+    explicit PlayListFixture(ConfigHook configure = ConfigHook(),
+                             const fakespotify::CatalogConfig &catalog = fakespotify::CatalogConfig())
+        : FakeSessionFixture(catalog, configure), raw(fakespotify::GetPlayList(0)) {
+        playlist = session->CreatePlayList();
+        playlist->Load(raw);
+        BOOST_REQUIRE(PumpUntil([&] { return !playlist->IsLoading(true); }));
+    }
+
+    // names of the tracks as libspotify has them, the wrapper must be kept in the same order
+    std::vector<std::string> Expected() {
+        std::vector<std::string> names;
+        for (int i = 0; i < sp_playlist_num_tracks(raw); ++i)
+            names.push_back(sp_track_name(sp_playlist_track(raw, i)));
+        return names;
+    }
+
+    std::vector<std::string> Actual() {
+        std::vector<std::string> names;
+        for (int i = 0; i < playlist->GetNumTracks(); ++i)
+            names.push_back(playlist->GetTrack(i)->GetName());
+        return names;
+    }
+
+    void CheckInSync() {
+        BOOST_REQUIRE(PumpUntil([&] { return !playlist->IsLoading(true); }));
+        std::vector<std::string> expected = Expected();
+        std::vector<std::string> actual = Actual();
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
+    }
+
+    sp_playlist *raw;
+    boost::shared_ptr<spotify::PlayList> playlist;
+};
+
+struct LazyPlayListFixture : public PlayListFixture {
+    LazyPlayListFixture() : PlayListFixture([](spotify::Config &config) { config.lazy_playlist_tracks = true; }) {}
+};
+
+// metadata slow enough for a test to see the tracks it adds still loading
+fakespotify::CatalogConfig SlowMetadata() {
+    fakespotify::CatalogConfig catalog;
+    catalog.metadata_latency = 300;
+    return catalog;
+}
+
+struct SlowMetadataFixture : public PlayListFixture {
+    SlowMetadataFixture() : PlayListFixture(ConfigHook(), SlowMetadata()) {}
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(PlayListTests, PlayListFixture)
+
+BOOST_AUTO_TEST_CASE(TestTracksAdded)
+{
+    int position = -1;
+    int count = 0;
+    playlist->connectToOnTracksAdded([&](int p, int n) { position = p; count = n; });
+
+    const int added[] = {100, 101, 102};
+    fakespotify::AddTracks(0, added, 3, 5);
+    BOOST_REQUIRE(PumpUntil([&] { return count > 0; }));
+
+    BOOST_CHECK_EQUAL(position, 5);
+    BOOST_CHECK_EQUAL(count, 3);
+    BOOST_CHECK_EQUAL(playlist->GetNumTracks(), 23);
+    CheckInSync();
+}
+
+BOOST_AUTO_TEST_CASE(TestTracksRemoved)
+{
+    int count = 0;
+    playlist->connectToOnTracksRemoved([&](const int *, int n) { count = n; });
+    boost::shared_ptr<spotify::Track> kept = playlist->GetTrack(10);
+
+    const int removed[] = {19, 0, 7, 8};
+    fakespotify::RemoveTracks(0, removed, 4);
+    BOOST_REQUIRE(PumpUntil([&] { return count > 0; }));
+
+    BOOST_CHECK_EQUAL(playlist->GetNumTracks(), 16);
+    // untouched tracks keep their wrapper
+    BOOST_CHECK(playlist->GetTrack(7) == kept);
+    CheckInSync();
+}
+
+BOOST_AUTO_TEST_CASE(TestTracksMoved)
+{
+    int moves = 0;
+    playlist->connectToOnTracksMoved([&](const int *, int, int) { ++moves; });
+    boost::shared_ptr<spotify::Track> first = playlist->GetTrack(0);
+
+    // a block moved down, a block moved up and scattered tracks
+    const int down[] = {2, 3, 4};
+    fakespotify::MoveTracks(0, down, 3, 10);
+    const int up[] = {15, 16};
+    fakespotify::MoveTracks(0, up, 2, 1);
+    const int scattered[] = {1, 5, 9, 18};
+    fakespotify::MoveTracks(0, scattered, 4, 7);
+    BOOST_REQUIRE(PumpUntil([&] { return moves == 3; }));
+
+    BOOST_CHECK_EQUAL(playlist->GetNumTracks(), 20);
+    BOOST_CHECK(playlist->GetTrack(0) == first);
+    CheckInSync();
+}
+
+BOOST_AUTO_TEST_CASE(TestCanonicalWrappers)
+{
+    sp_track *raw_track = sp_playlist_track(raw, 2);
+    boost::shared_ptr<spotify::Track> track = playlist->GetTrack(2);
+    BOOST_CHECK(session->GetTrack(raw_track) == track);
+    BOOST_CHECK(track->GetArtist(0) == track->GetArtist(0));
+    BOOST_CHECK(track->GetAlbum() == track->GetAlbum());
+
+    // the album metadata arrives on its own
+    boost::shared_ptr<spotify::Album> album = track->GetAlbum();
+    BOOST_REQUIRE(album);
+    BOOST_REQUIRE(PumpUntil([&] { return !album->IsLoading(); }));
+    BOOST_CHECK(album->GetArtist() == session->GetArtist(sp_album_artist(sp_track_album(raw_track))));
+}
+
+BOOST_AUTO_TEST_CASE(TestIdentityMapNestedCreate)
+{
+    // the factory may look other objects up in the same map, as a track creating its album does
+    spotify::IdentityMap<int, std::string> map;
+    int outer = 0;
+    int inner = 1;
+    boost::shared_ptr<std::string> inner_value;
+    boost::shared_ptr<std::string> outer_value = map.Get(&outer, [&] {
+        inner_value = map.Get(&inner, [] { return boost::make_shared<std::string>("inner"); });
+        return boost::make_shared<std::string>("outer");
+    });
+    BOOST_REQUIRE(outer_value && inner_value);
+    BOOST_CHECK_EQUAL(*outer_value, "outer");
+    BOOST_CHECK(map.Get(&outer, [] { return boost::make_shared<std::string>("other"); }) == outer_value);
+    BOOST_CHECK(map.Get(&inner, [] { return boost::make_shared<std::string>("other"); }) == inner_value);
+    BOOST_CHECK_EQUAL(map.GetSize(), 2u);
+}
+
+BOOST_FIXTURE_TEST_CASE(TestLazyTracks, LazyPlayListFixture)
+{
+    BOOST_CHECK_EQUAL(playlist->GetNumTracks(), 20);
+    boost::shared_ptr<spotify::Track> held = playlist->GetTrack(3);
+    BOOST_CHECK(playlist->GetTrack(3) == held);
+    BOOST_CHECK_EQUAL(held->GetName(), sp_track_name(sp_playlist_track(raw, 3)));
+
+    // wrappers held by the application survive the eviction
+    playlist->EvictTracks();
+    BOOST_CHECK(playlist->GetTrack(3) == held);
+    CheckInSync();
+}
+
+BOOST_FIXTURE_TEST_CASE(TestLazyTracksDeltas, LazyPlayListFixture)
+{
+    int edits = 0;
+    playlist->connectToOnTracksAdded([&](int, int) { ++edits; });
+    playlist->connectToOnTracksRemoved([&](const int *, int) { ++edits; });
+    playlist->connectToOnTracksMoved([&](const int *, int, int) { ++edits; });
+    CheckInSync();
+
+    const int added[] = {100, 101, 102};
+    fakespotify::AddTracks(0, added, 3, 5);
+    const int removed[] = {22, 0, 7};
+    fakespotify::RemoveTracks(0, removed, 3);
+    const int moved[] = {1, 5, 9};
+    fakespotify::MoveTracks(0, moved, 3, 15);
+    BOOST_REQUIRE(PumpUntil([&] { return edits == 3; }));
+
+    BOOST_CHECK_EQUAL(playlist->GetNumTracks(), 20);
+    CheckInSync();
+}
+
+BOOST_FIXTURE_TEST_CASE(TestPendingLoads, SlowMetadataFixture)
+{
+    BOOST_CHECK_EQUAL(playlist->GetPendingLoads(), 0);
+
+    // tracks nothing has asked for yet
+    int edits = 0;
+    playlist->connectToOnTracksAdded([&](int, int) { ++edits; });
+    playlist->connectToOnTracksRemoved([&](const int *, int) { ++edits; });
+    const int added[] = {150, 151, 152};
+    fakespotify::AddTracks(0, added, 3, 5);
+    BOOST_REQUIRE(PumpUntil([&] { return edits == 1; }));
+    BOOST_CHECK_EQUAL(playlist->GetPendingLoads(), 3);
+    BOOST_CHECK(playlist->IsLoading(true));
+    BOOST_CHECK(!playlist->IsLoading(false));
+
+    const int removed[] = {6};
+    fakespotify::RemoveTracks(0, removed, 1);
+    BOOST_REQUIRE(PumpUntil([&] { return edits == 2; }));
+    BOOST_CHECK_EQUAL(playlist->GetPendingLoads(), 2);
+
+    // metadata_updated settles the count
+    BOOST_REQUIRE(PumpUntil([&] { return !playlist->IsLoading(true); }));
+    BOOST_CHECK_EQUAL(playlist->GetPendingLoads(), 0);
+    for (int i = 0; i < sp_playlist_num_tracks(raw); ++i)
+        BOOST_CHECK(sp_track_is_loaded(sp_playlist_track(raw, i)));
+}
+
+BOOST_FIXTURE_TEST_CASE(TestWaitFor, SlowMetadataFixture)
+{
+    typedef spotify::Session::Deadline::clock Clock;
+
+    int edits = 0;
+    playlist->connectToOnTracksAdded([&](int, int) { ++edits; });
+    const int added[] = {150, 151, 152};
+    fakespotify::AddTracks(0, added, 3, 5);
+    BOOST_REQUIRE(PumpUntil([&] { return edits == 1; }));
+    BOOST_REQUIRE(playlist->IsLoading(true));
+
+    // the metadata takes longer than the deadline
+    Clock::time_point start = Clock::now();
+    BOOST_CHECK(!session->WaitFor(playlist, start + std::chrono::milliseconds(20)));
+    BOOST_CHECK(Clock::now() - start >= std::chrono::milliseconds(20));
+    BOOST_CHECK(playlist->IsLoading(true));
+
+    // metadata_updated ends the wait as soon as the last track loads
+    BOOST_CHECK(session->WaitFor(playlist, Clock::now() + std::chrono::seconds(2)));
+    BOOST_CHECK(Clock::now() - start < std::chrono::seconds(1));
+    BOOST_CHECK(!playlist->IsLoading(true));
+
+    boost::shared_ptr<spotify::Album> album = playlist->GetTrack(5)->GetAlbum();
+    BOOST_CHECK(session->WaitFor(album, Clock::now() + std::chrono::seconds(2)));
+    BOOST_CHECK(!album->IsLoading());
+}
+
+BOOST_AUTO_TEST_CASE(TestSnapshot)
+{
+    // the artists are only requested when a track is asked for them
+    BOOST_CHECK_GT(playlist->Snapshot()->GetNumLoading(), 0);
+    for (int row = 0; row < playlist->GetNumTracks(); ++row) {
+        BOOST_REQUIRE(session->WaitFor(playlist->GetTrack(row)->GetArtist(0),
+                                       spotify::Session::Deadline::clock::now() + std::chrono::seconds(2)));
+    }
+
+    boost::shared_ptr<const spotify::TrackSnapshot> snapshot = playlist->Snapshot();
+    BOOST_REQUIRE_EQUAL(snapshot->GetNumTracks(), playlist->GetNumTracks());
+    BOOST_CHECK_EQUAL(snapshot->GetNumLoading(), 0);
+
+    for (int row = 0; row < snapshot->GetNumTracks(); ++row) {
+        boost::shared_ptr<spotify::Track> track = playlist->GetTrack(row);
+        BOOST_CHECK_EQUAL(snapshot->GetName(row), track->GetName());
+        BOOST_CHECK_EQUAL(snapshot->GetNameLength(row), track->GetName().size());
+        BOOST_CHECK_EQUAL(snapshot->GetDurations()[row], track->GetDuration());
+        BOOST_CHECK_EQUAL(snapshot->GetPopularities()[row], track->GetPopularity());
+        BOOST_CHECK_EQUAL(snapshot->GetDiscs()[row], track->GetDisc());
+        BOOST_CHECK_NE(snapshot->GetArtistName(row), "");
+        BOOST_CHECK_EQUAL(snapshot->GetArtistName(row), track->GetArtist(0)->GetName());
+        // the ids lead back to the canonical wrappers
+        BOOST_CHECK(session->GetTrack(snapshot->GetTrack(row)) == track);
+        BOOST_CHECK(session->GetAlbum(snapshot->GetAlbum(snapshot->GetAlbumIds()[row])) == track->GetAlbum());
+        BOOST_CHECK(session->GetArtist(snapshot->GetArtist(snapshot->GetArtistIds()[row])) == track->GetArtist(0));
+    }
+
+    // each album and artist is numbered once
+    for (int i = 0; i < snapshot->GetNumArtists(); ++i) {
+        for (int j = i + 1; j < snapshot->GetNumArtists(); ++j)
+            BOOST_CHECK(snapshot->GetArtist(i) != snapshot->GetArtist(j));
+    }
+
+    // later edits leave the snapshot as it was
+    const int removed[] = {0, 1};
+    fakespotify::RemoveTracks(0, removed, 2);
+    BOOST_REQUIRE(PumpUntil([&] { return playlist->GetNumTracks() == 18; }));
+    BOOST_CHECK_EQUAL(snapshot->GetNumTracks(), 20);
+    BOOST_CHECK_EQUAL(playlist->Snapshot()->GetName(0), playlist->GetTrack(0)->GetName());
+
+    // the removed tracks are still referenced by the snapshot, until it goes
+    sp_track *removed_track = snapshot->GetTrack(0);
+    int refs = fakespotify::GetRefCount(removed_track);
+    BOOST_CHECK_GT(refs, 0);
+    snapshot.reset();
+    BOOST_CHECK_EQUAL(fakespotify::GetRefCount(removed_track), refs - 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(TestSnapshotWhileLoading, SlowMetadataFixture)
+{
+    int edits = 0;
+    playlist->connectToOnTracksAdded([&](int, int) { ++edits; });
+    const int added[] = {150, 151, 152};
+    fakespotify::AddTracks(0, added, 3, 5);
+    BOOST_REQUIRE(PumpUntil([&] { return edits == 1; }));
+
+    boost::shared_ptr<const spotify::TrackSnapshot> snapshot = playlist->Snapshot();
+    BOOST_CHECK_GE(snapshot->GetNumLoading(), 3);
+    for (int row = 5; row < 8; ++row) {
+        BOOST_CHECK_EQUAL(snapshot->GetName(row), "");
+        BOOST_CHECK_EQUAL(snapshot->GetDurations()[row], 0);
+        BOOST_CHECK_EQUAL(snapshot->GetAlbumIds()[row], spotify::TrackSnapshot::kNone);
+        BOOST_CHECK_EQUAL(snapshot->GetArtistName(row), "");
+    }
+
+    BOOST_REQUIRE(session->WaitFor(playlist, spotify::Session::Deadline::clock::now() + std::chrono::seconds(2)));
+    snapshot = playlist->Snapshot();
+    for (int row = 5; row < 8; ++row)
+        BOOST_CHECK_NE(snapshot->GetName(row), "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,269 @@
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <stdexcept>
+#include <future>
+#include <chrono>
+#include <vector>
+
+#include <spotify/Session.hpp>
+#include <spotify/Wakeup.hpp>
+#include <spotify/Track.hpp>
+
+#include "fakespotify/FakeSpotify.hpp"
+#include "appkeys.hpp"
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+long long MillisSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+// Creates a session without logging in, the tests drive it with Run or RunInThread
+struct RunFixture : public SpotifyBasicFixture {
+    RunFixture() {
+        fakespotify::CatalogConfig catalog;
+        catalog.notify_burst = 20;
+        fakespotify::Configure(catalog);
+
+        session = spotify::Session::Create();
+        BOOST_REQUIRE(session->Initialise(configuration) == SP_ERROR_OK);
+    }
+
+    ~RunFixture() {
+        session->Quit();
+        fakespotify::StopSessions();
+    }
+
+    boost::shared_ptr<spotify::Session> session;
+};
+}
+
+BOOST_AUTO_TEST_SUITE(WakeupTests)
+
+BOOST_AUTO_TEST_CASE(TestWaitHonoursTimeout)
+{
+    spotify::Wakeup wakeup;
+    Clock::time_point start = Clock::now();
+    BOOST_CHECK(!wakeup.Wait(30));
+    BOOST_CHECK_GE(MillisSince(start), 30);
+    BOOST_CHECK(!wakeup.Wait(0));
+}
+
+BOOST_AUTO_TEST_CASE(TestNotificationsCoalesce)
+{
+    spotify::Wakeup wakeup;
+    for (int i = 0; i < 100; ++i)
+        wakeup.Notify();
+
+    Clock::time_point start = Clock::now();
+    BOOST_CHECK(wakeup.Wait(1000));
+    BOOST_CHECK_LT(MillisSince(start), 500);
+    BOOST_CHECK(!wakeup.Wait(0));
+}
+
+BOOST_AUTO_TEST_CASE(TestNotifyFromAnotherThread)
+{
+    spotify::Wakeup wakeup;
+    boost::thread notifier([&] {
+        boost::this_thread::sleep(boost::posix_time::millisec(20));
+        wakeup.Notify();
+    });
+    BOOST_CHECK(wakeup.Wait(-1));
+    notifier.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(SessionRunTests, RunFixture)
+
+BOOST_AUTO_TEST_CASE(TestRunInThread)
+{
+    session->RunInThread();
+    BOOST_CHECK(session->IsRunning());
+
+    // nothing is scheduled yet, so the driver only learns about the login through notify_main_thread
+    boost::this_thread::sleep(boost::posix_time::millisec(20));
+    session->Login(username.c_str(), password.c_str());
+
+    Clock::time_point start = Clock::now();
+    while (!session->IsLoggedIn() && MillisSince(start) < 2000)
+        boost::this_thread::sleep(boost::posix_time::millisec(5));
+    BOOST_REQUIRE(session->IsLoggedIn());
+
+    // every event is notified 20 times, at most one Update follows each notification
+    boost::this_thread::sleep(boost::posix_time::millisec(100));
+    fakespotify::Counters counters = fakespotify::GetCounters();
+    BOOST_CHECK_GE(counters.notify_main_thread, 20);
+    BOOST_CHECK_LE(counters.process_events, counters.notify_main_thread + 2);
+
+    // with nothing scheduled the driver sleeps for the whole timeout libspotify returned
+    boost::this_thread::sleep(boost::posix_time::millisec(300));
+    BOOST_CHECK_LE(fakespotify::GetCounters().process_events, counters.process_events + 1);
+
+    session->Quit();
+    BOOST_CHECK(!session->IsRunning());
+}
+
+BOOST_AUTO_TEST_CASE(TestQuitFromCallback)
+{
+    bool logged_in = false;
+    session->connectToOnLoggedIn([&](sp_error error) {
+        logged_in = error == SP_ERROR_OK;
+        session->Quit();
+    });
+
+    // makes the test fail instead of hang if Quit is never honoured
+    boost::thread watchdog([&] {
+        boost::this_thread::sleep(boost::posix_time::seconds(5));
+        session->Quit();
+    });
+
+    session->Login(username.c_str(), password.c_str());
+    session->Run();
+    BOOST_CHECK(logged_in);
+
+    watchdog.interrupt();
+    watchdog.join();
+}
+
+BOOST_AUTO_TEST_CASE(TestExecuteFromManyThreads)
+{
+    session->RunInThread();
+    boost::thread::id session_thread = session->Execute<boost::thread::id>(&boost::this_thread::get_id).get();
+    BOOST_CHECK(session_thread != boost::this_thread::get_id());
+
+    // the counter is not synchronised, commands only ever run on the session thread
+    const int num_producers = 8;
+    const int commands_per_producer = 1000;
+    int counter = 0;
+    bool same_thread = true;
+    std::vector<boost::shared_ptr<boost::thread> > producers;
+    for (int p = 0; p < num_producers; ++p) {
+        producers.push_back(boost::make_shared<boost::thread>([&] {
+            std::vector<std::future<int> > results;
+            for (int i = 0; i < commands_per_producer; ++i) {
+                results.push_back(session->Execute<int>([&] {
+                    same_thread = same_thread && boost::this_thread::get_id() == session_thread;
+                    return ++counter;
+                }));
+            }
+            for (std::size_t i = 0; i < results.size(); ++i)
+                results[i].get();
+        }));
+    }
+    for (int p = 0; p < num_producers; ++p)
+        producers[p]->join();
+
+    BOOST_CHECK_EQUAL(session->Execute<int>([&] { return counter; }).get(), num_producers * commands_per_producer);
+    BOOST_CHECK(same_thread);
+}
+
+BOOST_AUTO_TEST_CASE(TestExecuteForwardsExceptions)
+{
+    session->RunInThread();
+    std::future<int> result = session->Execute<int>([]() -> int { throw std::runtime_error("failed"); });
+    BOOST_CHECK_THROW(result.get(), std::runtime_error);
+
+    // a throwing command does not stop the ones after it
+    session->Post([] { throw std::runtime_error("failed"); });
+    BOOST_CHECK_EQUAL(session->Execute<int>([] { return 1; }).get(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestRunOnSessionThread)
+{
+    session->RunInThread();
+    boost::thread::id loop = session->Execute<boost::thread::id>([] { return boost::this_thread::get_id(); }).get();
+
+    // posted from here, and run before the loop returns even when it quits right after
+    boost::thread::id ran;
+    session->RunOnSessionThread([&] { ran = boost::this_thread::get_id(); });
+    session->Quit();
+    BOOST_CHECK(ran == loop);
+
+    // left for the next Update, then run in place by the thread driving the session
+    bool posted = false;
+    session->RunOnSessionThread([&] { posted = true; });
+    BOOST_CHECK(!posted);
+    session->Update();
+    BOOST_CHECK(posted);
+    bool in_place = false;
+    session->RunOnSessionThread([&] { in_place = true; });
+    BOOST_CHECK(in_place);
+}
+
+BOOST_AUTO_TEST_CASE(TestPlayerCommands)
+{
+    session->RunInThread();
+    session->Post([&] { session->Login(username.c_str(), password.c_str()); });
+    BOOST_REQUIRE(session->WaitForLogin(Clock::now() + std::chrono::seconds(2)));
+
+    boost::shared_ptr<spotify::Track> track = session->Execute<boost::shared_ptr<spotify::Track> >([&] {
+        boost::shared_ptr<spotify::Track> track = session->CreateTrack();
+        track->Load(fakespotify::GetTrack(1));
+        return track;
+    }).get();
+    BOOST_REQUIRE(session->WaitFor(track, Clock::now() + std::chrono::seconds(2)));
+
+    Clock::time_point start = Clock::now();
+
+    BOOST_CHECK(session->LoadAsync(track).get() == SP_ERROR_OK);
+    session->PlayAsync().get();
+    start = Clock::now();
+    while (fakespotify::GetCounters().frames_delivered == 0 && MillisSince(start) < 2000)
+        boost::this_thread::sleep(boost::posix_time::millisec(5));
+    BOOST_CHECK_GT(fakespotify::GetCounters().frames_delivered, 0);
+    session->StopAsync().get();
+
+    track->SetStarredAsync(true).get();
+    BOOST_CHECK(session->Execute<bool>([&] { return track->IsStarred(); }).get());
+    session->UnloadAsync(track).get();
+    BOOST_CHECK(!session->GetCurrentTrack());
+
+    // the command holds the track, releasing it before the command runs does not drop the change. The first tracks
+    // of the catalog are starred.
+    boost::shared_ptr<spotify::Track> other = session->Execute<boost::shared_ptr<spotify::Track> >([&] {
+        return session->GetTrack(fakespotify::GetTrack(2));
+    }).get();
+    std::promise<void> blocker;
+    std::shared_future<void> unblocked = blocker.get_future().share();
+    session->Post([unblocked] { unblocked.wait(); });
+    std::future<void> unstarred = other->SetStarredAsync(false);
+    other.reset();
+    blocker.set_value();
+    unstarred.get();
+    std::future<bool> starred = session->Execute<bool>([&] {
+        return session->GetTrack(fakespotify::GetTrack(2))->IsStarred();
+    });
+    BOOST_CHECK(!starred.get());
+}
+
+BOOST_AUTO_TEST_CASE(TestWaitForWhileRunning)
+{
+    session->RunInThread();
+
+    // nothing to wait for when the deadline has already passed
+    BOOST_CHECK(!session->WaitForLogin(Clock::now()));
+    // completed by logged_in, not by a timeout of the driver
+    session->Post([&] { session->Login(username.c_str(), password.c_str()); });
+    Clock::time_point start = Clock::now();
+    BOOST_REQUIRE(session->WaitForLogin(start + std::chrono::seconds(2)));
+    BOOST_CHECK_LT(MillisSince(start), 500);
+
+    std::vector<std::future<bool> > loaded;
+    std::vector<boost::shared_ptr<spotify::Track> > tracks;
+    for (int i = 0; i < 10; ++i) {
+        tracks.push_back(session->Execute<boost::shared_ptr<spotify::Track> >([&] {
+            return session->GetTrack(fakespotify::GetTrack(i));
+        }).get());
+        loaded.push_back(session->WhenLoaded(tracks.back(), Clock::now() + std::chrono::seconds(2)));
+    }
+    for (std::size_t i = 0; i < loaded.size(); ++i)
+        BOOST_CHECK(loaded[i].get());
+    BOOST_CHECK(session->Execute<bool>([&] { return !tracks.back()->IsLoading(false); }).get());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
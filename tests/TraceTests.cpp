@@ -0,0 +1,68 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <spotify/PlayList.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/Trace.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+namespace {
+std::string Dump() {
+    std::ostringstream out;
+    spotify::Trace::WriteChromeTrace(out);
+    return out.str();
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(TraceTests, FakeSessionFixture)
+
+BOOST_AUTO_TEST_CASE(TestCallbacksRecorded)
+{
+    boost::shared_ptr<spotify::PlayList> starred = session->GetStarredPlayList();
+    BOOST_REQUIRE(PumpUntil([&] { return !starred->IsLoading(true); }));
+
+    std::string trace = Dump();
+    BOOST_CHECK_EQUAL(trace.find("{\"traceEvents\":["), 0u);
+    BOOST_CHECK(trace.find("\"name\":\"logged_in\"") != std::string::npos);
+    BOOST_CHECK(trace.find("\"name\":\"playlist_state_changed\"") != std::string::npos);
+    BOOST_CHECK(trace.find("\"name\":\"process_events\",\"cat\":\"libspotify\",\"ph\":\"B\"") != std::string::npos);
+    BOOST_CHECK(trace.find("\"name\":\"process_events\",\"cat\":\"libspotify\",\"ph\":\"E\"") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(TestExitedThreadKept)
+{
+    // the second thread reuses the ring of the first one
+    boost::thread([] { spotify::Trace::Record(spotify::TRACE_END_OF_TRACK, reinterpret_cast<void *>(0xE1)); }).join();
+    boost::thread([] { spotify::Trace::Record(spotify::TRACE_END_OF_TRACK, reinterpret_cast<void *>(0xE2)); }).join();
+
+    std::string trace = Dump();
+    BOOST_CHECK(trace.find("\"object\":\"0xE1\"") != std::string::npos);
+    BOOST_CHECK(trace.find("\"object\":\"0xE2\"") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(TestDumpOnSignal)
+{
+    const std::string path = "trace_on_signal.json";
+    std::remove(path.c_str());
+
+    spotify::Trace::DumpOnSignal(SIGTERM, path);
+    std::raise(SIGTERM);
+    session->Update();
+
+    std::ifstream in(path.c_str());
+    BOOST_REQUIRE(in);
+    std::string head;
+    std::getline(in, head);
+    BOOST_CHECK_EQUAL(head, "{\"traceEvents\":[");
+    std::signal(SIGTERM, SIG_DFL);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
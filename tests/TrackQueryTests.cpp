@@ -0,0 +1,140 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <spotify/Artist.hpp>
+#include <spotify/PlayList.hpp>
+#include <spotify/Session.hpp>
+#include <spotify/TrackQuery.hpp>
+#include <spotify/TrackSnapshot.hpp>
+
+#include "FakeSessionFixture.hpp"
+
+namespace {
+fakespotify::CatalogConfig LargePlayList() {
+    fakespotify::CatalogConfig catalog;
+    catalog.num_playlists = 1;
+    catalog.tracks_per_playlist = 70000;
+    catalog.num_tracks = 5000;
+    catalog.num_starred = 700;
+    catalog.playlist_latency = 0;
+    catalog.metadata_latency = 0;
+    return catalog;
+}
+
+// Snapshot of a playlist of 70000 rows with every track and artist loaded, large enough to be split in ranges
+struct QueryFixture : public FakeSessionFixture {
+    QueryFixture() : FakeSessionFixture(LargePlayList()) {
+        spotify::Session::Deadline deadline = spotify::Session::Deadline::clock::now() + std::chrono::seconds(10);
+        playlist = session->CreatePlayList();
+        playlist->Load(fakespotify::GetPlayList(0));
+        BOOST_REQUIRE(session->WaitFor(playlist, deadline));
+
+        snapshot = playlist->Snapshot();
+        for (int id = 0; id < snapshot->GetNumArtists(); ++id)
+            BOOST_REQUIRE(session->WaitFor(session->GetArtist(snapshot->GetArtist(id)), deadline));
+        snapshot = playlist->Snapshot();
+        BOOST_REQUIRE_EQUAL(snapshot->GetNumLoading(), 0);
+    }
+
+    std::string Lower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+        return text;
+    }
+
+    boost::shared_ptr<spotify::PlayList> playlist;
+    boost::shared_ptr<const spotify::TrackSnapshot> snapshot;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(TrackQueryTests, QueryFixture)
+
+BOOST_AUTO_TEST_CASE(TestNumericConditions)
+{
+    std::vector<int> rows = spotify::TrackQuery().Where(spotify::TrackQuery::DURATION, 150000, 200000)
+                                                 .Where(spotify::TrackQuery::POPULARITY, 50, 100)
+                                                 .Where(spotify::TrackQuery::DISC, 2, 2)
+                                                 .Run(*snapshot);
+
+    std::vector<int> expected;
+    for (int row = 0; row < snapshot->GetNumTracks(); ++row) {
+        int duration = snapshot->GetDurations()[row];
+        if (duration >= 150000 && duration <= 200000 && snapshot->GetPopularities()[row] >= 50
+            && snapshot->GetDiscs()[row] == 2)
+            expected.push_back(row);
+    }
+    BOOST_REQUIRE(!expected.empty());
+    BOOST_CHECK_EQUAL_COLLECTIONS(rows.begin(), rows.end(), expected.begin(), expected.end());
+
+    // starred rows only, the bounds of the ints and an empty range
+    rows = spotify::TrackQuery().Where(spotify::TrackQuery::STARRED, 1, 1).Run(*snapshot);
+    BOOST_CHECK_EQUAL(rows.size(), 70000u / 5000u * 700u);
+    rows = spotify::TrackQuery().Where(spotify::TrackQuery::DURATION, INT_MIN, INT_MAX).Run(*snapshot);
+    BOOST_CHECK_EQUAL(rows.size(), 70000u);
+    rows = spotify::TrackQuery().Where(spotify::TrackQuery::DURATION, 1, 0).Run(*snapshot);
+    BOOST_CHECK(rows.empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestTextConditions)
+{
+    std::vector<int> rows = spotify::TrackQuery().Where(spotify::TrackQuery::NAME, spotify::TrackQuery::PREFIX,
+                                                        "TRACK 12")
+                                                 .Where(spotify::TrackQuery::ARTIST, spotify::TrackQuery::SUBSTRING,
+                                                        "ist 1")
+                                                 .Run(*snapshot);
+
+    std::vector<int> expected;
+    for (int row = 0; row < snapshot->GetNumTracks(); ++row) {
+        std::string name = Lower(snapshot->GetName(row));
+        std::string artist = Lower(snapshot->GetArtistName(row));
+        if (name.compare(0, 8, "track 12") == 0 && artist.find("ist 1") != std::string::npos)
+            expected.push_back(row);
+    }
+    BOOST_REQUIRE(!expected.empty());
+    BOOST_CHECK_EQUAL_COLLECTIONS(rows.begin(), rows.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(TestSortAndLimit)
+{
+    spotify::TrackQuery query;
+    query.Where(spotify::TrackQuery::POPULARITY, 10, 90)
+         .OrderBy(spotify::TrackQuery::BY_ARTIST)
+         .OrderBy(spotify::TrackQuery::BY_DURATION, true);
+    std::vector<int> rows = query.Run(*snapshot);
+
+    std::vector<int> expected;
+    for (int row = 0; row < snapshot->GetNumTracks(); ++row) {
+        if (snapshot->GetPopularities()[row] >= 10 && snapshot->GetPopularities()[row] <= 90)
+            expected.push_back(row);
+    }
+    std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) {
+        std::string artist_a = Lower(snapshot->GetArtistName(a));
+        std::string artist_b = Lower(snapshot->GetArtistName(b));
+        if (artist_a != artist_b)
+            return artist_a < artist_b;
+        return snapshot->GetDurations()[a] > snapshot->GetDurations()[b];
+    });
+    BOOST_CHECK_EQUAL_COLLECTIONS(rows.begin(), rows.end(), expected.begin(), expected.end());
+
+    // the ranges sorted on their own threads merge into the same order
+    std::vector<int> single = spotify::TrackQuery(query).SetMaxThreads(1).Run(*snapshot);
+    BOOST_CHECK(single == rows);
+
+    // top-k is the head of the full sort
+    std::vector<int> top = query.Limit(25).Run(*snapshot);
+    BOOST_REQUIRE_EQUAL(top.size(), 25u);
+    BOOST_CHECK(std::equal(top.begin(), top.end(), expected.begin()));
+
+    // without keys the limit keeps the first rows in playlist order
+    top = spotify::TrackQuery().Where(spotify::TrackQuery::STARRED, 1, 1).Limit(3).Run(*snapshot);
+    BOOST_REQUIRE_EQUAL(top.size(), 3u);
+    BOOST_CHECK_EQUAL(top[0], 0);
+    BOOST_CHECK_EQUAL(top[2], 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include <spotify/Session.hpp>
+
+// Holds the application key and the credentials used by the tests, fill them in appkeys.cpp (generated from
+// appkeys.cpp.TEMPLATE) to run against the real service
+struct SpotifyBasicFixture {
+    SpotifyBasicFixture();
+    ~SpotifyBasicFixture();
+
+    static const std::uint8_t app_key[];
+    std::size_t key_size;
+    std::string username;
+    std::string password;
+    spotify::Config configuration;
+};
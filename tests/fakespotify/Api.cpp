@@ -0,0 +1,914 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// The libspotify entry points used by libspotifypp, implemented on top of the synthetic catalog of World.hpp
+#include <libspotify/api.h>
+
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "fakespotify/World.hpp"
+
+using fakespotify::CountCall;
+using fakespotify::Now;
+using fakespotify::World;
+
+namespace {
+typedef fakespotify::Millis Millis;
+
+template <typename T>
+bool InRange(const std::vector<T> &v, int index) {
+    return index >= 0 && static_cast<std::size_t>(index) < v.size();
+}
+
+template <typename Callbacks>
+bool SameSubscription(const fakespotify::Subscription<Callbacks> &subscription, const Callbacks *callbacks,
+                      void *userdata) {
+    return subscription.userdata == userdata &&
+           std::memcmp(&subscription.callbacks, callbacks, sizeof(Callbacks)) == 0;
+}
+
+sp_track *RequestTrack(sp_track *track) {
+    if (track)
+        World::Instance().RequestMetadata(&track->load);
+    return track;
+}
+
+sp_artist *RequestArtist(sp_artist *artist) {
+    if (artist)
+        World::Instance().RequestMetadata(&artist->load);
+    return artist;
+}
+
+sp_album *RequestAlbum(sp_album *album) {
+    if (album)
+        World::Instance().RequestMetadata(&album->load);
+    return album;
+}
+
+const byte *AsImageId(const std::string &id) {
+    return reinterpret_cast<const byte *>(id.data());
+}
+
+sp_error BrowseError(int index) {
+    int every = World::Instance().GetConfig().browse_error_every;
+    return every > 0 && index % every == 0 ? SP_ERROR_OTHER_TRANSIENT : SP_ERROR_OK;
+}
+
+void ScheduleBrowse(sp_session *session, fakespotify::Loadable *load, const std::function<void ()> &complete) {
+    World &world = World::Instance();
+    int latency = world.GetConfig().browse_latency;
+    Millis due = Now() + (latency > 0 ? latency : 0);
+    load->Request(latency > 0 ? due : 0);
+    world.Schedule(session, due, complete);
+}
+}
+
+// error handling
+
+const char *sp_error_message(sp_error error) {
+    switch (error) {
+        case SP_ERROR_OK: return "No error";
+        case SP_ERROR_BAD_API_VERSION: return "Invalid library version";
+        case SP_ERROR_API_INITIALIZATION_FAILED: return "Initialization failed";
+        case SP_ERROR_TRACK_NOT_PLAYABLE: return "Track not playable";
+        case SP_ERROR_BAD_APPLICATION_KEY: return "Invalid application key";
+        case SP_ERROR_BAD_USERNAME_OR_PASSWORD: return "Incorrect username or password";
+        case SP_ERROR_MISSING_CALLBACK: return "Missing callback";
+        case SP_ERROR_INVALID_INDATA: return "Invalid input";
+        case SP_ERROR_INDEX_OUT_OF_RANGE: return "Index out of range";
+        case SP_ERROR_IS_LOADING: return "Resource not loaded yet";
+        case SP_ERROR_INVALID_ARGUMENT: return "Invalid argument";
+        case SP_ERROR_OTHER_PERMANENT: return "Generic error";
+        case SP_ERROR_OTHER_TRANSIENT: return "A transient error occurred";
+        default: return "Unknown error";
+    }
+}
+
+// session
+
+sp_error sp_session_create(const sp_session_config *config, sp_session **sess) {
+    CountCall();
+    if (!config || !sess)
+        return SP_ERROR_INVALID_INDATA;
+    if (config->api_version != SPOTIFY_API_VERSION)
+        return SP_ERROR_BAD_API_VERSION;
+    if (!config->callbacks || !config->callbacks->notify_main_thread)
+        return SP_ERROR_MISSING_CALLBACK;
+
+    *sess = World::Instance().CreateSession(config);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_release(sp_session *session) {
+    CountCall();
+    World::Instance().ReleaseSession(session);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_login(sp_session *session, const char *username, const char *password, bool remember_me,
+                          const char *blob) {
+    CountCall();
+    World &world = World::Instance();
+    world.Schedule(session, Now() + world.GetConfig().login_latency, [session] {
+        session->state = SP_CONNECTION_STATE_LOGGED_IN;
+        if (session->callbacks.logged_in)
+            session->callbacks.logged_in(session, SP_ERROR_OK);
+        if (session->callbacks.connectionstate_updated)
+            session->callbacks.connectionstate_updated(session);
+    });
+    return SP_ERROR_OK;
+}
+
+sp_user *sp_session_user(sp_session *session) {
+    CountCall();
+    return session->state == SP_CONNECTION_STATE_LOGGED_IN ? &session->user : NULL;
+}
+
+sp_error sp_session_logout(sp_session *session) {
+    CountCall();
+    World::Instance().Schedule(session, Now(), [session] {
+        session->state = SP_CONNECTION_STATE_LOGGED_OUT;
+        if (session->callbacks.logged_out)
+            session->callbacks.logged_out(session);
+        if (session->callbacks.connectionstate_updated)
+            session->callbacks.connectionstate_updated(session);
+    });
+    return SP_ERROR_OK;
+}
+
+sp_connectionstate sp_session_connectionstate(sp_session *session) {
+    CountCall();
+    return static_cast<sp_connectionstate>(session->state.load());
+}
+
+void *sp_session_userdata(sp_session *session) {
+    return session->userdata;
+}
+
+sp_error sp_session_process_events(sp_session *session, int *next_timeout) {
+    CountCall();
+    int timeout = World::Instance().ProcessEvents(session);
+    if (next_timeout)
+        *next_timeout = timeout;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_load(sp_session *session, sp_track *track) {
+    CountCall();
+    if (!track)
+        return SP_ERROR_INVALID_INDATA;
+    if (!track->load.IsLoaded())
+        return SP_ERROR_IS_LOADING;
+    World::Instance().Load(session, track);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_seek(sp_session *session, int offset) {
+    CountCall();
+    World::Instance().Seek(session, offset);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_play(sp_session *session, bool play) {
+    CountCall();
+    World::Instance().Play(session, play);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_unload(sp_session *session) {
+    CountCall();
+    World::Instance().Load(session, NULL);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_prefetch(sp_session *session, sp_track *track) {
+    CountCall();
+    RequestTrack(track);
+    return SP_ERROR_OK;
+}
+
+sp_playlistcontainer *sp_session_playlistcontainer(sp_session *session) {
+    CountCall();
+    if (session->state != SP_CONNECTION_STATE_LOGGED_IN)
+        return NULL;
+    World &world = World::Instance();
+    world.RequestContainer();
+    return world.container;
+}
+
+sp_playlist *sp_session_starred_create(sp_session *session) {
+    CountCall();
+    if (session->state != SP_CONNECTION_STATE_LOGGED_IN)
+        return NULL;
+    World &world = World::Instance();
+    world.RequestPlayList(world.starred);
+    ++world.starred->refs;
+    return world.starred;
+}
+
+sp_error sp_session_preferred_bitrate(sp_session *session, sp_bitrate bitrate) {
+    CountCall();
+    return SP_ERROR_OK;
+}
+
+// track
+
+bool sp_track_is_loaded(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded();
+}
+
+sp_error sp_track_error(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded() ? SP_ERROR_OK : SP_ERROR_IS_LOADING;
+}
+
+bool sp_track_is_starred(sp_session *session, sp_track *track) {
+    CountCall();
+    return track->starred;
+}
+
+sp_error sp_track_set_starred(sp_session *session, sp_track *const *tracks, int num_tracks, bool star) {
+    CountCall();
+    for (int i = 0; i < num_tracks; ++i)
+        tracks[i]->starred = star;
+    return SP_ERROR_OK;
+}
+
+int sp_track_num_artists(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded() ? static_cast<int>(track->artists.size()) : 0;
+}
+
+sp_artist *sp_track_artist(sp_track *track, int index) {
+    CountCall();
+    if (!track->load.IsLoaded() || !InRange(track->artists, index))
+        return NULL;
+    return RequestArtist(track->artists[index]);
+}
+
+sp_album *sp_track_album(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded() ? RequestAlbum(track->album) : NULL;
+}
+
+const char *sp_track_name(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded() ? track->name.c_str() : "";
+}
+
+int sp_track_duration(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded() ? track->duration : 0;
+}
+
+int sp_track_popularity(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded() ? track->popularity : 0;
+}
+
+int sp_track_disc(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded() ? track->disc : 0;
+}
+
+int sp_track_index(sp_track *track) {
+    CountCall();
+    return track->load.IsLoaded() ? track->album_index : 0;
+}
+
+sp_error sp_track_add_ref(sp_track *track) {
+    CountCall();
+    ++track->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_track_release(sp_track *track) {
+    CountCall();
+    if (track)
+        --track->refs;
+    return SP_ERROR_OK;
+}
+
+// album
+
+bool sp_album_is_loaded(sp_album *album) {
+    CountCall();
+    return album->load.IsLoaded();
+}
+
+bool sp_album_is_available(sp_album *album) {
+    CountCall();
+    return true;
+}
+
+sp_artist *sp_album_artist(sp_album *album) {
+    CountCall();
+    return album->load.IsLoaded() ? RequestArtist(album->artist) : NULL;
+}
+
+const byte *sp_album_cover(sp_album *album, sp_image_size size) {
+    CountCall();
+    return album->load.IsLoaded() ? AsImageId(album->cover) : NULL;
+}
+
+const char *sp_album_name(sp_album *album) {
+    CountCall();
+    return album->load.IsLoaded() ? album->name.c_str() : "";
+}
+
+int sp_album_year(sp_album *album) {
+    CountCall();
+    return album->load.IsLoaded() ? album->year : 0;
+}
+
+sp_error sp_album_add_ref(sp_album *album) {
+    CountCall();
+    ++album->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_album_release(sp_album *album) {
+    CountCall();
+    if (album)
+        --album->refs;
+    return SP_ERROR_OK;
+}
+
+// artist
+
+const char *sp_artist_name(sp_artist *artist) {
+    CountCall();
+    return artist->load.IsLoaded() ? artist->name.c_str() : "";
+}
+
+bool sp_artist_is_loaded(sp_artist *artist) {
+    CountCall();
+    return artist->load.IsLoaded();
+}
+
+const byte *sp_artist_portrait(sp_artist *artist, sp_image_size size) {
+    CountCall();
+    return artist->load.IsLoaded() ? AsImageId(artist->portrait) : NULL;
+}
+
+sp_error sp_artist_add_ref(sp_artist *artist) {
+    CountCall();
+    ++artist->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_artist_release(sp_artist *artist) {
+    CountCall();
+    if (artist)
+        --artist->refs;
+    return SP_ERROR_OK;
+}
+
+// album browse
+
+sp_albumbrowse *sp_albumbrowse_create(sp_session *session, sp_album *album, albumbrowse_complete_cb *callback,
+                                      void *userdata) {
+    CountCall();
+    sp_albumbrowse *browse = new sp_albumbrowse();
+    browse->refs = 2;  // the caller and the pending completion
+    browse->error = BrowseError(album->index);
+    browse->album = album;
+    browse->tracks = album->tracks;
+    browse->copyrights.push_back("(C) " + std::to_string(static_cast<long long>(album->year)) + " Fake Records");
+    browse->review = "A review of " + album->name;
+    browse->callback = callback;
+    browse->userdata = userdata;
+
+    ScheduleBrowse(session, &browse->load, [browse] {
+        // a browse released before it completed does not call back
+        if (browse->refs > 1 && browse->callback)
+            browse->callback(browse, browse->userdata);
+        sp_albumbrowse_release(browse);
+    });
+    return browse;
+}
+
+bool sp_albumbrowse_is_loaded(sp_albumbrowse *alb) {
+    CountCall();
+    return alb->load.IsLoaded();
+}
+
+sp_error sp_albumbrowse_error(sp_albumbrowse *alb) {
+    CountCall();
+    return alb->load.IsLoaded() ? alb->error : SP_ERROR_IS_LOADING;
+}
+
+sp_album *sp_albumbrowse_album(sp_albumbrowse *alb) {
+    CountCall();
+    return alb->load.IsLoaded() ? alb->album : NULL;
+}
+
+sp_artist *sp_albumbrowse_artist(sp_albumbrowse *alb) {
+    CountCall();
+    return alb->load.IsLoaded() ? RequestArtist(alb->album->artist) : NULL;
+}
+
+int sp_albumbrowse_num_copyrights(sp_albumbrowse *alb) {
+    CountCall();
+    return alb->load.IsLoaded() ? static_cast<int>(alb->copyrights.size()) : 0;
+}
+
+const char *sp_albumbrowse_copyright(sp_albumbrowse *alb, int index) {
+    CountCall();
+    return alb->load.IsLoaded() && InRange(alb->copyrights, index) ? alb->copyrights[index].c_str() : NULL;
+}
+
+int sp_albumbrowse_num_tracks(sp_albumbrowse *alb) {
+    CountCall();
+    return alb->load.IsLoaded() ? static_cast<int>(alb->tracks.size()) : 0;
+}
+
+sp_track *sp_albumbrowse_track(sp_albumbrowse *alb, int index) {
+    CountCall();
+    return alb->load.IsLoaded() && InRange(alb->tracks, index) ? RequestTrack(alb->tracks[index]) : NULL;
+}
+
+const char *sp_albumbrowse_review(sp_albumbrowse *alb) {
+    CountCall();
+    return alb->load.IsLoaded() ? alb->review.c_str() : "";
+}
+
+int sp_albumbrowse_backend_request_duration(sp_albumbrowse *alb) {
+    CountCall();
+    return alb->load.IsLoaded() ? World::Instance().GetConfig().browse_latency : -1;
+}
+
+sp_error sp_albumbrowse_add_ref(sp_albumbrowse *alb) {
+    CountCall();
+    ++alb->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_albumbrowse_release(sp_albumbrowse *alb) {
+    CountCall();
+    if (alb && --alb->refs == 0)
+        delete alb;
+    return SP_ERROR_OK;
+}
+
+// artist browse
+
+sp_artistbrowse *sp_artistbrowse_create(sp_session *session, sp_artist *artist, sp_artistbrowse_type type,
+                                        artistbrowse_complete_cb *callback, void *userdata) {
+    CountCall();
+    World &world = World::Instance();
+    sp_artistbrowse *browse = new sp_artistbrowse();
+    browse->refs = 2;  // the caller and the pending completion
+    browse->error = BrowseError(artist->index);
+    browse->artist = artist;
+    browse->portraits.push_back(artist->portrait);
+    browse->biography = artist->name + " is a synthetic artist.";
+    browse->callback = callback;
+    browse->userdata = userdata;
+
+    for (std::size_t i = 0; i < world.albums.size(); ++i) {
+        sp_album *album = world.albums[i];
+        if (album->artist != artist)
+            continue;
+        if (type != SP_ARTISTBROWSE_NO_ALBUMS)
+            browse->albums.push_back(album);
+        if (type != SP_ARTISTBROWSE_NO_TRACKS)
+            browse->tracks.insert(browse->tracks.end(), album->tracks.begin(), album->tracks.end());
+    }
+    int num_artists = static_cast<int>(world.artists.size());
+    for (int i = 1; i <= 5 && i < num_artists; ++i)
+        browse->similar.push_back(world.artists[(artist->index + i) % num_artists]);
+
+    ScheduleBrowse(session, &browse->load, [browse] {
+        // a browse released before it completed does not call back
+        if (browse->refs > 1 && browse->callback)
+            browse->callback(browse, browse->userdata);
+        sp_artistbrowse_release(browse);
+    });
+    return browse;
+}
+
+bool sp_artistbrowse_is_loaded(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded();
+}
+
+sp_error sp_artistbrowse_error(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded() ? arb->error : SP_ERROR_IS_LOADING;
+}
+
+sp_artist *sp_artistbrowse_artist(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded() ? arb->artist : NULL;
+}
+
+int sp_artistbrowse_num_portraits(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded() ? static_cast<int>(arb->portraits.size()) : 0;
+}
+
+const byte *sp_artistbrowse_portrait(sp_artistbrowse *arb, int index) {
+    CountCall();
+    return arb->load.IsLoaded() && InRange(arb->portraits, index) ? AsImageId(arb->portraits[index]) : NULL;
+}
+
+int sp_artistbrowse_num_tracks(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded() ? static_cast<int>(arb->tracks.size()) : 0;
+}
+
+sp_track *sp_artistbrowse_track(sp_artistbrowse *arb, int index) {
+    CountCall();
+    return arb->load.IsLoaded() && InRange(arb->tracks, index) ? RequestTrack(arb->tracks[index]) : NULL;
+}
+
+int sp_artistbrowse_num_albums(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded() ? static_cast<int>(arb->albums.size()) : 0;
+}
+
+sp_album *sp_artistbrowse_album(sp_artistbrowse *arb, int index) {
+    CountCall();
+    return arb->load.IsLoaded() && InRange(arb->albums, index) ? RequestAlbum(arb->albums[index]) : NULL;
+}
+
+int sp_artistbrowse_num_similar_artists(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded() ? static_cast<int>(arb->similar.size()) : 0;
+}
+
+sp_artist *sp_artistbrowse_similar_artist(sp_artistbrowse *arb, int index) {
+    CountCall();
+    return arb->load.IsLoaded() && InRange(arb->similar, index) ? RequestArtist(arb->similar[index]) : NULL;
+}
+
+const char *sp_artistbrowse_biography(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded() ? arb->biography.c_str() : "";
+}
+
+int sp_artistbrowse_backend_request_duration(sp_artistbrowse *arb) {
+    CountCall();
+    return arb->load.IsLoaded() ? World::Instance().GetConfig().browse_latency : -1;
+}
+
+sp_error sp_artistbrowse_add_ref(sp_artistbrowse *arb) {
+    CountCall();
+    ++arb->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_artistbrowse_release(sp_artistbrowse *arb) {
+    CountCall();
+    if (arb && --arb->refs == 0)
+        delete arb;
+    return SP_ERROR_OK;
+}
+
+// image
+
+sp_image *sp_image_create(sp_session *session, const byte image_id[20]) {
+    CountCall();
+    if (!image_id)
+        return NULL;
+    return World::Instance().AcquireImage(std::string(reinterpret_cast<const char *>(image_id), 20));
+}
+
+sp_error sp_image_add_load_callback(sp_image *image, image_loaded_cb *callback, void *userdata) {
+    CountCall();
+    World &world = World::Instance();
+    bool loaded = false;
+    {
+        std::lock_guard<std::mutex> lock(world.GetMutex());
+        image->subscriptions.push_back(std::make_pair(callback, userdata));
+        loaded = image->loaded_notified;
+        if (loaded)
+            ++image->refs;
+    }
+
+    // an already loaded image calls back from the next sp_session_process_events
+    sp_session *session = world.GetActiveSession();
+    if (loaded && session && world.GetConfig().image_callback_when_loaded) {
+        world.Schedule(session, Now(), [image, callback, userdata] {
+            World &world = World::Instance();
+            bool subscribed = false;
+            {
+                std::lock_guard<std::mutex> lock(world.GetMutex());
+                for (std::size_t i = 0; i < image->subscriptions.size(); ++i)
+                    subscribed = subscribed || image->subscriptions[i] == std::make_pair(callback, userdata);
+            }
+            if (subscribed)
+                callback(image, userdata);
+            world.ReleaseImage(image);
+        });
+    } else if (loaded) {
+        world.ReleaseImage(image);
+    }
+    return SP_ERROR_OK;
+}
+
+sp_error sp_image_remove_load_callback(sp_image *image, image_loaded_cb *callback, void *userdata) {
+    CountCall();
+    std::lock_guard<std::mutex> lock(World::Instance().GetMutex());
+    std::vector<std::pair<image_loaded_cb *, void *>> &subscriptions = image->subscriptions;
+    for (std::size_t i = 0; i < subscriptions.size(); ++i) {
+        if (subscriptions[i].first == callback && subscriptions[i].second == userdata) {
+            subscriptions.erase(subscriptions.begin() + i);
+            return SP_ERROR_OK;
+        }
+    }
+    return SP_ERROR_INVALID_INDATA;
+}
+
+bool sp_image_is_loaded(sp_image *image) {
+    CountCall();
+    return image->load.IsLoaded();
+}
+
+sp_error sp_image_error(sp_image *image) {
+    CountCall();
+    return image->load.IsLoaded() ? SP_ERROR_OK : SP_ERROR_IS_LOADING;
+}
+
+sp_imageformat sp_image_format(sp_image *image) {
+    CountCall();
+    return image->load.IsLoaded() ? SP_IMAGE_FORMAT_JPEG : SP_IMAGE_FORMAT_UNKNOWN;
+}
+
+const void *sp_image_data(sp_image *image, size_t *data_size) {
+    CountCall();
+    if (!image->load.IsLoaded() || image->data.empty()) {
+        if (data_size)
+            *data_size = 0;
+        return NULL;
+    }
+    if (data_size)
+        *data_size = image->data.size();
+    return &image->data[0];
+}
+
+const byte *sp_image_image_id(sp_image *image) {
+    CountCall();
+    return AsImageId(image->id);
+}
+
+sp_error sp_image_add_ref(sp_image *image) {
+    CountCall();
+    std::lock_guard<std::mutex> lock(World::Instance().GetMutex());
+    ++image->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_image_release(sp_image *image) {
+    CountCall();
+    if (image)
+        World::Instance().ReleaseImage(image);
+    return SP_ERROR_OK;
+}
+
+// playlist
+
+bool sp_playlist_is_loaded(sp_playlist *playlist) {
+    CountCall();
+    return playlist->load.IsLoaded();
+}
+
+sp_error sp_playlist_add_callbacks(sp_playlist *playlist, sp_playlist_callbacks *callbacks, void *userdata) {
+    CountCall();
+    fakespotify::Subscription<sp_playlist_callbacks> subscription = {*callbacks, userdata};
+    std::lock_guard<std::mutex> lock(World::Instance().GetMutex());
+    playlist->subscriptions.push_back(subscription);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_playlist_remove_callbacks(sp_playlist *playlist, sp_playlist_callbacks *callbacks, void *userdata) {
+    CountCall();
+    std::lock_guard<std::mutex> lock(World::Instance().GetMutex());
+    for (std::size_t i = 0; i < playlist->subscriptions.size(); ++i) {
+        if (SameSubscription(playlist->subscriptions[i], callbacks, userdata)) {
+            playlist->subscriptions.erase(playlist->subscriptions.begin() + i);
+            return SP_ERROR_OK;
+        }
+    }
+    return SP_ERROR_INVALID_INDATA;
+}
+
+int sp_playlist_num_tracks(sp_playlist *playlist) {
+    CountCall();
+    return playlist->load.IsLoaded() ? static_cast<int>(playlist->tracks.size()) : 0;
+}
+
+sp_track *sp_playlist_track(sp_playlist *playlist, int index) {
+    CountCall();
+    if (!playlist->load.IsLoaded() || !InRange(playlist->tracks, index))
+        return NULL;
+    return RequestTrack(playlist->tracks[index]);
+}
+
+const char *sp_playlist_name(sp_playlist *playlist) {
+    CountCall();
+    return playlist->load.IsLoaded() ? playlist->name.c_str() : "";
+}
+
+sp_error sp_playlist_add_ref(sp_playlist *playlist) {
+    CountCall();
+    ++playlist->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_playlist_release(sp_playlist *playlist) {
+    CountCall();
+    if (playlist)
+        --playlist->refs;
+    return SP_ERROR_OK;
+}
+
+// playlist container
+
+sp_error sp_playlistcontainer_add_callbacks(sp_playlistcontainer *pc, sp_playlistcontainer_callbacks *callbacks,
+                                            void *userdata) {
+    CountCall();
+    World &world = World::Instance();
+    fakespotify::Subscription<sp_playlistcontainer_callbacks> subscription = {*callbacks, userdata};
+    bool loaded = false;
+    {
+        std::lock_guard<std::mutex> lock(world.GetMutex());
+        pc->subscriptions.push_back(subscription);
+        loaded = pc->loaded_notified;
+    }
+
+    // subscribers arriving after the load still get their container_loaded
+    sp_session *session = world.GetActiveSession();
+    if (loaded && session && callbacks->container_loaded) {
+        world.Schedule(session, Now(), [pc, subscription] {
+            bool subscribed = false;
+            {
+                std::lock_guard<std::mutex> lock(World::Instance().GetMutex());
+                for (std::size_t i = 0; i < pc->subscriptions.size(); ++i) {
+                    subscribed = subscribed || SameSubscription(pc->subscriptions[i], &subscription.callbacks,
+                                                                subscription.userdata);
+                }
+            }
+            if (subscribed)
+                subscription.callbacks.container_loaded(pc, subscription.userdata);
+        });
+    }
+    return SP_ERROR_OK;
+}
+
+sp_error sp_playlistcontainer_remove_callbacks(sp_playlistcontainer *pc, sp_playlistcontainer_callbacks *callbacks,
+                                               void *userdata) {
+    CountCall();
+    std::lock_guard<std::mutex> lock(World::Instance().GetMutex());
+    for (std::size_t i = 0; i < pc->subscriptions.size(); ++i) {
+        if (SameSubscription(pc->subscriptions[i], callbacks, userdata)) {
+            pc->subscriptions.erase(pc->subscriptions.begin() + i);
+            return SP_ERROR_OK;
+        }
+    }
+    return SP_ERROR_INVALID_INDATA;
+}
+
+int sp_playlistcontainer_num_playlists(sp_playlistcontainer *pc) {
+    CountCall();
+    return pc->load.IsLoaded() ? static_cast<int>(pc->entries.size()) : 0;
+}
+
+bool sp_playlistcontainer_is_loaded(sp_playlistcontainer *pc) {
+    CountCall();
+    return pc->load.IsLoaded();
+}
+
+sp_playlist *sp_playlistcontainer_playlist(sp_playlistcontainer *pc, int index) {
+    CountCall();
+    if (!pc->load.IsLoaded() || !InRange(pc->entries, index))
+        return NULL;
+    sp_playlist *playlist = pc->entries[index].playlist;
+    if (playlist)
+        World::Instance().RequestPlayList(playlist);
+    return playlist;
+}
+
+sp_playlist_type sp_playlistcontainer_playlist_type(sp_playlistcontainer *pc, int index) {
+    CountCall();
+    if (!pc->load.IsLoaded() || !InRange(pc->entries, index))
+        return SP_PLAYLIST_TYPE_PLACEHOLDER;
+    return pc->entries[index].type;
+}
+
+sp_error sp_playlistcontainer_playlist_folder_name(sp_playlistcontainer *pc, int index, char *buffer,
+                                                   int buffer_size) {
+    CountCall();
+    if (!InRange(pc->entries, index))
+        return SP_ERROR_INDEX_OUT_OF_RANGE;
+    if (buffer_size <= 0)
+        return SP_ERROR_INVALID_INDATA;
+    const std::string &name = pc->entries[index].folder_name;
+    std::size_t length = std::min(name.size(), static_cast<std::size_t>(buffer_size - 1));
+    std::memcpy(buffer, name.data(), length);
+    buffer[length] = '\0';
+    return SP_ERROR_OK;
+}
+
+sp_uint64 sp_playlistcontainer_playlist_folder_id(sp_playlistcontainer *pc, int index) {
+    CountCall();
+    return InRange(pc->entries, index) ? pc->entries[index].folder_id : 0;
+}
+
+sp_error sp_playlistcontainer_add_ref(sp_playlistcontainer *pc) {
+    CountCall();
+    ++pc->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_playlistcontainer_release(sp_playlistcontainer *pc) {
+    CountCall();
+    if (pc)
+        --pc->refs;
+    return SP_ERROR_OK;
+}
+
+// link
+
+sp_link *sp_link_create_from_playlist(sp_playlist *playlist) {
+    CountCall();
+    // like libspotify, there is no link before the playlist is loaded
+    if (!playlist->load.IsLoaded())
+        return NULL;
+    sp_link *link = new sp_link();
+    link->refs = 1;
+    link->uri = playlist->index < 0 ? "spotify:user:fake:starred"
+                                    : "spotify:user:fake:playlist:" + std::to_string(playlist->index);
+    return link;
+}
+
+sp_link *sp_link_create_from_track(sp_track *track, int offset) {
+    CountCall();
+    if (!track->load.IsLoaded())
+        return NULL;
+    sp_link *link = new sp_link();
+    link->refs = 1;
+    link->uri = "spotify:track:" + std::to_string(track->index);
+    return link;
+}
+
+sp_link *sp_link_create_from_album(sp_album *album) {
+    CountCall();
+    // the id is known before the metadata arrives
+    sp_link *link = new sp_link();
+    link->refs = 1;
+    link->uri = "spotify:album:" + std::to_string(album->index);
+    return link;
+}
+
+sp_link *sp_link_create_from_artist(sp_artist *artist) {
+    CountCall();
+    // the id is known before the metadata arrives
+    sp_link *link = new sp_link();
+    link->refs = 1;
+    link->uri = "spotify:artist:" + std::to_string(artist->index);
+    return link;
+}
+
+int sp_link_as_string(sp_link *link, char *buffer, int buffer_size) {
+    CountCall();
+    if (buffer_size > 0) {
+        std::size_t length = std::min(link->uri.size(), static_cast<std::size_t>(buffer_size - 1));
+        std::memcpy(buffer, link->uri.data(), length);
+        buffer[length] = '\0';
+    }
+    return static_cast<int>(link->uri.size());
+}
+
+sp_error sp_link_add_ref(sp_link *link) {
+    CountCall();
+    ++link->refs;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_link_release(sp_link *link) {
+    CountCall();
+    if (link && --link->refs == 0)
+        delete link;
+    return SP_ERROR_OK;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// C-libs includes
+#include <cstdint>
+
+// std includes
+#include <string>
+
+#if defined(WIN32)
+#   if defined(fakespotify_EXPORTS)
+#       define FAKESPOTIFY_API _declspec(dllexport)
+#   else
+#       define FAKESPOTIFY_API _declspec(dllimport)
+#   endif
+#else
+#   define FAKESPOTIFY_API
+#endif
+
+/// @namespace fakespotify
+/// @brief Control interface of the in-process libspotify stand-in.
+///
+/// The stand-in implements the libspotify entry points used by libspotifypp against a synthetic catalog, so the
+/// wrapper can be tested and benchmarked without an application key, credentials or network access. Any user name
+/// and password are accepted. Callbacks are fired with the same threading as the real library: session, playlist,
+/// container, browse and image callbacks from sp_session_process_events, notify_main_thread and music_delivery from
+/// internal threads.
+namespace fakespotify {
+/// @brief Shape and timing of the synthetic catalog. Latencies are in milliseconds; zero means the object is
+/// available as soon as it is requested.
+struct FAKESPOTIFY_API CatalogConfig {
+    CatalogConfig();
+
+    int num_playlists;
+    int tracks_per_playlist;
+    /// The first num_folders * playlists_per_folder playlists of the container are grouped into folders
+    int num_folders;
+    int playlists_per_folder;
+    /// Number of distinct tracks, playlists reuse them round robin. Zero means one per playlist entry
+    int num_tracks;
+    int num_artists;
+    int num_albums;
+    int num_starred;
+    int image_size;
+
+    int login_latency;
+    int container_latency;
+    int playlist_latency;
+    int metadata_latency;
+    int browse_latency;
+    int image_latency;
+    /// Browses of the artists and albums whose index is a multiple of it complete with SP_ERROR_OTHER_TRANSIENT.
+    /// Zero means every browse succeeds
+    int browse_error_every;
+    /// Whether sp_image_add_load_callback on an image already loaded calls back from the next
+    /// sp_session_process_events. libspotify does not promise it, turn it off to check nothing relies on it
+    bool image_callback_when_loaded;
+
+    /// Number of notify_main_thread calls fired every time the library needs its events processed
+    int notify_burst;
+    int frames_per_delivery;
+    /// Deliver audio at playback speed instead of as fast as the application consumes it
+    bool realtime_audio;
+};
+
+/// @brief Number of calls seen by the stand-in since the last Configure or ResetCounters
+struct FAKESPOTIFY_API Counters {
+    std::uint64_t api_calls;
+    std::uint64_t process_events;
+    std::uint64_t notify_main_thread;
+    std::uint64_t music_delivery;
+    std::uint64_t frames_delivered;
+    std::uint64_t frames_consumed;
+    std::uint64_t stutter;            // sum of the stutter reported by get_audio_buffer_stats
+    std::uint64_t buffered_samples;   // samples reported by the last get_audio_buffer_stats
+};
+
+/// @brief Builds a new catalog. Sessions created before the call are shut down and stop firing callbacks, so call
+/// it before creating the spotify::Session under test.
+FAKESPOTIFY_API void Configure(const CatalogConfig &config);
+FAKESPOTIFY_API const CatalogConfig &GetConfig();
+
+/// @brief Shuts down every session so no more callbacks are fired. spotify::Session never releases its sp_session,
+/// so fixtures call this before the wrapper goes away.
+FAKESPOTIFY_API void StopSessions();
+
+/// @brief Catalog handles, for benchmarks that drive the wrappers directly. NULL when out of range
+FAKESPOTIFY_API sp_playlist *GetPlayList(int index);
+FAKESPOTIFY_API sp_track *GetTrack(int index);
+/// @brief References held on a track, by the catalog and by the callers of sp_track_add_ref
+FAKESPOTIFY_API int GetRefCount(sp_track *track);
+
+/// @brief Playlist edits, as made by another client of a collaborative playlist. The edit is applied and reported
+/// to the playlist callbacks from the next sp_session_process_events. Positions follow libspotify: removed and moved
+/// tracks are indexes before the edit, new_position is the index before the move of the track the moved tracks are
+/// inserted in front of.
+FAKESPOTIFY_API void AddTracks(int playlist, const int *tracks, int num_tracks, int position);
+FAKESPOTIFY_API void RemoveTracks(int playlist, const int *positions, int num_positions);
+FAKESPOTIFY_API void MoveTracks(int playlist, const int *positions, int num_positions, int new_position);
+
+/// @brief Container edits, reported to the container callbacks like the playlist edits. Positions index the flat
+/// list of container entries, folder start and end markers included. A folder is added as an empty pair of markers
+/// and removing either marker removes both, keeping the contents. Moving a start marker moves the whole folder.
+FAKESPOTIFY_API void AddPlayList(int playlist, int position);
+FAKESPOTIFY_API void AddFolder(const std::string &name, sp_uint64 group_id, int position);
+FAKESPOTIFY_API void RemovePlayList(int position);
+FAKESPOTIFY_API void MovePlayList(int position, int new_position);
+
+FAKESPOTIFY_API Counters GetCounters();
+FAKESPOTIFY_API void ResetCounters();
+}
@@ -0,0 +1,863 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "fakespotify/World.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace fakespotify {
+namespace {
+const int kSampleRate = 44100;
+const int kChannels = 2;
+const int kNoEventTimeout = 1000;
+
+std::string Numbered(const char *prefix, int index) {
+    return prefix + std::to_string(static_cast<long long>(index));
+}
+}
+
+Millis Now() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string MakeImageId(char kind, int index) {
+    std::string id(20, '\0');
+    id[0] = kind;
+    id[1] = static_cast<char>((index >> 24) & 0xFF);
+    id[2] = static_cast<char>((index >> 16) & 0xFF);
+    id[3] = static_cast<char>((index >> 8) & 0xFF);
+    id[4] = static_cast<char>(index & 0xFF);
+    return id;
+}
+
+const Millis Loadable::kNotRequested = std::numeric_limits<long long>::max();
+
+Loadable::Loadable() : ready_at_(kNotRequested) {
+}
+
+bool Loadable::IsLoaded() const {
+    Millis ready_at = ready_at_.load(std::memory_order_acquire);
+    return ready_at == 0 || (ready_at != kNotRequested && ready_at <= Now());
+}
+
+bool Loadable::IsRequested() const {
+    return ready_at_.load(std::memory_order_acquire) != kNotRequested;
+}
+
+bool Loadable::Request(Millis ready_at) {
+    long long expected = kNotRequested;
+    return ready_at_.compare_exchange_strong(expected, ready_at, std::memory_order_acq_rel);
+}
+
+CatalogConfig::CatalogConfig() : num_playlists(10), tracks_per_playlist(20), num_folders(2), playlists_per_folder(2)
+                               , num_tracks(0), num_artists(50), num_albums(100), num_starred(10)
+                               , image_size(4096), login_latency(10), container_latency(10)
+                               , playlist_latency(10), metadata_latency(10), browse_latency(20)
+                               , image_latency(20), browse_error_every(0), image_callback_when_loaded(true)
+                               , notify_burst(1), frames_per_delivery(2048), realtime_audio(false) {
+}
+
+World &World::Instance() {
+    static World world;
+    return world;
+}
+
+World::World() : container(NULL), starred(NULL), api_calls(0), process_events(0), notify_main_thread(0)
+               , music_delivery(0), frames_delivered(0), frames_consumed(0), stutter(0)
+               , buffered_samples(0) {
+    Configure(CatalogConfig());
+}
+
+World::~World() {
+    for (std::size_t i = 0; i < sessions_.size(); ++i) {
+        StopSession(sessions_[i]);
+        delete sessions_[i];
+    }
+    sessions_.clear();
+    Clear();
+}
+
+std::mutex &World::GetMutex() {
+    return mutex_;
+}
+
+const CatalogConfig &World::GetConfig() const {
+    return config_;
+}
+
+void World::Clear() {
+    for (std::size_t i = 0; i < tracks.size(); ++i)
+        delete tracks[i];
+    for (std::size_t i = 0; i < albums.size(); ++i)
+        delete albums[i];
+    for (std::size_t i = 0; i < artists.size(); ++i)
+        delete artists[i];
+    for (std::size_t i = 0; i < playlists.size(); ++i)
+        delete playlists[i];
+    for (std::map<std::string, sp_image *>::iterator it = images_.begin(); it != images_.end(); ++it)
+        delete it->second;
+    delete container;
+    delete starred;
+
+    tracks.clear();
+    albums.clear();
+    artists.clear();
+    playlists.clear();
+    images_.clear();
+    container = NULL;
+    starred = NULL;
+}
+
+void World::StopSessions() {
+    for (std::size_t i = 0; i < sessions_.size(); ++i)
+        StopSession(sessions_[i]);
+}
+
+void World::Configure(const CatalogConfig &config) {
+    StopSessions();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Clear();
+    config_ = config;
+
+    int num_artists = std::max(1, config.num_artists);
+    int num_albums = std::max(1, config.num_albums);
+    int num_playlists = std::max(0, config.num_playlists);
+    int tracks_per_playlist = std::max(0, config.tracks_per_playlist);
+    int num_tracks = config.num_tracks > 0 ? config.num_tracks : std::max(1, num_playlists * tracks_per_playlist);
+
+    artists.reserve(num_artists);
+    for (int i = 0; i < num_artists; ++i) {
+        sp_artist *artist = new sp_artist();
+        artist->refs = 0;
+        artist->index = i;
+        artist->name = Numbered("Artist ", i);
+        artist->portrait = MakeImageId('R', i);
+        artists.push_back(artist);
+    }
+
+    albums.reserve(num_albums);
+    for (int i = 0; i < num_albums; ++i) {
+        sp_album *album = new sp_album();
+        album->refs = 0;
+        album->index = i;
+        album->name = Numbered("Album ", i);
+        album->cover = MakeImageId('A', i);
+        album->year = 1970 + i % 50;
+        album->artist = artists[i % num_artists];
+        albums.push_back(album);
+    }
+
+    tracks.reserve(num_tracks);
+    for (int i = 0; i < num_tracks; ++i) {
+        sp_track *track = new sp_track();
+        track->refs = 0;
+        track->index = i;
+        track->name = Numbered("Track ", i);
+        track->duration = 120000 + (i * 7919) % 240000;
+        track->popularity = (i * 37) % 101;
+        track->disc = 1 + (i / num_albums) % 2;
+        track->album_index = i / num_albums + 1;
+        track->starred = i < config.num_starred;
+        track->album = albums[i % num_albums];
+        track->artists.push_back(track->album->artist);
+        if (i % 4 == 3)
+            track->artists.push_back(artists[(i * 7 + 3) % num_artists]);
+        track->album->tracks.push_back(track);
+        tracks.push_back(track);
+    }
+
+    playlists.reserve(num_playlists);
+    for (int i = 0; i < num_playlists; ++i) {
+        sp_playlist *playlist = new sp_playlist();
+        playlist->refs = 0;
+        playlist->index = i;
+        playlist->name = Numbered("Playlist ", i);
+        playlist->tracks.reserve(tracks_per_playlist);
+        for (int j = 0; j < tracks_per_playlist; ++j)
+            playlist->tracks.push_back(tracks[(static_cast<long long>(i) * tracks_per_playlist + j) % num_tracks]);
+        playlists.push_back(playlist);
+    }
+
+    starred = new sp_playlist();
+    starred->refs = 0;
+    starred->index = -1;
+    starred->name = "Starred";
+    for (int i = 0; i < num_tracks && i < config.num_starred; ++i)
+        starred->tracks.push_back(tracks[i]);
+
+    container = new sp_playlistcontainer();
+    container->refs = 0;
+    container->loaded_notified = false;
+
+    int playlists_per_folder = std::max(0, config.playlists_per_folder);
+    int next = 0;
+    for (int f = 0; f < config.num_folders; ++f) {
+        sp_playlistcontainer::Entry start = {SP_PLAYLIST_TYPE_START_FOLDER, NULL, Numbered("Folder ", f),
+                                             static_cast<sp_uint64>(1000 + f)};
+        container->entries.push_back(start);
+        for (int j = 0; j < playlists_per_folder && next < num_playlists; ++j, ++next) {
+            sp_playlistcontainer::Entry entry = {SP_PLAYLIST_TYPE_PLAYLIST, playlists[next], "", 0};
+            container->entries.push_back(entry);
+        }
+        sp_playlistcontainer::Entry end = {SP_PLAYLIST_TYPE_END_FOLDER, NULL, "", static_cast<sp_uint64>(1000 + f)};
+        container->entries.push_back(end);
+    }
+    for (; next < num_playlists; ++next) {
+        sp_playlistcontainer::Entry entry = {SP_PLAYLIST_TYPE_PLAYLIST, playlists[next], "", 0};
+        container->entries.push_back(entry);
+    }
+
+    api_calls = 0;
+    process_events = 0;
+    notify_main_thread = 0;
+    music_delivery = 0;
+    frames_delivered = 0;
+    frames_consumed = 0;
+    stutter = 0;
+    buffered_samples = 0;
+}
+
+sp_session *World::CreateSession(const sp_session_config *config) {
+    sp_session *session = new sp_session();
+    std::memset(&session->callbacks, 0, sizeof(session->callbacks));
+    if (config->callbacks)
+        session->callbacks = *config->callbacks;
+    session->userdata = config->userdata;
+    session->alive = true;
+    session->state = SP_CONNECTION_STATE_LOGGED_OUT;
+    session->user.name = "fakeuser";
+    session->next_sequence = 0;
+    session->notify_pending = false;
+    session->track = NULL;
+    session->playing = false;
+    session->position = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.push_back(session);
+    }
+
+    session->notifier = std::thread([this, session] { NotifierLoop(session); });
+    session->audio = std::thread([this, session] { AudioLoop(session); });
+
+    return session;
+}
+
+void World::ReleaseSession(sp_session *session) {
+    // the memory is kept until the world goes away, wrappers may still poll a released session
+    StopSession(session);
+}
+
+sp_session *World::GetActiveSession() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::vector<sp_session *>::reverse_iterator it = sessions_.rbegin(); it != sessions_.rend(); ++it) {
+        if ((*it)->alive)
+            return *it;
+    }
+    return NULL;
+}
+
+void World::StopSession(sp_session *session) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!session->alive)
+            return;
+        session->alive = false;
+        while (!session->events.empty())
+            session->events.pop();
+        session->wakeup.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(session->player_mutex);
+        session->player_wakeup.notify_all();
+    }
+
+    std::thread::id self = std::this_thread::get_id();
+    if (session->notifier.joinable())
+        session->notifier.get_id() == self ? session->notifier.detach() : session->notifier.join();
+    if (session->audio.joinable())
+        session->audio.get_id() == self ? session->audio.detach() : session->audio.join();
+}
+
+void World::Schedule(sp_session *session, Millis due, const std::function<void ()> &fire, bool is_metadata) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!session->alive)
+        return;
+
+    Event event = {due, session->next_sequence++, is_metadata, fire};
+    session->events.push(event);
+    session->wakeup.notify_all();
+}
+
+int World::ProcessEvents(sp_session *session) {
+    process_events.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<Event> due_events;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session->notify_pending = false;
+        Millis now = Now();
+        while (!session->events.empty() && session->events.top().due <= now) {
+            due_events.push_back(session->events.top());
+            session->events.pop();
+        }
+    }
+
+    // libspotify reports a burst of metadata arriving together as a single metadata_updated
+    bool metadata_fired = false;
+    for (std::size_t i = 0; i < due_events.size(); ++i) {
+        if (due_events[i].is_metadata) {
+            if (metadata_fired)
+                continue;
+            metadata_fired = true;
+        }
+        due_events[i].fire();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (session->events.empty())
+        return kNoEventTimeout;
+    Millis timeout = session->events.top().due - Now();
+    return static_cast<int>(std::max<Millis>(0, std::min<Millis>(timeout, kNoEventTimeout)));
+}
+
+void World::RequestMetadata(Loadable *object) {
+    int latency = config_.metadata_latency;
+    if (latency <= 0) {
+        object->Request(0);
+        return;
+    }
+
+    Millis due = Now() + latency;
+    if (!object->Request(due))
+        return;
+
+    sp_session *session = GetActiveSession();
+    if (session) {
+        Schedule(session, due, [session] {
+            if (session->callbacks.metadata_updated)
+                session->callbacks.metadata_updated(session);
+        }, true);
+    }
+}
+
+void World::Request(Loadable *object, int latency, const std::function<void ()> &on_loaded) {
+    Millis due = latency > 0 ? Now() + latency : 0;
+    if (!object->Request(due))
+        return;
+
+    sp_session *session = GetActiveSession();
+    if (session)
+        Schedule(session, std::max(due, Now()), on_loaded);
+}
+
+void World::RequestContainer() {
+    sp_playlistcontainer *pc = container;
+    Request(&pc->load, config_.container_latency, [this, pc] {
+        std::vector<Subscription<sp_playlistcontainer_callbacks>> subscriptions;
+        std::vector<sp_playlist *> contents;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pc->loaded_notified = true;
+            subscriptions = pc->subscriptions;
+            for (std::size_t i = 0; i < pc->entries.size(); ++i) {
+                if (pc->entries[i].playlist)
+                    contents.push_back(pc->entries[i].playlist);
+            }
+        }
+        // playlists start loading once the container knows about them
+        for (std::size_t i = 0; i < contents.size(); ++i)
+            RequestPlayList(contents[i]);
+        for (std::size_t i = 0; i < subscriptions.size(); ++i) {
+            if (subscriptions[i].callbacks.container_loaded)
+                subscriptions[i].callbacks.container_loaded(pc, subscriptions[i].userdata);
+        }
+    });
+}
+
+void World::RequestPlayList(sp_playlist *playlist) {
+    Request(&playlist->load, config_.playlist_latency, [this, playlist] {
+        std::vector<Subscription<sp_playlist_callbacks>> subscriptions;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            subscriptions = playlist->subscriptions;
+        }
+        for (std::size_t i = 0; i < subscriptions.size(); ++i) {
+            if (subscriptions[i].callbacks.playlist_state_changed)
+                subscriptions[i].callbacks.playlist_state_changed(playlist, subscriptions[i].userdata);
+        }
+    });
+}
+
+sp_image *World::AcquireImage(const std::string &id) {
+    sp_image *image = NULL;
+    bool created = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<std::string, sp_image *>::iterator it = images_.find(id);
+        if (it != images_.end()) {
+            image = it->second;
+        } else {
+            image = new sp_image();
+            image->refs = 1;  // held by the pending load
+            image->id = id;
+            image->loaded_notified = false;
+            image->data.resize(std::max(0, config_.image_size));
+            for (std::size_t i = 0; i < image->data.size(); ++i)
+                image->data[i] = static_cast<byte>(id[4] + i);
+            images_[id] = image;
+            created = true;
+        }
+        ++image->refs;
+    }
+
+    if (created) {
+        Request(&image->load, config_.image_latency, [this, image] {
+            std::vector<std::pair<image_loaded_cb *, void *>> subscriptions;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                image->loaded_notified = true;
+                subscriptions = image->subscriptions;
+            }
+            for (std::size_t i = 0; i < subscriptions.size(); ++i)
+                subscriptions[i].first(image, subscriptions[i].second);
+            ReleaseImage(image);
+        });
+    }
+
+    return image;
+}
+
+void World::ReleaseImage(sp_image *image) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--image->refs == 0) {
+        images_.erase(image->id);
+        delete image;
+    }
+}
+
+void World::Load(sp_session *session, sp_track *track) {
+    std::lock_guard<std::mutex> lock(session->player_mutex);
+    session->track = track;
+    session->playing = false;
+    session->position = 0;
+    session->player_wakeup.notify_all();
+}
+
+void World::Play(sp_session *session, bool play) {
+    std::lock_guard<std::mutex> lock(session->player_mutex);
+    session->playing = play && session->track;
+    session->player_wakeup.notify_all();
+}
+
+void World::Seek(sp_session *session, int offset) {
+    std::lock_guard<std::mutex> lock(session->player_mutex);
+    session->position = static_cast<long long>(offset) * kSampleRate / 1000;
+    session->player_wakeup.notify_all();
+}
+
+void World::NotifierLoop(sp_session *session) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (session->alive) {
+        if (session->events.empty() || session->notify_pending) {
+            session->wakeup.wait(lock);
+            continue;
+        }
+
+        Millis wait = session->events.top().due - Now();
+        if (wait > 0) {
+            session->wakeup.wait_for(lock, std::chrono::milliseconds(wait));
+            continue;
+        }
+
+        session->notify_pending = true;
+        int burst = std::max(1, config_.notify_burst);
+        lock.unlock();
+        for (int i = 0; i < burst; ++i) {
+            notify_main_thread.fetch_add(1, std::memory_order_relaxed);
+            if (session->callbacks.notify_main_thread)
+                session->callbacks.notify_main_thread(session);
+        }
+        lock.lock();
+    }
+}
+
+void World::AudioLoop(sp_session *session) {
+    const int frames_per_delivery = std::max(1, config_.frames_per_delivery);
+    const bool realtime = config_.realtime_audio;
+    std::vector<std::int16_t> buffer(frames_per_delivery * kChannels);
+    sp_audioformat format;
+    format.sample_type = SP_SAMPLETYPE_INT16_NATIVE_ENDIAN;
+    format.sample_rate = kSampleRate;
+    format.channels = kChannels;
+
+    bool started = false;
+    std::unique_lock<std::mutex> lock(session->player_mutex);
+    while (session->alive) {
+        if (!session->playing) {
+            if (started) {
+                started = false;
+                lock.unlock();
+                if (session->callbacks.stop_playback)
+                    session->callbacks.stop_playback(session);
+                lock.lock();
+            } else {
+                session->player_wakeup.wait(lock);
+            }
+            continue;
+        }
+
+        if (!started) {
+            started = true;
+            lock.unlock();
+            if (session->callbacks.start_playback)
+                session->callbacks.start_playback(session);
+            lock.lock();
+            continue;
+        }
+
+        long long total = static_cast<long long>(session->track->duration) * kSampleRate / 1000;
+        if (session->position >= total) {
+            session->playing = false;
+            session->position = 0;
+            started = false;
+            lock.unlock();
+            if (session->callbacks.end_of_track)
+                session->callbacks.end_of_track(session);
+            lock.lock();
+            continue;
+        }
+
+        long long start = session->position;
+        int frames = static_cast<int>(std::min<long long>(frames_per_delivery, total - start));
+        for (int i = 0; i < frames * kChannels; ++i)
+            buffer[i] = static_cast<std::int16_t>((start * kChannels + i) & 0x7FFF);
+
+        lock.unlock();
+        int consumed = 0;
+        if (session->callbacks.music_delivery)
+            consumed = session->callbacks.music_delivery(session, &format, &buffer[0], frames);
+        consumed = std::max(0, std::min(consumed, frames));
+        music_delivery.fetch_add(1, std::memory_order_relaxed);
+        frames_delivered.fetch_add(frames, std::memory_order_relaxed);
+        frames_consumed.fetch_add(consumed, std::memory_order_relaxed);
+        if (session->callbacks.get_audio_buffer_stats) {
+            sp_audio_buffer_stats stats = {0, 0};
+            session->callbacks.get_audio_buffer_stats(session, &stats);
+            stutter.fetch_add(std::max(0, stats.stutter), std::memory_order_relaxed);
+            buffered_samples.store(std::max(0, stats.samples), std::memory_order_relaxed);
+        }
+        lock.lock();
+
+        // a seek while the frames were being delivered wins over the delivery
+        if (session->position == start)
+            session->position += consumed;
+
+        if (consumed == 0)
+            session->player_wakeup.wait_for(lock, std::chrono::milliseconds(10));
+        else if (realtime)
+            session->player_wakeup.wait_for(lock, std::chrono::milliseconds(consumed * 1000LL / kSampleRate));
+    }
+}
+
+void Configure(const CatalogConfig &config) {
+    World::Instance().Configure(config);
+}
+
+const CatalogConfig &GetConfig() {
+    return World::Instance().GetConfig();
+}
+
+sp_playlist *GetPlayList(int index) {
+    World &world = World::Instance();
+    if (index < 0 || static_cast<std::size_t>(index) >= world.playlists.size())
+        return NULL;
+    world.RequestPlayList(world.playlists[index]);
+    return world.playlists[index];
+}
+
+sp_track *GetTrack(int index) {
+    World &world = World::Instance();
+    if (index < 0 || static_cast<std::size_t>(index) >= world.tracks.size())
+        return NULL;
+    world.RequestMetadata(&world.tracks[index]->load);
+    return world.tracks[index];
+}
+
+int GetRefCount(sp_track *track) {
+    return track->refs;
+}
+
+namespace {
+// Applies an edit to a playlist and reports it from the next process_events of the active session
+void EditPlayList(int index, const std::function<void (sp_playlist *)> &apply,
+                  const std::function<void (sp_playlist *, const Subscription<sp_playlist_callbacks> &)> &report) {
+    World &world = World::Instance();
+    sp_session *session = world.GetActiveSession();
+    if (!session || index < 0 || static_cast<std::size_t>(index) >= world.playlists.size())
+        return;
+
+    sp_playlist *playlist = world.playlists[index];
+    world.Schedule(session, Now(), [&world, playlist, apply, report] {
+        std::vector<Subscription<sp_playlist_callbacks>> subscriptions;
+        {
+            std::lock_guard<std::mutex> lock(world.GetMutex());
+            apply(playlist);
+            subscriptions = playlist->subscriptions;
+        }
+        for (std::size_t i = 0; i < subscriptions.size(); ++i)
+            report(playlist, subscriptions[i]);
+    }, false);
+}
+}
+
+void AddTracks(int playlist, const int *tracks, int num_tracks, int position) {
+    World &world = World::Instance();
+    std::vector<sp_track *> added;
+    for (int i = 0; i < num_tracks; ++i) {
+        added.push_back(world.tracks[tracks[i] % world.tracks.size()]);
+        world.RequestMetadata(&added.back()->load);
+    }
+
+    EditPlayList(playlist, [added, position](sp_playlist *pl) {
+        pl->tracks.insert(pl->tracks.begin() + position, added.begin(), added.end());
+    }, [added, position](sp_playlist *pl, const Subscription<sp_playlist_callbacks> &subscription) {
+        if (subscription.callbacks.tracks_added && !added.empty())
+            subscription.callbacks.tracks_added(pl, &added[0], static_cast<int>(added.size()), position,
+                                                subscription.userdata);
+    });
+}
+
+void RemoveTracks(int playlist, const int *positions, int num_positions) {
+    std::vector<int> removed(positions, positions + num_positions);
+
+    EditPlayList(playlist, [removed](sp_playlist *pl) {
+        std::vector<sp_track *> kept;
+        for (std::size_t i = 0; i < pl->tracks.size(); ++i) {
+            if (std::find(removed.begin(), removed.end(), static_cast<int>(i)) == removed.end())
+                kept.push_back(pl->tracks[i]);
+        }
+        pl->tracks.swap(kept);
+    }, [removed](sp_playlist *pl, const Subscription<sp_playlist_callbacks> &subscription) {
+        if (subscription.callbacks.tracks_removed && !removed.empty())
+            subscription.callbacks.tracks_removed(pl, &removed[0], static_cast<int>(removed.size()),
+                                                  subscription.userdata);
+    });
+}
+
+void MoveTracks(int playlist, const int *positions, int num_positions, int new_position) {
+    std::vector<int> moved(positions, positions + num_positions);
+
+    EditPlayList(playlist, [moved, new_position](sp_playlist *pl) {
+        // the straightforward way, tests compare the wrapper against it
+        std::vector<sp_track *> before, block, after;
+        for (std::size_t i = 0; i < pl->tracks.size(); ++i) {
+            if (std::find(moved.begin(), moved.end(), static_cast<int>(i)) != moved.end())
+                block.push_back(pl->tracks[i]);
+            else if (static_cast<int>(i) < new_position)
+                before.push_back(pl->tracks[i]);
+            else
+                after.push_back(pl->tracks[i]);
+        }
+        before.insert(before.end(), block.begin(), block.end());
+        before.insert(before.end(), after.begin(), after.end());
+        pl->tracks.swap(before);
+    }, [moved, new_position](sp_playlist *pl, const Subscription<sp_playlist_callbacks> &subscription) {
+        if (subscription.callbacks.tracks_moved && !moved.empty())
+            subscription.callbacks.tracks_moved(pl, &moved[0], static_cast<int>(moved.size()), new_position,
+                                                subscription.userdata);
+    });
+}
+
+namespace {
+typedef std::function<void (sp_playlistcontainer *, const Subscription<sp_playlistcontainer_callbacks> &)> Report;
+
+// Applies an edit to the container and reports it from the next process_events of the active session, one callback
+// per entry returned by apply
+void EditContainer(const std::function<std::vector<Report> (sp_playlistcontainer *)> &apply) {
+    World &world = World::Instance();
+    sp_session *session = world.GetActiveSession();
+    if (!session)
+        return;
+
+    sp_playlistcontainer *pc = world.container;
+    world.Schedule(session, Now(), [&world, pc, apply] {
+        std::vector<Subscription<sp_playlistcontainer_callbacks>> subscriptions;
+        std::vector<Report> reports;
+        {
+            std::lock_guard<std::mutex> lock(world.GetMutex());
+            reports = apply(pc);
+            subscriptions = pc->subscriptions;
+        }
+        for (std::size_t r = 0; r < reports.size(); ++r) {
+            for (std::size_t i = 0; i < subscriptions.size(); ++i)
+                reports[r](pc, subscriptions[i]);
+        }
+    }, false);
+}
+
+Report ReportAdded(sp_playlist *playlist, int position) {
+    return [playlist, position](sp_playlistcontainer *pc,
+                                const Subscription<sp_playlistcontainer_callbacks> &subscription) {
+        if (subscription.callbacks.playlist_added)
+            subscription.callbacks.playlist_added(pc, playlist, position, subscription.userdata);
+    };
+}
+
+Report ReportRemoved(sp_playlist *playlist, int position) {
+    return [playlist, position](sp_playlistcontainer *pc,
+                                const Subscription<sp_playlistcontainer_callbacks> &subscription) {
+        if (subscription.callbacks.playlist_removed)
+            subscription.callbacks.playlist_removed(pc, playlist, position, subscription.userdata);
+    };
+}
+
+// the position of the end marker of the folder starting at position
+int FolderEnd(sp_playlistcontainer *pc, int position) {
+    int depth = 0;
+    for (std::size_t i = position; i < pc->entries.size(); ++i) {
+        if (pc->entries[i].type == SP_PLAYLIST_TYPE_START_FOLDER)
+            ++depth;
+        else if (pc->entries[i].type == SP_PLAYLIST_TYPE_END_FOLDER && --depth == 0)
+            return static_cast<int>(i);
+    }
+    return static_cast<int>(pc->entries.size()) - 1;
+}
+
+// the position of the start marker of the folder ending at position
+int FolderStart(sp_playlistcontainer *pc, int position) {
+    int depth = 0;
+    for (int i = position; i >= 0; --i) {
+        if (pc->entries[i].type == SP_PLAYLIST_TYPE_END_FOLDER)
+            ++depth;
+        else if (pc->entries[i].type == SP_PLAYLIST_TYPE_START_FOLDER && --depth == 0)
+            return i;
+    }
+    return 0;
+}
+}
+
+void AddPlayList(int playlist, int position) {
+    World &world = World::Instance();
+    if (playlist < 0 || static_cast<std::size_t>(playlist) >= world.playlists.size())
+        return;
+    sp_playlist *added = world.playlists[playlist];
+    world.RequestPlayList(added);
+
+    EditContainer([added, position](sp_playlistcontainer *pc) {
+        sp_playlistcontainer::Entry entry = {SP_PLAYLIST_TYPE_PLAYLIST, added, "", 0};
+        pc->entries.insert(pc->entries.begin() + position, entry);
+        return std::vector<Report>(1, ReportAdded(added, position));
+    });
+}
+
+void AddFolder(const std::string &name, sp_uint64 group_id, int position) {
+    EditContainer([name, group_id, position](sp_playlistcontainer *pc) {
+        sp_playlistcontainer::Entry start = {SP_PLAYLIST_TYPE_START_FOLDER, NULL, name, group_id};
+        sp_playlistcontainer::Entry end = {SP_PLAYLIST_TYPE_END_FOLDER, NULL, "", group_id};
+        pc->entries.insert(pc->entries.begin() + position, end);
+        pc->entries.insert(pc->entries.begin() + position, start);
+
+        std::vector<Report> reports;
+        reports.push_back(ReportAdded(NULL, position));
+        reports.push_back(ReportAdded(NULL, position + 1));
+        return reports;
+    });
+}
+
+void RemovePlayList(int position) {
+    EditContainer([position](sp_playlistcontainer *pc) {
+        std::vector<Report> reports;
+        switch (pc->entries[position].type) {
+            case SP_PLAYLIST_TYPE_START_FOLDER:
+            case SP_PLAYLIST_TYPE_END_FOLDER: {
+                // both markers go, the contents stay
+                int start = pc->entries[position].type == SP_PLAYLIST_TYPE_START_FOLDER ? position
+                                                                                       : FolderStart(pc, position);
+                int end = FolderEnd(pc, start);
+                pc->entries.erase(pc->entries.begin() + end);
+                pc->entries.erase(pc->entries.begin() + start);
+                reports.push_back(ReportRemoved(NULL, start));
+                reports.push_back(ReportRemoved(NULL, end - 1));
+            }   break;
+            default: {
+                sp_playlist *removed = pc->entries[position].playlist;
+                pc->entries.erase(pc->entries.begin() + position);
+                reports.push_back(ReportRemoved(removed, position));
+            }   break;
+        }
+        return reports;
+    });
+}
+
+void MovePlayList(int position, int new_position) {
+    EditContainer([position, new_position](sp_playlistcontainer *pc) {
+        // new_position is an index before the move, like for MoveTracks. A folder moves with its contents.
+        int last = pc->entries[position].type == SP_PLAYLIST_TYPE_START_FOLDER ? FolderEnd(pc, position) + 1
+                                                                               : position + 1;
+        std::vector<sp_playlistcontainer::Entry> block(pc->entries.begin() + position, pc->entries.begin() + last);
+        sp_playlist *moved = block.front().playlist;
+        if (new_position < position || new_position > last) {
+            pc->entries.erase(pc->entries.begin() + position, pc->entries.begin() + last);
+            int target = new_position > position ? new_position - (last - position) : new_position;
+            pc->entries.insert(pc->entries.begin() + target, block.begin(), block.end());
+        }
+
+        return std::vector<Report>(1, [moved, position, new_position](
+                sp_playlistcontainer *pc, const Subscription<sp_playlistcontainer_callbacks> &subscription) {
+            if (subscription.callbacks.playlist_moved)
+                subscription.callbacks.playlist_moved(pc, moved, position, new_position, subscription.userdata);
+        });
+    });
+}
+
+Counters GetCounters() {
+    World &world = World::Instance();
+    Counters counters;
+    counters.api_calls = world.api_calls;
+    counters.process_events = world.process_events;
+    counters.notify_main_thread = world.notify_main_thread;
+    counters.music_delivery = world.music_delivery;
+    counters.frames_delivered = world.frames_delivered;
+    counters.frames_consumed = world.frames_consumed;
+    counters.stutter = world.stutter;
+    counters.buffered_samples = world.buffered_samples;
+    return counters;
+}
+
+void StopSessions() {
+    World::Instance().StopSessions();
+}
+
+void ResetCounters() {
+    World &world = World::Instance();
+    world.api_calls = 0;
+    world.process_events = 0;
+    world.notify_main_thread = 0;
+    world.music_delivery = 0;
+    world.frames_delivered = 0;
+    world.frames_consumed = 0;
+    world.stutter = 0;
+    world.buffered_samples = 0;
+}
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright 2012 Alexander Rojas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+// libspotify includes
+#include <libspotify/api.h>
+
+// C-libs includes
+#include <cstdint>
+
+// std includes
+#include <condition_variable>
+#include <functional>
+#include <utility>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <queue>
+#include <map>
+
+#include "fakespotify/FakeSpotify.hpp"
+
+namespace fakespotify {
+/// @brief Milliseconds on the monotonic clock
+typedef long long Millis;
+Millis Now();
+
+/// @brief Load state of a catalog object. Objects are not requested until the api hands them out for the first
+/// time, after which they become loaded once the configured latency has passed.
+class Loadable {
+  public:
+    static const Millis kNotRequested;
+
+    Loadable();
+
+    bool IsLoaded() const;
+    bool IsRequested() const;
+
+    /// @return true for the call that actually requested the object
+    bool Request(Millis ready_at);
+
+  private:
+    std::atomic<long long> ready_at_;
+};
+
+struct Event {
+    Millis due;
+    std::uint64_t sequence;
+    bool is_metadata;
+    std::function<void ()> fire;
+};
+
+struct EventOrder {
+    bool operator()(const Event &lhs, const Event &rhs) const {
+        if (lhs.due != rhs.due)
+            return lhs.due > rhs.due;
+        return lhs.sequence > rhs.sequence;
+    }
+};
+
+template <typename Callbacks>
+struct Subscription {
+    Callbacks callbacks;
+    void *userdata;
+};
+
+std::string MakeImageId(char kind, int index);
+}
+
+// The opaque libspotify types, defined in the global namespace where api.h declares them
+struct sp_user {
+    std::string name;
+};
+
+struct sp_artist {
+    fakespotify::Loadable load;
+    std::atomic<int> refs;
+    int index;
+    std::string name;
+    std::string portrait;
+};
+
+struct sp_album {
+    fakespotify::Loadable load;
+    std::atomic<int> refs;
+    int index;
+    std::string name;
+    std::string cover;
+    int year;
+    sp_artist *artist;
+    std::vector<sp_track *> tracks;
+};
+
+struct sp_track {
+    fakespotify::Loadable load;
+    std::atomic<int> refs;
+    int index;
+    std::string name;
+    int duration;
+    int popularity;
+    int disc;
+    int album_index;
+    std::atomic<bool> starred;
+    sp_album *album;
+    std::vector<sp_artist *> artists;
+};
+
+struct sp_playlist {
+    fakespotify::Loadable load;
+    std::atomic<int> refs;
+    int index;
+    std::string name;
+    std::vector<sp_track *> tracks;
+    std::vector<fakespotify::Subscription<sp_playlist_callbacks>> subscriptions;
+};
+
+struct sp_playlistcontainer {
+    struct Entry {
+        sp_playlist_type type;
+        sp_playlist *playlist;
+        std::string folder_name;
+        sp_uint64 folder_id;
+    };
+
+    fakespotify::Loadable load;
+    std::atomic<int> refs;
+    bool loaded_notified;
+    std::vector<Entry> entries;
+    std::vector<fakespotify::Subscription<sp_playlistcontainer_callbacks>> subscriptions;
+};
+
+// a link to a playlist, freed by its last sp_link_release
+struct sp_link {
+    std::atomic<int> refs;
+    std::string uri;
+};
+
+struct sp_image {
+    fakespotify::Loadable load;
+    std::atomic<int> refs;
+    std::string id;
+    std::vector<byte> data;
+    bool loaded_notified;
+    std::vector<std::pair<image_loaded_cb *, void *>> subscriptions;
+};
+
+struct sp_albumbrowse {
+    fakespotify::Loadable load;
+    std::atomic<int> refs;
+    sp_error error;  // reported once loaded
+    sp_album *album;
+    std::vector<sp_track *> tracks;
+    std::vector<std::string> copyrights;
+    std::string review;
+    albumbrowse_complete_cb *callback;
+    void *userdata;
+};
+
+struct sp_artistbrowse {
+    fakespotify::Loadable load;
+    std::atomic<int> refs;
+    sp_error error;  // reported once loaded
+    sp_artist *artist;
+    std::vector<std::string> portraits;
+    std::vector<sp_track *> tracks;
+    std::vector<sp_album *> albums;
+    std::vector<sp_artist *> similar;
+    std::string biography;
+    artistbrowse_complete_cb *callback;
+    void *userdata;
+};
+
+struct sp_session {
+    sp_session_callbacks callbacks;
+    void *userdata;
+    std::atomic<bool> alive;
+    std::atomic<int> state;
+    sp_user user;
+
+    // pending work for sp_session_process_events, guarded by the world mutex
+    std::priority_queue<fakespotify::Event, std::vector<fakespotify::Event>, fakespotify::EventOrder> events;
+    std::uint64_t next_sequence;
+    bool notify_pending;
+    std::condition_variable wakeup;
+    std::thread notifier;
+
+    // player state, guarded by player_mutex
+    std::mutex player_mutex;
+    std::condition_variable player_wakeup;
+    sp_track *track;
+    bool playing;
+    long long position;
+    std::thread audio;
+};
+
+namespace fakespotify {
+/// @brief The synthetic catalog together with every session created against it
+class World {
+  public:
+    static World &Instance();
+
+    ~World();
+
+    void Configure(const CatalogConfig &config);
+    const CatalogConfig &GetConfig() const;
+
+    sp_session *CreateSession(const sp_session_config *config);
+    void ReleaseSession(sp_session *session);
+    void StopSessions();
+    sp_session *GetActiveSession();
+
+    /// @brief Queues work for sp_session_process_events and wakes the notifier
+    void Schedule(sp_session *session, Millis due, const std::function<void ()> &fire, bool is_metadata = false);
+    int ProcessEvents(sp_session *session);
+
+    /// @brief Requests metadata for an object, metadata_updated follows once it is loaded
+    void RequestMetadata(Loadable *object);
+    /// @brief Requests an object whose load is announced by its own callback
+    void Request(Loadable *object, int latency, const std::function<void ()> &on_loaded);
+
+    void RequestContainer();
+    void RequestPlayList(sp_playlist *playlist);
+
+    sp_image *AcquireImage(const std::string &id);
+    void ReleaseImage(sp_image *image);
+
+    void Play(sp_session *session, bool play);
+    void Load(sp_session *session, sp_track *track);
+    void Seek(sp_session *session, int offset);
+
+    std::mutex &GetMutex();
+
+    std::vector<sp_artist *> artists;
+    std::vector<sp_album *> albums;
+    std::vector<sp_track *> tracks;
+    std::vector<sp_playlist *> playlists;
+    sp_playlistcontainer *container;
+    sp_playlist *starred;
+
+    std::atomic<std::uint64_t> api_calls;
+    std::atomic<std::uint64_t> process_events;
+    std::atomic<std::uint64_t> notify_main_thread;
+    std::atomic<std::uint64_t> music_delivery;
+    std::atomic<std::uint64_t> frames_delivered;
+    std::atomic<std::uint64_t> frames_consumed;
+    std::atomic<std::uint64_t> stutter;
+    std::atomic<std::uint64_t> buffered_samples;
+
+  private:
+    World();
+
+    void Clear();
+    void StopSession(sp_session *session);
+    void NotifierLoop(sp_session *session);
+    void AudioLoop(sp_session *session);
+
+    CatalogConfig config_;
+    std::mutex mutex_;
+    std::vector<sp_session *> sessions_;
+    std::map<std::string, sp_image *> images_;
+};
+
+inline void CountCall() {
+    World::Instance().api_calls.fetch_add(1, std::memory_order_relaxed);
+}
+}